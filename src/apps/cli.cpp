@@ -63,6 +63,12 @@
     cli.add_option("", "", "scene", "Path to scene description file", cxxopts::value<std::filesystem::path>(), "<file>");
     cli.add_option("", "D", "define", "Parameter definitions to override scene description macros.",
                    cxxopts::value<std::vector<luisa::string>>()->default_value("<none>"), "<key>=<value>");
+    cli.add_option("", "t", "time-budget", "Wall-clock time budget in seconds after which sampling stops and the images are written (0 = unlimited)",
+                   cxxopts::value<double>()->default_value("0"), "<seconds>");
+    cli.add_option("", "", "checkpoint", "File to periodically save the render progress to and to resume from if it exists",
+                   cxxopts::value<std::filesystem::path>(), "<file>");
+    cli.add_option("", "", "checkpoint-interval", "Seconds between two checkpoints",
+                   cxxopts::value<double>()->default_value("300"), "<seconds>");
     cli.add_option("", "h", "help", "Display this help message", cxxopts::value<bool>()->default_value("false"), "");
     cli.allow_unrecognised_options();
     cli.positional_help("<file>");
@@ -166,6 +172,16 @@ int main(int argc, char *argv[]) {
     auto backend = options["backend"].as<luisa::string>();
     auto index = options["device"].as<int32_t>();
     auto path = options["scene"].as<std::filesystem::path>();
+    Integrator::RenderOptions render_options;
+    if (auto budget = options["time-budget"].as<double>(); budget > 0.) {
+        render_options.deadline = std::chrono::steady_clock::now() +
+                                  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                      std::chrono::duration<double>{budget});
+    }
+    if (options["checkpoint"].count() != 0u) {
+        render_options.checkpoint = options["checkpoint"].as<std::filesystem::path>();
+        render_options.checkpoint_interval = std::max(options["checkpoint-interval"].as<double>(), 1.);
+    }
     compute::DeviceConfig config;
     config.device_index = index;
     config.inqueue_buffer_limit = false;// Do not limit the number of in-queue buffers --- we are doing offline rendering!
@@ -180,6 +196,6 @@ int main(int argc, char *argv[]) {
     auto scene = Scene::create(context, scene_desc.get());
     auto stream = device.create_stream(StreamTag::GRAPHICS);
     auto pipeline = Pipeline::create(device, stream, *scene);
-    pipeline->render(stream);
+    pipeline->render(stream, render_options);
     stream.synchronize();
 }
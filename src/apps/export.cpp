@@ -61,18 +61,6 @@ int main(int argc, char *argv[]) {
                path.filename().string(), scene->mNumCameras,
                scene->mNumMeshes, scene->mNumMaterials);
 
-    for (auto i = 0u; i < scene->mNumLights; i++) {
-        auto light = scene->mLights[i];
-        switch (light->mType) {
-            case aiLightSource_DIRECTIONAL: LUISA_WARNING("Ignoring punctual light #{}: DIRECTIONAL('{}')", i, light->mName.C_Str()); break;
-            case aiLightSource_POINT: LUISA_WARNING("Ignoring punctual light #{}: POINT('{}')", i, light->mName.C_Str()); break;
-            case aiLightSource_SPOT: LUISA_WARNING("Ignoring punctual light #{}: SPOT('{}')", i, light->mName.C_Str()); break;
-            case aiLightSource_AMBIENT: LUISA_WARNING("Ignoring punctual light #{}: AMBIENT('{}')", i, light->mName.C_Str()); break;
-            case aiLightSource_AREA: LUISA_WARNING("Ignoring punctual light #{}: AREA('{}')", i, light->mName.C_Str()); break;
-            default: LUISA_WARNING("Ignoring punctual light #{}: Undefined('{}')", i, light->mName.C_Str()); break;
-        }
-    };
-
     // convert
     json scene_materials;
     json scene_geometry;
@@ -493,6 +481,52 @@ int main(int argc, char *argv[]) {
             }
         }
     }
+    // punctual lights, placed by the nodes of the same names
+    std::vector<json::string_t> punctual_lights;
+    for (auto i = 0u; i < scene->mNumLights; i++) {
+        auto light = scene->mLights[i];
+        auto is_spot = light->mType == aiLightSource_SPOT;
+        if (light->mType != aiLightSource_POINT && !is_spot) {
+            switch (light->mType) {
+                case aiLightSource_DIRECTIONAL: LUISA_WARNING("Ignoring punctual light #{}: DIRECTIONAL('{}')", i, light->mName.C_Str()); break;
+                case aiLightSource_AMBIENT: LUISA_WARNING("Ignoring punctual light #{}: AMBIENT('{}')", i, light->mName.C_Str()); break;
+                case aiLightSource_AREA: LUISA_WARNING("Ignoring punctual light #{}: AREA('{}')", i, light->mName.C_Str()); break;
+                default: LUISA_WARNING("Ignoring punctual light #{}: Undefined('{}')", i, light->mName.C_Str()); break;
+            }
+            continue;
+        }
+        aiMatrix4x4 transform;
+        if (auto node = scene->mRootNode->FindNode(light->mName)) {
+            transform = node->mTransformation;
+            for (auto n = node->mParent; n != nullptr; n = n->mParent) {
+                transform = n->mTransformation * transform;
+            }
+        }
+        auto position = transform * light->mPosition;
+        auto c = light->mColorDiffuse;
+        json::string_t light_name{luisa::format("PunctualLight:{:05}:{}", i, light->mName.C_Str())};
+        scene_geometry[light_name] = {
+            {"type", "Light"},
+            {"impl", is_spot ? "Spot" : "Point"},
+            {"prop",
+             {{"position", {position.x, position.y, position.z}},
+              {"emission",
+               {{"impl", "Constant"},
+                {"prop", {{"v", {c.r, c.g, c.b}}}}}}}}};
+        if (is_spot) {
+            // cone angles in assimp are full angles in radians
+            auto direction = (aiMatrix3x3{transform} * light->mDirection).NormalizeSafe();
+            auto outer = luisa::degrees(light->mAngleOuterCone);
+            auto inner = std::min(luisa::degrees(light->mAngleInnerCone), outer);
+            scene_geometry[light_name]["prop"]["direction"] = {direction.x, direction.y, direction.z};
+            scene_geometry[light_name]["prop"]["angle"] = outer;
+            scene_geometry[light_name]["prop"]["falloff"] = .5f * (outer - inner);
+        }
+        LUISA_INFO("Found punctual light '{}'.", light_name);
+        punctual_lights.emplace_back(luisa::format("@{}", light_name));
+    }
+    has_lights |= !punctual_lights.empty();
+
     scene_geometry["lr_exported_geometry"] = {
         {"type", "Shape"},
         {"impl", "Group"},
@@ -567,6 +601,9 @@ int main(int argc, char *argv[]) {
     scene_configs["render"] = {{"cameras", std::move(cameras)},
                                {"shapes", {"@lr_exported_geometry"}},
                                {"integrator", {{"impl", "WavePath"}, {"prop", {{"sampler", {{"impl", "PMJ02BN"}}}}}}}};
+    if (!punctual_lights.empty()) {
+        scene_configs["render"]["lights"] = std::move(punctual_lights);
+    }
     if (!has_lights) {
         scene_configs["render"]["environment"] = {
             {"impl", "Spherical"},
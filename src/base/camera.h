@@ -105,10 +105,14 @@ public:
     [[nodiscard]] auto transform() const noexcept { return _transform; }
     [[nodiscard]] auto shutter_span() const noexcept { return _shutter_span; }
     [[nodiscard]] auto shutter_weight(float time) const noexcept -> float;
+    [[nodiscard]] auto shutter_points() const noexcept { return luisa::span{_shutter_points}; }
     [[nodiscard]] auto shutter_samples() const noexcept -> luisa::vector<ShutterSample>;
     [[nodiscard]] auto spp() const noexcept { return _spp; }
     [[nodiscard]] auto file() const noexcept { return _file; }
     [[nodiscard]] virtual bool requires_lens_sampling() const noexcept = 0;
+    // world-space size of a pixel at `distance` in front of the camera, for selecting levels of detail;
+    // zero if unknown, which keeps the full detail
+    [[nodiscard]] virtual float pixel_footprint(float distance) const noexcept { return 0.f; }
     [[nodiscard]] virtual luisa::unique_ptr<Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept = 0;
 };
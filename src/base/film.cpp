@@ -23,4 +23,28 @@ void Film::Instance::accumulate(Expr<uint2> pixel, Expr<float3> rgb,
     };
 }
 
+void Film::Instance::set_window(CommandBuffer &command_buffer, uint2 offset, uint2 size) noexcept {
+    LUISA_ERROR_WITH_LOCATION(
+        "Film '{}' does not support windows.",
+        node()->impl_type());
+}
+
+Float Film::Instance::relative_error(Expr<uint2> pixel) const noexcept {
+    LUISA_ERROR_WITH_LOCATION(
+        "Film '{}' does not track variance.",
+        node()->impl_type());
+}
+
+void Film::Instance::save_checkpoint(CommandBuffer &command_buffer, std::byte *data) const noexcept {
+    LUISA_ERROR_WITH_LOCATION(
+        "Film '{}' does not support checkpoints.",
+        node()->impl_type());
+}
+
+void Film::Instance::load_checkpoint(CommandBuffer &command_buffer, const std::byte *data) noexcept {
+    LUISA_ERROR_WITH_LOCATION(
+        "Film '{}' does not support checkpoints.",
+        node()->impl_type());
+}
+
 }// namespace luisa::render
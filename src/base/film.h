@@ -41,6 +41,24 @@ public:
         virtual void prepare(CommandBuffer &command_buffer) noexcept = 0;
         virtual void clear(CommandBuffer &command_buffer) noexcept = 0;
         virtual void download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept = 0;
+        // Restricts the film to a cleared window so that only the window is kept on device,
+        // e.g., for tiled rendering. Pixels passed to accumulate() and read() stay in film
+        // coordinates and must lie inside the window, and download() only returns the window.
+        // prepare() resets the window to the whole film.
+        virtual void set_window(CommandBuffer &command_buffer, uint2 offset, uint2 size) noexcept;
+        // Whether set_window() may be used, e.g., for tiled rendering.
+        [[nodiscard]] virtual bool supports_windows() const noexcept { return false; }
+        // Whether the film accumulates the second moment of the samples, so that
+        // relative_error() may be used to test per-pixel convergence.
+        [[nodiscard]] virtual bool tracks_variance() const noexcept { return false; }
+        // Estimated relative standard error of the mean luminance of the pixel.
+        [[nodiscard]] virtual Float relative_error(Expr<uint2> pixel) const noexcept;
+        // Raw accumulation state of the current window, e.g., for checkpointing. Films
+        // that cannot save their state report a zero size. The copies are only enqueued,
+        // so the host memory must stay alive until the command buffer is synchronized.
+        [[nodiscard]] virtual size_t checkpoint_size() const noexcept { return 0u; }
+        virtual void save_checkpoint(CommandBuffer &command_buffer, std::byte *data) const noexcept;
+        virtual void load_checkpoint(CommandBuffer &command_buffer, const std::byte *data) noexcept;
         virtual bool show(CommandBuffer &command_buffer) const noexcept { return false; }
         virtual void release() noexcept = 0;
     };
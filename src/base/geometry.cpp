@@ -3,29 +3,704 @@
 //
 
 #include <util/sampling.h>
+#include <util/half.h>
 #include <util/thread_pool.h>
+#include <util/light_tree.h>
+#include <util/analytic_primitive.h>
+#include <util/xform.h>
+#include <base/camera.h>
 #include <base/geometry.h>
 #include <base/pipeline.h>
 
 namespace luisa::render {
 
+namespace detail {
+
+// Triangles are sampled by area, or by power if the emission varies over the mesh,
+// in which case `emission` holds the emitted strength averaged over each triangle.
+[[nodiscard]] static auto geometry_area_sampling_table(luisa::span<const Vertex> vertices,
+                                                       luisa::span<const Triangle> triangles,
+                                                       luisa::span<const float> emission) noexcept {
+    luisa::vector<float> triangle_areas(triangles.size());
+    for (auto j = 0u; j < triangles.size(); j++) {
+        auto t = triangles[j];
+        auto p0 = vertices[t.i0].position();
+        auto p1 = vertices[t.i1].position();
+        auto p2 = vertices[t.i2].position();
+        triangle_areas[j] = std::abs(length(cross(p1 - p0, p2 - p0)));
+        if (!emission.empty()) { triangle_areas[j] *= emission[j]; }
+    }
+    return create_alias_table(triangle_areas);
+}
+
+// fraction of the average emission that every triangle keeps, so that bright
+// features missed by the integration can still be sampled
+static constexpr auto geometry_emission_floor = 1e-2f;
+
+// appends the UVs of the corners of each triangle, three per triangle
+static void geometry_append_corner_uvs(luisa::vector<float2> &corner_uvs,
+                                       luisa::span<const Vertex> vertices,
+                                       luisa::span<const Triangle> triangles,
+                                       bool has_vertex_uv) noexcept {
+    // meshes without UVs use the barycentric coordinates instead
+    for (auto t : triangles) {
+        corner_uvs.emplace_back(has_vertex_uv ? vertices[t.i0].uv() : make_float2(0.f, 0.f));
+        corner_uvs.emplace_back(has_vertex_uv ? vertices[t.i1].uv() : make_float2(1.f, 0.f));
+        corner_uvs.emplace_back(has_vertex_uv ? vertices[t.i2].uv() : make_float2(0.f, 1.f));
+    }
+}
+
+// adds the emission of the uniform lights on a mesh to the per-triangle emission
+// integrated for its textured lights, empty if all are uniform
+[[nodiscard]] static auto geometry_triangle_emission(luisa::vector<float> emission, float uniform,
+                                                     luisa::span<const Vertex> vertices,
+                                                     luisa::span<const Triangle> triangles) noexcept {
+    if (emission.empty()) { return emission; }
+    auto sum_area = 0.;
+    auto sum_power = 0.;
+    for (auto j = 0u; j < triangles.size(); j++) {
+        auto t = triangles[j];
+        auto p0 = vertices[t.i0].position();
+        auto area = static_cast<double>(length(cross(vertices[t.i1].position() - p0, vertices[t.i2].position() - p0)));
+        emission[j] += uniform;
+        sum_area += area;
+        sum_power += area * emission[j];
+    }
+    auto floor = sum_area > 0. ? static_cast<float>(sum_power / sum_area) * geometry_emission_floor : 0.f;
+    // fall back to area sampling if nothing emits
+    if (!(floor > 0.f)) { return luisa::vector<float>{}; }
+    for (auto &&e : emission) { e = std::max(e, floor); }
+    return emission;
+}
+
+static constexpr auto geometry_light_tree_node_words = static_cast<uint>(sizeof(LightTreeNode) / sizeof(uint));
+
+// Tree over the emissive triangles in object space, stored after their sampling pdfs in
+// the same buffer, so that it takes no bindless slot of its own. The buffer holds the pdf
+// and then the leaf node (~0u if degenerate) of each triangle, both padded to whole nodes,
+// followed by the nodes. It is sized for all triangles, so that deformed meshes can rebuild
+// it in place.
+[[nodiscard]] static auto geometry_light_tree(luisa::span<const Vertex> vertices,
+                                              luisa::span<const Triangle> triangles,
+                                              luisa::span<const float> emission,
+                                              luisa::span<const float> pdf) noexcept {
+    luisa::vector<LightTreePrimitive> primitives(triangles.size());
+    for (auto j = 0u; j < triangles.size(); j++) {
+        auto t = triangles[j];
+        primitives[j] = {.bounds = light_bounds_triangle(vertices[t.i0].position(),
+                                                         vertices[t.i1].position(),
+                                                         vertices[t.i2].position(),
+                                                         emission.empty() ? 1.f : emission[j]),
+                         .instance = 0u,
+                         .triangle = j};
+    }
+    auto nodes = build_light_tree(primitives);
+    constexpr auto words_per_node = geometry_light_tree_node_words;
+    auto padded_words = (static_cast<uint>(triangles.size()) + words_per_node - 1u) / words_per_node * words_per_node;
+    // an empty tree reads as a root without power, which selects nothing
+    luisa::vector<uint> tree(padded_words * 2u + (triangles.size() * 2u - 1u) * words_per_node, 0u);
+    std::memcpy(tree.data(), pdf.data(), pdf.size_bytes());
+    std::fill_n(tree.begin() + padded_words, triangles.size(), ~0u);
+    for (auto i = 0u; i < nodes.size(); i++) {
+        if (nodes[i].flags & LightTreeNode::flag_leaf) { tree[padded_words + nodes[i].triangle] = i; }
+    }
+    std::memcpy(tree.data() + padded_words * 2u, nodes.data(), nodes.size() * sizeof(LightTreeNode));
+    return tree;
+}
+
+static constexpr auto geometry_motion_bvh_leaf_size = 4u;
+static constexpr auto geometry_motion_bvh_stack_size = 64u;
+static constexpr auto geometry_motion_bvh_interior = ~0u;
+// samples per keyframe interval when bounding the sweep of a moving instance
+static constexpr auto geometry_motion_bound_steps = 16u;
+
+struct GeometryMotionBVH {
+    luisa::vector<float4> nodes;
+    luisa::vector<float4> triangles;
+};
+
+// Object-space BVH over the triangles of a moving mesh, split at the centroid median.
+// Each node is (min, second child or first triangle) followed by (max, triangle count
+// or geometry_motion_bvh_interior), and the first child of an interior node immediately
+// follows it. Triangles are their three corners in leaf order, the first of which carries
+// the index of the triangle in the mesh. Indices are relative to the returned arrays.
+[[nodiscard]] static auto geometry_motion_bvh(luisa::span<const Vertex> vertices,
+                                              luisa::span<const Triangle> triangles) noexcept {
+    luisa::vector<uint> order(triangles.size());
+    luisa::vector<float3> centroids(triangles.size());
+    for (auto j = 0u; j < triangles.size(); j++) {
+        auto t = triangles[j];
+        order[j] = j;
+        centroids[j] = (vertices[t.i0].position() + vertices[t.i1].position() + vertices[t.i2].position()) / 3.f;
+    }
+    GeometryMotionBVH bvh;
+    bvh.triangles.reserve(triangles.size() * 3u);
+    auto build = [&](auto &&self, uint begin, uint end, uint depth) noexcept -> void {
+        auto b_min = make_float3(std::numeric_limits<float>::max());
+        auto b_max = make_float3(-std::numeric_limits<float>::max());
+        auto c_min = b_min;
+        auto c_max = b_max;
+        for (auto k = begin; k < end; k++) {
+            auto t = triangles[order[k]];
+            for (auto i : {t.i0, t.i1, t.i2}) {
+                b_min = min(b_min, vertices[i].position());
+                b_max = max(b_max, vertices[i].position());
+            }
+            c_min = min(c_min, centroids[order[k]]);
+            c_max = max(c_max, centroids[order[k]]);
+        }
+        auto node = static_cast<uint>(bvh.nodes.size());
+        bvh.nodes.emplace_back(make_float4(b_min, 0.f));
+        bvh.nodes.emplace_back(make_float4(b_max, 0.f));
+        auto extent = c_max - c_min;
+        auto axis = extent.x > extent.y ? (extent.x > extent.z ? 0u : 2u) :
+                                          (extent.y > extent.z ? 1u : 2u);
+        // the traversal stack holds at most one pending node per level
+        if (end - begin <= geometry_motion_bvh_leaf_size || !(extent[axis] > 0.f) ||
+            depth + 2u >= geometry_motion_bvh_stack_size) {
+            bvh.nodes[node].w = luisa::bit_cast<float>(static_cast<uint>(bvh.triangles.size() / 3u));
+            bvh.nodes[node + 1u].w = luisa::bit_cast<float>(end - begin);
+            for (auto k = begin; k < end; k++) {
+                auto t = triangles[order[k]];
+                bvh.triangles.emplace_back(make_float4(vertices[t.i0].position(), luisa::bit_cast<float>(order[k])));
+                bvh.triangles.emplace_back(make_float4(vertices[t.i1].position(), 0.f));
+                bvh.triangles.emplace_back(make_float4(vertices[t.i2].position(), 0.f));
+            }
+            return;
+        }
+        auto mid = (begin + end) / 2u;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](auto a, auto b) noexcept { return centroids[a][axis] < centroids[b][axis]; });
+        bvh.nodes[node + 1u].w = luisa::bit_cast<float>(geometry_motion_bvh_interior);
+        self(self, begin, mid, depth + 1u);
+        bvh.nodes[node].w = luisa::bit_cast<float>(static_cast<uint>(bvh.nodes.size() / 2u));
+        self(self, mid, end, depth + 1u);
+    };
+    build(build, 0u, static_cast<uint>(triangles.size()), 0u);
+    return bvh;
+}
+
+// object-to-world matrix between two keyframes, with the rotation interpolated on the sphere
+[[nodiscard]] static auto geometry_motion_matrix(const DecomposedTransform &t0,
+                                                 const DecomposedTransform &t1, float f) noexcept {
+    return translation(lerp(t0.translation, t1.translation, f)) *
+           rotation(slerp(t0.quaternion, t1.quaternion, f)) *
+           scaling(lerp(t0.scaling, t1.scaling, f));
+}
+
+// rotates v by the unit quaternion q, with the vector part in xyz
+[[nodiscard]] static auto geometry_rotate(Expr<float4> q, Expr<float3> v) noexcept {
+    auto t = 2.f * cross(q.xyz(), v);
+    return v + q.w * t + cross(q.xyz(), t);
+}
+
+}// namespace detail
+
 void Geometry::build(CommandBuffer &command_buffer,
                      luisa::span<const Shape *const> shapes,
-                     float init_time) noexcept {
-    // TODO: AccelOption
-    _accel = _pipeline.device().create_accel({});
+                     float init_time, const BuildOptions &options) noexcept {
+    _accel = _pipeline.device().create_accel(options.accel_option);
+    // without refitting, every update rebuilds the TLAS and the deformed BLASes
+    _accel_rebuild_interval = options.accel_option.allow_update ? options.accel_rebuild_interval : 1u;
     for (auto i = 0u; i < 3u; ++i) {
         _world_max[i] = -std::numeric_limits<float>::max();
         _world_min[i] = std::numeric_limits<float>::max();
     }
     _triangle_count = 0u;
+    // walk the shape tree serially: this registers surfaces, lights and media,
+    // and evaluates transforms, none of which are thread-safe
     for (auto shape : shapes) { _process_shape(command_buffer, shape, init_time, nullptr); }
-    LUISA_INFO_WITH_LOCATION("Geometry built with {} triangles.", _triangle_count);
+    _select_lods(options, init_time);
+    // hash and upload unique meshes, and build sampling tables for emissive ones
+    _build_meshes(command_buffer, init_time);
+    _build_procedurals(command_buffer);
+    _compute_world_bounds();
+    // moving instances that are interpolated per ray time instead of updated
+    luisa::vector<uint> motion_instance_ids;
+    if (options.motion_keyframes > 1u && options.shutter_span.y > options.shutter_span.x) {
+        for (auto i = 0u; i < _mesh_instances.size(); i++) {
+            auto &&inst = _mesh_instances[i];
+            if (inst.dynamic && inst.visible && inst.shape->is_mesh() &&
+                !inst.shape->deformable()) { motion_instance_ids.emplace_back(i); }
+        }
+    }
+    _transform_time = init_time;
+    if (!motion_instance_ids.empty()) { _build_motion_instances(command_buffer, options, motion_instance_ids); }
+    // create instances
+    for (auto i = 0u, m = 0u; i < _mesh_instances.size(); i++) {
+        auto &&inst = _mesh_instances[i];
+        if (inst.shape->is_procedural()) {
+            // procedural instances never carry lights and are intersected without alpha testing
+            auto procedural = _procedurals.at(inst.shape);
+            auto primitive_count = static_cast<uint>(inst.shape->primitives().size());
+            _accel.emplace_back(*procedural.resource, inst.object_to_world, inst.visible);
+            _instances.emplace_back(Shape::Handle::encode(
+                procedural.primitive_buffer_id,
+                inst.properties | Shape::property_flag_procedural,
+                inst.surface_tag, inst.light_tag, inst.medium_tag,
+                primitive_count, 0.f, inst.shape->intersection_offset_factor()));
+            _primitive_count += primitive_count;
+            continue;
+        }
+        auto mesh = _meshes.at(inst.shape)[inst.lod];
+        auto properties = mesh.vertex_properties | inst.properties;
+        // moving instances are replaced by their proxies in the TLAS, keeping their instance ids
+        if (m < _motion_instances.size() && _motion_instances[m].instance_id == i) {
+            _accel.emplace_back(*_motion_instances[m++].proxy, make_float4x4(1.f), true);
+        } else {
+            _accel.emplace_back(*mesh.resource, inst.object_to_world, inst.visible,
+                                (properties & Shape::property_flag_maybe_non_opaque) == 0u);
+        }
+        _instances.emplace_back(Shape::Handle::encode(
+            mesh.geometry_buffer_id_base,
+            properties, inst.surface_tag, inst.light_tag, inst.medium_tag,
+            mesh.resource->triangle_count(),
+            static_cast<float>(mesh.shadow_term) / 65535.f,
+            static_cast<float>(mesh.intersection_offset) / 65535.f));
+        if (properties & Shape::property_flag_has_light) {
+            _instanced_lights.emplace_back(Light::Handle{
+                .instance_id = i,
+                .light_tag = inst.light_tag});
+            _light_mesh_instances.emplace_back(inst);
+        }
+        _triangle_count += mesh.resource->triangle_count();
+    }
+    // punctual lights have no geometry and only follow the emissive instances in the light list
+    for (auto light : options.lights) {
+        if (light->is_null()) { continue; }
+        _instanced_lights.emplace_back(Light::Handle{
+            .instance_id = Light::Handle::punctual_instance,
+            .light_tag = _pipeline.register_light(command_buffer, light)});
+    }
+    if (_any_non_opaque) { _build_opacity_states(command_buffer); }
+    _mesh_instances = {};
+    _dynamic_matrices.reserve(_dynamic_transforms.size());
+    for (auto t : _dynamic_transforms) { _dynamic_matrices.emplace_back(t.matrix(init_time)); }
+    LUISA_INFO_WITH_LOCATION("Geometry built with {} triangles and {} analytic primitives.",
+                             _triangle_count, _primitive_count);
     _instance_buffer = _pipeline.device().create_buffer<uint4>(_instances.size());
     command_buffer << _instance_buffer.copy_from(_instances.data())
                    << _accel.build();
 }
 
+void Geometry::_select_lods(const BuildOptions &options, float init_time) noexcept {
+    if (options.lod_triangles_per_pixel <= 0.f) { return; }
+    // emissive instances keep the full meshes, which light samplers are built from,
+    // and deformable meshes have no simplified levels
+    auto lod_capable = [](const MeshInstance &inst) noexcept {
+        return inst.shape->is_mesh() && inst.shape->lod_count() != 0u && !inst.shape->deformable() &&
+               (inst.properties & Shape::property_flag_has_light) == 0u;
+    };
+    // object-space bounding spheres of the unique shapes with levels of detail
+    luisa::vector<const Shape *> shapes;
+    luisa::unordered_map<const Shape *, float4> bounds;
+    for (auto &&inst : _mesh_instances) {
+        if (lod_capable(inst) && bounds.try_emplace(inst.shape).second) { shapes.emplace_back(inst.shape); }
+    }
+    if (shapes.empty()) { return; }
+    global_thread_pool().parallel(shapes.size(), [&](auto i) noexcept {
+        auto b_min = make_float3(std::numeric_limits<float>::max());
+        auto b_max = make_float3(-std::numeric_limits<float>::max());
+        for (auto &&v : shapes[i]->mesh().vertices) {
+            b_min = min(b_min, v.position());
+            b_max = max(b_max, v.position());
+        }
+        bounds.at(shapes[i]) = make_float4(.5f * (b_min + b_max), .5f * length(b_max - b_min));
+    });
+    global_thread_pool().synchronize();
+    // camera positions at the initial time
+    luisa::vector<float3> eyes;
+    for (auto camera : options.cameras) {
+        auto m = camera->transform() == nullptr ? make_float4x4(1.f) : camera->transform()->matrix(init_time);
+        eyes.emplace_back(make_float3(m[3]));
+    }
+    // the finest level within the triangle budget of the pixels the instance
+    // covers, i.e., the most detailed level needed by any camera
+    luisa::vector<uint> simplified(_mesh_instances.size(), 0u);
+    global_thread_pool().parallel(_mesh_instances.size(), [&](auto i) noexcept {
+        auto &&inst = _mesh_instances[i];
+        if (!lod_capable(inst)) { return; }
+        auto sphere = bounds.at(inst.shape);
+        auto m = inst.object_to_world;
+        auto center = make_float3(m * make_float4(make_float3(sphere), 1.f));
+        auto scale = std::max(std::max(length(make_float3(m[0])), length(make_float3(m[1]))), length(make_float3(m[2])));
+        auto radius = std::max(sphere.w * scale, 1e-6f);
+        auto lod = inst.shape->lod_count();
+        for (auto c = 0u; c < eyes.size() && lod != 0u; c++) {
+            auto distance = length(center - eyes[c]) - radius;
+            auto footprint = distance > 0.f ? options.cameras[c]->pixel_footprint(distance) : 0.f;
+            if (!(footprint > 0.f)) {
+                lod = 0u;
+                break;
+            }
+            auto pixels = pi * (radius / footprint) * (radius / footprint);
+            auto budget = static_cast<double>(pixels) * options.lod_triangles_per_pixel;
+            auto level = 0u;
+            while (level < lod && static_cast<double>(inst.shape->lod(level).triangles.size()) > budget) { level++; }
+            lod = level;
+        }
+        inst.lod = lod;
+        simplified[i] = lod != 0u;
+    });
+    global_thread_pool().synchronize();
+    LUISA_INFO_WITH_LOCATION("Selected simplified levels of detail for {} instance(s).",
+                             std::count(simplified.cbegin(), simplified.cend(), 1u));
+}
+
+MeshView Geometry::_mesh_view(const Shape *shape, uint lod) const noexcept {
+    if (auto iter = _deformable_indices.find(shape); iter != _deformable_indices.end()) {
+        return MeshView{_deformables[iter->second].vertices, shape->mesh().triangles};
+    }
+    return shape->lod(lod);
+}
+
+void Geometry::_build_meshes(CommandBuffer &command_buffer, float init_time) noexcept {
+    // unique (shape, level of detail) pairs in the order of first appearance;
+    // emissive instances always use the full meshes, see _select_lods()
+    luisa::vector<std::pair<const Shape *, uint>> shapes;
+    luisa::unordered_map<const Shape *, uint> listed_levels;// bit mask of the levels in `shapes`
+    luisa::unordered_map<const Shape *, luisa::vector<uint>> emissive_shapes;// distinct light tags
+    for (auto &&inst : _mesh_instances) {
+        if (!inst.shape->is_mesh()) { continue; }
+        if (auto &&mask = listed_levels[inst.shape]; (mask & (1u << inst.lod)) == 0u) {
+            mask |= 1u << inst.lod;
+            shapes.emplace_back(inst.shape, inst.lod);
+        }
+        if (inst.properties & Shape::property_flag_has_light) {
+            auto &&tags = emissive_shapes[inst.shape];
+            if (std::find(tags.cbegin(), tags.cend(), inst.light_tag) == tags.cend()) { tags.emplace_back(inst.light_tag); }
+        }
+    }
+    // deformable meshes are uploaded in their pose at the initial time
+    global_thread_pool().parallel(_deformables.size(), [&](auto i) noexcept {
+        auto &&d = _deformables[i];
+        d.vertices.resize(d.shape->mesh().vertices.size());
+        d.shape->deform(init_time, d.vertices);
+    });
+    global_thread_pool().synchronize();
+    _deformed_time = init_time;
+    // parallel phase 1: content hashes
+    luisa::vector<uint64_t> hashes(shapes.size());
+    global_thread_pool().parallel(shapes.size(), [&](auto i) noexcept {
+        auto shape = shapes[i].first;
+        auto [vertices, triangles] = shape->lod(shapes[i].second);
+        LUISA_ASSERT(!vertices.empty() && !triangles.empty(), "Empty mesh.");
+        auto hash = luisa::hash64(triangles.data(), triangles.size_bytes(), luisa::hash64_default_seed);
+        // deformable meshes own their vertex buffers, so they are never shared
+        if (shape->deformable()) {
+            hashes[i] = luisa::hash64(&shape, sizeof(shape), hash);
+            return;
+        }
+        hash = luisa::hash64(vertices.data(), vertices.size_bytes(), hash);
+        // the vertex layout is part of the uploaded geometry
+        hashes[i] = shape->compressed_vertices() ? luisa::hash64(&hash, sizeof(hash), hash) : hash;
+    });
+    global_thread_pool().synchronize();
+    // deduplicate geometries by content
+    luisa::vector<uint> geometry_shapes;// index of the first shape with each new geometry
+    luisa::unordered_map<uint64_t, uint> new_geometries;
+    for (auto i = 0u; i < shapes.size(); i++) {
+        if (!_mesh_cache.contains(hashes[i]) &&
+            new_geometries.try_emplace(hashes[i], static_cast<uint>(geometry_shapes.size())).second) {
+            geometry_shapes.emplace_back(i);
+        }
+    }
+    // area-sampling tables are only read when sampling emissive instances, so they are
+    // built on demand for geometries referenced by at least one light, including cached
+    // geometries that were previously uploaded without tables
+    luisa::vector<uint> table_shapes;// index of a shape with each geometry that needs tables
+    luisa::unordered_map<uint64_t, luisa::vector<const Light::Instance *>> table_geometries;
+    for (auto i = 0u; i < shapes.size(); i++) {
+        if (shapes[i].second != 0u) { continue; }
+        if (auto lights = emissive_shapes.find(shapes[i].first); lights != emissive_shapes.end()) {
+            auto [iter, first] = table_geometries.try_emplace(hashes[i]);
+            // geometries shared by several lights are weighted by their total emission
+            for (auto tag : lights->second) {
+                auto light = _pipeline.lights().impl(tag);
+                if (std::find(iter->second.cbegin(), iter->second.cend(), light) == iter->second.cend()) {
+                    iter->second.emplace_back(light);
+                }
+            }
+            if (!first) { continue; }
+            if (auto cached = _mesh_cache.find(hashes[i]);
+                cached == _mesh_cache.end() || !cached->second.has_sampling_tables) {
+                table_shapes.emplace_back(i);
+            }
+        }
+    }
+    // parallel phase 2: compressed vertices of new geometries that opt into them
+    luisa::vector<luisa::vector<CompressedVertex>> compressed_vertices(geometry_shapes.size());
+    global_thread_pool().parallel(geometry_shapes.size(), [&](auto i) noexcept {
+        auto [shape, lod] = shapes[geometry_shapes[i]];
+        if (!shape->compressed_vertices()) { return; }
+        auto vertices = shape->lod(lod).vertices;
+        compressed_vertices[i].resize(vertices.size());
+        for (auto j = 0u; j < vertices.size(); j++) {
+            compressed_vertices[i][j] = CompressedVertex::encode(vertices[j]);
+        }
+    });
+    // emission of textured lights integrated over the triangles on the device: each light
+    // covers all of its meshes in one dispatch, and all lights share one readback
+    luisa::vector<luisa::vector<float>> emissions(table_shapes.size());
+    luisa::vector<float> uniform_emissions(table_shapes.size(), 0.f);
+    luisa::vector<const Light::Instance *> textured_lights;
+    luisa::unordered_map<const Light::Instance *, luisa::vector<uint>> textured_light_meshes;
+    for (auto i = 0u; i < table_shapes.size(); i++) {
+        for (auto light : table_geometries.at(hashes[table_shapes[i]])) {
+            if (!light->has_varying_emission()) {
+                uniform_emissions[i] += light->node()->emission_estimate();
+                continue;
+            }
+            auto [iter, first] = textured_light_meshes.try_emplace(light);
+            if (first) { textured_lights.emplace_back(light); }
+            iter->second.emplace_back(i);
+        }
+    }
+    if (!textured_lights.empty()) {
+        Clock clock;
+        // corner UVs of the meshes of each light in turn; the first triangle of each
+        // light, and of each (mesh, light) pair
+        luisa::vector<float2> corner_uvs;
+        luisa::vector<size_t> light_offsets;
+        luisa::vector<std::pair<uint, size_t>> mesh_offsets;
+        for (auto light : textured_lights) {
+            light_offsets.emplace_back(corner_uvs.size() / 3u);
+            for (auto i : textured_light_meshes.at(light)) {
+                auto shape = shapes[table_shapes[i]].first;
+                auto [vertices, triangles] = _mesh_view(shape, 0u);
+                mesh_offsets.emplace_back(i, corner_uvs.size() / 3u);
+                detail::geometry_append_corner_uvs(corner_uvs, vertices, triangles, shape->has_vertex_uv());
+            }
+        }
+        light_offsets.emplace_back(corner_uvs.size() / 3u);
+        if (auto triangle_count = light_offsets.back(); triangle_count != 0u) {
+            auto &&device = _pipeline.device();
+            auto uv_buffer = device.create_buffer<float2>(corner_uvs.size());
+            auto emission_buffer = device.create_buffer<float>(triangle_count);
+            luisa::vector<float> emission(triangle_count);
+            // the textures are looked up through the bindless array, which must be up to date
+            command_buffer << _pipeline.bindless_array().update()
+                           << uv_buffer.copy_from(corner_uvs.data());
+            for (auto l = 0u; l < textured_lights.size(); l++) {
+                auto offset = light_offsets[l];
+                auto count = light_offsets[l + 1u] - offset;
+                textured_lights[l]->triangle_emission(
+                    command_buffer, uv_buffer.view(offset * 3u, count * 3u),
+                    emission_buffer.view(offset, count));
+            }
+            command_buffer << emission_buffer.copy_to(emission.data())
+                           << compute::synchronize();
+            // meshes shared by several textured lights sum their emission
+            for (auto [i, offset] : mesh_offsets) {
+                auto count = _mesh_view(shapes[table_shapes[i]].first, 0u).triangles.size();
+                auto e = emission.data() + offset;
+                if (emissions[i].empty()) {
+                    emissions[i].assign(e, e + count);
+                } else {
+                    for (auto j = 0u; j < count; j++) { emissions[i][j] += e[j]; }
+                }
+            }
+        }
+        LUISA_INFO_WITH_LOCATION("Integrated emission over {} textured light mesh(es) in {} ms.",
+                                 std::count_if(emissions.cbegin(), emissions.cend(),
+                                               [](auto &&e) noexcept { return !e.empty(); }),
+                                 clock.toc());
+    }
+    // area-sampling tables and triangle trees of emissive geometries
+    luisa::vector<std::pair<luisa::vector<AliasEntry>, luisa::vector<float>>> tables(table_shapes.size());
+    luisa::vector<luisa::vector<uint>> light_trees(table_shapes.size());
+    global_thread_pool().parallel(table_shapes.size(), [&](auto i) noexcept {
+        auto [vertices, triangles] = _mesh_view(shapes[table_shapes[i]].first, 0u);
+        emissions[i] = detail::geometry_triangle_emission(
+            std::move(emissions[i]), uniform_emissions[i], vertices, triangles);
+        tables[i] = detail::geometry_area_sampling_table(vertices, triangles, emissions[i]);
+        light_trees[i] = detail::geometry_light_tree(vertices, triangles, emissions[i], tables[i].second);
+    });
+    global_thread_pool().synchronize();
+    // non-emissive geometries bind a shared placeholder in their table slots,
+    // so that the bindless layout stays the same for every mesh
+    if (!geometry_shapes.empty() && !_placeholder_table) {
+        static constexpr auto zero = make_uint4(0u);
+        auto view = _pipeline.arena_buffer<uint4>(1u);
+        command_buffer << view.copy_from(&zero);
+        _placeholder_table = view;
+    }
+    // upload phase: batch copies and BLAS builds to bound the number of commits
+    auto batch_bytes = static_cast<size_t>(0u);
+    auto commit_if_full = [&](size_t bytes) noexcept {
+        batch_bytes += bytes;
+        if (batch_bytes >= mesh_upload_batch_bytes) {
+            command_buffer << compute::commit();
+            batch_bytes = 0u;
+        }
+    };
+    for (auto i = 0u; i < geometry_shapes.size(); i++) {
+        auto shape = shapes[geometry_shapes[i]].first;
+        auto [vertices, triangles] = _mesh_view(shape, shapes[geometry_shapes[i]].second);
+        auto build_option = shape->build_option();
+        // deformable meshes are refit rather than rebuilt every frame
+        if (shape->deformable()) { build_option.allow_update = true; }
+        auto triangle_buffer = _pipeline.create<Buffer<Triangle>>(triangles.size());
+        auto [mesh, vertex_buffer_id, vertex_bytes] = [&] {
+            if (auto &&compressed = compressed_vertices[i]; !compressed.empty()) {
+                _any_compressed_vertex = true;
+                auto vertex_buffer = _pipeline.create<Buffer<CompressedVertex>>(compressed.size());
+                auto mesh = _pipeline.create<Mesh>(*vertex_buffer, *triangle_buffer, build_option);
+                auto vertex_buffer_id = _pipeline.register_bindless(vertex_buffer->view());
+                command_buffer << vertex_buffer->copy_from(compressed.data());
+                return std::make_tuple(mesh, vertex_buffer_id, compressed.size() * sizeof(CompressedVertex));
+            }
+            auto vertex_buffer = _pipeline.create<Buffer<Vertex>>(vertices.size());
+            auto mesh = _pipeline.create<Mesh>(*vertex_buffer, *triangle_buffer, build_option);
+            auto vertex_buffer_id = _pipeline.register_bindless(vertex_buffer->view());
+            command_buffer << vertex_buffer->copy_from(vertices.data());
+            if (auto iter = _deformable_indices.find(shape); iter != _deformable_indices.end()) {
+                auto &&d = _deformables[iter->second];
+                d.resource = mesh;
+                d.vertex_buffer = vertex_buffer->view();
+            }
+            return std::make_tuple(mesh, vertex_buffer_id, vertices.size_bytes());
+        }();
+        auto triangle_buffer_id = _pipeline.register_bindless(triangle_buffer->view());
+        auto alias_buffer_id = _pipeline.register_bindless(*_placeholder_table);
+        auto pdf_buffer_id = _pipeline.register_bindless(*_placeholder_table);
+        LUISA_ASSERT(triangle_buffer_id - vertex_buffer_id == Shape::Handle::triangle_buffer_id_offset, "Invalid.");
+        LUISA_ASSERT(alias_buffer_id - vertex_buffer_id == Shape::Handle::alias_table_buffer_id_offset, "Invalid.");
+        LUISA_ASSERT(pdf_buffer_id - vertex_buffer_id == Shape::Handle::pdf_buffer_id_offset, "Invalid.");
+        command_buffer << triangle_buffer->copy_from(triangles.data())
+                       << mesh->build();
+        _mesh_cache.emplace(hashes[geometry_shapes[i]], MeshGeometry{mesh, vertex_buffer_id, false, {}});
+        commit_if_full(vertex_bytes + triangles.size_bytes());
+    }
+    // bind the sampling tables into the reserved slots of their geometries
+    for (auto i = 0u; i < table_shapes.size(); i++) {
+        auto &&alias_table = tables[i].first;
+        auto &&light_tree = light_trees[i];
+        auto &&geom = _mesh_cache.at(hashes[table_shapes[i]]);
+        auto alias_table_view = _pipeline.arena_buffer<AliasEntry>(alias_table.size());
+        auto light_tree_view = _pipeline.arena_buffer<uint>(light_tree.size());
+        _pipeline.bindless_array().emplace_on_update(
+            geom.buffer_id_base + Shape::Handle::alias_table_buffer_id_offset, alias_table_view);
+        _pipeline.bindless_array().emplace_on_update(
+            geom.buffer_id_base + Shape::Handle::pdf_buffer_id_offset, light_tree_view);
+        command_buffer << alias_table_view.copy_from(alias_table.data())
+                       << light_tree_view.copy_from(light_tree.data());
+        geom.has_sampling_tables = true;
+        geom.emission = std::move(emissions[i]);
+        // emissive deformable meshes refresh their tables in place when deformed
+        if (auto iter = _deformable_indices.find(shapes[table_shapes[i]].first);
+            iter != _deformable_indices.end()) {
+            auto &&d = _deformables[iter->second];
+            d.alias_table_buffer = alias_table_view;
+            d.light_tree_buffer = light_tree_view;
+            d.emission = geom.emission;
+        }
+        commit_if_full(alias_table.size() * sizeof(AliasEntry) + light_tree.size() * sizeof(uint));
+    }
+    // the host-side tables must outlive the commands that upload them
+    command_buffer << compute::commit();
+    for (auto i = 0u; i < shapes.size(); i++) {
+        if (auto &&e = _mesh_cache.at(hashes[i]).emission; shapes[i].second == 0u && !e.empty()) {
+            _triangle_emissions.try_emplace(shapes[i].first, e);
+        }
+    }
+    auto encode_fixed_point = [](float x) noexcept {
+        return static_cast<uint16_t>(std::clamp(
+            std::round(x * 65535.f), 0.f, 65535.f));
+    };
+    for (auto i = 0u; i < shapes.size(); i++) {
+        auto [shape, lod] = shapes[i];
+        auto mesh_geom = _mesh_cache.at(hashes[i]);
+        auto &&levels = _meshes[shape];
+        if (levels.empty()) { levels.resize(shape->lod_count() + 1u); }
+        levels[lod] = MeshData{
+            .resource = mesh_geom.resource,
+            .shadow_term = encode_fixed_point(shape->has_vertex_normal() ? shape->shadow_terminator_factor() : 0.f),
+            .intersection_offset = encode_fixed_point(shape->intersection_offset_factor()),
+            .geometry_buffer_id_base = mesh_geom.buffer_id_base,
+            .vertex_properties = shape->vertex_properties() |
+                                 (shape->compressed_vertices() ? Shape::property_flag_compressed_vertex : 0u)};
+    }
+}
+
+void Geometry::_build_procedurals(CommandBuffer &command_buffer) noexcept {
+    luisa::vector<const Shape *> shapes;
+    for (auto &&inst : _mesh_instances) {
+        if (inst.shape->is_procedural() && _procedurals.try_emplace(inst.shape).second) {
+            shapes.emplace_back(inst.shape);
+        }
+    }
+    if (shapes.empty()) { return; }
+    _any_procedural = true;
+    // bounding boxes are only read by the BLAS builds, which are committed before returning
+    luisa::vector<luisa::vector<AABB>> bounds(shapes.size());
+    global_thread_pool().parallel(shapes.size(), [&](auto i) noexcept {
+        auto primitives = shapes[i]->primitives();
+        LUISA_ASSERT(!primitives.empty(), "Empty procedural shape.");
+        bounds[i].resize(primitives.size());
+        for (auto j = 0u; j < primitives.size(); j++) { bounds[i][j] = primitives[j].bounds(); }
+    });
+    global_thread_pool().synchronize();
+    auto batch_bytes = static_cast<size_t>(0u);
+    for (auto i = 0u; i < shapes.size(); i++) {
+        auto primitives = shapes[i]->primitives();
+        auto primitive_buffer = _pipeline.create<Buffer<AnalyticPrimitive>>(primitives.size());
+        auto aabb_buffer = _pipeline.create<Buffer<AABB>>(primitives.size());
+        auto resource = _pipeline.create<ProceduralPrimitive>(aabb_buffer->view(), shapes[i]->build_option());
+        auto primitive_buffer_id = _pipeline.register_bindless(primitive_buffer->view());
+        command_buffer << primitive_buffer->copy_from(primitives.data())
+                       << aabb_buffer->copy_from(bounds[i].data())
+                       << resource->build();
+        _procedurals[shapes[i]] = ProceduralData{resource, primitive_buffer_id};
+        batch_bytes += primitives.size_bytes() + bounds[i].size() * sizeof(AABB);
+        if (batch_bytes >= mesh_upload_batch_bytes) {
+            command_buffer << compute::commit();
+            batch_bytes = 0u;
+        }
+    }
+    command_buffer << compute::commit();
+}
+
+void Geometry::_compute_world_bounds() noexcept {
+    luisa::vector<std::pair<float3, float3>> bounds(_mesh_instances.size());
+    global_thread_pool().parallel(_mesh_instances.size(), [&](auto i) noexcept {
+        auto &&inst = _mesh_instances[i];
+        auto m = inst.object_to_world;
+        auto b_min = make_float3(std::numeric_limits<float>::max());
+        auto b_max = make_float3(-std::numeric_limits<float>::max());
+        if (inst.shape->is_procedural()) {
+            // transform the corners of the object-space bounds
+            auto o_min = make_float3(std::numeric_limits<float>::max());
+            auto o_max = make_float3(-std::numeric_limits<float>::max());
+            for (auto &&prim : inst.shape->primitives()) {
+                auto aabb = prim.bounds();
+                o_min = min(o_min, make_float3(aabb.packed_min[0], aabb.packed_min[1], aabb.packed_min[2]));
+                o_max = max(o_max, make_float3(aabb.packed_max[0], aabb.packed_max[1], aabb.packed_max[2]));
+            }
+            for (auto c = 0u; c < 8u; c++) {
+                auto corner = make_float3(c & 1u ? o_max.x : o_min.x,
+                                          c & 2u ? o_max.y : o_min.y,
+                                          c & 4u ? o_max.z : o_min.z);
+                auto p = make_float3(m * make_float4(corner, 1.f));
+                b_min = min(b_min, p);
+                b_max = max(b_max, p);
+            }
+        } else {
+            for (auto &&v : inst.shape->mesh().vertices) {
+                auto p = make_float3(m * make_float4(v.position(), 1.f));
+                b_min = min(b_min, p);
+                b_max = max(b_max, p);
+            }
+        }
+        bounds[i] = std::make_pair(b_min, b_max);
+    });
+    global_thread_pool().synchronize();
+    for (auto [b_min, b_max] : bounds) {
+        _world_min = min(_world_min, b_min);
+        _world_max = max(_world_max, b_max);
+    }
+}
+
 void Geometry::_process_shape(
     CommandBuffer &command_buffer, const Shape *shape, float init_time,
     const Surface *overridden_surface,
@@ -38,85 +713,34 @@ void Geometry::_process_shape(
     auto medium = overridden_medium == nullptr ? shape->medium() : overridden_medium;
     auto visible = overridden_visible && shape->visible();
 
-    if (shape->is_mesh()) {
-        if (shape->deformable()) [[unlikely]] {
-            LUISA_ERROR_WITH_LOCATION(
-                "Deformable meshes are not yet supported.");
+    if (shape->is_procedural() && light != nullptr && !light->is_null()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Procedural shape '{}' cannot be emissive. "
+            "Ignoring its light.",
+            shape->impl_type());
+        light = nullptr;
+    }
+    if (light != nullptr && light->is_punctual()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Punctual light '{}' cannot be attached to shape '{}'. "
+            "Ignoring the light, which should be listed in the scene root instead.",
+            light->impl_type(), shape->impl_type());
+        light = nullptr;
+    }
+
+    if (shape->is_mesh() || shape->is_procedural()) {
+        if (shape->deformable() &&
+            _deformable_indices.try_emplace(shape, static_cast<uint>(_deformables.size())).second) {
+            _deformables.emplace_back(DeformableMesh{.shape = shape});
         }
-        auto mesh = [&] {
-            if (auto iter = _meshes.find(shape); iter != _meshes.end()) {
-                return iter->second;
-            }
-            auto mesh_geom = [&] {
-                auto [vertices, triangles] = shape->mesh();
-                LUISA_ASSERT(!vertices.empty() && !triangles.empty(), "Empty mesh.");
-                auto hash = luisa::hash64(vertices.data(), vertices.size_bytes(), luisa::hash64_default_seed);
-                hash = luisa::hash64(triangles.data(), triangles.size_bytes(), hash);
-                if (auto mesh_iter = _mesh_cache.find(hash);
-                    mesh_iter != _mesh_cache.end()) {
-                    return mesh_iter->second;
-                }
-                // create mesh
-                auto vertex_buffer = _pipeline.create<Buffer<Vertex>>(vertices.size());
-                auto triangle_buffer = _pipeline.create<Buffer<Triangle>>(triangles.size());
-                auto mesh = _pipeline.create<Mesh>(*vertex_buffer, *triangle_buffer, shape->build_option());
-                command_buffer << vertex_buffer->copy_from(vertices.data())
-                               << triangle_buffer->copy_from(triangles.data())
-                               << compute::commit()
-                               << mesh->build()
-                               << compute::commit();
-                auto vertex_buffer_id = _pipeline.register_bindless(vertex_buffer->view());
-                auto triangle_buffer_id = _pipeline.register_bindless(triangle_buffer->view());
-                // compute alias table
-                luisa::vector<float> triangle_areas(triangles.size());
-                for (auto i = 0u; i < triangles.size(); i++) {
-                    auto t = triangles[i];
-                    auto p0 = vertices[t.i0].position();
-                    auto p1 = vertices[t.i1].position();
-                    auto p2 = vertices[t.i2].position();
-                    triangle_areas[i] = std::abs(length(cross(p1 - p0, p2 - p0)));
-                }
-                auto [alias_table, pdf] = create_alias_table(triangle_areas);
-                auto [alias_table_buffer_view, alias_buffer_id] = _pipeline.bindless_arena_buffer<AliasEntry>(alias_table.size());
-                auto [pdf_buffer_view, pdf_buffer_id] = _pipeline.bindless_arena_buffer<float>(pdf.size());
-                LUISA_ASSERT(triangle_buffer_id - vertex_buffer_id == Shape::Handle::triangle_buffer_id_offset, "Invalid.");
-                LUISA_ASSERT(alias_buffer_id - vertex_buffer_id == Shape::Handle::alias_table_buffer_id_offset, "Invalid.");
-                LUISA_ASSERT(pdf_buffer_id - vertex_buffer_id == Shape::Handle::pdf_buffer_id_offset, "Invalid.");
-                command_buffer << alias_table_buffer_view.copy_from(alias_table.data())
-                               << pdf_buffer_view.copy_from(pdf.data());
-                command_buffer << compute::commit();
-                auto geom = MeshGeometry{mesh, vertex_buffer_id};
-                _mesh_cache.emplace(hash, geom);
-                return geom;
-            }();
-            auto encode_fixed_point = [](float x) noexcept {
-                return static_cast<uint16_t>(std::clamp(
-                    std::round(x * 65535.f), 0.f, 65535.f));
-            };
-            // assign mesh data
-            MeshData mesh_data{
-                .resource = mesh_geom.resource,
-                .shadow_term = encode_fixed_point(shape->has_vertex_normal() ? shape->shadow_terminator_factor() : 0.f),
-                .intersection_offset = encode_fixed_point(shape->intersection_offset_factor()),
-                .geometry_buffer_id_base = mesh_geom.buffer_id_base,
-                .vertex_properties = shape->vertex_properties()};
-            _meshes.emplace(shape, mesh_data);
-            return mesh_data;
-        }();
-        auto instance_id = static_cast<uint>(_accel.size());
+        auto instance_id = static_cast<uint>(_mesh_instances.size());
         auto [t_node, is_static] = _transform_tree.leaf(shape->transform());
         InstancedTransform inst_xform{t_node, instance_id};
         if (!is_static) { _dynamic_transforms.emplace_back(inst_xform); }
-        auto object_to_world = inst_xform.matrix(init_time);
-        auto vertices = shape->mesh().vertices;
-        for (auto &v : vertices) {
-            _world_max = max(_world_max, make_float3(object_to_world * make_float4(v.position(), 1.f)));
-            _world_min = min(_world_min, make_float3(object_to_world * make_float4(v.position(), 1.f)));
-        }
 
-        // create instance
+        // register surface, light and medium
+        auto properties = 0u;
         auto surface_tag = 0u;
-        auto properties = mesh.vertex_properties;
         if (surface != nullptr && !surface->is_null()) {
             surface_tag = _pipeline.register_surface(command_buffer, surface);
             properties |= Shape::property_flag_has_surface;
@@ -125,11 +749,6 @@ void Geometry::_process_shape(
                 _any_non_opaque = true;
             }
         }
-
-        // emplace instance here since we need to know the opaque property
-        _accel.emplace_back(*mesh.resource, object_to_world, visible,
-                            (properties & Shape::property_flag_maybe_non_opaque) == 0u);
-
         auto light_tag = 0u;
         auto medium_tag = 0u;
         if (light != nullptr && !light->is_null()) {
@@ -140,18 +759,16 @@ void Geometry::_process_shape(
             medium_tag = _pipeline.register_medium(command_buffer, medium);
             properties |= Shape::property_flag_has_medium;
         }
-        _instances.emplace_back(Shape::Handle::encode(
-            mesh.geometry_buffer_id_base,
-            properties, surface_tag, light_tag, medium_tag,
-            mesh.resource->triangle_count(),
-            static_cast<float>(mesh.shadow_term) / 65535.f,
-            static_cast<float>(mesh.intersection_offset) / 65535.f));
-        if (properties & Shape::property_flag_has_light) {
-            _instanced_lights.emplace_back(Light::Handle{
-                .instance_id = instance_id,
-                .light_tag = light_tag});
-        }
-        _triangle_count += mesh.resource->triangle_count();
+        _mesh_instances.emplace_back(MeshInstance{
+            .shape = shape,
+            .object_to_world = inst_xform.matrix(init_time),
+            .properties = properties,
+            .surface_tag = surface_tag,
+            .light_tag = light_tag,
+            .medium_tag = medium_tag,
+            .lod = 0u,
+            .visible = visible,
+            .dynamic = !is_static});
     } else {
         _transform_tree.push(shape->transform());
         for (auto child : shape->children()) {
@@ -162,7 +779,119 @@ void Geometry::_process_shape(
     }
 }
 
+void Geometry::_build_opacity_states(CommandBuffer &command_buffer) noexcept {
+    // alpha-tested (mesh, level of detail, surface) triples in the order of first appearance
+    luisa::vector<std::tuple<const Shape *, uint, uint>> keys;
+    luisa::unordered_map<const Shape *, luisa::unordered_map<uint64_t, uint>> key_indices;
+    luisa::vector<uint> instance_keys(_mesh_instances.size(), ~0u);
+    for (auto i = 0u; i < _mesh_instances.size(); i++) {
+        auto &&inst = _mesh_instances[i];
+        if (!inst.shape->is_mesh() || (inst.properties & Shape::property_flag_maybe_non_opaque) == 0u) { continue; }
+        auto [iter, first] = key_indices[inst.shape].try_emplace(
+            (static_cast<uint64_t>(inst.lod) << 32u) | inst.surface_tag, static_cast<uint>(keys.size()));
+        if (first) { keys.emplace_back(inst.shape, inst.lod, inst.surface_tag); }
+        instance_keys[i] = iter->second;
+    }
+    // bound the opacity over the UV bounding box of each triangle; UVs are
+    // never deformed, so the rest pose of deformable meshes is as good as any
+    luisa::vector<luisa::vector<uint>> states(keys.size());
+    luisa::vector<uint> classified(keys.size(), 0u);// non-zero if any triangle is not mixed
+    global_thread_pool().parallel(keys.size(), [&](auto k) noexcept {
+        auto [shape, lod, surface_tag] = keys[k];
+        auto surface = _pipeline.surfaces().impl(surface_tag);
+        auto [vertices, triangles] = shape->lod(lod);
+        auto vertex_uv = [shape, vertices](uint index) noexcept {
+            auto uv = vertices[index].uv();
+            if (!shape->compressed_vertices()) { return uv; }
+            // match the half-precision UVs seen by the shader
+            uv = clamp(uv, half_min, half_max);
+            return make_float2(half_to_float(float_to_half(uv.x)),
+                               half_to_float(float_to_half(uv.y)));
+        };
+        states[k].resize((triangles.size() + 15u) / 16u, 0u);
+        for (auto t = 0u; t < triangles.size(); t++) {
+            // meshes without UVs use the barycentric coordinates instead
+            auto uv_min = make_float2(0.f);
+            auto uv_max = make_float2(1.f);
+            if (shape->has_vertex_uv()) {
+                auto triangle = triangles[t];
+                auto uv0 = vertex_uv(triangle.i0);
+                auto uv1 = vertex_uv(triangle.i1);
+                auto uv2 = vertex_uv(triangle.i2);
+                uv_min = min(min(uv0, uv1), uv2);
+                uv_max = max(max(uv0, uv1), uv2);
+            }
+            auto state = opacity_state_mixed;
+            if (auto range = surface->evaluate_opacity_range(uv_min, uv_max)) {
+                // the alpha test skips a hit if a uniform number in [0, 1) exceeds the opacity
+                if (range->x >= 1.f) {
+                    state = opacity_state_opaque;
+                } else if (range->y <= 0.f) {
+                    state = opacity_state_transparent;
+                }
+            }
+            if (state != opacity_state_mixed) { classified[k] = 1u; }
+            states[k][t / 16u] |= state << (t % 16u * 2u);
+        }
+    });
+    global_thread_pool().synchronize();
+    // instances whose triangles are all mixed fall back to the full test without a lookup
+    // the states of all meshes are packed into one buffer, addressed by per-instance offsets
+    luisa::vector<uint> packed_states;
+    luisa::vector<uint> key_offsets(keys.size(), ~0u);
+    auto opaque_count = 0u;
+    auto transparent_count = 0u;
+    auto mixed_count = 0u;
+    for (auto k = 0u; k < keys.size(); k++) {
+        auto triangle_count = std::get<0>(keys[k])->lod(std::get<1>(keys[k])).triangles.size();
+        for (auto t = 0u; t < triangle_count; t++) {
+            switch ((states[k][t / 16u] >> (t % 16u * 2u)) & 3u) {
+                case opacity_state_opaque: opaque_count++; break;
+                case opacity_state_transparent: transparent_count++; break;
+                default: mixed_count++; break;
+            }
+        }
+        if (!classified[k]) { continue; }
+        key_offsets[k] = static_cast<uint>(packed_states.size());
+        packed_states.insert(packed_states.end(), states[k].cbegin(), states[k].cend());
+        _any_opacity_states = true;
+    }
+    LUISA_INFO_WITH_LOCATION("Classified alpha-tested triangles: {} opaque, {} transparent and {} mixed.",
+                             opaque_count, transparent_count, mixed_count);
+    if (!_any_opacity_states) { return; }
+    luisa::vector<uint> instance_offsets(_mesh_instances.size(), ~0u);
+    for (auto i = 0u; i < _mesh_instances.size(); i++) {
+        if (auto k = instance_keys[i]; k != ~0u) { instance_offsets[i] = key_offsets[k]; }
+    }
+    _opacity_states = _pipeline.device().create_buffer<uint>(packed_states.size());
+    _opacity_state_offsets = _pipeline.device().create_buffer<uint>(instance_offsets.size());
+    // the host-side states must outlive the commands that upload them
+    command_buffer << _opacity_states.copy_from(packed_states.data())
+                   << _opacity_state_offsets.copy_from(instance_offsets.data())
+                   << compute::commit();
+}
+
 Bool Geometry::_alpha_skip(const Var<Ray> &ray, const Var<SurfaceHit> &hit) const noexcept {
+    if (!_any_opacity_states) { return _alpha_test(ray, hit); }
+    // consult the precomputed states first, so that only triangles
+    // with varying opacity pay for the interaction and the texture lookups
+    auto offset = _opacity_state_offsets->read(hit.inst);
+    auto state = def(opacity_state_mixed);
+    $if(offset != ~0u) {
+        auto word = _opacity_states->read(offset + hit.prim / 16u);
+        state = (word >> (hit.prim % 16u * 2u)) & 3u;
+    };
+    auto skip = def(false);
+    $if(state == opacity_state_transparent) {
+        skip = true;
+    }
+    $elif(state == opacity_state_mixed) {
+        skip = _alpha_test(ray, hit);
+    };
+    return skip;
+}
+
+Bool Geometry::_alpha_test(const Var<Ray> &ray, const Var<SurfaceHit> &hit) const noexcept {
     auto bary = make_float3(1.f - hit.bary.x - hit.bary.y, hit.bary);
     auto it = interaction(hit.inst, hit.prim, bary, -ray->direction());
     auto skip = def(true);
@@ -191,38 +920,336 @@ Bool Geometry::_alpha_skip(const Var<Ray> &ray, const Var<SurfaceHit> &hit) cons
     return skip;
 }
 
+void Geometry::_deform_meshes(CommandBuffer &command_buffer, float time, bool rebuild) noexcept {
+    global_thread_pool().parallel(_deformables.size(), [time, this](auto i) noexcept {
+        auto &&d = _deformables[i];
+        d.shape->deform(time, d.vertices);
+        if (d.alias_table_buffer) {
+            auto triangles = d.shape->mesh().triangles;
+            auto [alias_table, pdf] = detail::geometry_area_sampling_table(d.vertices, triangles, d.emission);
+            d.alias_table = std::move(alias_table);
+            d.light_tree = detail::geometry_light_tree(d.vertices, triangles, d.emission, pdf);
+        }
+    });
+    global_thread_pool().synchronize();
+    for (auto &&d : _deformables) {
+        // the topology is fixed, so refitting the BLAS suffices
+        command_buffer << d.vertex_buffer->copy_from(d.vertices.data())
+                       << d.resource->build(rebuild ? compute::AccelBuildRequest::FORCE_BUILD :
+                                                      compute::AccelBuildRequest::PREFER_UPDATE);
+        if (d.alias_table_buffer) {
+            command_buffer << d.alias_table_buffer->copy_from(d.alias_table.data())
+                           << d.light_tree_buffer->copy_from(d.light_tree.data());
+        }
+    }
+}
+
 bool Geometry::update(CommandBuffer &command_buffer, float time) noexcept {
     auto updated = false;
-    if (!_dynamic_transforms.empty()) {
+    if (!_deformables.empty() && time != _deformed_time) {
         updated = true;
-        if (_dynamic_transforms.size() < 128u) {
-            for (auto t : _dynamic_transforms) {
-                _accel.set_transform_on_update(
-                    t.instance_id(), t.matrix(time));
+        _deformed_time = time;
+        // deformed BLASes follow the rebuild schedule of the TLAS
+        auto rebuild = _accel_rebuild_interval != 0u &&
+                       _accel_updates_since_build + 1u >= _accel_rebuild_interval;
+        _deform_meshes(command_buffer, time, rebuild);
+    }
+    if (!_dynamic_transforms.empty() && time != _transform_time) {
+        _transform_time = time;
+        // only instances whose matrices actually changed are sent to the accel
+        luisa::vector<uint8_t> dirty(_dynamic_transforms.size(), 0u);
+        auto evaluate = [&](auto i) noexcept {
+            auto m = _dynamic_transforms[i].matrix(time);
+            if (std::memcmp(&m, &_dynamic_matrices[i], sizeof(m)) != 0) {
+                _dynamic_matrices[i] = m;
+                dirty[i] = 1u;
             }
+        };
+        if (_dynamic_transforms.size() < 128u) {
+            for (auto i = 0u; i < _dynamic_transforms.size(); i++) { evaluate(i); }
         } else {
-            global_thread_pool().parallel(
-                _dynamic_transforms.size(),
-                [this, time](auto i) noexcept {
-                    auto t = _dynamic_transforms[i];
-                    _accel.set_transform_on_update(
-                        t.instance_id(), t.matrix(time));
-                });
+            global_thread_pool().parallel(_dynamic_transforms.size(), evaluate);
             global_thread_pool().synchronize();
         }
-        command_buffer << _accel.build();
+        for (auto i = 0u; i < _dynamic_transforms.size(); i++) {
+            if (dirty[i]) {
+                updated = true;
+                _accel.set_transform_on_update(
+                    _dynamic_transforms[i].instance_id(), _dynamic_matrices[i]);
+            }
+        }
+    }
+    // moving instances only need the time for queries without a ray time
+    auto motion_updated = false;
+    if (!_motion_instances.empty() && time != _motion_time) {
+        _motion_time = time;
+        motion_updated = true;
+        command_buffer << _motion_time_buffer.copy_from(&_motion_time);
+    }
+    if (updated) {
+        // refit when allowed, but rebuild periodically to bound the quality loss
+        auto rebuild = _accel_rebuild_interval != 0u &&
+                       ++_accel_updates_since_build >= _accel_rebuild_interval;
+        if (rebuild) { _accel_updates_since_build = 0u; }
+        command_buffer << _accel.build(rebuild ? compute::AccelBuildRequest::FORCE_BUILD :
+                                                 compute::AccelBuildRequest::PREFER_UPDATE);
+    }
+    return updated || motion_updated;
+}
+
+void Geometry::_build_motion_instances(CommandBuffer &command_buffer, const BuildOptions &options,
+                                       luisa::span<const uint> instance_ids) noexcept {
+    _motion_span = options.shutter_span;
+    _motion_keyframes = options.motion_keyframes;
+    _motion_time = _transform_time;
+    // one BVH per moving mesh, shared by its instances
+    luisa::vector<uint> slots(_mesh_instances.size(), ~0u);
+    luisa::vector<uint> slot_meshes(instance_ids.size());
+    luisa::vector<std::pair<const Shape *, uint>> meshes;
+    luisa::unordered_map<uint, uint> mesh_indices;// by geometry buffer id
+    for (auto slot = 0u; slot < instance_ids.size(); slot++) {
+        auto &&inst = _mesh_instances[instance_ids[slot]];
+        auto geometry_id = _meshes.at(inst.shape)[inst.lod].geometry_buffer_id_base;
+        auto [iter, first] = mesh_indices.try_emplace(geometry_id, static_cast<uint>(meshes.size()));
+        if (first) { meshes.emplace_back(inst.shape, inst.lod); }
+        slot_meshes[slot] = iter->second;
+        slots[instance_ids[slot]] = slot;
+    }
+    luisa::vector<detail::GeometryMotionBVH> bvhs(meshes.size());
+    global_thread_pool().parallel(meshes.size(), [&](auto i) noexcept {
+        auto [vertices, triangles] = _mesh_view(meshes[i].first, meshes[i].second);
+        bvhs[i] = detail::geometry_motion_bvh(vertices, triangles);
+    });
+    global_thread_pool().synchronize();
+    // concatenate the trees, offsetting their node and triangle indices
+    luisa::vector<uint> mesh_roots(meshes.size());
+    luisa::vector<float4> nodes;
+    luisa::vector<float4> triangles;
+    for (auto i = 0u; i < bvhs.size(); i++) {
+        auto node_base = static_cast<uint>(nodes.size() / 2u);
+        auto triangle_base = static_cast<uint>(triangles.size() / 3u);
+        mesh_roots[i] = node_base;
+        for (auto n = 0u; n < bvhs[i].nodes.size(); n += 2u) {
+            auto interior = luisa::bit_cast<uint>(bvhs[i].nodes[n + 1u].w) == detail::geometry_motion_bvh_interior;
+            auto index = luisa::bit_cast<uint>(bvhs[i].nodes[n].w) + (interior ? node_base : triangle_base);
+            nodes.emplace_back(make_float4(bvhs[i].nodes[n].xyz(), luisa::bit_cast<float>(index)));
+            nodes.emplace_back(bvhs[i].nodes[n + 1u]);
+        }
+        triangles.insert(triangles.end(), bvhs[i].triangles.cbegin(), bvhs[i].triangles.cend());
+    }
+    // sample the transforms of the moving instances uniformly over the shutter, and
+    // decompose them so that rotations are interpolated without shearing or scaling
+    luisa::vector<DecomposedTransform> keyframes(instance_ids.size() * _motion_keyframes);
+    auto is_moving = [&slots](auto t) noexcept { return slots[t.instance_id()] != ~0u; };
+    for (auto t : _dynamic_transforms) {
+        if (!is_moving(t)) { continue; }
+        auto slot = slots[t.instance_id()];
+        for (auto k = 0u; k < _motion_keyframes; k++) {
+            auto time = lerp(_motion_span.x, _motion_span.y,
+                             static_cast<float>(k) / static_cast<float>(_motion_keyframes - 1u));
+            auto &&keyframe = keyframes[slot * _motion_keyframes + k];
+            keyframe = decompose(t.matrix(time));
+            // take the shorter arc between consecutive rotations
+            if (k != 0u && dot(keyframes[slot * _motion_keyframes + k - 1u].quaternion, keyframe.quaternion) < 0.f) {
+                keyframe.quaternion = keyframe.quaternion * -1.f;
+            }
+        }
+    }
+    // the moving instances are no longer updated on the host
+    _dynamic_transforms.erase(std::remove_if(_dynamic_transforms.begin(), _dynamic_transforms.end(), is_moving),
+                              _dynamic_transforms.end());
+    // bound the sweep of each instance by transforming the corners of its object-space bounds
+    // at fine steps, padded by the farthest a corner moves between two steps
+    luisa::vector<AABB> sweeps(instance_ids.size());
+    global_thread_pool().parallel(instance_ids.size(), [&](auto slot) noexcept {
+        auto root = mesh_roots[slot_meshes[slot]] * 2u;
+        auto o_min = nodes[root].xyz();
+        auto o_max = nodes[root + 1u].xyz();
+        auto s_min = make_float3(std::numeric_limits<float>::max());
+        auto s_max = make_float3(-std::numeric_limits<float>::max());
+        auto padding = 0.f;
+        std::array<float3, 8u> corners{};
+        for (auto k = 0u; k + 1u < _motion_keyframes; k++) {
+            auto &&t0 = keyframes[slot * _motion_keyframes + k];
+            auto &&t1 = keyframes[slot * _motion_keyframes + k + 1u];
+            for (auto s = k == 0u ? 0u : 1u; s <= detail::geometry_motion_bound_steps; s++) {
+                auto m = detail::geometry_motion_matrix(
+                    t0, t1, static_cast<float>(s) / static_cast<float>(detail::geometry_motion_bound_steps));
+                for (auto c = 0u; c < 8u; c++) {
+                    auto p = make_float3(m * make_float4((c & 1u) ? o_max.x : o_min.x,
+                                                         (c & 2u) ? o_max.y : o_min.y,
+                                                         (c & 4u) ? o_max.z : o_min.z, 1.f));
+                    if (k != 0u || s != 0u) { padding = std::max(padding, length(p - corners[c])); }
+                    corners[c] = p;
+                    s_min = min(s_min, p);
+                    s_max = max(s_max, p);
+                }
+            }
+        }
+        s_min -= padding;
+        s_max += padding;
+        sweeps[slot] = AABB{.packed_min = {s_min.x, s_min.y, s_min.z},
+                            .packed_max = {s_max.x, s_max.y, s_max.z}};
+    });
+    global_thread_pool().synchronize();
+    for (auto slot = 0u; slot < instance_ids.size(); slot++) {
+        auto aabb_buffer = _pipeline.create<Buffer<AABB>>(1u);
+        auto proxy = _pipeline.create<ProceduralPrimitive>(aabb_buffer->view(), AccelOption{});
+        command_buffer << aabb_buffer->copy_from(&sweeps[slot])
+                       << proxy->build();
+        _motion_instances.emplace_back(MotionInstance{instance_ids[slot], proxy});
+        for (auto i = 0u; i < 3u; i++) {
+            _world_min[i] = std::min(_world_min[i], sweeps[slot].packed_min[i]);
+            _world_max[i] = std::max(_world_max[i], sweeps[slot].packed_max[i]);
+        }
     }
-    return updated;
+    luisa::vector<float4> srts(keyframes.size() * 3u);
+    for (auto i = 0u; i < keyframes.size(); i++) {
+        auto &&q = keyframes[i].quaternion;
+        srts[i * 3u + 0u] = make_float4(keyframes[i].translation, 0.f);
+        srts[i * 3u + 1u] = make_float4(q.v, q.w);
+        srts[i * 3u + 2u] = make_float4(keyframes[i].scaling, 0.f);
+    }
+    luisa::vector<uint> roots(instance_ids.size());
+    for (auto slot = 0u; slot < instance_ids.size(); slot++) { roots[slot] = mesh_roots[slot_meshes[slot]]; }
+    _motion_keyframes_srt = _pipeline.device().create_buffer<float4>(srts.size());
+    _motion_slots = _pipeline.device().create_buffer<uint>(slots.size());
+    _motion_bvh_roots = _pipeline.device().create_buffer<uint>(roots.size());
+    _motion_bvh_nodes = _pipeline.device().create_buffer<float4>(nodes.size());
+    _motion_triangles = _pipeline.device().create_buffer<float4>(std::max<size_t>(triangles.size(), 1u));
+    _motion_time_buffer = _pipeline.device().create_buffer<float>(1u);
+    command_buffer << _motion_keyframes_srt.copy_from(srts.data())
+                   << _motion_slots.copy_from(slots.data())
+                   << _motion_bvh_roots.copy_from(roots.data())
+                   << _motion_bvh_nodes.copy_from(nodes.data());
+    if (!triangles.empty()) { command_buffer << _motion_triangles.copy_from(triangles.data()); }
+    command_buffer << _motion_time_buffer.copy_from(&_motion_time)
+                   << compute::commit();
+    LUISA_INFO_WITH_LOCATION("Native motion blur for {} moving instance(s) over {} mesh(es) with {} keyframes.",
+                             _motion_instances.size(), meshes.size(), _motion_keyframes);
+}
+
+std::tuple<Float3, Float4, Float3> Geometry::_motion_transform(Expr<uint> slot, Expr<float> time) const noexcept {
+    auto x = clamp((time - _motion_span.x) / (_motion_span.y - _motion_span.x), 0.f, 1.f) *
+             static_cast<float>(_motion_keyframes - 1u);
+    auto k = min(compute::cast<uint>(x), _motion_keyframes - 2u);
+    auto f = x - compute::cast<float>(k);
+    auto i0 = (slot * _motion_keyframes + k) * 3u;
+    auto i1 = i0 + 3u;
+    auto t = lerp(_motion_keyframes_srt->read(i0).xyz(), _motion_keyframes_srt->read(i1).xyz(), f);
+    auto s = lerp(_motion_keyframes_srt->read(i0 + 2u).xyz(), _motion_keyframes_srt->read(i1 + 2u).xyz(), f);
+    // slerp, as the keyframe rotations are already on the same hemisphere
+    auto q0 = _motion_keyframes_srt->read(i0 + 1u);
+    auto q1 = _motion_keyframes_srt->read(i1 + 1u);
+    auto theta = acos(clamp(dot(q0, q1), -1.f, 1.f));
+    auto sin_theta = sin(theta);
+    auto w0 = ite(sin_theta > 1e-4f, sin((1.f - f) * theta) / sin_theta, 1.f - f);
+    auto w1 = ite(sin_theta > 1e-4f, sin(f * theta) / sin_theta, f);
+    auto q = normalize(w0 * q0 + w1 * q1);
+    return std::make_tuple(t, q, s);
+}
+
+Float4x4 Geometry::_motion_matrix(Expr<uint> slot, Expr<float> time) const noexcept {
+    auto [t, q, s] = _motion_transform(slot, time);
+    return make_float4x4(make_float4(detail::geometry_rotate(q, make_float3(s.x, 0.f, 0.f)), 0.f),
+                         make_float4(detail::geometry_rotate(q, make_float3(0.f, s.y, 0.f)), 0.f),
+                         make_float4(detail::geometry_rotate(q, make_float3(0.f, 0.f, s.z)), 0.f),
+                         make_float4(t, 1.f));
+}
+
+Float Geometry::_update_time() const noexcept {
+    if (_motion_instances.empty()) { return 0.f; }
+    return _motion_time_buffer->read(0u);
+}
+
+Var<SurfaceHit> Geometry::_intersect_motion(const Var<Ray> &ray, Expr<uint> inst_id,
+                                            Expr<float> time, bool any) const noexcept {
+    using namespace compute;
+    auto slot = _motion_slots->read(inst_id);
+    auto [offset, orientation, scale] = _motion_transform(slot, time);
+    // the direction is not normalized, so that distances along the ray are preserved
+    auto inverse_orientation = make_float4(-orientation.xyz(), orientation.w);
+    auto o = def(detail::geometry_rotate(inverse_orientation, ray->origin() - offset) / scale);
+    auto d = def(detail::geometry_rotate(inverse_orientation, ray->direction()) / scale);
+    auto inv_d = def(1.f / d);
+    auto maybe_non_opaque = def(false);
+    if (_any_non_opaque) { maybe_non_opaque = instance(inst_id).maybe_non_opaque(); }
+    auto hit = def<SurfaceHit>();
+    hit.inst = ~0u;
+    hit.committed_ray_t = ray->t_max();
+    ArrayVar<uint, detail::geometry_motion_bvh_stack_size> stack;
+    stack[0u] = _motion_bvh_roots->read(slot);
+    auto stack_size = def(1u);
+    $while(stack_size != 0u) {
+        stack_size -= 1u;
+        auto node = stack[stack_size];
+        auto lower = _motion_bvh_nodes->read(node * 2u);
+        auto upper = _motion_bvh_nodes->read(node * 2u + 1u);
+        auto t0 = (lower.xyz() - o) * inv_d;
+        auto t1 = (upper.xyz() - o) * inv_d;
+        auto t_near = min(t0, t1);
+        auto t_far = max(t0, t1);
+        auto t_enter = max(max(max(t_near.x, t_near.y), t_near.z), ray->t_min());
+        auto t_exit = min(min(min(t_far.x, t_far.y), t_far.z), hit.committed_ray_t);
+        $if(t_enter <= t_exit) {
+            auto index = as<uint>(lower.w);
+            auto count = as<uint>(upper.w);
+            $if(count == detail::geometry_motion_bvh_interior) {
+                stack[stack_size] = index;
+                stack[stack_size + 1u] = node + 1u;
+                stack_size += 2u;
+            }
+            $else {
+                $for(i, index, index + count) {
+                    // Moller-Trumbore in object space
+                    auto p0 = _motion_triangles->read(i * 3u);
+                    auto e1 = _motion_triangles->read(i * 3u + 1u).xyz() - p0.xyz();
+                    auto e2 = _motion_triangles->read(i * 3u + 2u).xyz() - p0.xyz();
+                    auto pv = cross(d, e2);
+                    auto det = dot(e1, pv);
+                    auto inv_det = 1.f / det;
+                    auto tv = o - p0.xyz();
+                    auto u = dot(tv, pv) * inv_det;
+                    auto qv = cross(tv, e1);
+                    auto v = dot(d, qv) * inv_det;
+                    auto t = dot(e2, qv) * inv_det;
+                    $if(det != 0.f & u >= 0.f & v >= 0.f & u + v <= 1.f &
+                        t >= ray->t_min() & t < hit.committed_ray_t) {
+                        auto candidate = def<SurfaceHit>();
+                        candidate.inst = inst_id;
+                        candidate.prim = as<uint>(p0.w);
+                        candidate.bary = make_float2(u, v);
+                        candidate.committed_ray_t = t;
+                        auto accept = def(true);
+                        $if(maybe_non_opaque) { accept = !_alpha_skip(ray, candidate); };
+                        $if(accept) {
+                            hit = candidate;
+                            if (any) {
+                                stack_size = 0u;
+                                $break;
+                            }
+                        };
+                    };
+                };
+            };
+        };
+    };
+    return hit;
+}
+
+Var<Hit> Geometry::trace_closest(const Var<Ray> &ray) const noexcept {
+    return trace_closest(ray, _update_time());
 }
 
-Var<Hit> Geometry::trace_closest(const Var<Ray> &ray_in) const noexcept {
-    if (!_any_non_opaque) {
+Var<Hit> Geometry::trace_closest(const Var<Ray> &ray_in, Expr<float> time) const noexcept {
+    auto any_motion = !_motion_instances.empty();
+    if (!_any_non_opaque && !_any_procedural && !any_motion) {
         // happy path
         auto hit = _accel->intersect(ray_in, {});
         return Var<Hit>{hit.inst, hit.prim, hit.bary};
     }
     // TODO: DirectX has bug with ray query, so we manually march the ray here
-    if (_pipeline.device().backend_name() == "dx") {
+    if (!_any_procedural && !any_motion && _pipeline.device().backend_name() == "dx") {
         auto ray = ray_in;
         auto hit = _accel->intersect(ray, {});
         constexpr auto max_iterations = 100u;
@@ -244,8 +1271,9 @@ Var<Hit> Geometry::trace_closest(const Var<Ray> &ray_in) const noexcept {
         };
         return Var<Hit>{hit.inst, hit.prim, hit.bary};
     }
-    // use ray query
-    Callable impl = [this](Var<Ray> ray) noexcept {
+    // use ray query, in which moving instances are intersected through their proxies
+    Callable impl = [this, any_motion](Var<Ray> ray, Float time) noexcept {
+        auto motion_hit = def<SurfaceHit>();
         auto rq_hit =
             _accel->traverse(ray, {})
                 .on_surface_candidate([&](compute::SurfaceCandidate &c) noexcept {
@@ -253,18 +1281,48 @@ Var<Hit> Geometry::trace_closest(const Var<Ray> &ray_in) const noexcept {
                         c.commit();
                     };
                 })
+                .on_procedural_candidate([&](compute::ProceduralCandidate &c) noexcept {
+                    auto h = c.hit();
+                    auto moving = def(false);
+                    if (any_motion) { moving = _motion_slots->read(h.inst) != ~0u; }
+                    $if(moving) {
+                        auto hit = this->_intersect_motion(c.ray(), h.inst, time, false);
+                        $if(!hit->miss()) {
+                            motion_hit = hit;
+                            c.commit(hit.committed_ray_t);
+                        };
+                    }
+                    $else {
+                        auto t = this->_intersect_procedural(c.ray(), h.inst, h.prim);
+                        $if(t >= 0.f) { c.commit(t); };
+                    };
+                })
                 .trace();
-        return Var<Hit>{rq_hit.inst, rq_hit.prim, rq_hit.bary};
+        // procedural hits keep the hit distance, from which the interaction is recovered
+        Var<Hit> hit{rq_hit.inst, rq_hit.prim,
+                     ite(rq_hit->is_procedural(), make_float2(rq_hit.committed_ray_t, 0.f), rq_hit.bary)};
+        if (any_motion) {
+            $if(rq_hit->is_procedural() & _motion_slots->read(rq_hit.inst) != ~0u) {
+                hit.prim = motion_hit.prim;
+                hit.bary = motion_hit.bary;
+            };
+        }
+        return hit;
     };
-    return impl(ray_in);
+    return impl(ray_in, time);
 }
 
 Var<bool> Geometry::trace_any(const Var<Ray> &ray) const noexcept {
-    if (!_any_non_opaque) {
+    return trace_any(ray, _update_time());
+}
+
+Var<bool> Geometry::trace_any(const Var<Ray> &ray_in, Expr<float> time) const noexcept {
+    auto any_motion = !_motion_instances.empty();
+    if (!_any_non_opaque && !_any_procedural && !any_motion) {
         // happy path
-        return _accel->intersect_any(ray, {});
+        return _accel->intersect_any(ray_in, {});
     }
-    Callable impl = [this](Var<Ray> ray) noexcept {
+    Callable impl = [this, any_motion](Var<Ray> ray, Float time) noexcept {
         auto rq_hit =
             _accel->traverse_any(ray, {})
                 .on_surface_candidate([&](compute::SurfaceCandidate &c) noexcept {
@@ -272,16 +1330,35 @@ Var<bool> Geometry::trace_any(const Var<Ray> &ray) const noexcept {
                         c.commit();
                     };
                 })
+                .on_procedural_candidate([&](compute::ProceduralCandidate &c) noexcept {
+                    auto h = c.hit();
+                    auto moving = def(false);
+                    if (any_motion) { moving = _motion_slots->read(h.inst) != ~0u; }
+                    $if(moving) {
+                        auto hit = this->_intersect_motion(c.ray(), h.inst, time, true);
+                        $if(!hit->miss()) { c.commit(hit.committed_ray_t); };
+                    }
+                    $else {
+                        auto t = this->_intersect_procedural(c.ray(), h.inst, h.prim);
+                        $if(t >= 0.f) { c.commit(t); };
+                    };
+                })
                 .trace();
         return !rq_hit->miss();
     };
-    return impl(ray);
+    return impl(ray_in, time);
 }
 
 luisa::shared_ptr<Interaction> Geometry::interaction(Expr<uint> inst_id, Expr<uint> prim_id,
                                                      Expr<float3> bary, Expr<float3> wo) const noexcept {
+    return interaction(inst_id, prim_id, bary, wo, _update_time());
+}
+
+luisa::shared_ptr<Interaction> Geometry::interaction(Expr<uint> inst_id, Expr<uint> prim_id,
+                                                     Expr<float3> bary, Expr<float3> wo,
+                                                     Expr<float> time) const noexcept {
     auto shape = instance(inst_id);
-    auto m = instance_to_world(inst_id);
+    auto m = instance_to_world(inst_id, time);
     auto tri = triangle(shape, prim_id);
     auto attrib = shading_point(shape, tri, bary, m);
     return luisa::make_shared<Interaction>(
@@ -290,28 +1367,122 @@ luisa::shared_ptr<Interaction> Geometry::interaction(Expr<uint> inst_id, Expr<ui
 }
 
 luisa::shared_ptr<Interaction> Geometry::interaction(const Var<Ray> &ray, const Var<Hit> &hit) const noexcept {
+    return interaction(ray, hit, _update_time());
+}
+
+luisa::shared_ptr<Interaction> Geometry::interaction(const Var<Ray> &ray, const Var<Hit> &hit,
+                                                     Expr<float> time) const noexcept {
     using namespace luisa::compute;
     Interaction it;
+    auto triangle_interaction = [&] {
+        return *interaction(hit.inst, hit.prim,
+                            make_float3(1.f - hit.bary.x - hit.bary.y, hit.bary),
+                            -ray->direction(), time);
+    };
     $if(!hit->miss()) {
-        it = *interaction(hit.inst, hit.prim,
-                          make_float3(1.f - hit.bary.x - hit.bary.y, hit.bary),
-                          -ray->direction());
+        if (!_any_procedural) {
+            it = triangle_interaction();
+        } else {
+            $if(instance(hit.inst).is_procedural()) {
+                auto p = ray->origin() + hit.bary.x * ray->direction();
+                it = *_procedural_interaction(hit.inst, hit.prim, p, -ray->direction());
+            }
+            $else {
+                it = triangle_interaction();
+            };
+        }
     };
     return luisa::make_shared<Interaction>(std::move(it));
 }
 
+Float Geometry::_intersect_procedural(const Var<Ray> &ray, Expr<uint> inst_id, Expr<uint> prim_id) const noexcept {
+    auto shape = instance(inst_id);
+    auto primitive = _pipeline.buffer<AnalyticPrimitive>(shape.primitive_buffer_id()).read(prim_id);
+    // the direction is not normalized, so that distances along the ray are preserved
+    auto world_to_object = inverse(_accel->instance_transform(inst_id));
+    auto o = make_float3(world_to_object * make_float4(ray->origin(), 1.f));
+    auto d = make_float3(world_to_object * make_float4(ray->direction(), 0.f));
+    return intersect_analytic_primitive(primitive, o, d, ray->t_min(), ray->t_max());
+}
+
+luisa::shared_ptr<Interaction> Geometry::_procedural_interaction(Expr<uint> inst_id, Expr<uint> prim_id,
+                                                                 Expr<float3> p, Expr<float3> wo) const noexcept {
+    auto shape = instance(inst_id);
+    auto primitive = _pipeline.buffer<AnalyticPrimitive>(shape.primitive_buffer_id()).read(prim_id);
+    auto m = _accel->instance_transform(inst_id);
+    auto m3 = make_float3x3(m);
+    auto surface = analytic_primitive_surface(primitive, make_float3(inverse(m) * make_float4(p, 1.f)));
+    auto ps = m3 * surface.p + make_float3(m[3]);
+    auto n = normalize(transpose(inverse(m3)) * surface.n);
+    auto dpdu = normalize(m3 * surface.dpdu);
+    // exact for uniform scaling
+    auto area = surface.area * pow(abs(determinant(m3)), 2.f / 3.f);
+    return luisa::make_shared<Interaction>(
+        std::move(shape), inst_id, prim_id, area, ps, n,
+        surface.uv, ps, n, dpdu, dot(wo, n) < 0.f);
+}
+
+luisa::span<const float> Geometry::triangle_emission(const Shape *shape) const noexcept {
+    if (auto iter = _triangle_emissions.find(shape); iter != _triangle_emissions.end()) {
+        return iter->second;
+    }
+    return {};
+}
+
 Shape::Handle Geometry::instance(Expr<uint> index) const noexcept {
     return Shape::Handle::decode(_instance_buffer->read(index));
 }
 
 Float4x4 Geometry::instance_to_world(Expr<uint> index) const noexcept {
-    return _accel->instance_transform(index);
+    return instance_to_world(index, _update_time());
+}
+
+Float4x4 Geometry::instance_to_world(Expr<uint> index, Expr<float> time) const noexcept {
+    if (_motion_instances.empty()) { return _accel->instance_transform(index); }
+    auto m = def(_accel->instance_transform(index));
+    auto slot = _motion_slots->read(index);
+    $if(slot != ~0u) { m = _motion_matrix(slot, time); };
+    return m;
 }
 
 Var<Triangle> Geometry::triangle(const Shape::Handle &instance, Expr<uint> index) const noexcept {
     return _pipeline.buffer<Triangle>(instance.triangle_buffer_id()).read(index);
 }
 
+// The trees are in object space. Which side of a triangle a point lies on is invariant
+// under affine maps, but mirroring flips the winding against the world-space normals,
+// so mirrored instances are treated as two-sided.
+std::tuple<UInt, Float, Float> Geometry::sample_light_triangle(const Shape::Handle &instance, Expr<float4x4> shape_to_world,
+                                                               Expr<float3> p_from, Expr<bool> two_sided, Expr<float> u) const noexcept {
+    auto p = make_float3(inverse(shape_to_world) * make_float4(p_from, 1.f));
+    auto mirrored = determinant(make_float3x3(shape_to_world)) < 0.f;
+    constexpr auto words_per_node = detail::geometry_light_tree_node_words;
+    auto node_offset = (instance.triangle_count() + words_per_node - 1u) / words_per_node * 2u;
+    auto tree_buffer_id = instance.pdf_buffer_id();
+    auto [leaf, prob, u_remapped] = sample_light_tree(
+        _pipeline.buffer<LightTreeNode>(tree_buffer_id), p, two_sided | mirrored, u, node_offset);
+    // the descent stops at an interior node if nothing emits towards p_from
+    auto triangle_id = _pipeline.buffer<LightTreeNode>(tree_buffer_id).read(node_offset + leaf).triangle;
+    return std::make_tuple(ite(prob > 0.f, triangle_id, 0u), prob, u_remapped);
+}
+
+Float Geometry::light_triangle_pmf(const Shape::Handle &instance, Expr<float4x4> shape_to_world,
+                                   Expr<float3> p_from, Expr<bool> two_sided, Expr<uint> triangle_id) const noexcept {
+    auto p = make_float3(inverse(shape_to_world) * make_float4(p_from, 1.f));
+    auto mirrored = determinant(make_float3x3(shape_to_world)) < 0.f;
+    constexpr auto words_per_node = detail::geometry_light_tree_node_words;
+    auto padded_nodes = (instance.triangle_count() + words_per_node - 1u) / words_per_node;
+    auto node_offset = padded_nodes * 2u;
+    auto tree_buffer_id = instance.pdf_buffer_id();
+    auto leaf = _pipeline.buffer<uint>(tree_buffer_id).read(padded_nodes * words_per_node + triangle_id);
+    auto prob = def(0.f);
+    $if(leaf != ~0u) {
+        prob = pmf_light_tree(_pipeline.buffer<LightTreeNode>(tree_buffer_id),
+                              p, two_sided | mirrored, leaf, node_offset);
+    };
+    return prob;
+}
+
 template<typename T>
 [[nodiscard]] inline auto interpolate(Expr<float3> uvw,
                                       const T &v0,
@@ -320,12 +1491,35 @@ template<typename T>
     return uvw.x * v0 + uvw.y * v1 + uvw.z * v2;
 }
 
+Var<Vertex> Geometry::_vertex(const Shape::Handle &instance, Expr<uint> index) const noexcept {
+    auto v_buffer = instance.vertex_buffer_id();
+    if (!_any_compressed_vertex) { return _pipeline.buffer<Vertex>(v_buffer).read(index); }
+    Var<Vertex> v;
+    $if(instance.compressed_vertex()) {
+        auto c = _pipeline.buffer<CompressedVertex>(v_buffer).read(index);
+        auto p = c->position();
+        auto n = c->normal();
+        auto uv = c->uv();
+        v.px = p.x;
+        v.py = p.y;
+        v.pz = p.z;
+        v.nx = n.x;
+        v.ny = n.y;
+        v.nz = n.z;
+        v.u = uv.x;
+        v.v = uv.y;
+    }
+    $else {
+        v = _pipeline.buffer<Vertex>(v_buffer).read(index);
+    };
+    return v;
+}
+
 GeometryAttribute Geometry::geometry_point(const Shape::Handle &instance, const Var<Triangle> &triangle,
                                            const Var<float3> &bary, const Var<float4x4> &shape_to_world) const noexcept {
-    auto v_buffer = instance.vertex_buffer_id();
-    auto v0 = _pipeline.buffer<Vertex>(v_buffer).read(triangle.i0);
-    auto v1 = _pipeline.buffer<Vertex>(v_buffer).read(triangle.i1);
-    auto v2 = _pipeline.buffer<Vertex>(v_buffer).read(triangle.i2);
+    auto v0 = _vertex(instance, triangle.i0);
+    auto v1 = _vertex(instance, triangle.i1);
+    auto v2 = _vertex(instance, triangle.i2);
     // object space
     auto p0 = v0->position();
     auto p1 = v1->position();
@@ -344,10 +1538,9 @@ GeometryAttribute Geometry::geometry_point(const Shape::Handle &instance, const
 
 ShadingAttribute Geometry::shading_point(const Shape::Handle &instance, const Var<Triangle> &triangle,
                                          const Var<float3> &bary, const Var<float4x4> &shape_to_world) const noexcept {
-    auto v_buffer = instance.vertex_buffer_id();
-    auto v0 = _pipeline.buffer<Vertex>(v_buffer).read(triangle.i0);
-    auto v1 = _pipeline.buffer<Vertex>(v_buffer).read(triangle.i1);
-    auto v2 = _pipeline.buffer<Vertex>(v_buffer).read(triangle.i2);
+    auto v0 = _vertex(instance, triangle.i0);
+    auto v1 = _vertex(instance, triangle.i1);
+    auto v2 = _vertex(instance, triangle.i2);
     // object space
     auto p0_local = v0->position();
     auto p1_local = v1->position();
@@ -6,6 +6,8 @@
 
 #include <dsl/syntax.h>
 #include <runtime/rtx/accel.h>
+#include <runtime/rtx/procedural_primitive.h>
+#include <util/sampling.h>
 #include <base/transform.h>
 #include <base/light.h>
 #include <base/shape.h>
@@ -32,14 +34,17 @@ namespace luisa::render {
 using compute::Accel;
 using compute::AccelOption;
 using compute::Buffer;
+using compute::BufferView;
 using compute::Expr;
 using compute::Float4x4;
 using compute::Mesh;
+using compute::ProceduralPrimitive;
 using compute::Ray;
 using compute::SurfaceHit;
 using compute::Var;
 
 class Pipeline;
+class Camera;
 
 class Geometry {
 
@@ -47,6 +52,14 @@ public:
     struct MeshGeometry {
         Mesh *resource;
         uint buffer_id_base;
+        bool has_sampling_tables;// false until an emissive instance references the geometry
+        luisa::vector<float> emission;// per-triangle strength of textured lights, empty if uniform
+    };
+
+    // analytic primitives of a procedural shape, bound to a single bindless slot
+    struct ProceduralData {
+        ProceduralPrimitive *resource;
+        uint primitive_buffer_id;
     };
 
     struct MeshData {
@@ -59,22 +72,104 @@ public:
 
     static_assert(sizeof(MeshData) == 16u);
 
+    // mesh or procedural instance collected while walking the shape tree, built in bulk afterwards
+    struct MeshInstance {
+        const Shape *shape;
+        float4x4 object_to_world;
+        uint properties;
+        uint surface_tag;
+        uint light_tag;
+        uint medium_tag;
+        uint lod;    // level of detail of the mesh, 0 for the full mesh
+        bool visible;
+        bool dynamic;// transform changes over time
+    };
+
+    // mesh whose vertices are re-uploaded and whose BLAS is refit on every update
+    struct DeformableMesh {
+        const Shape *shape;
+        Mesh *resource{nullptr};
+        luisa::optional<BufferView<Vertex>> vertex_buffer;
+        luisa::optional<BufferView<AliasEntry>> alias_table_buffer;// only for emissive meshes
+        luisa::optional<BufferView<uint>> light_tree_buffer;// after the pdfs, see detail::geometry_light_tree
+        // host-side staging of the current pose
+        luisa::vector<Vertex> vertices;
+        luisa::vector<AliasEntry> alias_table;
+        luisa::vector<uint> light_tree;
+        luisa::vector<float> emission;// per-triangle strength of textured lights, from the UVs
+    };
+
+    // moving instance, represented in the TLAS by a procedural proxy bounding its sweep over
+    // the shutter; candidates are intersected through the object-space BVH of its triangles
+    // with the ray transformed by the keyframes interpolated at the ray time
+    struct MotionInstance {
+        uint instance_id;
+        ProceduralPrimitive *proxy;
+    };
+
+    struct BuildOptions {
+        AccelOption accel_option;
+        uint accel_rebuild_interval;// force a TLAS rebuild every N updates, 0 to always refit
+        float2 shutter_span;        // union of the shutter spans of all cameras
+        uint motion_keyframes;      // > 1 to interpolate moving instances per ray time
+        luisa::span<const Camera *const> cameras;// for selecting levels of detail
+        float lod_triangles_per_pixel;           // 0 to always use the full meshes
+        luisa::span<const Light *const> lights;  // punctual lights, not attached to shapes
+    };
+
     using SurfaceCandidate = compute::SurfaceCandidate;
 
+    // bounds the number of commits issued while uploading meshes
+    static constexpr auto mesh_upload_batch_bytes = static_cast<size_t>(256u << 20u);
+    // per-triangle opacity states of alpha-tested instances, 2 bits each and 16 per word
+    static constexpr auto opacity_state_opaque = 0u;
+    static constexpr auto opacity_state_transparent = 1u;
+    static constexpr auto opacity_state_mixed = 2u;
+
 private:
     Pipeline &_pipeline;
     Accel _accel;
     TransformTree _transform_tree;
     luisa::unordered_map<uint64_t, MeshGeometry> _mesh_cache;
-    luisa::unordered_map<const Shape *, MeshData> _meshes;
+    luisa::unordered_map<const Shape *, luisa::vector<MeshData>> _meshes;// per level of detail, null resources for unused levels
+    luisa::unordered_map<const Shape *, ProceduralData> _procedurals;
+    luisa::unordered_map<const Shape *, luisa::span<const float>> _triangle_emissions;// into _mesh_cache
     luisa::vector<Light::Handle> _instanced_lights;
     luisa::vector<uint4> _instances;
     luisa::vector<InstancedTransform> _dynamic_transforms;
+    luisa::vector<MeshInstance> _mesh_instances;
+    luisa::vector<MeshInstance> _light_mesh_instances;
+    luisa::vector<DeformableMesh> _deformables;
+    luisa::unordered_map<const Shape *, uint> _deformable_indices;
+    float _deformed_time{};
+    // dirty tracking and refit-vs-rebuild policy of the top-level acceleration structure
+    luisa::vector<float4x4> _dynamic_matrices;// current transforms of _dynamic_transforms
+    float _transform_time{};
+    uint _accel_rebuild_interval{0u};
+    uint _accel_updates_since_build{0u};
+    // native motion blur
+    luisa::vector<MotionInstance> _motion_instances;
+    Buffer<float4> _motion_keyframes_srt;// translation, rotation and scaling of the keyframes of each motion instance, uniform over the shutter
+    Buffer<uint> _motion_slots;          // index into _motion_instances per instance, ~0u if not moving
+    Buffer<uint> _motion_bvh_roots;      // per motion instance
+    Buffer<float4> _motion_bvh_nodes;    // of all moving meshes, see detail::geometry_motion_bvh
+    Buffer<float4> _motion_triangles;    // object-space corners in leaf order
+    float2 _motion_span;
+    uint _motion_keyframes{0u};
+    float _motion_time{};            // of the last update, seen by queries without a ray time
+    Buffer<float> _motion_time_buffer;
     Buffer<uint4> _instance_buffer;
+    Buffer<uint> _opacity_states;       // 2 bits per triangle of all classified meshes
+    Buffer<uint> _opacity_state_offsets;// into _opacity_states per instance, ~0u if not classified
+    luisa::optional<BufferView<uint4>> _placeholder_table;// bound to the table slots of non-emissive meshes
     float3 _world_min;
     float3 _world_max;
     uint _triangle_count{};// for debug
+    uint _primitive_count{};// for debug
     bool _any_non_opaque{false};
+    bool _any_procedural{false};
+    bool _any_compressed_vertex{false};
+    bool _any_opacity_states{false};
 
 private:
     void _process_shape(
@@ -83,34 +178,84 @@ private:
         const Light *overridden_light = nullptr,
         const Medium *overridden_medium = nullptr,
         bool overridden_visible = true) noexcept;
+    void _select_lods(const BuildOptions &options, float init_time) noexcept;
+    void _build_meshes(CommandBuffer &command_buffer, float init_time) noexcept;
+    void _build_procedurals(CommandBuffer &command_buffer) noexcept;
+    void _deform_meshes(CommandBuffer &command_buffer, float time, bool rebuild) noexcept;
+    [[nodiscard]] MeshView _mesh_view(const Shape *shape, uint lod) const noexcept;// with the current pose of deformable meshes
+    void _compute_world_bounds() noexcept;
+    void _build_opacity_states(CommandBuffer &command_buffer) noexcept;
 
+    void _build_motion_instances(CommandBuffer &command_buffer, const BuildOptions &options,
+                                 luisa::span<const uint> instance_ids) noexcept;
+    // translation, rotation quaternion and scaling of a motion instance at the time
+    [[nodiscard]] std::tuple<Float3, Float4, Float3> _motion_transform(Expr<uint> slot, Expr<float> time) const noexcept;
+    [[nodiscard]] Float4x4 _motion_matrix(Expr<uint> slot, Expr<float> time) const noexcept;
+    [[nodiscard]] Float _update_time() const noexcept;
+    // closest (or any, if `any`) alpha-tested hit on a moving instance along the world-space ray
+    [[nodiscard]] Var<SurfaceHit> _intersect_motion(const Var<Ray> &ray, Expr<uint> inst_id,
+                                                    Expr<float> time, bool any) const noexcept;
+    // returns the hit distance along the world-space ray, or a negative value on a miss
+    [[nodiscard]] Float _intersect_procedural(const Var<Ray> &ray, Expr<uint> inst_id, Expr<uint> prim_id) const noexcept;
+    [[nodiscard]] luisa::shared_ptr<Interaction> _procedural_interaction(Expr<uint> inst_id, Expr<uint> prim_id,
+                                                                         Expr<float3> p, Expr<float3> wo) const noexcept;
+    [[nodiscard]] Var<Vertex> _vertex(const Shape::Handle &instance, Expr<uint> index) const noexcept;
     [[nodiscard]] Bool _alpha_skip(const Var<Ray> &ray,
                                    const Var<SurfaceHit> &hit) const noexcept;
+    [[nodiscard]] Bool _alpha_test(const Var<Ray> &ray,
+                                   const Var<SurfaceHit> &hit) const noexcept;
 
 public:
     explicit Geometry(Pipeline &pipeline) noexcept : _pipeline{pipeline} {};
     void build(CommandBuffer &command_buffer,
                luisa::span<const Shape *const> shapes,
-               float init_time) noexcept;
+               float init_time, const BuildOptions &options) noexcept;
     bool update(CommandBuffer &command_buffer, float time) noexcept;
     [[nodiscard]] auto instances() const noexcept { return luisa::span{_instances}; }
+    // emissive instances followed by punctual lights, which have Light::Handle::punctual_instance as the instance id
     [[nodiscard]] auto light_instances() const noexcept { return luisa::span{_instanced_lights}; }
+    // host-side shapes and initial transforms of the emissive instances leading light_instances(),
+    // for building light sampling structures
+    [[nodiscard]] auto light_mesh_instances() const noexcept { return luisa::span{_light_mesh_instances}; }
+    // per-triangle strength of the textured lights on an emissive mesh, as weighted in its
+    // sampling tables, summed over the lights sharing the geometry; empty if uniform
+    [[nodiscard]] luisa::span<const float> triangle_emission(const Shape *shape) const noexcept;
     [[nodiscard]] auto world_min() const noexcept { return _world_min; }
     [[nodiscard]] auto world_max() const noexcept { return _world_max; }
+    // true if moving instances are interpolated per ray time instead of updated per shutter sample
+    [[nodiscard]] auto motion_blur() const noexcept { return !_motion_instances.empty(); }
+    // true if some instances still change with the time passed to update()
+    [[nodiscard]] auto host_animated() const noexcept { return !_dynamic_transforms.empty() || !_deformables.empty(); }
+    // queries without a ray time see moving instances at the time of the last update
     [[nodiscard]] Var<Hit> trace_closest(const Var<Ray> &ray) const noexcept;
+    [[nodiscard]] Var<Hit> trace_closest(const Var<Ray> &ray, Expr<float> time) const noexcept;
     [[nodiscard]] Var<bool> trace_any(const Var<Ray> &ray) const noexcept;
+    [[nodiscard]] Var<bool> trace_any(const Var<Ray> &ray, Expr<float> time) const noexcept;
     [[nodiscard]] luisa::shared_ptr<Interaction> interaction(const Var<Ray> &ray, const Var<Hit> &hit) const noexcept;
+    [[nodiscard]] luisa::shared_ptr<Interaction> interaction(const Var<Ray> &ray, const Var<Hit> &hit, Expr<float> time) const noexcept;
     [[nodiscard]] luisa::shared_ptr<Interaction> interaction(Expr<uint> inst_id, Expr<uint> prim_id,
                                                              Expr<float3> bary, Expr<float3> wo) const noexcept;
+    [[nodiscard]] luisa::shared_ptr<Interaction> interaction(Expr<uint> inst_id, Expr<uint> prim_id,
+                                                             Expr<float3> bary, Expr<float3> wo,
+                                                             Expr<float> time) const noexcept;
     [[nodiscard]] Shape::Handle instance(Expr<uint> index) const noexcept;
     [[nodiscard]] Float4x4 instance_to_world(Expr<uint> index) const noexcept;
+    [[nodiscard]] Float4x4 instance_to_world(Expr<uint> index, Expr<float> time) const noexcept;
     [[nodiscard]] Var<Triangle> triangle(const Shape::Handle &instance, Expr<uint> index) const noexcept;
+    // picks an emissive triangle by its estimated contribution to p_from, returning
+    // the triangle, its probability and the remapped random number
+    [[nodiscard]] std::tuple<UInt, Float, Float> sample_light_triangle(const Shape::Handle &instance, Expr<float4x4> shape_to_world,
+                                                                       Expr<float3> p_from, Expr<bool> two_sided, Expr<float> u) const noexcept;
+    [[nodiscard]] Float light_triangle_pmf(const Shape::Handle &instance, Expr<float4x4> shape_to_world,
+                                           Expr<float3> p_from, Expr<bool> two_sided, Expr<uint> triangle_id) const noexcept;
     [[nodiscard]] GeometryAttribute geometry_point(const Shape::Handle &instance, const Var<Triangle> &triangle,
                                                    const Var<float3> &bary, const Var<float4x4> &shape_to_world) const noexcept;
     [[nodiscard]] ShadingAttribute shading_point(const Shape::Handle &instance, const Var<Triangle> &triangle,
                                                  const Var<float3> &bary, const Var<float4x4> &shape_to_world) const noexcept;
     [[nodiscard]] auto intersect(const Var<Ray> &ray) const noexcept { return interaction(ray, trace_closest(ray)); }
+    [[nodiscard]] auto intersect(const Var<Ray> &ray, Expr<float> time) const noexcept { return interaction(ray, trace_closest(ray, time), time); }
     [[nodiscard]] auto intersect_any(const Var<Ray> &ray) const noexcept { return trace_any(ray); }
+    [[nodiscard]] auto intersect_any(const Var<Ray> &ray, Expr<float> time) const noexcept { return trace_any(ray, time); }
 };
 
 }// namespace luisa::render
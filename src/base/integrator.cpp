@@ -2,9 +2,16 @@
 // Created by Mike on 2021/12/14.
 //
 
+#include <bit>
+#include <array>
+#include <mutex>
+#include <atomic>
+
 #include <base/scene.h>
 #include <sdl/scene_node_desc.h>
 #include <util/progress_bar.h>
+#include <util/image_writer.h>
+#include <util/rng.h>
 #include <base/integrator.h>
 #include <base/pipeline.h>
 
@@ -31,21 +38,290 @@ ProgressiveIntegrator::Instance::Instance(Pipeline &pipeline,
 
 ProgressiveIntegrator::Instance::~Instance() noexcept = default;
 
+namespace detail {
+
+static constexpr auto integrator_checkpoint_magic = 0x504b43415349554cull;// "LUISACKP" in little-endian
+static constexpr auto integrator_checkpoint_version = 1u;
+
+// followed by the framebuffer of the finished tiles (tiled rendering only)
+// and the accumulation state of the film window being rendered
+struct IntegratorCheckpointHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t camera_index;
+    uint32_t window_index;
+    uint32_t sample_id;
+    uint32_t spp;
+    uint32_t resolution_x;
+    uint32_t resolution_y;
+    uint32_t window_x;
+    uint32_t window_y;
+    uint32_t padding;
+    uint64_t framebuffer_size;
+    uint64_t film_size;
+};
+
+static_assert(sizeof(IntegratorCheckpointHeader) == 64u);
+
+// returns nullptr if the checkpoint is missing or invalid
+[[nodiscard]] static auto integrator_checkpoint_header(const MappedFile &file) noexcept {
+    auto header = static_cast<const IntegratorCheckpointHeader *>(nullptr);
+    if (!file || file.size() < sizeof(IntegratorCheckpointHeader)) { return header; }
+    header = reinterpret_cast<const IntegratorCheckpointHeader *>(file.data());
+    auto valid = header->magic == integrator_checkpoint_magic &&
+                 header->version == integrator_checkpoint_version &&
+                 file.size() == sizeof(IntegratorCheckpointHeader) +
+                                    header->framebuffer_size + header->film_size;
+    return valid ? header : nullptr;
+}
+
+// maps index d along the Hilbert curve over an n x n grid (n a power of two) to (x, y)
+[[nodiscard]] static auto hilbert_curve_point(uint n, uint d) noexcept {
+    auto x = 0u;
+    auto y = 0u;
+    for (auto s = 1u; s < n; s *= 2u) {
+        auto rx = 1u & (d / 2u);
+        auto ry = 1u & (d ^ rx);
+        if (ry == 0u) {
+            if (rx == 1u) {
+                x = s - 1u - x;
+                y = s - 1u - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4u;
+    }
+    return make_uint2(x, y);
+}
+
+[[nodiscard]] static auto integrator_tile_origins(uint2 resolution, uint2 tile_size,
+                                                  ProgressiveIntegrator::TileOrder order) noexcept {
+    auto tiles = (resolution + tile_size - 1u) / tile_size;
+    luisa::vector<uint2> origins;
+    origins.reserve(tiles.x * tiles.y);
+    switch (order) {
+        case ProgressiveIntegrator::TileOrder::HILBERT: {
+            // walk the curve over the enclosing power-of-two grid and skip tiles outside the film
+            auto n = std::bit_ceil(std::max(tiles.x, tiles.y));
+            for (auto d = 0u; d < n * n; d++) {
+                if (auto t = hilbert_curve_point(n, d); all(t < tiles)) {
+                    origins.emplace_back(t * tile_size);
+                }
+            }
+            break;
+        }
+        case ProgressiveIntegrator::TileOrder::SPIRAL: {
+            // ring by ring from the center, counter-clockwise within each ring
+            for (auto y = 0u; y < tiles.y; y++) {
+                for (auto x = 0u; x < tiles.x; x++) {
+                    origins.emplace_back(make_uint2(x, y));
+                }
+            }
+            auto center = make_float2(tiles - 1u) * .5f;
+            auto key = [center](uint2 t) noexcept {
+                auto d = make_float2(t) - center;
+                auto ring = std::max(std::abs(d.x), std::abs(d.y));
+                return std::make_pair(std::round(ring * 2.f), std::atan2(d.y, d.x));
+            };
+            std::stable_sort(origins.begin(), origins.end(), [&key](auto lhs, auto rhs) noexcept {
+                return key(lhs) < key(rhs);
+            });
+            for (auto &o : origins) { o *= tile_size; }
+            break;
+        }
+        case ProgressiveIntegrator::TileOrder::SCANLINE: {
+            for (auto y = 0u; y < tiles.y; y++) {
+                for (auto x = 0u; x < tiles.x; x++) {
+                    origins.emplace_back(make_uint2(x, y) * tile_size);
+                }
+            }
+            break;
+        }
+    }
+    return origins;
+}
+
+// Writes preview images through the image writer. The film is downloaded into one of
+// two host staging buffers; a preview is skipped if both are still being encoded or
+// the writer is saturated, so the stream never waits for the encoder.
+class IntegratorPreviewWriter {
+
+private:
+    std::filesystem::path _path;
+    std::array<std::filesystem::path, 2u> _temporary_paths;
+    uint2 _resolution;
+    std::array<luisa::vector<float4>, 2u> _staging;
+    std::array<std::atomic_bool, 2u> _busy{};
+    std::array<uint, 2u> _sequence{};
+    uint _next_sequence{0u};
+    uint _written_sequence{0u};
+    std::mutex _mutex;
+
+public:
+    IntegratorPreviewWriter(const std::filesystem::path &file, uint2 resolution) noexcept
+        : _path{file}, _resolution{resolution} {
+        // e.g., render.exr -> render.preview.exr, encoded into render.preview.tmp{0, 1}.exr
+        auto ext = file.extension().string();
+        _path.replace_extension(".preview" + ext);
+        for (auto i = 0u; i < _staging.size(); i++) {
+            _temporary_paths[i] = file;
+            _temporary_paths[i].replace_extension(".preview.tmp" + std::to_string(i) + ext);
+            _staging[i].resize(resolution.x * resolution.y);
+        }
+    }
+    ~IntegratorPreviewWriter() noexcept {
+        for (auto &b : _busy) {
+            while (b.load()) { std::this_thread::yield(); }
+        }
+    }
+    IntegratorPreviewWriter(IntegratorPreviewWriter &&) noexcept = delete;
+    IntegratorPreviewWriter(const IntegratorPreviewWriter &) noexcept = delete;
+    // returns a free staging buffer, or nullptr if the preview should be skipped
+    [[nodiscard]] float4 *acquire() noexcept {
+        for (auto i = 0u; i < _staging.size(); i++) {
+            if (!_busy[i].exchange(true)) {
+                _sequence[i] = ++_next_sequence;
+                return _staging[i].data();
+            }
+        }
+        return nullptr;
+    }
+    // encodes the acquired staging buffer once its contents are ready
+    void write(const float4 *staging) noexcept {
+        auto i = staging == _staging[0].data() ? 0u : 1u;
+        auto queued = global_image_writer().try_write(
+            _temporary_paths[i], reinterpret_cast<const float *>(staging), _resolution, 4u, [this, i] {
+                std::scoped_lock lock{_mutex};
+                // the previews are encoded concurrently, and a slow
+                // one must not replace a newer preview
+                std::error_code ec;
+                if (_sequence[i] > _written_sequence) {
+                    std::filesystem::rename(_temporary_paths[i], _path, ec);
+                    _written_sequence = _sequence[i];
+                } else {
+                    std::filesystem::remove(_temporary_paths[i], ec);
+                }
+                _busy[i].store(false);
+            });
+        if (!queued) { _busy[i].store(false); }
+    }
+};
+
+}// namespace detail
+
 void ProgressiveIntegrator::Instance::render(Stream &stream) noexcept {
     CommandBuffer command_buffer{&stream};
+    if (auto n = node<ProgressiveIntegrator>();
+        (any(n->tile_size() != 0u) || n->adaptive_threshold() > 0.f) &&
+        !_uses_default_render_loop()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Integrator '{}' does not support tiled rendering "
+            "or adaptive sampling. Ignoring the options.",
+            node()->impl_type());
+    }
+    auto &&options = render_options();
+    if ((options.deadline || !options.checkpoint.empty()) &&
+        !_uses_default_render_loop()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Integrator '{}' does not support deadlines "
+            "or checkpoints. Ignoring the options.",
+            node()->impl_type());
+    }
+    if (!options.checkpoint.empty() && _uses_default_render_loop()) {
+        if (_resume = MappedFile::open(options.checkpoint); _resume) {
+            if (auto h = detail::integrator_checkpoint_header(_resume)) {
+                LUISA_INFO("Resuming from checkpoint '{}' (camera {}).",
+                           options.checkpoint.string(), h->camera_index);
+            } else {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Ignoring invalid checkpoint '{}'.",
+                    options.checkpoint.string());
+                _resume = {};
+            }
+        }
+    }
     for (auto i = 0u; i < pipeline().camera_count(); i++) {
+        // cameras before the checkpoint have already been written
+        if (auto h = detail::integrator_checkpoint_header(_resume);
+            h != nullptr && h->camera_index > i) {
+            LUISA_INFO("Skipping camera {} finished before the checkpoint.", i);
+            continue;
+        }
         auto camera = pipeline().camera(i);
         auto resolution = camera->film()->node()->resolution();
         auto pixel_count = resolution.x * resolution.y;
-        camera->film()->prepare(command_buffer);
+        _camera_index = i;
+        // the remaining time is split evenly over the remaining cameras
+        _camera_deadline = luisa::nullopt;
+        if (options.deadline) {
+            auto now = std::chrono::steady_clock::now();
+            _camera_deadline = now + (*options.deadline - now) /
+                                         static_cast<int>(pipeline().camera_count() - i);
+        }
+        // in tiled mode, the film only holds the current tile on device and
+        // _render_one_camera() gathers the tiles into the framebuffer
+        auto tiled = _tile_size(camera).x != 0u;
+        _framebuffer.assign(pixel_count, make_float4(0.f));
+        if (!tiled) { camera->film()->prepare(command_buffer); }
+        pipeline().prefetch_resources(command_buffer, camera,
+                                      camera->node()->shutter_samples().front().point.time);
         _render_one_camera(command_buffer, camera);
-        luisa::vector<float4> pixels(pixel_count);
-        camera->film()->download(command_buffer, pixels.data());
-        command_buffer << compute::synchronize();
+        if (!tiled) {
+            camera->film()->download(command_buffer, _framebuffer.data());
+            command_buffer << compute::synchronize();
+        }
         camera->film()->release();
-        auto film_path = camera->node()->file();
-        save_image(film_path, reinterpret_cast<const float *>(pixels.data()), resolution);
+        _resume = {};
+        // the next camera is rendered while the image is being encoded
+        global_image_writer().write(camera->node()->file(), std::move(_framebuffer), resolution);
+    }
+    _framebuffer = {};
+    // the job is complete, so a later run should start from scratch
+    if (!options.checkpoint.empty() && _uses_default_render_loop()) {
+        global_image_writer().flush();
+        std::error_code ec;
+        std::filesystem::remove(options.checkpoint, ec);
+    }
+}
+
+uint2 ProgressiveIntegrator::Instance::_tile_size(const Camera::Instance *camera) const noexcept {
+    auto tile_size = node<ProgressiveIntegrator>()->tile_size();
+    if (any(tile_size == 0u) || !_uses_default_render_loop()) { return make_uint2(); }
+    auto resolution = camera->film()->node()->resolution();
+    // no need to tile if a single tile covers the film
+    if (all(tile_size >= resolution)) { return make_uint2(); }
+    if (!camera->film()->supports_windows()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Film '{}' does not support windows. "
+            "Tiled rendering disabled.",
+            camera->film()->node()->impl_type());
+        return make_uint2();
+    }
+    return min(tile_size, resolution);
+}
+
+bool ProgressiveIntegrator::Instance::_adaptive_sampling(const Camera::Instance *camera) const noexcept {
+    auto n = node<ProgressiveIntegrator>();
+    if (n->adaptive_threshold() <= 0.f || !_uses_default_render_loop()) { return false; }
+    if (!camera->film()->tracks_variance()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Film '{}' does not track variance. "
+            "Adaptive sampling disabled.",
+            camera->film()->node()->impl_type());
+        return false;
+    }
+    // stopping early would drop the later shutter samples of converged pixels,
+    // unless every sample covers the whole shutter with native motion blur
+    if (camera->node()->shutter_samples().size() > 1u &&
+        !pipeline().native_motion_blur()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Adaptive sampling is not supported with motion blur. "
+            "Adaptive sampling disabled.");
+        return false;
     }
+    return n->adaptive_min_spp() < camera->node()->spp();
 }
 
 void ProgressiveIntegrator::Instance::_render_one_camera(
@@ -55,8 +331,18 @@ void ProgressiveIntegrator::Instance::_render_one_camera(
     auto resolution = camera->film()->node()->resolution();
     auto image_file = camera->node()->file();
 
-    auto pixel_count = resolution.x * resolution.y;
-    sampler()->reset(command_buffer, resolution, pixel_count, spp);
+    // the film is rendered window by window: either the tiles or the whole film
+    auto tile_size = _tile_size(camera);
+    auto tiled = tile_size.x != 0u;
+    auto window_size = tiled ? tile_size : resolution;
+    auto windows = tiled ?
+                       detail::integrator_tile_origins(
+                           resolution, tile_size, node<ProgressiveIntegrator>()->tile_order()) :
+                       luisa::vector<uint2>{make_uint2()};
+    auto window_pixel_count = window_size.x * window_size.y;
+
+    // pixels keep their film coordinates, so samplers only need states for one window
+    sampler()->reset(command_buffer, resolution, window_pixel_count, spp);
     command_buffer << pipeline().printer().reset();
     command_buffer << compute::synchronize();
 
@@ -64,44 +350,308 @@ void ProgressiveIntegrator::Instance::_render_one_camera(
         "Rendering to '{}' of resolution {}x{} at {}spp.",
         image_file.string(),
         resolution.x, resolution.y, spp);
+    if (tiled) {
+        LUISA_INFO("Rendering in {} tiles of {}x{}.",
+                   windows.size(), tile_size.x, tile_size.y);
+    }
 
     using namespace luisa::compute;
 
-    Kernel2D render_kernel = [&](UInt frame_index, Float time, Float shutter_weight) noexcept {
+    // with native motion blur, the geometry is updated once and every sample
+    // picks its own time, stratified over the samples of each pixel
+    auto shutter_span = camera->node()->shutter_span();
+    auto shutter_points = camera->node()->shutter_points();
+    auto native_motion_blur = pipeline().native_motion_blur() && shutter_span.y > shutter_span.x;
+    // normalizes the piecewise-linear shutter curve to unit mean over the span
+    auto shutter_average_weight = 0.f;
+    if (native_motion_blur) {
+        for (auto i = 1u; i < shutter_points.size(); i++) {
+            auto p0 = shutter_points[i - 1u];
+            auto p1 = shutter_points[i];
+            shutter_average_weight += .5f * (p0.weight + p1.weight) * (p1.time - p0.time);
+        }
+        shutter_average_weight /= shutter_span.y - shutter_span.x;
+    }
+    auto sample_shutter = [&](Expr<uint> frame_index, Expr<uint2> pixel_id,
+                              Expr<float> time, Expr<float> shutter_weight) noexcept -> std::pair<Float, Float> {
+        if (!native_motion_blur) { return {time, shutter_weight}; }
+        auto offset = cast<float>(xxhash32(make_uint3(pixel_id, 0x5eed5eedu))) * 0x1p-32f;
+        auto u = fract((cast<float>(frame_index) + offset) / static_cast<float>(spp));
+        auto t = lerp(shutter_span.x, shutter_span.y, u);
+        if (shutter_average_weight <= 0.f) { return {t, 1.f}; }
+        auto w = def(0.f);
+        for (auto i = 1u; i < shutter_points.size(); i++) {
+            auto p0 = shutter_points[i - 1u];
+            auto p1 = shutter_points[i];
+            if (p1.time <= p0.time) { continue; }
+            auto x = clamp((t - p0.time) / (p1.time - p0.time), 0.f, 1.f);
+            w = ite(t >= p0.time, lerp(p0.weight, p1.weight, x), w);
+        }
+        return {t, w * (1.f / shutter_average_weight)};
+    };
+    if (native_motion_blur) {
+        LUISA_INFO("Sampling the shutter per sample with native motion blur.");
+    }
+
+    Kernel2D render_kernel = [&](UInt frame_index, Float shutter_time, Float shutter_weight_in, UInt2 window_offset) noexcept {
         set_block_size(16u, 16u, 1u);
-        auto pixel_id = dispatch_id().xy();
+        auto pixel_id = window_offset + dispatch_id().xy();
+        auto [time, shutter_weight] = sample_shutter(frame_index, pixel_id, shutter_time, shutter_weight_in);
         auto L = Li(camera, frame_index, pixel_id, time);
         camera->film()->accumulate(pixel_id, shutter_weight * L);
     };
 
+    // adaptive sampling: after a few uniform passes, only the pixels that fail the
+    // convergence test are compacted into a list and shaded in the next pass
+    auto adaptive = _adaptive_sampling(camera);
+    auto adaptive_threshold = node<ProgressiveIntegrator>()->adaptive_threshold();
+    auto adaptive_min_spp = node<ProgressiveIntegrator>()->adaptive_min_spp();
+    auto adaptive_pass_spp = node<ProgressiveIntegrator>()->adaptive_pass_spp();
+
     Clock clock_compile;
     auto render = pipeline().device().compile(render_kernel);
+    luisa::optional<Shader1D<Buffer<uint2>, uint, float, float>> adaptive_render;
+    luisa::optional<Shader2D<Buffer<uint2>, Buffer<uint>, uint2, float>> compact;
+    Buffer<uint2> active_pixels;
+    Buffer<uint> active_counter;
+    if (adaptive) {
+        Kernel1D adaptive_render_kernel = [&](BufferUInt2 active_pixels, UInt frame_index, Float shutter_time, Float shutter_weight_in) noexcept {
+            auto pixel_id = active_pixels.read(dispatch_x());
+            auto [time, shutter_weight] = sample_shutter(frame_index, pixel_id, shutter_time, shutter_weight_in);
+            auto L = Li(camera, frame_index, pixel_id, time);
+            camera->film()->accumulate(pixel_id, shutter_weight * L);
+        };
+        Kernel2D compact_kernel = [&](BufferUInt2 active_pixels, BufferUInt active_count,
+                                      UInt2 window_offset, Float threshold) noexcept {
+            set_block_size(16u, 16u, 1u);
+            auto pixel_id = window_offset + dispatch_id().xy();
+            $if(!(camera->film()->relative_error(pixel_id) <= threshold)) {
+                auto slot = active_count.atomic(0u).fetch_add(1u);
+                active_pixels.write(slot, pixel_id);
+            };
+        };
+        adaptive_render.emplace(pipeline().device().compile(adaptive_render_kernel));
+        compact.emplace(pipeline().device().compile(compact_kernel));
+        active_pixels = pipeline().device().create_buffer<uint2>(window_pixel_count);
+        active_counter = pipeline().device().create_buffer<uint>(1u);
+    }
     auto integrator_shader_compilation_time = clock_compile.toc();
     LUISA_INFO("Integrator shader compile in {} ms.", integrator_shader_compilation_time);
-    auto shutter_samples = camera->node()->shutter_samples();
+    auto shutter_samples = native_motion_blur ?
+                               luisa::vector<Camera::ShutterSample>{{{shutter_span.x, 1.f}, spp}} :
+                               camera->node()->shutter_samples();
     command_buffer << synchronize();
 
+    // resume from the checkpoint if it was saved for this camera with the same settings
+    auto &&options = render_options();
+    auto first_window = 0u;
+    auto first_sample = 0u;
+    auto resumed_film_size = static_cast<size_t>(0u);
+    auto resumed_film = static_cast<const std::byte *>(nullptr);
+    if (auto h = detail::integrator_checkpoint_header(_resume);
+        h != nullptr && h->camera_index == _camera_index) {
+        auto framebuffer_size = tiled ? _framebuffer.size() * sizeof(float4) : 0u;
+        if (h->spp == spp && h->resolution_x == resolution.x && h->resolution_y == resolution.y &&
+            h->window_index < windows.size() &&
+            all(windows[h->window_index] == make_uint2(h->window_x, h->window_y)) &&
+            h->framebuffer_size == framebuffer_size) {
+            first_window = h->window_index;
+            first_sample = h->sample_id;
+            auto data = _resume.data() + sizeof(detail::IntegratorCheckpointHeader);
+            std::memcpy(_framebuffer.data(), data, framebuffer_size);
+            resumed_film = data + framebuffer_size;
+            resumed_film_size = h->film_size;
+        } else {
+            LUISA_WARNING_WITH_LOCATION(
+                "Checkpoint '{}' does not match the current settings. "
+                "Rendering from scratch.",
+                options.checkpoint.string());
+        }
+    }
+
+    // the clock is only consulted after the stream catches up, as the
+    // host would otherwise run far ahead of the device
+    auto checkpointing = !options.checkpoint.empty();
+    auto synchronize_periodically = checkpointing || _camera_deadline.has_value();
+    auto save_checkpoint = [&](uint window_index, uint sample_id) noexcept {
+        luisa::vector<std::byte> film_state(camera->film()->checkpoint_size());
+        if (film_state.empty()) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Film '{}' does not support checkpoints. "
+                "Checkpointing disabled.",
+                camera->film()->node()->impl_type());
+            checkpointing = false;
+            return;
+        }
+        // a checkpoint past a camera skips it on resume, so its image
+        // must have left the asynchronous writer before that point
+        if (_flushed_camera_count < _camera_index) {
+            global_image_writer().flush();
+            _flushed_camera_count = _camera_index;
+        }
+        camera->film()->save_checkpoint(command_buffer, film_state.data());
+        command_buffer << synchronize();
+        auto offset = windows[window_index];
+        detail::IntegratorCheckpointHeader header{
+            .magic = detail::integrator_checkpoint_magic,
+            .version = detail::integrator_checkpoint_version,
+            .camera_index = _camera_index,
+            .window_index = window_index,
+            .sample_id = sample_id,
+            .spp = spp,
+            .resolution_x = resolution.x,
+            .resolution_y = resolution.y,
+            .window_x = offset.x,
+            .window_y = offset.y,
+            .framebuffer_size = tiled ? _framebuffer.size() * sizeof(float4) : 0u,
+            .film_size = film_state.size()};
+        std::array chunks{std::as_bytes(luisa::span{&header, 1u}),
+                          std::as_bytes(luisa::span{_framebuffer}).subspan(0u, header.framebuffer_size),
+                          luisa::span<const std::byte>{film_state}};
+        if (write_file_atomic(options.checkpoint, chunks)) {
+            LUISA_VERBOSE("Saved checkpoint '{}' at sample {} of window {}.",
+                          options.checkpoint.string(), sample_id, window_index);
+        }
+    };
+
+    // previews are downloaded without synchronizing and written by worker threads;
+    // the interval is checked on the device timeline through the progress callbacks
+    auto preview_spp = node<ProgressiveIntegrator>()->preview_spp();
+    auto preview_interval = node<ProgressiveIntegrator>()->preview_interval();
+    luisa::unique_ptr<detail::IntegratorPreviewWriter> preview_writer;
+    if (preview_spp != 0u || preview_interval > 0.f) {
+        preview_writer = luisa::make_unique<detail::IntegratorPreviewWriter>(image_file, resolution);
+    }
+    Clock preview_clock;
+    std::atomic_bool preview_due{false};
+    auto write_preview = [&] {
+        if (auto staging = preview_writer->acquire()) {
+            if (tiled) {
+                std::copy(_framebuffer.cbegin(), _framebuffer.cend(), staging);
+                preview_writer->write(staging);
+            } else {
+                camera->film()->download(command_buffer, staging);
+                command_buffer << [w = preview_writer.get(), staging] { w->write(staging); };
+            }
+        }
+        preview_due = false;
+        // in the non-tiled case, the clock belongs to the progress callbacks
+        if (tiled) { preview_clock.tic(); }
+    };
+
     LUISA_INFO("Rendering started.");
     Clock clock;
+    Clock checkpoint_clock;
     ProgressBar progress;
-    progress.update(0.);
+    progress.update((static_cast<double>(first_window) * spp + first_sample) /
+                    (static_cast<double>(windows.size()) * spp));
+    luisa::vector<float4> tile_pixels(tiled ? window_pixel_count : 0u);
+    auto total_samples = static_cast<double>(windows.size()) * spp;
+    auto shaded_samples = 0.;
     auto dispatch_count = 0u;
-    auto sample_id = 0u;
-    for (auto s : shutter_samples) {
-        pipeline().update(command_buffer, s.point.time);
-        for (auto i = 0u; i < s.spp; i++) {
-            command_buffer << render(sample_id++, s.point.time, s.point.weight)
-                                  .dispatch(resolution);
-            if (auto &&p = pipeline().printer(); !p.empty()) {
-                command_buffer << p.retrieve();
+    for (auto w = first_window; w < windows.size(); w++) {
+        auto offset = windows[w];
+        auto size = tiled ? min(tile_size, resolution - offset) : resolution;
+        if (tiled) { camera->film()->set_window(command_buffer, offset, size); }
+        auto sample_id = 0u;
+        auto active_count = size.x * size.y;
+        auto compaction_pending = false;
+        if (resumed_film != nullptr) {
+            if (camera->film()->checkpoint_size() == resumed_film_size) {
+                camera->film()->load_checkpoint(command_buffer, resumed_film);
+                sample_id = first_sample;
+                // the list of active pixels is not saved, so it is rebuilt
+                compaction_pending = adaptive && sample_id > adaptive_min_spp;
+                LUISA_INFO("Resumed from sample {} of window {}.", sample_id, w);
+            } else {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Checkpoint '{}' does not match the film. "
+                    "Rendering from scratch.",
+                    options.checkpoint.string());
             }
-            dispatch_count++;
-            if (camera->film()->show(command_buffer)) { dispatch_count = 0u; }
-            auto dispatches_per_commit = 4u;
-            if (dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
-                dispatch_count = 0u;
-                auto p = sample_id / static_cast<double>(spp);
-                command_buffer << [&progress, p] { progress.update(p); };
+            command_buffer << synchronize();
+            resumed_film = nullptr;
+            _resume = {};
+        }
+        // the remaining time is split evenly over the remaining windows
+        auto window_deadline = _camera_deadline;
+        if (window_deadline) {
+            auto now = std::chrono::steady_clock::now();
+            window_deadline = now + (*_camera_deadline - now) / static_cast<int>(windows.size() - w);
+        }
+        auto out_of_time = false;
+        auto zero = 0u;
+        auto shutter_end = 0u;
+        for (auto s : shutter_samples) {
+            shutter_end += s.spp;
+            // skip the shutter samples that have been taken before the checkpoint
+            if (sample_id >= shutter_end) { continue; }
+            pipeline().update(command_buffer, s.point.time);
+            while (sample_id < shutter_end && active_count != 0u && !out_of_time) {
+                if (adaptive && sample_id >= adaptive_min_spp) {
+                    if (compaction_pending || (sample_id - adaptive_min_spp) % adaptive_pass_spp == 0u) {
+                        compaction_pending = false;
+                        command_buffer << active_counter.copy_from(&zero)
+                                       << (*compact)(active_pixels, active_counter, offset, adaptive_threshold)
+                                              .dispatch(size)
+                                       << active_counter.copy_to(&active_count)
+                                       << synchronize();
+                        if (active_count == 0u) { break; }
+                    }
+                    command_buffer << (*adaptive_render)(active_pixels, sample_id++, s.point.time, s.point.weight)
+                                          .dispatch(active_count);
+                } else {
+                    command_buffer << render(sample_id++, s.point.time, s.point.weight, offset)
+                                          .dispatch(size);
+                }
+                shaded_samples += active_count;
+                if (auto &&p = pipeline().printer(); !p.empty()) {
+                    command_buffer << p.retrieve();
+                }
+                pipeline().stream_resources(command_buffer);
+                dispatch_count++;
+                if (camera->film()->show(command_buffer)) { dispatch_count = 0u; }
+                auto dispatches_per_commit = 4u;
+                if (dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
+                    dispatch_count = 0u;
+                    auto p = (static_cast<double>(w) * spp + sample_id) / total_samples;
+                    command_buffer << [&progress, p] { progress.update(p); };
+                    if (!tiled && preview_interval > 0.f) {
+                        command_buffer << [&] {
+                            if (preview_clock.toc() >= preview_interval * 1e3) {
+                                preview_clock.tic();
+                                preview_due = true;
+                            }
+                        };
+                    }
+                    if (synchronize_periodically) {
+                        command_buffer << synchronize();
+                        if (window_deadline && std::chrono::steady_clock::now() >= *window_deadline) {
+                            LUISA_INFO("Deadline reached at sample {} of window {}.", sample_id, w);
+                            out_of_time = true;
+                        } else if (checkpointing && checkpoint_clock.toc() >= options.checkpoint_interval * 1e3) {
+                            save_checkpoint(w, sample_id);
+                            checkpoint_clock.tic();
+                        }
+                    }
+                }
+                if (!tiled && preview_writer != nullptr && sample_id < spp &&
+                    ((preview_spp != 0u && sample_id % preview_spp == 0u) || preview_due)) {
+                    write_preview();
+                }
+            }
+        }
+        if (tiled) {
+            camera->film()->download(command_buffer, tile_pixels.data());
+            command_buffer << synchronize();
+            for (auto y = 0u; y < size.y; y++) {
+                std::copy_n(tile_pixels.data() + y * size.x, size.x,
+                            _framebuffer.data() + (offset.y + y) * resolution.x + offset.x);
+            }
+            // tiles are only complete at the end, so previews show the finished ones
+            if (preview_writer != nullptr && w + 1u < windows.size() &&
+                (preview_spp != 0u || preview_clock.toc() >= preview_interval * 1e3)) {
+                write_preview();
             }
         }
     }
@@ -110,6 +660,12 @@ void ProgressiveIntegrator::Instance::_render_one_camera(
 
     auto render_time = clock.toc();
     LUISA_INFO("Rendering finished in {} ms.", render_time);
+    if (adaptive) {
+        auto pixel_count = static_cast<double>(resolution.x) * resolution.y;
+        LUISA_INFO("Adaptive sampling took {:.2f}spp on average ({:.1f}% of the budget).",
+                   shaded_samples / pixel_count,
+                   100. * shaded_samples / (pixel_count * spp));
+    }
 }
 
 Float3 ProgressiveIntegrator::Instance::Li(const Camera::Instance *camera, Expr<uint> frame_index,
@@ -118,6 +674,28 @@ Float3 ProgressiveIntegrator::Instance::Li(const Camera::Instance *camera, Expr<
 }
 
 ProgressiveIntegrator::ProgressiveIntegrator(Scene *scene, const SceneNodeDesc *desc) noexcept
-    : Integrator{scene, desc} {}
+    : Integrator{scene, desc},
+      _tile_size{desc->property_uint2_or_default(
+          "tile_size", lazy_construct([desc] {
+              return make_uint2(desc->property_uint_or_default("tile_size", 0u));
+          }))},
+      _tile_order{[desc] {
+          auto order = desc->property_string_or_default("tile_order", "hilbert");
+          for (auto &c : order) { c = static_cast<char>(std::tolower(c)); }
+          if (order == "spiral") { return TileOrder::SPIRAL; }
+          if (order == "scanline") { return TileOrder::SCANLINE; }
+          if (order != "hilbert") {
+              LUISA_WARNING_WITH_LOCATION(
+                  "Unknown tile order \"{}\". "
+                  "Available options are: \"hilbert\", \"spiral\", \"scanline\".",
+                  order);
+          }
+          return TileOrder::HILBERT;
+      }()},
+      _adaptive_threshold{std::max(desc->property_float_or_default("adaptive_threshold", 0.f), 0.f)},
+      _adaptive_min_spp{std::max(desc->property_uint_or_default("adaptive_min_spp", 32u), 2u)},
+      _adaptive_pass_spp{std::max(desc->property_uint_or_default("adaptive_pass_spp", 8u), 1u)},
+      _preview_spp{desc->property_uint_or_default("preview_spp", 0u)},
+      _preview_interval{std::max(desc->property_float_or_default("preview_interval", 0.f), 0.f)} {}
 
 }// namespace luisa::render
@@ -4,7 +4,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+
 #include <util/command_buffer.h>
+#include <util/mapped_file.h>
 #include <base/scene_node.h>
 #include <base/sampler.h>
 #include <base/spectrum.h>
@@ -19,6 +23,16 @@ class Display;
 class Integrator : public SceneNode {
 
 public:
+    // settings of a render job that are not part of the scene, e.g., from the command line
+    struct RenderOptions {
+        // sampling stops at the deadline and the images are written as they are
+        luisa::optional<std::chrono::steady_clock::time_point> deadline;
+        // file to periodically save the progress to and to resume from, empty to disable
+        std::filesystem::path checkpoint;
+        // seconds between two checkpoints
+        double checkpoint_interval{300.};
+    };
+
     class Instance {
 
     private:
@@ -26,6 +40,7 @@ public:
         const Integrator *_integrator;
         luisa::unique_ptr<Sampler::Instance> _sampler;
         luisa::unique_ptr<LightSampler::Instance> _light_sampler;
+        RenderOptions _render_options;
 
     public:
         explicit Instance(Pipeline &pipeline, CommandBuffer &command_buffer, const Integrator *integrator) noexcept;
@@ -41,6 +56,8 @@ public:
         [[nodiscard]] auto sampler() const noexcept { return _sampler.get(); }
         [[nodiscard]] auto light_sampler() noexcept { return _light_sampler.get(); }
         [[nodiscard]] auto light_sampler() const noexcept { return _light_sampler.get(); }
+        [[nodiscard]] auto &render_options() const noexcept { return _render_options; }
+        virtual void set_render_options(const RenderOptions &options) noexcept { _render_options = options; }
         virtual void render(Stream &stream) noexcept = 0;
     };
 
@@ -58,13 +75,34 @@ public:
 
 class ProgressiveIntegrator : public Integrator {
 
+public:
+    enum struct TileOrder : uint8_t {
+        HILBERT,
+        SPIRAL,
+        SCANLINE,
+    };
+
 public:
     class Instance : public Integrator::Instance {
 
+    private:
+        luisa::vector<float4> _framebuffer;
+        MappedFile _resume;// checkpoint to resume from, if any
+        luisa::optional<std::chrono::steady_clock::time_point> _camera_deadline;
+        uint _camera_index{0u};
+        uint _flushed_camera_count{0u};// cameras whose images are known to be on disk
+
+    private:
+        [[nodiscard]] uint2 _tile_size(const Camera::Instance *camera) const noexcept;
+        [[nodiscard]] bool _adaptive_sampling(const Camera::Instance *camera) const noexcept;
+
     protected:
         [[nodiscard]] virtual Float3 Li(const Camera::Instance *camera, Expr<uint> frame_index,
                                         Expr<uint2> pixel_id, Expr<float> time) const noexcept;
         virtual void _render_one_camera(CommandBuffer &command_buffer, Camera::Instance *camera) noexcept;
+        // whether _render_one_camera() goes through the default Li()-based loop,
+        // which may render the film tile by tile and sample pixels adaptively
+        [[nodiscard]] virtual bool _uses_default_render_loop() const noexcept { return false; }
 
     public:
         Instance(Pipeline &pipeline,
@@ -74,8 +112,30 @@ public:
         void render(Stream &stream) noexcept override;
     };
 
+private:
+    uint2 _tile_size;
+    TileOrder _tile_order;
+    float _adaptive_threshold;
+    uint _adaptive_min_spp;
+    uint _adaptive_pass_spp;
+    uint _preview_spp;
+    float _preview_interval;
+
 public:
     ProgressiveIntegrator(Scene *scene, const SceneNodeDesc *desc) noexcept;
+    // zero if the film is rendered as a whole
+    [[nodiscard]] auto tile_size() const noexcept { return _tile_size; }
+    [[nodiscard]] auto tile_order() const noexcept { return _tile_order; }
+    // target relative error of adaptive sampling, zero if disabled
+    [[nodiscard]] auto adaptive_threshold() const noexcept { return _adaptive_threshold; }
+    // uniform samples taken before the first convergence test
+    [[nodiscard]] auto adaptive_min_spp() const noexcept { return _adaptive_min_spp; }
+    // samples per pixel between convergence tests
+    [[nodiscard]] auto adaptive_pass_spp() const noexcept { return _adaptive_pass_spp; }
+    // samples per pixel between two preview images, zero if disabled
+    [[nodiscard]] auto preview_spp() const noexcept { return _preview_spp; }
+    // seconds between two preview images, zero if disabled
+    [[nodiscard]] auto preview_interval() const noexcept { return _preview_interval; }
 };
 
 }// namespace luisa::render
@@ -5,8 +5,10 @@
 #pragma once
 
 #include <dsl/rtx/ray.h>
+#include <runtime/buffer.h>
 #include <runtime/bindless_array.h>
 #include <util/spec.h>
+#include <util/light_tree.h>
 #include <base/scene_node.h>
 #include <base/sampler.h>
 #include <base/shape.h>
@@ -15,6 +17,7 @@
 namespace luisa::render {
 
 using compute::BindlessArray;
+using compute::BufferView;
 using compute::Ray;
 
 class Shape;
@@ -24,6 +27,8 @@ class Light : public SceneNode {
 
 public:
     struct Handle {
+        // instance id of punctual lights, which have no geometry
+        static constexpr auto punctual_instance = ~0u;
         uint instance_id;
         uint light_tag;
     };
@@ -41,8 +46,12 @@ public:
     struct Sample {
         Evaluation eval;
         Float3 p;
+        // Whether p is drawn from a delta distribution, e.g., on punctual lights. The pdf then
+        // only holds the discrete probabilities, and as BSDF sampling never hits such lights,
+        // integrators must give the sample an MIS weight of one.
+        Bool delta;
         [[nodiscard]] static auto zero(uint spec_dim) noexcept {
-            return Sample{.eval = Evaluation::zero(spec_dim), .p = make_float3()};
+            return Sample{.eval = Evaluation::zero(spec_dim), .p = make_float3(), .delta = false};
         }
     };
 
@@ -94,11 +103,30 @@ public:
         [[nodiscard]] auto &pipeline() const noexcept { return _pipeline; }
         [[nodiscard]] virtual luisa::unique_ptr<Closure> closure(
             const SampledWavelengths &swl, Expr<float> time) const noexcept = 0;
+        // Whether the emission varies over the surface, i.e. triangle_emission() is implemented.
+        [[nodiscard]] virtual bool has_varying_emission() const noexcept { return false; }
+        // Enqueues a single dispatch that writes the emitted strength averaged over each triangle
+        // given the UVs of its corners, three per triangle, for weighting the sampling tables of
+        // emissive meshes. The caller batches the triangles of all meshes and synchronizes.
+        virtual void triangle_emission(CommandBuffer &command_buffer,
+                                       BufferView<float2> corner_uvs,
+                                       BufferView<float> emission) const noexcept {}
     };
 
 public:
     Light(Scene *scene, const SceneNodeDesc *desc) noexcept;
     [[nodiscard]] virtual bool is_null() const noexcept { return false; }
+    // rough host-side estimate of the emitted luminance averaged over the surface,
+    // used by light samplers to build importance sampling structures
+    [[nodiscard]] virtual float emission_estimate() const noexcept { return 1.f; }
+    // conservatively assume emission from both sides if the light does not tell
+    [[nodiscard]] virtual bool two_sided() const noexcept { return true; }
+    // Punctual lights emit from a single point, so they are listed in the scene root
+    // instead of being attached to shapes, and can only be reached by light sampling.
+    [[nodiscard]] virtual bool is_punctual() const noexcept { return false; }
+    // world-space bounds of the emission of punctual lights at the given time,
+    // with phi as the emitted flux of the luminance given by emission_estimate()
+    [[nodiscard]] virtual LightBounds punctual_bounds(float time) const noexcept { return {}; }
     [[nodiscard]] virtual luisa::unique_ptr<Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept = 0;
 };
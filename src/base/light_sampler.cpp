@@ -106,21 +106,21 @@ LightSampler::Sample LightSampler::Instance::sample_environment_le(
     auto to_world = cd.x * fr.s() + cd.y * fr.t() + 1.0f * fr.n();
     auto origin =world_center+world_radius * to_world;
     s.eval.pdf *= 1 / (pi * world_radius * world_radius);
-    return Sample{.eval = s.eval, .shadow_ray = make_ray(origin,-s.wi)};
+    return Sample{.eval = s.eval, .shadow_ray = make_ray(origin,-s.wi), .delta = false};
 }
 
 LightSampler::Sample LightSampler::Sample::zero(uint spec_dim) noexcept {
-    return Sample{.eval = Evaluation::zero(spec_dim), .shadow_ray = {}};
+    return Sample{.eval = Evaluation::zero(spec_dim), .shadow_ray = {}, .delta = false};
 }
 
 LightSampler::Sample LightSampler::Sample::from_light(const Light::Sample &s,
                                                       const Interaction &it_from) noexcept {
-    return Sample{.eval = s.eval, .shadow_ray = it_from.spawn_ray_to(s.p)};
+    return Sample{.eval = s.eval, .shadow_ray = it_from.spawn_ray_to(s.p), .delta = s.delta};
 }
 
 LightSampler::Sample LightSampler::Sample::from_environment(const Environment::Sample &s,
                                                             const Interaction &it_from) noexcept {
-    return Sample{.eval = s.eval, .shadow_ray = it_from.spawn_ray(s.wi)};
+    return Sample{.eval = s.eval, .shadow_ray = it_from.spawn_ray(s.wi), .delta = false};
 }
 
 }// namespace luisa::render
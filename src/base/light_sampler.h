@@ -29,6 +29,7 @@ public:
     struct Sample {
         Evaluation eval;
         Var<Ray> shadow_ray;
+        Bool delta;// see Light::Sample::delta
         [[nodiscard]] static Sample zero(uint spec_dim) noexcept;
         [[nodiscard]] static Sample from_light(const Light::Sample &s,
                                                const Interaction &it_from) noexcept;
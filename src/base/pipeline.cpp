@@ -2,7 +2,9 @@
 // Created by Mike on 2021/12/15.
 //
 
+#include <core/clock.h>
 #include <util/thread_pool.h>
+#include <util/image_writer.h>
 #include <util/sampling.h>
 #include <base/pipeline.h>
 #include <base/scene.h>
@@ -12,7 +14,7 @@ namespace luisa::render {
 inline Pipeline::Pipeline(Device &device) noexcept
     : _device{device},
       _bindless_array{device.create_bindless_array(bindless_array_capacity)},
-      _general_buffer_arena{luisa::make_unique<BufferArena>(device, 16_M)},
+      _general_buffer_arena{luisa::make_unique<BufferArena>(device, buffer_arena_chunk_size)},
       _printer{luisa::make_unique<compute::Printer>(device)} {}
 
 Pipeline::~Pipeline() noexcept = default;
@@ -69,7 +71,16 @@ luisa::unique_ptr<Pipeline> Pipeline::create(Device &device, Stream &stream, con
     }
     update_bindless_if_dirty();
     pipeline->_geometry = luisa::make_unique<Geometry>(*pipeline);
-    pipeline->_geometry->build(command_buffer, scene.shapes(), pipeline->_initial_time);
+    auto shutter_span = make_float2(initial_time, initial_time);
+    for (auto c : scene.cameras()) { shutter_span.y = std::max(shutter_span.y, c->shutter_span().y); }
+    pipeline->_geometry->build(command_buffer, scene.shapes(), pipeline->_initial_time,
+                               Geometry::BuildOptions{.accel_option = scene.accel_option(),
+                                                      .accel_rebuild_interval = scene.accel_rebuild_interval(),
+                                                      .shutter_span = shutter_span,
+                                                      .motion_keyframes = scene.motion_keyframes(),
+                                                      .cameras = scene.cameras(),
+                                                      .lod_triangles_per_pixel = scene.lod_triangles_per_pixel(),
+                                                      .lights = scene.lights()});
     update_bindless_if_dirty();
     if (auto env = scene.environment(); env != nullptr && !env->is_black()) {
         pipeline->_environment = env->build(*pipeline, command_buffer);
@@ -99,7 +110,6 @@ luisa::unique_ptr<Pipeline> Pipeline::create(Device &device, Stream &stream, con
 }
 
 bool Pipeline::update(CommandBuffer &command_buffer, float time) noexcept {
-    // TODO: support deformable meshes
     auto updated = _geometry->update(command_buffer, time);
     if (_any_dynamic_transform) {
         updated = true;
@@ -112,8 +122,44 @@ bool Pipeline::update(CommandBuffer &command_buffer, float time) noexcept {
     return updated;
 }
 
-void Pipeline::render(Stream &stream) noexcept {
+void Pipeline::stream_resources(CommandBuffer &command_buffer) noexcept {
+    for (auto &&callback : _streaming_callbacks) { callback(command_buffer, false); }
+}
+
+void Pipeline::prefetch_resources(CommandBuffer &command_buffer, const Camera::Instance *camera, float time) noexcept {
+    if (_streaming_callbacks.empty()) { return; }
+    auto iter = _prefetch_shaders.find(camera);
+    if (iter == _prefetch_shaders.end()) {
+        using namespace compute;
+        // shading the primary hits makes their textures record the tiles they need
+        Kernel2D prefetch_kernel = [&](Float shutter_time) noexcept {
+            set_block_size(16u, 16u, 1u);
+            auto pixel_id = dispatch_id().xy();
+            auto swl = _spectrum->sample(.5f);
+            auto camera_sample = camera->generate_ray(pixel_id, shutter_time, make_float2(.5f), make_float2(.5f));
+            auto it = _geometry->intersect(camera_sample.ray, shutter_time);
+            $if(it->valid() & it->shape().has_surface()) {
+                auto wo = -camera_sample.ray->direction();
+                PolymorphicCall<Surface::Closure> call;
+                _surfaces.dispatch(it->shape().surface_tag(), [&](auto surface) noexcept {
+                    surface->closure(call, *it, swl, wo, 1.f, shutter_time);
+                });
+            };
+        };
+        auto shader = luisa::make_unique<Shader2D<float>>(_device.compile(prefetch_kernel));
+        iter = _prefetch_shaders.emplace(camera, std::move(shader)).first;
+    }
+    Clock clock;
+    command_buffer << (*iter->second)(time).dispatch(camera->film()->node()->resolution());
+    for (auto &&callback : _streaming_callbacks) { callback(command_buffer, true); }
+    command_buffer << compute::synchronize();
+    LUISA_INFO("Prefetched on-demand resources in {} ms.", clock.toc());
+}
+
+void Pipeline::render(Stream &stream, const Integrator::RenderOptions &options) noexcept {
+    _integrator->set_render_options(options);
     _integrator->render(stream);
+    global_image_writer().flush();
 }
 
 const Texture::Instance *Pipeline::build_texture(CommandBuffer &command_buffer, const Texture *texture) noexcept {
@@ -5,13 +5,13 @@
 #pragma once
 
 #include <runtime/buffer.h>
-#include <runtime/buffer_arena.h>
 #include <runtime/image.h>
 #include <runtime/bindless_array.h>
 #include <runtime/rtx/mesh.h>
 #include <runtime/rtx/accel.h>
 
 #include <util/spec.h>
+#include <util/buffer_arena.h>
 #include <base/shape.h>
 #include <base/light.h>
 #include <base/camera.h>
@@ -37,7 +37,6 @@ using compute::BindlessBuffer;
 using compute::BindlessTexture2D;
 using compute::BindlessTexture3D;
 using compute::Buffer;
-using compute::BufferArena;
 using compute::BufferView;
 using compute::Callable;
 using compute::Device;
@@ -60,12 +59,14 @@ public:
     static constexpr auto bindless_array_capacity = 500'000u;// limitation of Metal
     static constexpr auto transform_matrix_buffer_size = 65536u;
     static constexpr auto constant_buffer_size = 256u * 1024u;
+    static constexpr auto buffer_arena_chunk_size = 16u * 1024u * 1024u;
     using ResourceHandle = luisa::unique_ptr<Resource>;
 
 private:
     Device &_device;
     BindlessArray _bindless_array;
     luisa::unique_ptr<BufferArena> _general_buffer_arena;
+    luisa::vector<uint> _arena_chunk_buffer_ids;// bindless id per arena chunk, ~0u until first addressed
     size_t _bindless_buffer_count{0u};
     size_t _bindless_tex2d_count{0u};
     size_t _bindless_tex3d_count{0u};
@@ -93,6 +94,10 @@ private:
     luisa::vector<float4x4> _transform_matrices;
     Buffer<float4x4> _transform_matrix_buffer;
     luisa::unordered_map<luisa::string, uint> _named_ids;
+    // host-side streaming of on-demand resources, run between sample passes
+    // and synchronously (blocking until the requests are served) on prefetch
+    luisa::vector<luisa::function<void(CommandBuffer &, bool /* synchronous */)>> _streaming_callbacks;
+    luisa::unordered_map<const Camera::Instance *, luisa::unique_ptr<compute::Shader2D<float>>> _prefetch_shaders;
     // other things
     luisa::unique_ptr<Printer> _printer;
     float _initial_time{};
@@ -174,21 +179,34 @@ public:
 
     template<typename T>
     [[nodiscard]] BufferView<T> arena_buffer(size_t n) noexcept {
-        return create<Buffer<T>>(n)->view();
-        // FIXME: buffer arena is broken
-        return _general_buffer_arena->allocate<T>(
-            std::max(n, static_cast<size_t>(1u)));
+        return _general_buffer_arena->allocate<T>(n);
     }
 
+    // Arena buffer read in shaders as buffer<T>(buffer_id).read(offset + i). Arena chunks
+    // take one bindless slot each, shared by all the buffers carved out of them.
     template<typename T>
-    [[nodiscard]] std::pair<BufferView<T>, uint /* bindless id */> bindless_arena_buffer(size_t n) noexcept {
-        auto view = arena_buffer<T>(n);
-        auto buffer_id = register_bindless(view);
-        return std::make_pair(view, buffer_id);
+    struct BindlessArenaBuffer {
+        BufferView<T> view;
+        uint buffer_id;
+        uint offset;
+    };
+
+    template<typename T>
+    [[nodiscard]] BindlessArenaBuffer<T> bindless_arena_buffer(size_t n) noexcept {
+        auto [view, chunk, offset] = _general_buffer_arena->allocate_addressable<T>(n);
+        if (chunk == BufferArena::dedicated_chunk) { return {view, register_bindless(view), 0u}; }
+        if (chunk >= _arena_chunk_buffer_ids.size()) { _arena_chunk_buffer_ids.resize(chunk + 1u, ~0u); }
+        auto &&buffer_id = _arena_chunk_buffer_ids[chunk];
+        if (buffer_id == ~0u) { buffer_id = register_bindless(_general_buffer_arena->chunk(chunk).view()); }
+        return {view, buffer_id, offset};
     }
 
     [[nodiscard]] std::pair<BufferView<float4>, uint> allocate_constant_slot() noexcept;
 
+    void register_streaming_callback(luisa::function<void(CommandBuffer &, bool)> callback) noexcept {
+        _streaming_callbacks.emplace_back(std::move(callback));
+    }
+
 
 public:
     [[nodiscard]] auto &device() const noexcept { return _device; }
@@ -207,13 +225,25 @@ public:
     [[nodiscard]] auto integrator() const noexcept { return _integrator.get(); }
     [[nodiscard]] auto spectrum() const noexcept { return _spectrum.get(); }
     [[nodiscard]] auto geometry() const noexcept { return _geometry.get(); }
+    [[nodiscard]] auto initial_time() const noexcept { return _initial_time; }
     [[nodiscard]] auto has_lighting() const noexcept { return !_lights.empty() || _environment != nullptr; }
     [[nodiscard]] auto has_non_opaque_surfaces() const noexcept { return _any_non_opaque_surface; }
+    // true if all motion is resolved per ray time, so a single update covers the whole shutter
+    [[nodiscard]] auto native_motion_blur() const noexcept {
+        return _geometry->motion_blur() && !_geometry->host_animated() && !_any_dynamic_transform;
+    }
     [[nodiscard]] const Texture::Instance *build_texture(CommandBuffer &command_buffer, const Texture *texture) noexcept;
     [[nodiscard]] const Filter::Instance *build_filter(CommandBuffer &command_buffer, const Filter *filter) noexcept;
     [[nodiscard]] const PhaseFunction::Instance *build_phasefunction(CommandBuffer &command_buffer, const PhaseFunction *phasefunction) noexcept;
     bool update(CommandBuffer &command_buffer, float time) noexcept;
-    void render(Stream &stream) noexcept;
+    [[nodiscard]] auto has_streaming_resources() const noexcept { return !_streaming_callbacks.empty(); }
+    // serves the requests of on-demand resources recorded by the previous passes;
+    // integrators call it after each sample pass, and it never blocks
+    void stream_resources(CommandBuffer &command_buffer) noexcept;
+    // records and serves, before the first sample, the requests of the surfaces
+    // seen through the camera, so that early samples do not use coarse fallbacks
+    void prefetch_resources(CommandBuffer &command_buffer, const Camera::Instance *camera, float time) noexcept;
+    void render(Stream &stream, const Integrator::RenderOptions &options = {}) noexcept;
     [[nodiscard]] auto &printer() noexcept { return *_printer; }
     [[nodiscard]] auto &printer() const noexcept { return *_printer; }
     [[nodiscard]] uint named_id(luisa::string_view name) const noexcept;
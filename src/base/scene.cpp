@@ -30,6 +30,12 @@ namespace luisa::render {
 struct Scene::Config {
     float shadow_terminator{0.f};
     float intersection_offset{0.f};
+    bool compress_vertices{false};
+    AccelOption accel_option{};
+    uint accel_rebuild_interval{0u};
+    uint motion_keyframes{0u};
+    float lod_triangles_per_pixel{1.f};
+    std::filesystem::path cache_directory;
     luisa::vector<NodeHandle> internal_nodes;
     luisa::unordered_map<luisa::string, NodeHandle> nodes;
     Integrator *integrator{nullptr};
@@ -38,6 +44,7 @@ struct Scene::Config {
     Spectrum *spectrum{nullptr};
     luisa::vector<Camera *> cameras;
     luisa::vector<Shape *> shapes;
+    luisa::vector<Light *> lights;
 };
 
 const Integrator *Scene::integrator() const noexcept { return _config->integrator; }
@@ -45,9 +52,16 @@ const Environment *Scene::environment() const noexcept { return _config->environ
 const Medium *Scene::environment_medium() const noexcept { return _config->environment_medium; }
 const Spectrum *Scene::spectrum() const noexcept { return _config->spectrum; }
 luisa::span<const Shape *const> Scene::shapes() const noexcept { return _config->shapes; }
+luisa::span<const Light *const> Scene::lights() const noexcept { return _config->lights; }
 luisa::span<const Camera *const> Scene::cameras() const noexcept { return _config->cameras; }
 float Scene::shadow_terminator_factor() const noexcept { return _config->shadow_terminator; }
 float Scene::intersection_offset_factor() const noexcept { return _config->intersection_offset; }
+bool Scene::compress_vertices() const noexcept { return _config->compress_vertices; }
+AccelOption Scene::accel_option() const noexcept { return _config->accel_option; }
+uint Scene::accel_rebuild_interval() const noexcept { return _config->accel_rebuild_interval; }
+uint Scene::motion_keyframes() const noexcept { return _config->motion_keyframes; }
+float Scene::lod_triangles_per_pixel() const noexcept { return _config->lod_triangles_per_pixel; }
+const std::filesystem::path &Scene::cache_directory() const noexcept { return _config->cache_directory; }
 
 namespace detail {
 
@@ -207,6 +221,29 @@ luisa::unique_ptr<Scene> Scene::create(const Context &ctx, const SceneDesc *desc
     auto scene = luisa::make_unique<Scene>(ctx);
     scene->_config->shadow_terminator = desc->root()->property_float_or_default("shadow_terminator", 0.f);
     scene->_config->intersection_offset = desc->root()->property_float_or_default("intersection_offset", 0.f);
+    scene->_config->compress_vertices = desc->root()->property_bool_or_default("compress_vertices", false);
+    scene->_config->accel_option.hint = [root = desc->root()] {
+        auto hint = root->property_string_or_default("accel_hint", "trace");
+        for (auto &c : hint) { c = static_cast<char>(tolower(c)); }
+        if (hint == "build") { return compute::AccelUsageHint::FAST_BUILD; }
+        if (hint != "trace") {
+            LUISA_WARNING_WITH_LOCATION(
+                "Unknown acceleration structure hint: \"{}\". "
+                "Available options are: \"trace\", \"build\".",
+                hint);
+        }
+        return compute::AccelUsageHint::FAST_TRACE;
+    }();
+    scene->_config->accel_option.allow_compaction = desc->root()->property_bool_or_default("accel_compaction", true);
+    scene->_config->accel_option.allow_update = desc->root()->property_bool_or_default("accel_update", false);
+    scene->_config->accel_rebuild_interval = desc->root()->property_uint_or_default("accel_rebuild_interval", 0u);
+    scene->_config->motion_keyframes = desc->root()->property_uint_or_default("motion_keyframes", 0u);
+    scene->_config->lod_triangles_per_pixel = std::max(desc->root()->property_float_or_default("lod_triangles_per_pixel", 1.f), 0.f);
+    // on-disk caching is opt-in, as it writes outside the scene folder
+    if (desc->root()->property_bool_or_default("cache", false)) {
+        scene->_config->cache_directory = desc->root()->property_path_or_default(
+            "cache_dir", std::filesystem::temp_directory_path() / "luisa-render-cache");
+    }
     scene->_config->spectrum = scene->load_spectrum(desc->root()->property_node_or_default(
         "spectrum", SceneNodeDesc::shared_default_spectrum("sRGB")));
     scene->_config->integrator = scene->load_integrator(
@@ -228,6 +265,18 @@ luisa::unique_ptr<Scene> Scene::create(const Context &ctx, const SceneDesc *desc
         scene->_config->shapes.emplace_back(
             scene->load_shape(s));
     }
+    auto lights = desc->root()->property_node_list_or_default("lights");
+    scene->_config->lights.reserve(lights.size());
+    for (auto l : lights) {
+        auto light = scene->load_light(l);
+        if (!light->is_punctual()) [[unlikely]] {
+            LUISA_ERROR_WITH_LOCATION(
+                "Light '{}' in the scene root is not punctual. "
+                "Area lights must be attached to shapes.",
+                l->identifier());
+        }
+        scene->_config->lights.emplace_back(light);
+    }
     global_thread_pool().synchronize();
     return scene;
 }
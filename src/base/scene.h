@@ -6,15 +6,18 @@
 
 #include <span>
 #include <mutex>
+#include <filesystem>
 
 #include <core/stl.h>
 #include <core/dynamic_module.h>
 #include <core/basic_types.h>
 #include <runtime/context.h>
+#include <runtime/rtx/accel.h>
 #include <base/scene_node.h>
 
 namespace luisa::render {
 
+using compute::AccelOption;
 using compute::Context;
 
 class SceneDesc;
@@ -84,9 +87,16 @@ public:
     [[nodiscard]] const Medium *environment_medium() const noexcept;
     [[nodiscard]] const Spectrum *spectrum() const noexcept;
     [[nodiscard]] luisa::span<const Shape *const> shapes() const noexcept;
+    [[nodiscard]] luisa::span<const Light *const> lights() const noexcept;// punctual lights, not attached to shapes
     [[nodiscard]] luisa::span<const Camera *const> cameras() const noexcept;
     [[nodiscard]] float shadow_terminator_factor() const noexcept;
     [[nodiscard]] float intersection_offset_factor() const noexcept;
+    [[nodiscard]] bool compress_vertices() const noexcept;
+    [[nodiscard]] AccelOption accel_option() const noexcept;// of the top-level acceleration structure
+    [[nodiscard]] uint accel_rebuild_interval() const noexcept;// force a rebuild every N updates, 0 to always refit when `accel_update` is set
+    [[nodiscard]] uint motion_keyframes() const noexcept;// per moving instance over the shutter, 0 to update transforms per shutter sample
+    [[nodiscard]] float lod_triangles_per_pixel() const noexcept;// triangle budget per covered pixel when selecting levels of detail, 0 to always use the full meshes
+    [[nodiscard]] const std::filesystem::path &cache_directory() const noexcept;// empty if on-disk caching is disabled
 };
 
 }// namespace luisa::render
@@ -17,7 +17,9 @@ Shape::Shape(Scene *scene, const SceneNodeDesc *desc) noexcept
       _surface{scene->load_surface(desc->property_node_or_default("surface"))},
       _light{scene->load_light(desc->property_node_or_default("light"))},
       _transform{scene->load_transform(desc->property_node_or_default("transform"))},
-      _medium{scene->load_medium(desc->property_node_or_default("medium"))} {}
+      _medium{scene->load_medium(desc->property_node_or_default("medium"))},
+      _compressed_vertices{desc->property_bool_or_default(
+          "compress_vertices", scene->compress_vertices())} {}
 
 AccelOption Shape::build_option() const noexcept { return {}; }
 
@@ -37,12 +39,32 @@ bool Shape::has_vertex_uv() const noexcept {
     return is_mesh() && (vertex_properties() & property_flag_has_vertex_uv) != 0u;
 }
 
+bool Shape::compressed_vertices() const noexcept {
+    // deformable meshes are re-uploaded every frame from the uncompressed vertices
+    return is_mesh() && !deformable() && _compressed_vertices;
+}
+
 bool Shape::is_mesh() const noexcept { return false; }
+bool Shape::is_procedural() const noexcept { return false; }
+luisa::span<const AnalyticPrimitive> Shape::primitives() const noexcept { return {}; }
 uint Shape::vertex_properties() const noexcept { return 0u; }
 MeshView Shape::mesh() const noexcept { return {}; }
+uint Shape::lod_count() const noexcept { return 0u; }
+
+MeshView Shape::lod(uint level) const noexcept {
+    LUISA_ASSERT(level == 0u, "Invalid level of detail {} for shape '{}'.", level, impl_type());
+    return mesh();
+}
+
 luisa::span<const Shape *const> Shape::children() const noexcept { return {}; }
 bool Shape::deformable() const noexcept { return false; }
 
+void Shape::deform(float time, luisa::span<Vertex> vertices) const noexcept {
+    auto rest = mesh().vertices;
+    LUISA_ASSERT(vertices.size() == rest.size(), "Invalid vertex count for deformation.");
+    std::copy(rest.begin(), rest.end(), vertices.begin());
+}
+
 uint4 Shape::Handle::encode(
     uint buffer_base, uint flags,
     uint surface_tag, uint light_tag, uint medium_tag,
@@ -7,6 +7,7 @@
 #include <runtime/rtx/mesh.h>
 #include <util/half.h>
 #include <util/vertex.h>
+#include <util/analytic_primitive.h>
 #include <base/scene_node.h>
 #include <base/scene.h>
 
@@ -37,12 +38,15 @@ public:
     static constexpr auto property_flag_has_light = 1u << 3u;
     static constexpr auto property_flag_has_medium = 1u << 4u;
     static constexpr auto property_flag_maybe_non_opaque = 1u << 5u;
+    static constexpr auto property_flag_compressed_vertex = 1u << 6u;
+    static constexpr auto property_flag_procedural = 1u << 7u;
 
 private:
     const Surface *_surface;
     const Light *_light;
     const Medium *_medium;
     const Transform *_transform;
+    bool _compressed_vertices;
 
 public:
     Shape(Scene *scene, const SceneNodeDesc *desc) noexcept;
@@ -54,13 +58,21 @@ public:
     [[nodiscard]] virtual float shadow_terminator_factor() const noexcept;
     [[nodiscard]] virtual float intersection_offset_factor() const noexcept;
     [[nodiscard]] virtual bool is_mesh() const noexcept;
+    [[nodiscard]] virtual bool is_procedural() const noexcept;// made of analytic primitives instead of triangles
     [[nodiscard]] virtual uint vertex_properties() const noexcept;
     [[nodiscard]] bool has_vertex_normal() const noexcept;
     [[nodiscard]] bool has_vertex_uv() const noexcept;
+    [[nodiscard]] bool compressed_vertices() const noexcept;// upload vertices as CompressedVertex
     [[nodiscard]] virtual MeshView mesh() const noexcept;                           // empty if the shape is not a mesh
+    [[nodiscard]] virtual uint lod_count() const noexcept;                          // number of simplified levels of detail of the mesh
+    [[nodiscard]] virtual MeshView lod(uint level) const noexcept;                  // level 0 is mesh(), up to lod_count() for the coarsest
+    [[nodiscard]] virtual luisa::span<const AnalyticPrimitive> primitives() const noexcept;// empty if the shape is not procedural
     [[nodiscard]] virtual luisa::span<const Shape *const> children() const noexcept;// empty if the shape is a mesh
-    [[nodiscard]] virtual bool deformable() const noexcept;                         // true if the shape will not deform
-    [[nodiscard]] virtual AccelOption build_option() const noexcept;                // accel struct build quality, only considered for meshes
+    [[nodiscard]] virtual bool deformable() const noexcept;                         // true if the vertices of the mesh change over time
+    // writes the vertices at `time` into `vertices`, which has as many elements as mesh().vertices;
+    // the triangles of a deformable mesh must not change
+    virtual void deform(float time, luisa::span<Vertex> vertices) const noexcept;
+    [[nodiscard]] virtual AccelOption build_option() const noexcept;                // accel struct build quality, only considered for meshes and procedural shapes
 };
 
 template<typename BaseShape>
@@ -139,7 +151,7 @@ public:
     static constexpr auto vertex_buffer_id_offset = 0u;
     static constexpr auto triangle_buffer_id_offset = 1u;
     static constexpr auto alias_table_buffer_id_offset = 2u;
-    static constexpr auto pdf_buffer_id_offset = 3u;
+    static constexpr auto pdf_buffer_id_offset = 3u;// per-triangle pdfs, followed by the light tree over the triangles
 
 private:
     UInt _buffer_base;
@@ -174,7 +186,8 @@ public:
     [[nodiscard]] auto property_flags() const noexcept { return _properties; }
     [[nodiscard]] auto vertex_buffer_id() const noexcept { return geometry_buffer_base() + luisa::render::Shape::Handle::vertex_buffer_id_offset; }
     [[nodiscard]] auto triangle_buffer_id() const noexcept { return geometry_buffer_base() + luisa::render::Shape::Handle::triangle_buffer_id_offset; }
-    [[nodiscard]] auto triangle_count() const noexcept { return _triangle_count; }
+    [[nodiscard]] auto triangle_count() const noexcept { return _triangle_count; }// or the number of primitives of procedural shapes
+    [[nodiscard]] auto primitive_buffer_id() const noexcept { return geometry_buffer_base(); }// only for procedural shapes
     [[nodiscard]] auto alias_table_buffer_id() const noexcept { return geometry_buffer_base() + luisa::render::Shape::Handle::alias_table_buffer_id_offset; }
     [[nodiscard]] auto pdf_buffer_id() const noexcept { return geometry_buffer_base() + luisa::render::Shape::Handle::pdf_buffer_id_offset; }
     [[nodiscard]] auto surface_tag() const noexcept { return _surface_tag; }
@@ -187,6 +200,8 @@ public:
     [[nodiscard]] auto has_surface() const noexcept { return test_property_flag(luisa::render::Shape::property_flag_has_surface); }
     [[nodiscard]] auto has_medium() const noexcept { return test_property_flag(luisa::render::Shape::property_flag_has_medium); }
     [[nodiscard]] auto maybe_non_opaque() const noexcept { return test_property_flag(luisa::render::Shape::property_flag_maybe_non_opaque); }
+    [[nodiscard]] auto compressed_vertex() const noexcept { return test_property_flag(luisa::render::Shape::property_flag_compressed_vertex); }
+    [[nodiscard]] auto is_procedural() const noexcept { return test_property_flag(luisa::render::Shape::property_flag_procedural); }
     [[nodiscard]] auto shadow_terminator_factor() const noexcept { return _shadow_terminator; }
     [[nodiscard]] auto intersection_offset_factor() const noexcept { return _intersection_offset; }
 };
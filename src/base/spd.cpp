@@ -8,8 +8,22 @@
 
 namespace luisa::render {
 
-SPD::SPD(Pipeline &pipeline, uint buffer_id, float sample_interval) noexcept
-    : _pipeline{pipeline}, _buffer_id{buffer_id}, _sample_interval{sample_interval} {}
+SPD::SPD(Pipeline &pipeline, uint buffer_id, uint buffer_offset, float sample_interval) noexcept
+    : _pipeline{pipeline}, _buffer_id{buffer_id}, _buffer_offset{buffer_offset}, _sample_interval{sample_interval} {}
+
+SPD SPD::create(Pipeline &pipeline, CommandBuffer &cb, luisa::string_view name,
+                luisa::span<const float> samples, float sample_interval) noexcept {
+    auto offset = 0u;
+    auto buffer_id = pipeline.register_named_id(name, [&] {
+        auto [view, index, o] = pipeline.bindless_arena_buffer<float>(samples.size());
+        cb << view.copy_from(samples.data()) << compute::commit();
+        offset = o;
+        return index;
+    });
+    // the offset is only known when the samples are uploaded, so it is named alongside
+    offset = pipeline.register_named_id(luisa::format("{}.offset", name), [offset] { return offset; });
+    return {pipeline, buffer_id, offset, sample_interval};
+}
 
 static inline auto densely_sampled_spectrum_integral(uint t, const float *spec) noexcept {
     auto sum = 0.0;
@@ -35,51 +49,27 @@ static inline auto downsample_densely_sampled_spectrum(uint t, const float *spec
 static constexpr auto spd_lut_interval = 5u;
 
 SPD SPD::create_cie_x(Pipeline &pipeline, CommandBuffer &cb) noexcept {
-    auto buffer = pipeline.register_named_id(
-        "__internal_spd_cie_x", [&pipeline, &cb] {
-            auto s = downsample_densely_sampled_spectrum(
-                spd_lut_interval, cie_x_samples.data());
-            auto [view, index] = pipeline.bindless_arena_buffer<float>(s.size());
-            cb << view.copy_from(s.data()) << compute::commit();
-            return index;
-        });
-    return {pipeline, buffer, spd_lut_interval};
+    auto s = downsample_densely_sampled_spectrum(
+        spd_lut_interval, cie_x_samples.data());
+    return create(pipeline, cb, "__internal_spd_cie_x", s, spd_lut_interval);
 }
 
 SPD SPD::create_cie_y(Pipeline &pipeline, CommandBuffer &cb) noexcept {
-    auto buffer = pipeline.register_named_id(
-        "__internal_spd_cie_y", [&pipeline, &cb] {
-            auto s = downsample_densely_sampled_spectrum(
-                spd_lut_interval, cie_y_samples.data());
-            auto [view, index] = pipeline.bindless_arena_buffer<float>(s.size());
-            cb << view.copy_from(s.data()) << compute::commit();
-            return index;
-        });
-    return {pipeline, buffer, spd_lut_interval};
+    auto s = downsample_densely_sampled_spectrum(
+        spd_lut_interval, cie_y_samples.data());
+    return create(pipeline, cb, "__internal_spd_cie_y", s, spd_lut_interval);
 }
 
 SPD SPD::create_cie_z(Pipeline &pipeline, CommandBuffer &cb) noexcept {
-    auto buffer = pipeline.register_named_id(
-        "__internal_spd_cie_z", [&pipeline, &cb] {
-            auto s = downsample_densely_sampled_spectrum(
-                spd_lut_interval, cie_z_samples.data());
-            auto [view, index] = pipeline.bindless_arena_buffer<float>(s.size());
-            cb << view.copy_from(s.data()) << compute::commit();
-            return index;
-        });
-    return {pipeline, buffer, spd_lut_interval};
+    auto s = downsample_densely_sampled_spectrum(
+        spd_lut_interval, cie_z_samples.data());
+    return create(pipeline, cb, "__internal_spd_cie_z", s, spd_lut_interval);
 }
 
 SPD SPD::create_cie_d65(Pipeline &pipeline, CommandBuffer &cb) noexcept {
-    auto buffer = pipeline.register_named_id(
-        "__internal_spd_cie_d65", [&pipeline, &cb] {
-            auto s = downsample_densely_sampled_spectrum(
-                spd_lut_interval, cie_d65_samples.data());
-            auto [view, index] = pipeline.bindless_arena_buffer<float>(s.size());
-            cb << view.copy_from(s.data()) << compute::commit();
-            return index;
-        });
-    return {pipeline, buffer, spd_lut_interval};
+    auto s = downsample_densely_sampled_spectrum(
+        spd_lut_interval, cie_d65_samples.data());
+    return create(pipeline, cb, "__internal_spd_cie_d65", s, spd_lut_interval);
 }
 
 float SPD::cie_y_integral() noexcept {
@@ -93,8 +83,8 @@ Float SPD::sample(Expr<float> lambda) const noexcept {
     auto t = (clamp(lambda, visible_wavelength_min, visible_wavelength_max) - visible_wavelength_min) / _sample_interval;
     auto sample_count = static_cast<uint>((visible_wavelength_max - visible_wavelength_min) / _sample_interval) + 1u;
     auto i = cast<uint>(min(t, static_cast<float>(sample_count - 2u)));
-    auto s0 = _pipeline.buffer<float>(_buffer_id).read(i);
-    auto s1 = _pipeline.buffer<float>(_buffer_id).read(i + 1u);
+    auto s0 = _pipeline.buffer<float>(_buffer_id).read(_buffer_offset + i);
+    auto s1 = _pipeline.buffer<float>(_buffer_id).read(_buffer_offset + i + 1u);
     return lerp(s0, s1, fract(t));
 }
 
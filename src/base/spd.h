@@ -18,10 +18,14 @@ class SPD {
 private:
     const Pipeline &_pipeline;
     uint _buffer_id;
+    uint _buffer_offset;// of the samples in the arena chunk bound at _buffer_id
     float _sample_interval;
 
 public:
-    SPD(Pipeline &pipeline, uint buffer_id, float sample_interval) noexcept;
+    SPD(Pipeline &pipeline, uint buffer_id, uint buffer_offset, float sample_interval) noexcept;
+    // uploads the samples on the first call with the name, and shares them afterwards
+    [[nodiscard]] static SPD create(Pipeline &pipeline, CommandBuffer &cb, luisa::string_view name,
+                                    luisa::span<const float> samples, float sample_interval) noexcept;
     [[nodiscard]] static SPD create_cie_x(Pipeline &pipeline, CommandBuffer &cb) noexcept;
     [[nodiscard]] static SPD create_cie_y(Pipeline &pipeline, CommandBuffer &cb) noexcept;
     [[nodiscard]] static SPD create_cie_z(Pipeline &pipeline, CommandBuffer &cb) noexcept;
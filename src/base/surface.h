@@ -132,6 +132,11 @@ public:
             const Interaction &it,
             const SampledWavelengths &swl,
             Expr<float> time) const noexcept { return luisa::nullopt; }
+        // (min, max) of the opacity over a UV rectangle, or nullopt if it cannot be bounded on the host
+        [[nodiscard]] virtual luisa::optional<float2> evaluate_opacity_range(float2 uv_min, float2 uv_max) const noexcept {
+            if (!maybe_non_opaque()) { return make_float2(1.f); }
+            return luisa::nullopt;
+        }
 
         void closure(PolymorphicCall<Closure> &call,
                      const Interaction &it, const SampledWavelengths &swl,
@@ -187,6 +192,17 @@ public:
             auto base_alpha = BaseInstance::evaluate_opacity(it, swl, time).value_or(1.f);
             return base_alpha * _opacity->evaluate(it, swl, time).x;
         }
+
+        [[nodiscard]] luisa::optional<float2> evaluate_opacity_range(float2 uv_min, float2 uv_max) const noexcept override {
+            if (!maybe_non_opaque()) { return make_float2(1.f); }
+            auto base_range = BaseInstance::evaluate_opacity_range(uv_min, uv_max);
+            if (_opacity == nullptr) { return base_range; }
+            auto alpha_range = _opacity->node()->evaluate_range(uv_min, uv_max);
+            if (!base_range || !alpha_range) { return luisa::nullopt; }
+            // only [0, 1] matters for the stochastic alpha test
+            return clamp(*base_range, 0.f, 1.f) *
+                   clamp(make_float2(alpha_range->first.x, alpha_range->second.x), 0.f, 1.f);
+        }
     };
 
 private:
@@ -11,6 +11,12 @@ Texture::Texture(Scene *scene, const SceneNodeDesc *desc) noexcept
     : SceneNode{scene, desc, SceneNodeTag::TEXTURE} {}
 
 luisa::optional<float4> Texture::evaluate_static() const noexcept { return luisa::nullopt; }
+luisa::optional<float4> Texture::evaluate_average() const noexcept { return evaluate_static(); }
+
+luisa::optional<std::pair<float4, float4>> Texture::evaluate_range(float2, float2) const noexcept {
+    if (auto v = evaluate_static()) { return std::make_pair(*v, *v); }
+    return luisa::nullopt;
+}
 
 [[nodiscard]] inline auto extend_color_to_rgb(auto color, uint n) noexcept {
     if (n == 1u) { return color.xxx(); }
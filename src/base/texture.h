@@ -64,6 +64,15 @@ public:
     [[nodiscard]] virtual bool is_black() const noexcept = 0;
     [[nodiscard]] virtual bool is_constant() const noexcept = 0;
     [[nodiscard]] virtual luisa::optional<float4> evaluate_static() const noexcept;
+    // average value over the texture domain, if it can be computed on the host
+    [[nodiscard]] virtual luisa::optional<float4> evaluate_average() const noexcept;
+    // (min, max) over a UV rectangle including the filter footprint, if it can be bounded on the host
+    [[nodiscard]] virtual luisa::optional<std::pair<float4, float4>> evaluate_range(
+        float2 uv_min, float2 uv_max) const noexcept;
+    // texels per unit UV along each axis, if the texture is backed by an image
+    [[nodiscard]] virtual luisa::optional<float2> texel_density() const noexcept { return luisa::nullopt; }
+    // hash of everything the texture values depend on, for keying on-disk caches of derived data
+    [[nodiscard]] virtual luisa::optional<uint64_t> content_hash() const noexcept { return luisa::nullopt; }
     [[nodiscard]] virtual uint channels() const noexcept { return 4u; }
     [[nodiscard]] virtual luisa::unique_ptr<Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept = 0;
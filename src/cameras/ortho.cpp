@@ -38,6 +38,9 @@ public:
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] bool requires_lens_sampling() const noexcept override { return false; }
     [[nodiscard]] auto zoom() const noexcept { return _zoom; }
+    [[nodiscard]] float pixel_footprint(float) const noexcept override {
+        return 2.f * std::pow(2.f, _zoom) / static_cast<float>(film()->resolution().y);
+    }
 };
 
 class OrthoCameraInstance : public Camera::Instance {
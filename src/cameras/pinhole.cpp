@@ -40,6 +40,9 @@ public:
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] bool requires_lens_sampling() const noexcept override { return false; }
     [[nodiscard]] auto fov() const noexcept { return _fov; }
+    [[nodiscard]] float pixel_footprint(float distance) const noexcept override {
+        return 2.f * distance * std::tan(_fov * .5f) / static_cast<float>(film()->resolution().y);
+    }
 };
 
 class PinholeCameraInstance : public Camera::Instance {
@@ -39,6 +39,24 @@ public:
     [[nodiscard]] auto aperture() const noexcept { return _aperture; }
     [[nodiscard]] auto focal_length() const noexcept { return _focal_length; }
     [[nodiscard]] auto focus_distance() const noexcept { return _focus_distance; }
+    // size of a pixel projected onto the focal plane
+    [[nodiscard]] auto projected_pixel_size() const noexcept {
+        auto v = static_cast<double>(_focus_distance);
+        auto f = _focal_length * 1e-3;
+        auto u = 1. / (1. / f - 1. / v);// 1 / f = 1 / v + 1 / sensor_plane
+        auto object_to_sensor_ratio = static_cast<float>(v / u);
+        auto resolution = make_float2(film()->resolution());
+        return resolution.x > resolution.y ?
+                   // landscape mode
+                   min(static_cast<float>(object_to_sensor_ratio * .036 / resolution.x),
+                       static_cast<float>(object_to_sensor_ratio * .024 / resolution.y)) :
+                   // portrait mode
+                   min(static_cast<float>(object_to_sensor_ratio * .024 / resolution.x),
+                       static_cast<float>(object_to_sensor_ratio * .036 / resolution.y));
+    }
+    [[nodiscard]] float pixel_footprint(float distance) const noexcept override {
+        return projected_pixel_size() * distance / _focus_distance;
+    }
 };
 
 struct ThinLensCameraData {
@@ -70,21 +88,11 @@ public:
           _device_data{ppl.arena_buffer<ThinLensCameraData>(1u)} {
         auto v = camera->focus_distance();
         auto f = camera->focal_length() * 1e-3;
-        auto u = 1. / (1. / f - 1. / v);// 1 / f = 1 / v + 1 / sensor_plane
-        auto object_to_sensor_ratio = static_cast<float>(v / u);
         auto lens_radius = static_cast<float>(.5 * f / camera->aperture());
         auto resolution = make_float2(camera->film()->resolution());
         auto pixel_offset = .5f * resolution;
-        auto projected_pixel_size =
-            resolution.x > resolution.y ?
-                // landscape mode
-                min(static_cast<float>(object_to_sensor_ratio * .036 / resolution.x),
-                    static_cast<float>(object_to_sensor_ratio * .024 / resolution.y)) :
-                // portrait mode
-                min(static_cast<float>(object_to_sensor_ratio * .024 / resolution.x),
-                    static_cast<float>(object_to_sensor_ratio * .036 / resolution.y));
         ThinLensCameraData host_data{pixel_offset, resolution, v,
-                                     lens_radius, projected_pixel_size};
+                                     lens_radius, camera->projected_pixel_size()};
         command_buffer << _device_data.copy_from(&host_data) << commit();
     }
 
@@ -2,10 +2,12 @@
 // Created by Mike Smith on 2022/1/15.
 //
 
+#include <bit>
 #include <numbers>
 
 #include <util/sampling.h>
 #include <util/imageio.h>
+#include <util/mapped_file.h>
 #include <base/interaction.h>
 #include <base/environment.h>
 #include <base/pipeline.h>
@@ -15,25 +17,83 @@ namespace luisa::render {
 
 using namespace luisa::compute;
 
+// Mip pyramid of the importance map, twice as wide as it is high with power-of-two
+// sides. Each coarser level holds the sums of 2x2 blocks of the finer one, down to
+// 2x1 at the root, and sampling descends the levels from the root.
+struct SphericalImportanceMap {
+
+    uint2 size;
+
+    [[nodiscard]] auto levels() const noexcept { return static_cast<uint>(std::countr_zero(size.y)) + 1u; }
+    [[nodiscard]] auto level_size(uint level) const noexcept { return make_uint2(size.x >> level, size.y >> level); }
+    [[nodiscard]] auto level_offset(uint level) const noexcept {
+        auto offset = 0u;
+        for (auto i = 0u; i < level; i++) { offset += (size.x >> i) * (size.y >> i); }
+        return offset;
+    }
+    [[nodiscard]] auto root_offset() const noexcept { return level_offset(levels() - 1u); }
+    [[nodiscard]] auto pixel_count() const noexcept { return level_offset(levels()); }
+};
+
 class Spherical final : public Environment {
 
 public:
-    static constexpr auto sample_map_size = make_uint2(2048u, 1024u);
+    // about one map pixel per texel of the emission, within these bounds
+    static constexpr auto min_sample_map_height = 32u;
+    static constexpr auto max_sample_map_height = 1024u;
+    // for procedural emission, which has no texels to match
+    static constexpr auto default_sample_map_height = 256u;
+
+private:
+    static constexpr auto cache_magic = 0x564e45415349554cull;// "LUISAENV" in little-endian
+    static constexpr auto cache_version = 1u;
+
+    // followed by the levels of the importance map
+    struct CacheHeader {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t reserved;
+    };
 
 private:
     const Texture *_emission;
     float _scale;
     bool _compensate_mis;
+    std::filesystem::path _cache_directory;// empty if the importance map is not cached
+
+private:
+    [[nodiscard]] std::filesystem::path _cache_path(SphericalImportanceMap map) const noexcept;
+    [[nodiscard]] bool _load_cached(CommandBuffer &command_buffer, const std::filesystem::path &path,
+                                    SphericalImportanceMap map, BufferView<float> pyramid) const noexcept;
+    void _save_cached(CommandBuffer &command_buffer, const std::filesystem::path &path,
+                      SphericalImportanceMap map, BufferView<float> pyramid) const noexcept;
+    void _generate(Pipeline &pipeline, CommandBuffer &command_buffer, const Texture::Instance *texture,
+                   SphericalImportanceMap map, BufferView<float> pyramid) const noexcept;
 
 public:
     Spherical(Scene *scene, const SceneNodeDesc *desc) noexcept
         : Environment{scene, desc},
           _emission{scene->load_texture(desc->property_node("emission"))},
           _scale{std::max(desc->property_float_or_default("scale", 1.0f), 0.0f)},
-          _compensate_mis{desc->property_bool_or_default("compensate_mis", true)} {}
+          _compensate_mis{desc->property_bool_or_default("compensate_mis", true)},
+          _cache_directory{desc->property_bool_or_default("cache", true) &&
+                                   !scene->cache_directory().empty() ?
+                               scene->cache_directory() / "environments" :
+                               std::filesystem::path{}} {}
     [[nodiscard]] auto scale() const noexcept { return _scale; }
     [[nodiscard]] auto compensate_mis() const noexcept { return _compensate_mis; }
     [[nodiscard]] auto emission() const noexcept { return _emission; }
+    [[nodiscard]] auto sample_map_size() const noexcept {
+        auto height = default_sample_map_height;
+        if (auto density = _emission->texel_density()) {
+            auto texels = std::clamp(std::max(density->x * .5f, density->y), 1.f, static_cast<float>(max_sample_map_height));
+            height = std::bit_ceil(static_cast<uint>(std::ceil(texels)));
+        }
+        height = std::clamp(height, min_sample_map_height, max_sample_map_height);
+        return make_uint2(height * 2u, height);
+    }
     [[nodiscard]] bool is_black() const noexcept override { return _scale == 0.0f || _emission->is_black(); }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
@@ -61,8 +121,8 @@ class SphericalInstance final : public Environment::Instance {
 
 private:
     const Texture::Instance *_texture;
-    luisa::optional<uint> _alias_buffer_id;
-    luisa::optional<uint> _pdf_buffer_id;
+    SphericalImportanceMap _map;
+    luisa::optional<uint2> _map_buffer;// bindless id and offset of the pyramid
 
 private:
     [[nodiscard]] auto _evaluate(Expr<float3> wi_local, Expr<float2> uv,
@@ -78,12 +138,23 @@ private:
         return p * inv_s * (.5f * inv_pi * inv_pi);
     }
 
+    [[nodiscard]] auto _map_reader() const noexcept {
+        return [buffer = pipeline().buffer<float>(_map_buffer->x), offset = _map_buffer->y](Expr<uint> i) noexcept {
+            return buffer.read(offset + i);
+        };
+    }
+
+    // density over the UV square of the map pixel holding `weight`, uniform if the map is empty
+    [[nodiscard]] auto _map_pdf(Expr<float> weight, Expr<float> total) const noexcept {
+        auto pixel_count = static_cast<float>(_map.size.x * _map.size.y);
+        return ite(total > 0.f, weight * pixel_count / total, 1.f);
+    }
+
 public:
     SphericalInstance(Pipeline &pipeline, const Environment *env, const Texture::Instance *texture,
-                      luisa::optional<uint> alias_buffer_id, luisa::optional<uint> pdf_buffer_id) noexcept
+                      SphericalImportanceMap map, luisa::optional<uint2> map_buffer) noexcept
         : Environment::Instance{pipeline, env}, _texture{texture},
-          _alias_buffer_id{std::move(alias_buffer_id)},
-          _pdf_buffer_id{std::move(pdf_buffer_id)} {}
+          _map{map}, _map_buffer{std::move(map_buffer)} {}
 
     [[nodiscard]] Environment::Evaluation evaluate(Expr<float3> wi,
                                                    const SampledWavelengths &swl,
@@ -96,13 +167,16 @@ public:
             auto L = _evaluate(wi_local, uv, swl, time);
             if (_texture->node()->is_constant()) {
                 eval = {.L = L, .pdf = uniform_sphere_pdf()};
+            } else {
+                auto size = make_float2(_map.size);
+                auto ix = cast<uint>(clamp(uv.x * size.x, 0.f, size.x - 1.f));
+                auto iy = cast<uint>(clamp(uv.y * size.y, 0.f, size.y - 1.f));
+                auto map = _map_reader();
+                auto root = _map.root_offset();
+                auto total = map(root) + map(root + 1u);
+                auto pdf = _map_pdf(map(iy * _map.size.x + ix), total);
+                eval = {.L = L, .pdf = _directional_pdf(pdf, theta)};
             }
-            auto size = make_float2(Spherical::sample_map_size);
-            auto ix = cast<uint>(clamp(uv.x * size.x, 0.f, size.x - 1.f));
-            auto iy = cast<uint>(clamp(uv.y * size.y, 0.f, size.y - 1.f));
-            auto pdf_buffer = pipeline().buffer<float>(*_pdf_buffer_id);
-            auto pdf = pdf_buffer.read(iy * Spherical::sample_map_size.x + ix);
-            eval = {.L = L, .pdf = _directional_pdf(pdf, theta)};
         };
         return eval;
     }
@@ -119,17 +193,38 @@ public:
                     auto L = _evaluate(w, uv, swl, time);
                     return std::make_tuple(w, L, def(uniform_sphere_pdf()));
                 }
-                auto alias_buffer = pipeline().buffer<AliasEntry>(*_alias_buffer_id);
-                auto [iy, uy] = sample_alias_table(
-                    alias_buffer, Spherical::sample_map_size.y, u.y);
-                auto offset = Spherical::sample_map_size.y +
-                              iy * Spherical::sample_map_size.x;
-                auto [ix, ux] = sample_alias_table(
-                    alias_buffer, Spherical::sample_map_size.x, u.x, offset);
-                auto uv = make_float2(cast<float>(ix) + ux, cast<float>(iy) + uy) /
-                          make_float2(Spherical::sample_map_size);
-                auto index = iy * Spherical::sample_map_size.x + ix;
-                auto p = pipeline().buffer<float>(*_pdf_buffer_id).read(index);
+                static constexpr auto one_minus_epsilon = 0x1.fffffep-1f;
+                auto map = _map_reader();
+                auto ux = def(u.x);
+                auto uy = def(u.y);
+                // picks the second of two weights, remapping the random number
+                auto pick = [](Var<float> &u, Expr<float> a, Expr<float> b) noexcept {
+                    auto p = ite(a + b > 0.f, a / (a + b), .5f);
+                    auto second = u >= p;
+                    u = min(ite(second, (u - p) / (1.f - p), u / p), one_minus_epsilon);
+                    return second;
+                };
+                // the x and y decisions consume separate dimensions, which keeps the warp continuous
+                auto root = _map.root_offset();
+                auto w0 = map(root);
+                auto w1 = map(root + 1u);
+                auto total = w0 + w1;
+                auto pixel = def(make_uint2(ite(pick(ux, w0, w1), 1u, 0u), 0u));
+                for (auto level = _map.levels() - 1u; level-- > 0u;) {
+                    auto offset = _map.level_offset(level);
+                    auto width = _map.level_size(level).x;
+                    pixel *= 2u;
+                    auto i = offset + pixel.y * width + pixel.x;
+                    auto c00 = map(i);
+                    auto c10 = map(i + 1u);
+                    auto c01 = map(i + width);
+                    auto c11 = map(i + width + 1u);
+                    auto right = pick(ux, c00 + c01, c10 + c11);
+                    auto bottom = pick(uy, ite(right, c10, c00), ite(right, c11, c01));
+                    pixel += make_uint2(ite(right, 1u, 0u), ite(bottom, 1u, 0u));
+                }
+                auto uv = (make_float2(pixel) + make_float2(ux, uy)) / make_float2(_map.size);
+                auto p = _map_pdf(map(pixel.y * _map.size.x + pixel.x), total);
                 auto [theta, phi, w] = Spherical::uv_to_direction(uv);
                 auto L = _evaluate(w, uv, swl, time);
                 return std::make_tuple(w, L, _directional_pdf(p, theta));
@@ -141,97 +236,139 @@ public:
     }
 };
 
+std::filesystem::path Spherical::_cache_path(SphericalImportanceMap map) const noexcept {
+    if (_cache_directory.empty()) { return {}; }
+    auto texture_hash = _emission->content_hash();
+    if (!texture_hash) { return {}; }
+    auto hash = luisa::hash64(&map.size, sizeof(map.size), *texture_hash);
+    hash = luisa::hash64(&_compensate_mis, sizeof(_compensate_mis), hash);
+    hash = luisa::hash64(&cache_version, sizeof(cache_version), hash);
+    return _cache_directory / luisa::format("{:016x}.imap", hash);
+}
+
+bool Spherical::_load_cached(CommandBuffer &command_buffer, const std::filesystem::path &path,
+                             SphericalImportanceMap map, BufferView<float> pyramid) const noexcept {
+    auto file = MappedFile::open(path);
+    if (!file || file.size() < sizeof(CacheHeader)) { return false; }
+    CacheHeader header{};
+    std::memcpy(&header, file.data(), sizeof(CacheHeader));
+    if (header.magic != cache_magic || header.version != cache_version ||
+        header.width != map.size.x || header.height != map.size.y ||
+        file.size() != sizeof(CacheHeader) + pyramid.size_bytes()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Ignoring invalid environment importance cache '{}'.",
+            path.string());
+        return false;
+    }
+    // the mapping must outlive the upload
+    command_buffer << pyramid.copy_from(file.data() + sizeof(CacheHeader))
+                   << synchronize();
+    return true;
+}
+
+void Spherical::_save_cached(CommandBuffer &command_buffer, const std::filesystem::path &path,
+                             SphericalImportanceMap map, BufferView<float> pyramid) const noexcept {
+    luisa::vector<float> levels(pyramid.size());
+    command_buffer << pyramid.copy_to(levels.data())
+                   << synchronize();
+    CacheHeader header{.magic = cache_magic,
+                       .version = cache_version,
+                       .width = map.size.x,
+                       .height = map.size.y};
+    std::array chunks{std::as_bytes(luisa::span{&header, 1u}),
+                      std::as_bytes(luisa::span<const float>{levels})};
+    if (write_file_atomic(path, chunks)) {
+        LUISA_INFO("Saved environment importance cache '{}'.", path.string());
+    }
+}
+
+void Spherical::_generate(Pipeline &pipeline, CommandBuffer &command_buffer, const Texture::Instance *texture,
+                          SphericalImportanceMap map, BufferView<float> pyramid) const noexcept {
+    auto &&device = pipeline.device();
+    Kernel2D generate_weight_map_kernel = [&](BufferFloat weights) noexcept {
+        auto pixel = dispatch_id().xy();
+        auto size = dispatch_size().xy();
+        auto center = make_float2(pixel) + .5f;
+        auto sum_weight = def(0.f);
+        auto sum_scale = def(0.f);
+        constexpr auto filter_radius = 1.f;
+        constexpr auto filter_step = .125f;
+        auto n = static_cast<int>(std::ceil(filter_radius / filter_step));
+        // kind of brute-force but it's only done once
+        $for(dy, -n, n + 1) {
+            $for(dx, -n, n + 1) {
+                auto offset = make_float2(make_int2(dx, dy)) * filter_step;
+                auto uv = (center + offset) / make_float2(size);
+                auto it = Interaction{uv};
+                auto scale = texture->evaluate_illuminant_spectrum(it, pipeline.spectrum()->sample(0.5f), 0.f).strength;
+                auto sin_theta = sin(uv.y * pi);
+                auto weight = exp(-4.f * length_squared(offset));// gaussian kernel with an approximate radius of 1
+                auto value = weight * min(scale * sin_theta, 1e8f);
+                sum_weight += weight;
+                sum_scale += value;
+            };
+        };
+        weights.write(pixel.y * size.x + pixel.x, sum_scale / sum_weight);
+    };
+    // sums 2x2 blocks of the level at `src` into the level at `dst`
+    Kernel2D reduce_kernel = [](BufferFloat levels, UInt src, UInt dst) noexcept {
+        auto pixel = dispatch_id().xy();
+        auto width = dispatch_size().x;
+        auto i = src + pixel.y * 4u * width + pixel.x * 2u;
+        auto sum = levels.read(i) + levels.read(i + 1u) +
+                   levels.read(i + 2u * width) + levels.read(i + 2u * width + 1u);
+        levels.write(dst + pixel.y * width + pixel.x, sum);
+    };
+    // only the directions that BSDF sampling handles poorly are kept
+    Kernel2D compensate_kernel = [](BufferFloat levels, UInt root) noexcept {
+        auto pixel = dispatch_id().xy();
+        auto size = dispatch_size().xy();
+        auto average = (levels.read(root) + levels.read(root + 1u)) / cast<float>(size.x * size.y);
+        auto i = pixel.y * size.x + pixel.x;
+        levels.write(i, max(levels.read(i) - average, 0.f));
+    };
+    // compile the small kernels while the weight map kernel compiles in the background
+    auto generate_weight_map = global_thread_pool().async([&] { return device.compile(generate_weight_map_kernel); });
+    auto reduce = device.compile(reduce_kernel);
+    auto compensate = compensate_mis() ? luisa::make_optional(device.compile(compensate_kernel)) : luisa::nullopt;
+    auto build_levels = [&] {
+        for (auto level = 1u; level < map.levels(); level++) {
+            command_buffer << reduce(pyramid, map.level_offset(level - 1u), map.level_offset(level))
+                                  .dispatch(map.level_size(level));
+        }
+    };
+    Clock clk;
+    command_buffer << pipeline.bindless_array().update()
+                   << generate_weight_map.get()(pyramid).dispatch(map.size);
+    build_levels();
+    if (compensate) {
+        command_buffer << (*compensate)(pyramid, map.root_offset()).dispatch(map.size);
+        build_levels();
+    }
+    command_buffer << synchronize();
+    LUISA_INFO_WITH_LOCATION(
+        "Spherical::build: Generated {}x{} importance map in {} ms.",
+        map.size.x, map.size.y, clk.toc());
+}
+
 luisa::unique_ptr<Environment::Instance> Spherical::build(
     Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
     auto texture = pipeline.build_texture(command_buffer, _emission);
-    luisa::optional<uint> alias_id;
-    luisa::optional<uint> pdf_id;
+    SphericalImportanceMap map{sample_map_size()};
+    luisa::optional<uint2> map_buffer;
     if (!_emission->is_constant()) {
-        command_buffer << pipeline.bindless_array().update() << commit();
-        auto &&device = pipeline.device();
-        constexpr auto pixel_count = sample_map_size.x * sample_map_size.y;
-        luisa::vector<float> scale_map(pixel_count);
-        auto scale_map_device = device.create_buffer<float>(pixel_count);
-        Kernel2D generate_weight_map_kernel = [&] {
-            auto pixel = dispatch_id().xy();
-            auto center = make_float2(pixel) + .5f;
-            auto sum_weight = def(0.f);
-            auto sum_scale = def(0.f);
-            constexpr auto filter_radius = 1.f;
-            constexpr auto filter_step = .125f;
-            auto n = static_cast<int>(std::ceil(filter_radius / filter_step));
-            // kind of brute-force but it's only done once
-            $for(dy, -n, n + 1) {
-                $for(dx, -n, n + 1) {
-                    auto offset = make_float2(make_int2(dx, dy)) * filter_step;
-                    auto uv = (center + offset) / make_float2(sample_map_size);
-                    auto [theta, phi, w] = Spherical::uv_to_direction(uv);
-                    auto it = Interaction{uv};
-                    auto scale = texture->evaluate_illuminant_spectrum(it, pipeline.spectrum()->sample(0.5f), 0.f).strength;
-                    auto sin_theta = sin(uv.y * pi);
-                    auto weight = exp(-4.f * length_squared(offset));// gaussian kernel with an approximate radius of 1
-                    auto value = weight * min(scale * sin_theta, 1e8f);
-                    sum_weight += weight;
-                    sum_scale += value;
-                };
-            };
-            auto pixel_id = pixel.y * sample_map_size.x + pixel.x;
-            scale_map_device->write(pixel_id, sum_scale / sum_weight);
-        };
-        auto generate_weight_map = device.compile(generate_weight_map_kernel);
-        Clock clk;
-        command_buffer << generate_weight_map().dispatch(sample_map_size)
-                       << scale_map_device.copy_to(scale_map.data())
-                       << synchronize();
-        LUISA_INFO_WITH_LOCATION(
-            "Spherical::build: Generated weight map in {} ms.", clk.toc());
-        if (compensate_mis()) {
-            auto sum_scale = 0.;
-            for (auto s : scale_map) { sum_scale += s; }
-            auto average_scale = static_cast<float>(sum_scale / pixel_count);
-            for (auto &&s : scale_map) { s = std::max(s - average_scale, 0.f); }
-        }
-        luisa::vector<float> row_averages(sample_map_size.y);
-        luisa::vector<float> pdfs(pixel_count);
-        luisa::vector<AliasEntry> aliases(sample_map_size.y + pixel_count);
-        // construct conditional alias table
-        for (auto i = 0u; i < sample_map_size.y; i++) {
-            auto sum = 0.;
-            auto values = luisa::span{scale_map}.subspan(
-                i * sample_map_size.x, sample_map_size.x);
-            for (auto v : values) { sum += v; }
-            row_averages[i] = static_cast<float>(sum * (1.0 / sample_map_size.x));
-            auto [alias_table, pdf_table] = create_alias_table(values);
-            std::copy_n(
-                pdf_table.data(), sample_map_size.x,
-                pdfs.data() + i * sample_map_size.x);
-            std::copy_n(
-                alias_table.data(), sample_map_size.x,
-                aliases.data() + sample_map_size.y + i * sample_map_size.x);
-        }
-        // construct marginal alias table
-        auto [alias_table, pdf_table] = create_alias_table(row_averages);
-        std::copy_n(alias_table.data(), sample_map_size.y, aliases.data());
-        for (auto y = 0u; y < sample_map_size.y; y++) {
-            auto offset = y * sample_map_size.x;
-            auto pdf_y = pdf_table[y];
-            auto scale = static_cast<float>(pdf_y * pixel_count);
-            for (auto x = 0u; x < sample_map_size.x; x++) {
-                pdfs[offset + x] *= scale;
-            }
+        auto [pyramid, buffer_id, buffer_offset] = pipeline.bindless_arena_buffer<float>(map.pixel_count());
+        map_buffer.emplace(make_uint2(buffer_id, buffer_offset));
+        auto cache_path = _cache_path(map);
+        if (!cache_path.empty() && _load_cached(command_buffer, cache_path, map, pyramid)) {
+            LUISA_INFO("Loaded environment importance map from cache '{}'.", cache_path.string());
+        } else {
+            _generate(pipeline, command_buffer, texture, map, pyramid);
+            if (!cache_path.empty()) { _save_cached(command_buffer, cache_path, map, pyramid); }
         }
-        auto [alias_buffer_view, alias_buffer_id] =
-            pipeline.bindless_arena_buffer<AliasEntry>(aliases.size());
-        auto [pdf_buffer_view, pdf_buffer_id] =
-            pipeline.bindless_arena_buffer<float>(pdfs.size());
-        command_buffer << alias_buffer_view.copy_from(aliases.data())
-                       << pdf_buffer_view.copy_from(pdfs.data())
-                       << commit();
-        alias_id.emplace(alias_buffer_id);
-        pdf_id.emplace(pdf_buffer_id);
     }
     return luisa::make_unique<SphericalInstance>(
-        pipeline, this, texture, std::move(alias_id), std::move(pdf_id));
+        pipeline, this, texture, map, std::move(map_buffer));
 }
 
 }// namespace luisa::render
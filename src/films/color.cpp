@@ -54,12 +54,21 @@ class ColorFilmInstance final : public Film::Instance {
 private:
     mutable Buffer<float4> _image;
     mutable Buffer<float4> _converted;
-    std::shared_future<Shader1D<Buffer<float4>>> _clear_image;
+    mutable Buffer<float> _second_moment;// sum of squared sample luminance
+    mutable Buffer<uint4> _window;// (offset, size) of the window kept on device
+    uint4 _host_window{};
+    std::shared_future<Shader1D<Buffer<float4>, Buffer<float>>> _clear_image;
     std::shared_future<Shader1D<Buffer<float4>, Buffer<float4>>> _convert_image;
 
 private:
     void _check_prepared() const noexcept {
-        LUISA_ASSERT(_image && _converted, "Film is not prepared.");
+        LUISA_ASSERT(_image && _converted && _second_moment && _window, "Film is not prepared.");
+    }
+    [[nodiscard]] auto _window_pixel_count() const noexcept { return _host_window.z * _host_window.w; }
+    [[nodiscard]] auto _window_pixel_index(Expr<uint2> pixel) const noexcept {
+        auto window = _window->read(0u);
+        auto p = pixel - window.xy();
+        return p.y * window.z + p.x;
     }
 
 public:
@@ -67,8 +76,17 @@ public:
     void prepare(CommandBuffer &command_buffer) noexcept override;
     void download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept override;
     [[nodiscard]] Film::Accumulation read(Expr<uint2> pixel) const noexcept override;
+    [[nodiscard]] bool tracks_variance() const noexcept override { return true; }
+    [[nodiscard]] bool supports_windows() const noexcept override { return true; }
+    [[nodiscard]] Float relative_error(Expr<uint2> pixel) const noexcept override;
+    [[nodiscard]] size_t checkpoint_size() const noexcept override {
+        return _window_pixel_count() * (sizeof(float4) + sizeof(float));
+    }
+    void save_checkpoint(CommandBuffer &command_buffer, std::byte *data) const noexcept override;
+    void load_checkpoint(CommandBuffer &command_buffer, const std::byte *data) noexcept override;
     void release() noexcept override;
     void clear(CommandBuffer &command_buffer) noexcept override;
+    void set_window(CommandBuffer &command_buffer, uint2 offset, uint2 size) noexcept override;
 
 protected:
     void _accumulate(Expr<uint2> pixel, Expr<float3> rgb, Expr<float> effective_spp) const noexcept override;
@@ -77,8 +95,9 @@ protected:
 ColorFilmInstance::ColorFilmInstance(Device &device, Pipeline &pipeline, const ColorFilm *film) noexcept
     : Film::Instance{pipeline, film} {
 
-    Kernel1D clear_image_kernel = [](BufferFloat4 image) noexcept {
+    Kernel1D clear_image_kernel = [](BufferFloat4 image, BufferFloat second_moment) noexcept {
         image.write(dispatch_x(), make_float4(0.f));
+        second_moment.write(dispatch_x(), 0.f);
     };
     _clear_image = global_thread_pool().async([&device, clear_image_kernel] {
         return device.compile(clear_image_kernel);
@@ -98,15 +117,14 @@ ColorFilmInstance::ColorFilmInstance(Device &device, Pipeline &pipeline, const C
 
 void ColorFilmInstance::download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept {
     _check_prepared();
-    auto resolution = node()->resolution();
-    auto pixel_count = resolution.x * resolution.y;
+    auto pixel_count = _window_pixel_count();
     command_buffer << _convert_image.get()(_image, _converted).dispatch(pixel_count)
-                   << _converted.copy_to(framebuffer);
+                   << _converted.view(0u, pixel_count).copy_to(framebuffer);
 }
 
 void ColorFilmInstance::_accumulate(Expr<uint2> pixel, Expr<float3> rgb, Expr<float> effective_spp) const noexcept {
     _check_prepared();
-    auto pixel_id = pixel.y * node()->resolution().x + pixel.x;
+    auto pixel_id = _window_pixel_index(pixel);
     $if(!any(isnan(rgb) || isinf(rgb))) {
         auto threshold = node<ColorFilm>()->clamp() * max(effective_spp, 1.f);
         auto abs_rgb = abs(rgb);
@@ -119,6 +137,9 @@ void ColorFilmInstance::_accumulate(Expr<uint2> pixel, Expr<float3> rgb, Expr<fl
         };
         $if(effective_spp != 0.f) {
             _image->atomic(pixel_id).w.fetch_add(effective_spp);
+            // treat the contribution as effective_spp samples of c / effective_spp each
+            auto y = srgb_to_cie_y(c);
+            _second_moment->atomic(pixel_id).fetch_add(y * y / max(effective_spp, 1.f));
         };
     }
     $else {
@@ -130,32 +151,71 @@ void ColorFilmInstance::_accumulate(Expr<uint2> pixel, Expr<float3> rgb, Expr<fl
 }
 
 void ColorFilmInstance::prepare(CommandBuffer &command_buffer) noexcept {
-    auto resolution = node()->resolution();
-    auto pixel_count = resolution.x * resolution.y;
-    if (!_image) { _image = pipeline().device().create_buffer<float4>(pixel_count); }
-    if (!_converted) { _converted = pipeline().device().create_buffer<float4>(pixel_count); }
+    set_window(command_buffer, make_uint2(), node()->resolution());
+}
+
+void ColorFilmInstance::set_window(CommandBuffer &command_buffer, uint2 offset, uint2 size) noexcept {
+    LUISA_ASSERT(all(offset + size <= node()->resolution()),
+                 "Film window ({}, {}) + ({}, {}) out of bounds.",
+                 offset.x, offset.y, size.x, size.y);
+    auto pixel_count = size.x * size.y;
+    // storage only grows, so that windows of varying sizes reuse it
+    if (!_image || _image.size() < pixel_count) {
+        _image = pipeline().device().create_buffer<float4>(pixel_count);
+        _converted = pipeline().device().create_buffer<float4>(pixel_count);
+        _second_moment = pipeline().device().create_buffer<float>(pixel_count);
+    }
+    if (!_window) { _window = pipeline().device().create_buffer<uint4>(1u); }
+    _host_window = make_uint4(offset.x, offset.y, size.x, size.y);
+    command_buffer << _window.copy_from(&_host_window)
+                   << compute::commit();
     clear(command_buffer);
 }
 
 void ColorFilmInstance::clear(CommandBuffer &command_buffer) noexcept {
-    auto resolution = node()->resolution();
-    auto pixel_count = resolution.x * resolution.y;
-    command_buffer << _clear_image.get()(_image).dispatch(pixel_count);
+    command_buffer << _clear_image.get()(_image, _second_moment).dispatch(_window_pixel_count());
 }
 
 Film::Accumulation ColorFilmInstance::read(Expr<uint2> pixel) const noexcept {
     _check_prepared();
-    auto width = node()->resolution().x;
-    auto i = pixel.y * width + pixel.x;
-    auto c = _image->read(i);
+    auto c = _image->read(_window_pixel_index(pixel));
     auto inv_n = (1.f / max(c.w, 1e-6f));
     auto scale = inv_n * node<ColorFilm>()->scale();
     return {.average = scale * c.xyz(), .sample_count = c.w};
 }
 
+Float ColorFilmInstance::relative_error(Expr<uint2> pixel) const noexcept {
+    _check_prepared();
+    auto pixel_id = _window_pixel_index(pixel);
+    auto c = _image->read(pixel_id);
+    auto n = c.w;
+    auto mean = srgb_to_cie_y(c.xyz()) / max(n, 1.f);
+    auto variance = max(_second_moment->read(pixel_id) / max(n, 1.f) - mean * mean, 0.f);
+    // the floor keeps near-black pixels from being judged by
+    // their (meaningless) relative error instead of the absolute one
+    auto error = sqrt(variance / max(n - 1.f, 1.f)) / max(mean, 1e-3f);
+    return ite(n < 2.f, std::numeric_limits<float>::infinity(), error);
+}
+
+void ColorFilmInstance::save_checkpoint(CommandBuffer &command_buffer, std::byte *data) const noexcept {
+    _check_prepared();
+    auto pixel_count = _window_pixel_count();
+    command_buffer << _image.view(0u, pixel_count).copy_to(data)
+                   << _second_moment.view(0u, pixel_count).copy_to(data + pixel_count * sizeof(float4));
+}
+
+void ColorFilmInstance::load_checkpoint(CommandBuffer &command_buffer, const std::byte *data) noexcept {
+    _check_prepared();
+    auto pixel_count = _window_pixel_count();
+    command_buffer << _image.view(0u, pixel_count).copy_from(data)
+                   << _second_moment.view(0u, pixel_count).copy_from(data + pixel_count * sizeof(float4));
+}
+
 void ColorFilmInstance::release() noexcept {
     _image = {};
     _converted = {};
+    _second_moment = {};
+    _window = {};
 }
 
 luisa::unique_ptr<Film::Instance> ColorFilm::build(
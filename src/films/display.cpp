@@ -141,6 +141,26 @@ public:
         return _base->read(pixel);
     }
 
+    [[nodiscard]] bool tracks_variance() const noexcept override {
+        return _base->tracks_variance();
+    }
+
+    [[nodiscard]] Float relative_error(Expr<uint2> pixel) const noexcept override {
+        return _base->relative_error(pixel);
+    }
+
+    [[nodiscard]] size_t checkpoint_size() const noexcept override {
+        return _base->checkpoint_size();
+    }
+
+    void save_checkpoint(CommandBuffer &command_buffer, std::byte *data) const noexcept override {
+        _base->save_checkpoint(command_buffer, data);
+    }
+
+    void load_checkpoint(CommandBuffer &command_buffer, const std::byte *data) noexcept override {
+        _base->load_checkpoint(command_buffer, data);
+    }
+
     void prepare(CommandBuffer &command_buffer) noexcept override {
         _base->prepare(command_buffer);
         auto &&device = pipeline().device();
@@ -2,7 +2,10 @@
 // Created by Mike Smith on 2022/1/10.
 //
 
+#include <mutex>
+
 #include <util/imageio.h>
+#include <util/image_writer.h>
 #include <util/medium_tracker.h>
 #include <util/progress_bar.h>
 #include <util/sampling.h>
@@ -127,6 +130,8 @@ public:
             _clock.tic();
             _framerate.clear();
             camera->film()->prepare(command_buffer);
+            pipeline().prefetch_resources(command_buffer, camera,
+                                          camera->node()->shutter_samples().front().point.time);
             _render_one_camera(command_buffer, camera);
             command_buffer << compute::synchronize();
             camera->film()->release();
@@ -140,6 +145,40 @@ luisa::unique_ptr<Integrator::Instance> AuxiliaryBufferPathTracing::build(
         this, pipeline, cmd_buffer);
 }
 
+// images that the stream callbacks could not queue on the image writer without blocking
+// the stream, written from the render loop instead
+class PendingAuxiliaryImages {
+
+private:
+    struct Image {
+        std::filesystem::path path;
+        luisa::shared_ptr<luisa::vector<float>> pixels;
+        uint2 resolution;
+        uint channels;
+    };
+    std::mutex _mutex;
+    luisa::vector<Image> _images;
+
+public:
+    void push(std::filesystem::path path, luisa::shared_ptr<luisa::vector<float>> pixels,
+              uint2 resolution, uint channels) noexcept {
+        std::scoped_lock lock{_mutex};
+        _images.emplace_back(Image{std::move(path), std::move(pixels), resolution, channels});
+    }
+    // blocks on the image writer, so it must not be called from a stream callback
+    void flush() noexcept {
+        luisa::vector<Image> images;
+        {
+            std::scoped_lock lock{_mutex};
+            images.swap(_images);
+        }
+        for (auto &&image : images) {
+            global_image_writer().write(std::move(image.path), std::move(*image.pixels),
+                                        image.resolution, image.channels);
+        }
+    }
+};
+
 class AuxiliaryBuffer {
 
 private:
@@ -170,8 +209,8 @@ public:
                                   .dispatch(_resolution.x * _resolution.y * _channels);
         }
     }
-    [[nodiscard]] auto save(CommandBuffer &command_buffer,
-                            std::filesystem::path path, uint total_samples) const noexcept
+    [[nodiscard]] auto save(CommandBuffer &command_buffer, std::filesystem::path path, uint total_samples,
+                            luisa::shared_ptr<PendingAuxiliaryImages> pending) const noexcept
         -> luisa::function<void()> {
         if (!_buffer) { return {}; }
         auto host_image = luisa::make_shared<luisa::vector<float>>();
@@ -180,11 +219,17 @@ public:
         return [host_image, total_samples,
                 resolution = _resolution,
                 channels = _channels,
-                path = std::move(path)] {
+                path = std::move(path),
+                pending = std::move(pending)] {
             auto scale = static_cast<float>(1. / total_samples);
             for (auto &p : *host_image) { p *= scale; }
             LUISA_INFO("Saving auxiliary buffer to '{}'.", path.string());
-            save_image(path.string(), host_image->data(), resolution, channels);
+            // the writer keeps the image alive until it is written; this runs on the
+            // stream's callback thread, so a full queue defers the image instead of waiting
+            if (!global_image_writer().try_write(path, host_image->data(), resolution, channels,
+                                                 [host_image] {})) {
+                pending->push(path, host_image, resolution, channels);
+            }
         };
     }
     void accumulate(Expr<uint2> p, Expr<float4> value) noexcept {
@@ -333,7 +378,7 @@ void AuxiliaryBufferPathTracingInstance::_render_one_camera(
                 $if(light_sample.eval.pdf > 0.0f & !occluded) {
                     auto wi = light_sample.shadow_ray->direction();
                     auto eval = closure->evaluate(wo, wi);
-                    auto w = balance_heuristic(light_sample.eval.pdf, eval.pdf) /
+                    auto w = ite(light_sample.delta, 1.f, balance_heuristic(light_sample.eval.pdf, eval.pdf)) /
                              light_sample.eval.pdf;
                     Li += w * beta * eval.f * light_sample.eval.L;
                     $if(!specular_bounce) {
@@ -401,6 +446,7 @@ void AuxiliaryBufferPathTracingInstance::_render_one_camera(
         shutter_samples = {ss};
     }
     auto sample_count = 0u;
+    auto pending_images = luisa::make_shared<PendingAuxiliaryImages>();
     for (auto s : shutter_samples) {
         pipeline().update(command_buffer, s.point.time);
         clear_auxiliary_buffers();
@@ -410,28 +456,31 @@ void AuxiliaryBufferPathTracingInstance::_render_one_camera(
         for (auto i = 0u; i < s.spp; i++) {
             command_buffer << render_auxiliary(sample_count++, s.point.time, s.point.weight)
                                   .dispatch(resolution);
+            pipeline().stream_resources(command_buffer);
             camera->film()->show(command_buffer);
             if (should_dump(sample_count)) {
                 LUISA_INFO("Saving AOVs at sample #{}.", sample_count);
+                pending_images->flush();
                 luisa::vector<luisa::function<void()>> savers;
                 for (auto &[component, buffer] : aux_buffers) {
                     auto path = node<AuxiliaryBufferPathTracing>()->dump_strategy() ==
                                         AuxiliaryBufferPathTracing::DumpStrategy::FINAL ?
                                     parent_path / fmt::format("{}_{}{}", filename, component, ext) :
                                     parent_path / fmt::format("{}_{}_{:05}{}", filename, component, sample_count, ext);
-                    if (auto saver = buffer->save(command_buffer, path, sample_count)) {
+                    if (auto saver = buffer->save(command_buffer, path, sample_count, pending_images)) {
                         savers.emplace_back(std::move(saver));
                     }
                 }
+                // the savers hand the images over to the image writer
                 if (!savers.empty()) {
-                    command_buffer << [&] { for (auto &s : savers) { s(); } }
-                                   << synchronize();
+                    command_buffer << [savers = std::move(savers)] { for (auto &s : savers) { s(); } };
                 }
             }
             if (sample_count % 16u == 0u) { command_buffer << commit(); }
         }
     }
     command_buffer << synchronize();
+    pending_images->flush();
     progress.done();
 
     auto render_time = clock.toc();
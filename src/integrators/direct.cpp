@@ -53,6 +53,7 @@ public:
     using ProgressiveIntegrator::Instance::Instance;
 
 protected:
+    [[nodiscard]] bool _uses_default_render_loop() const noexcept override { return true; }
     void _render_one_camera(CommandBuffer &command_buffer,
                             Camera::Instance *camera) noexcept override {
         if (!pipeline().has_lighting()) [[unlikely]] {
@@ -84,7 +85,7 @@ protected:
 
             // trace
             auto wo = -ray->direction();
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
 
             // miss
             $if(!it->valid()) {
@@ -119,7 +120,7 @@ protected:
                 // trace shadow ray
                 $if(light_sample.eval.pdf > 0.f &
                     light_sample.eval.L.any([](auto x) { return x > 0.f; })) {
-                    occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);
+                    occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray, time);
                 };
             }
 
@@ -147,7 +148,7 @@ protected:
                         $if(eval.pdf > 0.f) {
                             auto w = def(1.f);
                             // MIS if sampling surfaces as well
-                            if (samples_surfaces) { w = balance_heuristic(light_sample.eval.pdf, eval.pdf); }
+                            if (samples_surfaces) { w = ite(light_sample.delta, 1.f, balance_heuristic(light_sample.eval.pdf, eval.pdf)); }
                             Li += w * cs.weight * eval.f * light_sample.eval.L / light_sample.eval.pdf;
                         };
                     };
@@ -162,7 +163,7 @@ protected:
             $if(!alpha_skip) {
                 if (samples_surfaces) {
                     // trace
-                    auto bsdf_it = pipeline().geometry()->intersect(ray);
+                    auto bsdf_it = pipeline().geometry()->intersect(ray, time);
 
                     // miss
                     auto light_eval = Light::Evaluation::zero(swl.dimension());
@@ -580,7 +580,8 @@ luisa::unique_ptr<Integrator::Instance> GradientPathTracing::build(
                 auto main_distance_squared = length_squared(main.it.p() - main_light_sample.eval.p);
                 auto main_opposing_cosine = dot(main_light_sample.eval.ng, normalize(main.it.p() - main_light_sample.eval.p));
 
-                auto main_bsdf_pdf = main_light_eval.pdf;
+                // BSDF sampling never hits delta lights, so they are only weighted by the light pdfs
+                auto main_bsdf_pdf = ite(main_light_sample.delta, 0.f, main_light_eval.pdf);
 
                 // Balance Heuristic
                 auto main_weight = main.weight / (main_light_sample.eval.pdf + main_bsdf_pdf);// main.throughput / (main.pdf * (light sample pdf + bsdf pdf))
@@ -632,7 +633,7 @@ luisa::unique_ptr<Integrator::Instance> GradientPathTracing::build(
                                 });
                                 auto shifted_emitter_pdf = main_light_sample.eval.pdf;
                                 auto shifted_bsdf_value = shifted_bsdf_eval.f;
-                                auto shifted_bsdf_pdf = ite(!main_occluded, shifted_bsdf_eval.pdf, 0.f);
+                                auto shifted_bsdf_pdf = ite(!main_occluded & !main_light_sample.delta, shifted_bsdf_eval.pdf, 0.f);
                                 auto shifted_emitter_radiance = main_light_sample.eval.L;
                                 auto jacobian = 1.f;
 
@@ -674,7 +675,7 @@ luisa::unique_ptr<Integrator::Instance> GradientPathTracing::build(
                                         });
 
                                         auto shifted_bsdf_value = shifted_light_eval.f;
-                                        auto shifted_bsdf_pdf = shifted_light_eval.pdf;
+                                        auto shifted_bsdf_pdf = ite(shifted_light_sample.delta, 0.f, shifted_light_eval.pdf);
                                         auto jacobian = abs(shifted_opposing_cosine * main_distance_squared) / (D_EPSILON + abs(main_opposing_cosine * shifted_distance_squared));
 
                                         // MIS between main and shifted
@@ -1231,6 +1232,7 @@ void GradientPathTracingInstance::_render_one_camera(
             command_buffer << render(sample_id++, s.point.time, s.point.weight)
                                   .dispatch(resolution)
                            << accumulate().dispatch(resolution);
+            pipeline().stream_resources(command_buffer);
             constexpr auto dispatches_per_commit = 4u;
             if (camera->film()->show(command_buffer) ||
                 ++dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
@@ -1,4 +1,7 @@
+#include <array>
+
 #include <util/imageio.h>
+#include <util/mapped_file.h>
 #include <base/pipeline.h>
 #include <base/integrator.h>
 #include <base/scene.h>
@@ -7,6 +10,20 @@ namespace luisa::render {
 
 class GroupIntegrator;
 
+namespace detail {
+
+static constexpr auto group_checkpoint_magic = 0x505247415349554cull;// "LUISAGRP" in little-endian
+
+// saved at the group's checkpoint path once a child has finished, since
+// a finished child removes its own checkpoint and would restart on resume
+struct GroupCheckpoint {
+    uint64_t magic;
+    uint32_t child_count;
+    uint32_t finished_count;
+};
+
+}// namespace detail
+
 class GroupIntegratorInstance final : public Integrator::Instance {
 
 private:
@@ -50,8 +67,56 @@ GroupIntegratorInstance::GroupIntegratorInstance(
 }
 
 void GroupIntegratorInstance::render(Stream &stream) noexcept {
-    for (auto &_integrator : _integrators) {
-        _integrator->render(stream);
+    auto &&options = render_options();
+    auto child_count = static_cast<uint>(_integrators.size());
+    auto first = 0u;
+    if (!options.checkpoint.empty()) {
+        if (auto file = MappedFile::open(options.checkpoint);
+            file && file.size() == sizeof(detail::GroupCheckpoint)) {
+            auto record = reinterpret_cast<const detail::GroupCheckpoint *>(file.data());
+            if (record->magic == detail::group_checkpoint_magic &&
+                record->child_count == child_count &&
+                record->finished_count <= child_count) {
+                first = record->finished_count;
+                LUISA_INFO("Skipping {} integrator(s) finished before the checkpoint.", first);
+            } else {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Ignoring invalid checkpoint '{}'.",
+                    options.checkpoint.string());
+            }
+        }
+    }
+    for (auto i = first; i < child_count; i++) {
+        // the children render one after another, so the remaining time is split
+        // evenly over the remaining children, and they must not overwrite each
+        // other's checkpoints
+        auto child_options = options;
+        if (options.deadline) {
+            auto now = std::chrono::steady_clock::now();
+            child_options.deadline = now + (*options.deadline - now) /
+                                               static_cast<int>(child_count - i);
+        }
+        if (!options.checkpoint.empty()) {
+            child_options.checkpoint += luisa::format(".{}", i);
+        }
+        _integrators[i]->set_render_options(child_options);
+        _integrators[i]->render(stream);
+        if (!options.checkpoint.empty() && i + 1u < child_count) {
+            detail::GroupCheckpoint record{
+                .magic = detail::group_checkpoint_magic,
+                .child_count = child_count,
+                .finished_count = i + 1u};
+            std::array chunks{std::as_bytes(luisa::span{&record, 1u})};
+            if (write_file_atomic(options.checkpoint, chunks)) {
+                LUISA_VERBOSE("Saved checkpoint '{}' after integrator {}.",
+                              options.checkpoint.string(), i);
+            }
+        }
+    }
+    // the job is complete, so a later run should start from scratch
+    if (!options.checkpoint.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(options.checkpoint, ec);
     }
 }
 
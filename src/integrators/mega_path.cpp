@@ -16,16 +16,19 @@ private:
     uint _max_depth;
     uint _rr_depth;
     float _rr_threshold;
+    uint _light_samples;
 
 public:
     MegakernelPathTracing(Scene *scene, const SceneNodeDesc *desc) noexcept
         : ProgressiveIntegrator{scene, desc},
           _max_depth{std::max(desc->property_uint_or_default("depth", 10u), 1u)},
           _rr_depth{std::max(desc->property_uint_or_default("rr_depth", 0u), 0u)},
-          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)} {}
+          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)},
+          _light_samples{std::max(desc->property_uint_or_default("light_samples", 1u), 1u)} {}
     [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
     [[nodiscard]] auto rr_depth() const noexcept { return _rr_depth; }
     [[nodiscard]] auto rr_threshold() const noexcept { return _rr_threshold; }
+    [[nodiscard]] auto light_samples() const noexcept { return _light_samples; }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] luisa::unique_ptr<Integrator::Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
@@ -37,6 +40,7 @@ public:
     using ProgressiveIntegrator::Instance::Instance;
 
 protected:
+    [[nodiscard]] bool _uses_default_render_loop() const noexcept override { return true; }
     void _render_one_camera(CommandBuffer &command_buffer, Camera::Instance *camera) noexcept override {
         if (!pipeline().has_lighting()) [[unlikely]] {
             LUISA_WARNING_WITH_LOCATION(
@@ -60,17 +64,18 @@ protected:
 
         auto ray = camera_ray;
         auto pdf_bsdf = def(1e16f);
+        auto light_samples = node<MegakernelPathTracing>()->light_samples();
         $for(depth, node<MegakernelPathTracing>()->max_depth()) {
 
             // trace
             auto wo = -ray->direction();
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
 
             // miss
             $if(!it->valid()) {
                 if (pipeline().environment()) {
                     auto eval = light_sampler()->evaluate_miss(ray->direction(), swl, time);
-                    Li += beta * eval.L * balance_heuristic(pdf_bsdf, eval.pdf);
+                    Li += beta * eval.L * balance_heuristic(1u, pdf_bsdf, light_samples, eval.pdf);
                 }
                 $break;
             };
@@ -80,7 +85,7 @@ protected:
                 $outline {
                     $if(it->shape().has_light()) {
                         auto eval = light_sampler()->evaluate_hit(*it, ray->origin(), swl, time);
-                        Li += beta * eval.L * balance_heuristic(pdf_bsdf, eval.pdf);
+                        Li += beta * eval.L * balance_heuristic(1u, pdf_bsdf, light_samples, eval.pdf);
                     };
                 };
             }
@@ -96,17 +101,6 @@ protected:
             auto rr_depth = node<MegakernelPathTracing>()->rr_depth();
             $if(depth + 1u >= rr_depth) { u_rr = sampler()->generate_1d(); };
 
-            // generate uniform samples
-            auto light_sample = LightSampler::Sample::zero(swl.dimension());
-            $outline {
-                // sample one light
-                light_sample = light_sampler()->sample(
-                    *it, u_light_selection, u_light_surface, swl, time);
-            };
-
-            // trace shadow ray
-            auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);
-
             // evaluate material
             auto surface_tag = it->shape().surface_tag();
             auto eta_scale = def(1.f);
@@ -116,18 +110,32 @@ protected:
                 pipeline().surfaces().dispatch(surface_tag, [&](auto surface) noexcept {
                     surface->closure(call, *it, swl, wo, 1.f, time);
                 });
+                // direct lighting, with the light selection stratified over the samples
+                $for(k, light_samples) {
+                    auto u_surface = def(u_light_surface);
+                    $if(k > 0u) { u_surface = sampler()->generate_2d(); };
+                    auto light_sample = LightSampler::Sample::zero(swl.dimension());
+                    $outline {
+                        light_sample = light_sampler()->sample(
+                            *it, sample_stratified_1d(u_light_selection, k, light_samples),
+                            u_surface, swl, time);
+                    };
+                    // trace shadow ray
+                    auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray, time);
+                    $if(light_sample.eval.pdf > 0.0f & !occluded) {
+                        call.execute([&](const Surface::Closure *closure) noexcept {
+                            auto wi = light_sample.shadow_ray->direction();
+                            auto eval = closure->evaluate(wo, wi);
+                            auto w = ite(light_sample.delta, 1.f, balance_heuristic(light_samples, light_sample.eval.pdf, 1u, eval.pdf)) /
+                                     (static_cast<float>(light_samples) * light_sample.eval.pdf);
+                            Li += w * beta * eval.f * light_sample.eval.L;
+                        });
+                    };
+                };
                 call.execute([&](const Surface::Closure *closure) noexcept {
                     if (auto dispersive = closure->is_dispersive()) {
                         $if(*dispersive) { swl.terminate_secondary(); };
                     }
-                    // direct lighting
-                    $if(light_sample.eval.pdf > 0.0f & !occluded) {
-                        auto wi = light_sample.shadow_ray->direction();
-                        auto eval = closure->evaluate(wo, wi);
-                        auto w = balance_heuristic(light_sample.eval.pdf, eval.pdf) /
-                                 light_sample.eval.pdf;
-                        Li += w * beta * eval.f * light_sample.eval.L;
-                    };
                     // sample material
                     auto surface_sample = closure->sample(wo, u_lobe, u_bsdf);
                     ray = it->spawn_ray(surface_sample.wi);
@@ -20,16 +20,19 @@ private:
     uint _max_depth;
     uint _rr_depth;
     float _rr_threshold;
+    uint _light_samples;
 
 public:
     MegakernelVolumePathTracing(Scene *scene, const SceneNodeDesc *desc) noexcept
         : ProgressiveIntegrator{scene, desc},
           _max_depth{std::max(desc->property_uint_or_default("depth", 20u), 1u)},
           _rr_depth{std::max(desc->property_uint_or_default("rr_depth", 0u), 0u)},
-          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)} {}
+          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)},
+          _light_samples{std::max(desc->property_uint_or_default("light_samples", 1u), 1u)} {}
     [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
     [[nodiscard]] auto rr_depth() const noexcept { return _rr_depth; }
     [[nodiscard]] auto rr_threshold() const noexcept { return _rr_threshold; }
+    [[nodiscard]] auto light_samples() const noexcept { return _light_samples; }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] luisa::unique_ptr<Integrator::Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
@@ -41,6 +44,7 @@ public:
     using ProgressiveIntegrator::Instance::Instance;
 
 protected:
+    [[nodiscard]] bool _uses_default_render_loop() const noexcept override { return true; }
     void _render_one_camera(CommandBuffer &command_buffer, Camera::Instance *camera) noexcept override {
         if (!pipeline().has_lighting()) [[unlikely]] {
             LUISA_WARNING_WITH_LOCATION(
@@ -110,7 +114,7 @@ protected:
         // TODO: bug in initialization of medium tracker where the angle between shared edge is small
         auto depth_track = def<uint>(0u);
         $while(true) {
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
             $if(!it->valid()) { $break; };
 
             pipeline().printer().verbose_with_location("depth={}", depth_track + 1u);
@@ -164,6 +168,9 @@ protected:
 
         ray = camera_ray;
         auto pdf_bsdf = def(1e16f);
+        auto light_samples = node<MegakernelVolumePathTracing>()->light_samples();
+        // light samples taken at the previous vertex: one at medium vertices, light_samples at surfaces
+        auto light_samples_prev = def(light_samples);
         auto eta_scale = def(1.f);
         auto depth = def(0u);
         auto max_depth = node<MegakernelVolumePathTracing>()->max_depth();
@@ -174,7 +181,7 @@ protected:
             $if(depth + 1u >= rr_depth) { u_rr = sampler()->generate_1d(); };
 
             // trace
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
             auto has_medium = it->shape().has_medium();
 
             pipeline().printer().verbose_with_location("depth={}", depth + 1u);
@@ -282,7 +289,7 @@ protected:
                                                     //                                                            PCG32 rng(U64(make_uint2(xxhash32(light_ray.origin()), xxhash32(light_ray.direction()))));
 
                                                     $while(any(light_ray->direction() != 0.f)) {
-                                                        auto si = pipeline().geometry()->intersect(light_ray);
+                                                        auto si = pipeline().geometry()->intersect(light_ray, time);
                                                         $if(si->valid() & si->shape().has_surface()) {
                                                             Ld_medium_zero = true;
                                                             $break;
@@ -332,7 +339,8 @@ protected:
                                                         auto scatter_pdf = phase_function->pdf(wo, wi);
 
                                                         r_l *= r_u * light_sample.eval.pdf;
-                                                        r_u *= r_u * scatter_pdf;
+                                                        // phase function sampling never hits delta lights
+                                                        r_u *= r_u * ite(light_sample.delta, 0.f, scatter_pdf);
 
                                                         Li += beta * f_hat * T_ray * light_sample.eval.L / (r_l + r_u).average();
                                                     };
@@ -348,6 +356,7 @@ protected:
                                                     // Update ray path state for indirect volume scattering
                                                     beta *= ps.p / ps.pdf;
                                                     r_l = r_u / ps.pdf;
+                                                    light_samples_prev = 1u;
                                                     scattered = true;
                                                     auto p = closure_p->ray()->origin();
                                                     ray = make_ray(p, ps.wi);
@@ -404,7 +413,7 @@ protected:
                         Li += beta * eval.L / r_u.average();
                     }
                     $else {
-                        r_l /= balance_heuristic(pdf_bsdf, eval.pdf);
+                        r_l /= balance_heuristic(1u, pdf_bsdf, light_samples_prev, eval.pdf);
                         Li += beta * eval.L / (r_u + r_l).average();
                     };
                 }
@@ -419,7 +428,7 @@ protected:
                         Li += beta * eval.L / r_u.average();
                     }
                     $else {
-                        r_l /= balance_heuristic(pdf_bsdf, eval.pdf);
+                        r_l /= balance_heuristic(1u, pdf_bsdf, light_samples_prev, eval.pdf);
                         Li += beta * eval.L / (r_u + r_l).average();
                     };
                 };
@@ -439,13 +448,6 @@ protected:
                 auto u_lobe = sampler()->generate_1d();
                 auto u_bsdf = sampler()->generate_2d();
 
-                // sample one light
-                auto light_sample = light_sampler()->sample(
-                    *it, u_light_selection, u_light_surface, swl, time);
-
-                // trace shadow ray
-                auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);
-
                 auto medium_tag = it->shape().medium_tag();
                 auto medium_priority = def(0u);
                 auto eta_next = def(1.f);
@@ -472,6 +474,28 @@ protected:
                 pipeline().surfaces().dispatch(surface_tag, [&](auto surface) noexcept {
                     surface->closure(call, *it, swl, wo, eta, time);
                 });
+                // direct lighting, with the light selection stratified over the samples
+                // TODO: add medium to direct lighting
+                $if(medium_tag == medium_tracker.current().medium_tag) {
+                    $for(k, light_samples) {
+                        auto u_surface = def(u_light_surface);
+                        $if(k > 0u) { u_surface = sampler()->generate_2d(); };
+                        auto light_sample = light_sampler()->sample(
+                            *it, sample_stratified_1d(u_light_selection, k, light_samples),
+                            u_surface, swl, time);
+                        // trace shadow ray
+                        auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray, time);
+                        $if(light_sample.eval.pdf > 0.0f & !occluded) {
+                            call.execute([&](auto closure) noexcept {
+                                auto wi = light_sample.shadow_ray->direction();
+                                auto eval = closure->evaluate(wo, wi);
+                                auto w = ite(light_sample.delta, 1.f, balance_heuristic(light_samples, light_sample.eval.pdf, 1u, eval.pdf)) /
+                                         (static_cast<float>(light_samples) * light_sample.eval.pdf);
+                                Li += w * beta * eval.f * light_sample.eval.L;
+                            });
+                        };
+                    };
+                };
                 call.execute([&](auto closure) noexcept {
                     // apply opacity map
                     UInt surface_event;
@@ -484,21 +508,13 @@ protected:
                         if (auto dispersive = closure->is_dispersive()) {
                             $if(*dispersive) { swl.terminate_secondary(); };
                         }
-                        // direct lighting
-                        // TODO: add medium to direct lighting
-                        $if(light_sample.eval.pdf > 0.0f & !occluded) {
-                            auto wi = light_sample.shadow_ray->direction();
-                            auto eval = closure->evaluate(wo, wi);
-                            auto w = balance_heuristic(light_sample.eval.pdf, eval.pdf) /
-                                     light_sample.eval.pdf;
-                            Li += w * beta * eval.f * light_sample.eval.L;
-                        };
                         // sample material
                         auto surface_sample = closure->sample(wo, u_lobe, u_bsdf);
                         surface_event = surface_sample.event;
 
                         ray = it->spawn_ray(surface_sample.wi);
                         pdf_bsdf = surface_sample.eval.pdf;
+                        light_samples_prev = light_samples;
                         auto w = ite(surface_sample.eval.pdf > 0.f, 1.f / surface_sample.eval.pdf, 0.f);
                         beta *= w * surface_sample.eval.f;
                         r_l = r_u * w;
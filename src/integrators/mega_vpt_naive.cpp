@@ -54,6 +54,7 @@ public:
     };
 
 protected:
+    [[nodiscard]] bool _uses_default_render_loop() const noexcept override { return true; }
     void _render_one_camera(CommandBuffer &command_buffer, Camera::Instance *camera) noexcept override {
         if (!pipeline().has_lighting()) [[unlikely]] {
             LUISA_WARNING_WITH_LOCATION(
@@ -105,7 +106,7 @@ protected:
 
         // trace shadow ray
         $while(any(transmittance.f > 0.f)) {
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
 
             // end tracing
             $if(!it->valid()) { $break; };
@@ -194,7 +195,7 @@ protected:
         // TODO: bug in initialization of medium tracker where the angle between shared edge is small
         auto depth_track = def<uint>(0u);
         $while(true) {
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
             $if(!it->valid()) { $break; };
 
             pipeline().printer().verbose_with_location("depth={}", depth_track);
@@ -257,7 +258,7 @@ protected:
             $if(depth + 1u >= rr_depth) { u_rr = sampler()->generate_1d(); };
 
             // trace
-            auto it = pipeline().geometry()->intersect(ray);
+            auto it = pipeline().geometry()->intersect(ray, time);
             auto has_medium = it->shape().has_medium();
             auto t_max = ite(it->valid(), length(it->p() - ray->origin()), Interaction::default_t_max);
 
@@ -287,7 +288,7 @@ protected:
                 // trace shadow ray
                 auto transmittance_evaluation = _transmittance(frame_index, pixel_id, time, swl, rng, medium_tracker, light_sample.shadow_ray);
                 $if(transmittance_evaluation.pdf > 0.f) {
-                    auto w = 1.f / (pdf_bsdf + transmittance_evaluation.pdf + light_sample.eval.pdf);
+                    auto w = 1.f / (ite(light_sample.delta, 0.f, pdf_bsdf + transmittance_evaluation.pdf) + light_sample.eval.pdf);
                     Li += w * beta * transmittance_evaluation.f * light_sample.eval.L;
                 };
 #endif
@@ -357,7 +358,7 @@ protected:
 #ifdef VPT_NAIVE_ENABLE_DIRECT_LIGHTING
                 auto transmittance_evaluation = _transmittance(frame_index, pixel_id, time, swl, rng, medium_tracker, light_sample.shadow_ray);
 #else
-                auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);
+                auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray, time);
 #endif
 
                 auto medium_tag = it->shape().medium_tag();
@@ -403,10 +404,10 @@ protected:
                             auto wi = light_sample.shadow_ray->direction();
                             auto eval = closure->evaluate(wo, wi);
 #ifdef VPT_NAIVE_ENABLE_DIRECT_LIGHTING
-                            auto w = 1.f / (light_sample.eval.pdf + eval.pdf + transmittance_evaluation.pdf);
+                            auto w = 1.f / (light_sample.eval.pdf + ite(light_sample.delta, 0.f, eval.pdf + transmittance_evaluation.pdf));
                             Li += w * beta * eval.f * light_sample.eval.L * transmittance_evaluation.f;
 #else
-                            auto w = 1.f / (light_sample.eval.pdf + eval.pdf);
+                            auto w = 1.f / (light_sample.eval.pdf + ite(light_sample.delta, 0.f, eval.pdf));
                             Li += w * beta * eval.f * light_sample.eval.L;
 #endif
                             pipeline().printer().verbose_with_location(
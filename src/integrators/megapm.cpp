@@ -522,6 +522,7 @@ protected:
                 if (node<MegakernelPhotonMapping>()->shared_radius()) {
                     command_buffer << shared_update().dispatch(1u);
                 }
+                pipeline().stream_resources(command_buffer);
                 dispatch_count++;
                 if (camera->film()->show(command_buffer)) {
                     dispatch_count = 0u;
@@ -652,7 +653,7 @@ protected:
                     $if(light_sample.eval.pdf > 0.0f & !occluded) {
                         auto wi = light_sample.shadow_ray->direction();
                         auto eval = closure->evaluate(wo, wi);
-                        auto w = balance_heuristic(light_sample.eval.pdf, eval.pdf) /
+                        auto w = ite(light_sample.delta, 1.f, balance_heuristic(light_sample.eval.pdf, eval.pdf)) /
                                  light_sample.eval.pdf;
                         Li += w * beta * eval.f * light_sample.eval.L;
                     };
@@ -187,7 +187,7 @@ public:
     }
 };
 struct ThreadFrame {
-    float4 wi_and_pdf;
+    float4 wi_and_pdf;// the pdf is negated for samples on delta lights, which skip MIS
     float wl_sample;
     float pdf_bsdf;
     uint kernel_index;
@@ -620,7 +620,7 @@ void MegakernelWaveFrontInstance::_render_one_camera(
                     path_state_dim[path_id * dim + i].emission = ite(occluded, 0.f, 1.f) * light_sample.eval.L[i];
                 };
                 path_state[path_id].wi_and_pdf = make_float4(light_sample.shadow_ray->direction(),
-                                                             ite(occluded, 0.f, light_sample.eval.pdf));
+                                                             ite(occluded, 0.f, ite(light_sample.delta, -light_sample.eval.pdf, light_sample.eval.pdf)));
                 save_kernel(path_id, SAMPLE, SURFACE);
 
             };
@@ -666,10 +666,10 @@ void MegakernelWaveFrontInstance::_render_one_camera(
                     }
                     // direct lighting
                     auto light_wi_and_pdf = path_state[path_id].wi_and_pdf;
-                    auto pdf_light = light_wi_and_pdf.w;
-                    $if(light_wi_and_pdf.w > 0.f) {
+                    auto pdf_light = abs(light_wi_and_pdf.w);
+                    $if(pdf_light > 0.f) {
                         auto eval = closure->evaluate(wo, light_wi_and_pdf.xyz());
-                        auto mis_weight = balance_heuristic(pdf_light, eval.pdf);
+                        auto mis_weight = ite(light_wi_and_pdf.w < 0.f, 1.f, balance_heuristic(pdf_light, eval.pdf));
                         // update Li
                         SampledSpectrum Ld{dim};
                         for (auto i = 0u; i < dim; ++i) {
@@ -815,6 +815,7 @@ void MegakernelWaveFrontInstance::_render_one_camera(
                        << commit();
         LUISA_ASSERT(launch_size % render_shader.get().block_size().x == 0u, "");
         command_buffer << render_shader.get()(sample_count, host_sample_count, shutter_spp, time, s.point.weight).dispatch(launch_size);
+        pipeline().stream_resources(command_buffer);
         command_buffer << pipeline().printer().retrieve();
         command_buffer << synchronize();
         shutter_spp += s.spp;
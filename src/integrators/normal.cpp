@@ -33,6 +33,7 @@ public:
     using ProgressiveIntegrator::Instance::Instance;
 
 protected:
+    [[nodiscard]] bool _uses_default_render_loop() const noexcept override { return true; }
     [[nodiscard]] Float3 Li(const Camera::Instance *camera, Expr<uint> frame_index,
                             Expr<uint2> pixel_id, Expr<float> time) const noexcept override {
         sampler()->start(pixel_id, frame_index);
@@ -41,7 +42,7 @@ protected:
         auto cs = camera->generate_ray(pixel_id, time, u_filter, u_lens);
         auto swl = pipeline().spectrum()->sample(sampler()->generate_1d());
         auto path_weight = cs.weight;
-        auto it = pipeline().geometry()->intersect(cs.ray);
+        auto it = pipeline().geometry()->intersect(cs.ray, time);
         auto ns = def(make_float3(0.f));
         auto wo = -cs.ray->direction();
         $if(it->valid()) {
@@ -405,7 +405,7 @@ private:
                 $if(light_sample.eval.pdf > 0.0f & !occluded) {
                     auto wi = light_sample.shadow_ray->direction();
                     auto eval = closure->evaluate(wo, wi);
-                    auto w = balance_heuristic(light_sample.eval.pdf, eval.pdf) /
+                    auto w = ite(light_sample.delta, 1.f, balance_heuristic(light_sample.eval.pdf, eval.pdf)) /
                              light_sample.eval.pdf;
                     Li += w * beta * eval.f * light_sample.eval.L;
                 };
@@ -631,6 +631,7 @@ private:
                 command_buffer << propose(s.point.time, s.point.weight, static_cast<float>(b))
                                       .dispatch(chains_to_dispatch);
                 mutation_count += chains_to_dispatch;
+                pipeline().stream_resources(command_buffer);
                 dispatch_count++;
                 if (camera->film()->show(command_buffer)) { dispatch_count = 0u; }
                 auto dispatches_per_commit = 16u;
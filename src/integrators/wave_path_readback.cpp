@@ -36,6 +36,7 @@ private:
     uint _rr_depth;
     float _rr_threshold;
     uint _samples_per_pass;
+    uint _light_samples;
 
 public:
     WavefrontPathTracing(Scene *scene, const SceneNodeDesc *desc) noexcept
@@ -43,11 +44,13 @@ public:
           _max_depth{std::max(desc->property_uint_or_default("depth", 10u), 1u)},
           _rr_depth{std::max(desc->property_uint_or_default("rr_depth", 0u), 0u)},
           _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)},
-          _samples_per_pass{std::max(desc->property_uint_or_default("samples_per_pass", 4u), 1u)} {}
+          _samples_per_pass{std::max(desc->property_uint_or_default("samples_per_pass", 4u), 1u)},
+          _light_samples{std::max(desc->property_uint_or_default("light_samples", 1u), 1u)} {}
     [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
     [[nodiscard]] auto rr_depth() const noexcept { return _rr_depth; }
     [[nodiscard]] auto rr_threshold() const noexcept { return _rr_threshold; }
     [[nodiscard]] auto samples_per_pass() const noexcept { return _samples_per_pass; }
+    [[nodiscard]] auto light_samples() const noexcept { return _light_samples; }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] luisa::unique_ptr<Integrator::Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
@@ -138,7 +141,7 @@ class LightSampleSOA {
 private:
     const Spectrum::Instance *_spectrum;
     Buffer<float> _emission;
-    Buffer<float4> _wi_and_pdf;
+    Buffer<float4> _wi_and_pdf;// the pdf is negated for samples on delta lights, which skip MIS
 
 public:
     LightSampleSOA(const Spectrum::Instance *spec, size_t size) noexcept
@@ -238,18 +241,21 @@ void WavefrontPathTracingInstance::_render_one_camera(
     auto spp = camera->node()->spp();
     auto resolution = camera->film()->node()->resolution();
     auto pixel_count = resolution.x * resolution.y;
-    auto max_samples_per_pass = ((1ull << 30u) + pixel_count - 1u) / pixel_count;
+    auto light_sample_count = node<WavefrontPathTracing>()->light_samples();
+    // the light samples of all states must stay addressable with 32-bit indices
+    auto light_sample_stride = static_cast<uint64_t>(pixel_count) * light_sample_count;
+    auto max_samples_per_pass = ((1ull << 30u) + light_sample_stride - 1u) / light_sample_stride;
     auto samples_per_pass = std::min(node<WavefrontPathTracing>()->samples_per_pass(),
                                      static_cast<uint32_t>(max_samples_per_pass));
     auto state_count = static_cast<uint64_t>(samples_per_pass) *
                        static_cast<uint64_t>(pixel_count);
     LUISA_INFO("Wavefront path tracing configurations: "
-               "resolution = {}x{}, spp = {}, state_count = {}, samples_per_pass = {}.",
-               resolution.x, resolution.y, spp, state_count, samples_per_pass);
+               "resolution = {}x{}, spp = {}, state_count = {}, samples_per_pass = {}, light_samples = {}.",
+               resolution.x, resolution.y, spp, state_count, samples_per_pass, light_sample_count);
 
     auto spectrum = pipeline().spectrum();
     PathStateSOA path_states{spectrum, state_count};
-    LightSampleSOA light_samples{spectrum, state_count};
+    LightSampleSOA light_samples{spectrum, state_count * light_sample_count};
     sampler()->reset(command_buffer, resolution, state_count, spp);
     command_buffer << synchronize();
 
@@ -322,7 +328,7 @@ void WavefrontPathTracingInstance::_render_one_camera(
                 auto beta = path_states.read_beta(path_id);
                 auto Li = path_states.read_radiance(path_id);
                 auto eval = light_sampler()->evaluate_miss(wi, swl, time);
-                auto mis_weight = balance_heuristic(pdf_bsdf, eval.pdf);
+                auto mis_weight = balance_heuristic(1u, pdf_bsdf, light_sample_count, eval.pdf);
                 Li += beta * eval.L * mis_weight;
                 path_states.write_radiance(path_id, Li);
             };
@@ -345,7 +351,7 @@ void WavefrontPathTracingInstance::_render_one_camera(
                 auto Li = path_states.read_radiance(path_id);
                 auto it = pipeline().geometry()->interaction(ray, hit);
                 auto eval = light_sampler()->evaluate_hit(*it, ray->origin(), swl, time);
-                auto mis_weight = balance_heuristic(pdf_bsdf, eval.pdf);
+                auto mis_weight = balance_heuristic(1u, pdf_bsdf, light_sample_count, eval.pdf);
                 Li += beta * eval.L * mis_weight;
                 path_states.write_radiance(path_id, Li);
             };
@@ -354,26 +360,43 @@ void WavefrontPathTracingInstance::_render_one_camera(
 
     LUISA_INFO("Compiling light sampling kernel.");
     auto sample_light_shader = compile_async<1>(device, [&](BufferUInt path_indices, BufferRay rays, BufferHit hits,
-                                                            BufferUInt queue, BufferUInt queue_size, Float time) noexcept {
+                                                            BufferUInt queue, BufferUInt queue_size,
+                                                            BufferRay shadow_rays, Float time) noexcept {
         auto queue_id = dispatch_x();
         $if(queue_id < queue_size.read(0u)) {
             auto ray_id = queue.read(queue_id);
             auto path_id = path_indices.read(ray_id);
-            sampler()->load_state(path_id);
-            auto u_light_selection = sampler()->generate_1d();
-            auto u_light_surface = sampler()->generate_2d();
-            sampler()->save_state(path_id);
             auto ray = rays.read(ray_id);
             auto hit = hits.read(ray_id);
             auto it = pipeline().geometry()->interaction(ray, hit);
             auto [u_wl, swl] = path_states.read_swl(path_id);
-            auto light_sample = light_sampler()->sample(
-                *it, u_light_selection, u_light_surface, swl, time);
-            // trace shadow ray
-            auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);
-            light_samples.write_emission(queue_id, ite(occluded, 0.f, 1.f) * light_sample.eval.L);
-            light_samples.write_wi_and_pdf(queue_id, light_sample.shadow_ray->direction(),
-                                           ite(occluded, 0.f, light_sample.eval.pdf));
+            sampler()->load_state(path_id);
+            auto u_light_selection = sampler()->generate_1d();
+            // the shadow rays are traced in a separate pass over all samples of the bounce
+            $for(k, light_sample_count) {
+                auto u_light_surface = sampler()->generate_2d();
+                auto light_sample = light_sampler()->sample(
+                    *it, sample_stratified_1d(u_light_selection, k, light_sample_count),
+                    u_light_surface, swl, time);
+                auto sample_id = queue_id * light_sample_count + k;
+                shadow_rays.write(sample_id, light_sample.shadow_ray);
+                light_samples.write_emission(sample_id, light_sample.eval.L);
+                light_samples.write_wi_and_pdf(sample_id, light_sample.shadow_ray->direction(),
+                                               ite(light_sample.delta, -light_sample.eval.pdf, light_sample.eval.pdf));
+            };
+            sampler()->save_state(path_id);
+        };
+    });
+
+    LUISA_INFO("Compiling shadow ray tracing kernel.");
+    auto trace_shadow_shader = compile_async<1>(device, [&](BufferUInt queue_size, BufferRay shadow_rays) noexcept {
+        auto sample_id = dispatch_x();
+        $if(sample_id < queue_size.read(0u) * light_sample_count) {
+            auto wi_and_pdf = light_samples.read_wi_and_pdf(sample_id);
+            $if(wi_and_pdf.w != 0.f) {
+                auto occluded = pipeline().geometry()->intersect_any(shadow_rays.read(sample_id));
+                $if(occluded) { light_samples.write_wi_and_pdf(sample_id, wi_and_pdf.xyz(), 0.f); };
+            };
         };
     });
 
@@ -416,15 +439,23 @@ void WavefrontPathTracingInstance::_render_one_camera(
                     };
                 }
                 // direct lighting
-                auto light_wi_and_pdf = light_samples.read_wi_and_pdf(queue_id);
-                auto pdf_light = light_wi_and_pdf.w;
-                $if(light_wi_and_pdf.w > 0.f) {
-                    auto eval = closure->evaluate(wo, light_wi_and_pdf.xyz());
-                    auto mis_weight = balance_heuristic(pdf_light, eval.pdf);
-                    // update Li
-                    auto Ld = light_samples.read_emission(queue_id);
+                SampledSpectrum Ld{swl.dimension()};
+                $for(k, light_sample_count) {
+                    auto sample_id = queue_id * light_sample_count + k;
+                    auto light_wi_and_pdf = light_samples.read_wi_and_pdf(sample_id);
+                    auto pdf_light = abs(light_wi_and_pdf.w);
+                    $if(pdf_light > 0.f) {
+                        auto eval = closure->evaluate(wo, light_wi_and_pdf.xyz());
+                        auto mis_weight = ite(light_wi_and_pdf.w < 0.f, 1.f,
+                                              balance_heuristic(light_sample_count, pdf_light, 1u, eval.pdf));
+                        auto L = light_samples.read_emission(sample_id);
+                        Ld += mis_weight / (static_cast<float>(light_sample_count) * pdf_light) * eval.f * L;
+                    };
+                };
+                // update Li
+                $if(!Ld.is_zero()) {
                     auto Li = path_states.read_radiance(path_id);
-                    Li += mis_weight / pdf_light * beta * eval.f * Ld;
+                    Li += beta * Ld;
                     path_states.write_radiance(path_id, Li);
                 };
                 // sample material
@@ -482,6 +513,7 @@ void WavefrontPathTracingInstance::_render_one_camera(
     evaluate_surface_shader.get().set_name("evaluate_surfaces");
     evaluate_light_shader.get().set_name("evaluate_lights");
     sample_light_shader.get().set_name("sample_lights");
+    trace_shadow_shader.get().set_name("trace_shadow_rays");
     accumulate_shader.get().set_name("accumulate");
     auto integrator_shader_compilation_time = clock_compile.toc();
     LUISA_INFO("Integrator shader compile in {} ms.", integrator_shader_compilation_time);
@@ -496,6 +528,7 @@ void WavefrontPathTracingInstance::_render_one_camera(
     auto ray_buffer = device.create_buffer<Ray>(state_count);
     auto ray_buffer_out = device.create_buffer<Ray>(state_count);
     auto hit_buffer = device.create_buffer<Hit>(state_count);
+    auto shadow_ray_buffer = device.create_buffer<Ray>(state_count * light_sample_count);
     auto state_count_buffer = device.create_buffer<uint>(samples_per_pass);
     luisa::vector<uint> precomputed_state_counts(samples_per_pass);
     for (auto i = 0u; i < samples_per_pass; i++) {
@@ -557,8 +590,11 @@ void WavefrontPathTracingInstance::_render_one_camera(
                 command_buffer << surface_count.copy_to(&launch_size);
                 command_buffer << synchronize();
                 if (launch_size)
-                    command_buffer << sample_light_shader.get()(path_indices, rays, hits, surface_indices, surface_count, time)
-                                          .dispatch(launch_size);
+                    command_buffer << sample_light_shader.get()(path_indices, rays, hits, surface_indices, surface_count,
+                                                                shadow_ray_buffer, time)
+                                          .dispatch(launch_size)
+                                   << trace_shadow_shader.get()(surface_count, shadow_ray_buffer)
+                                          .dispatch(launch_size * light_sample_count);
                 command_buffer << surface_count.copy_to(&launch_size);
                 command_buffer << synchronize();
                 if (launch_size)
@@ -574,6 +610,7 @@ void WavefrontPathTracingInstance::_render_one_camera(
             }
             command_buffer << accumulate_shader.get()(s.point.weight).dispatch(launch_state_count);
             sample_id += launch_spp;
+            pipeline().stream_resources(command_buffer);
             camera->film()->show(command_buffer);
             auto launches_per_commit = 4u;
             if (sample_id - last_committed_sample_id >= launches_per_commit) {
@@ -58,6 +58,7 @@ private:
     bool _test_case;
     bool _compact;
     bool _use_tag_sort;
+    uint _light_samples;
 
 public:
     WavefrontPathTracingv2(Scene *scene, const SceneNodeDesc *desc) noexcept
@@ -69,7 +70,8 @@ public:
           _gathering{desc->property_bool_or_default("gathering", true)},
           _use_tag_sort{desc->property_bool_or_default("use_tag_sort", true)},
           _test_case{desc->property_bool_or_default("test_case", false)},
-          _compact{desc->property_bool_or_default("compact", true)} {}
+          _compact{desc->property_bool_or_default("compact", true)},
+          _light_samples{std::max(desc->property_uint_or_default("light_samples", 1u), 1u)} {}
 
     [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
     [[nodiscard]] auto use_tag_sort() const noexcept { return _use_tag_sort; }
@@ -79,6 +81,7 @@ public:
     [[nodiscard]] auto gathering() const noexcept { return _gathering; }
     [[nodiscard]] auto test_case() const noexcept { return _test_case; }
     [[nodiscard]] auto compact() const noexcept { return _compact; }
+    [[nodiscard]] auto light_samples() const noexcept { return _light_samples; }
     [[nodiscard]] string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] luisa::unique_ptr<Integrator::Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
@@ -227,18 +230,20 @@ class LightSampleSOA {
 private:
     const Spectrum::Instance *_spectrum;
     Buffer<float> _emission;
-    Buffer<float4> _wi_and_pdf;
+    Buffer<float4> _wi_and_pdf;// the pdf is negated for samples on delta lights, which skip MIS
     Buffer<uint> _surface_tag;
     Buffer<uint> _tag_counter;
     bool _use_tag_sort;
+    uint _samples_per_state;
 
 public:
-    LightSampleSOA(const Spectrum::Instance *spec, size_t size, size_t tag_size) noexcept
-        : _spectrum{spec} {
+    // emission and wi_and_pdf hold `samples_per_state` consecutive entries per state
+    LightSampleSOA(const Spectrum::Instance *spec, size_t size, size_t tag_size, uint samples_per_state) noexcept
+        : _spectrum{spec}, _samples_per_state{samples_per_state} {
         auto &&device = spec->pipeline().device();
         auto dimension = spec->node()->dimension();
-        _emission = device.create_buffer<float>(size * dimension);
-        _wi_and_pdf = device.create_buffer<float4>(size);
+        _emission = device.create_buffer<float>(size * samples_per_state * dimension);
+        _wi_and_pdf = device.create_buffer<float4>(size * samples_per_state);
         if (tag_size > 0) {
             _use_tag_sort = true;
             _surface_tag = device.create_buffer<uint>(size);
@@ -292,12 +297,16 @@ public:
         write_##entry(to, inst);        \
     }
     void move(Expr<uint> from, Expr<uint> to) noexcept {
-        MOVE(emission, from, to);
         if (_use_tag_sort) {
             MOVE(surface_tag, from, to);
         }
-        auto inst = read_wi_and_pdf(from);
-        write_wi_and_pdf(to, inst.xyz(), inst.w);
+        $for(k, _samples_per_state) {
+            auto sample_from = from * _samples_per_state + k;
+            auto sample_to = to * _samples_per_state + k;
+            MOVE(emission, sample_from, sample_to);
+            auto inst = read_wi_and_pdf(sample_from);
+            write_wi_and_pdf(sample_to, inst.xyz(), inst.w);
+        };
     }
 #undef MOVE
 };
@@ -454,15 +463,17 @@ void WavefrontPathTracingv2Instance::_render_one_camera(
     auto test_case = node<WavefrontPathTracingv2>()->test_case();
     auto compact = node<WavefrontPathTracingv2>()->compact();
     auto use_tag_sort = node<WavefrontPathTracingv2>()->use_tag_sort();
+    auto light_sample_count = node<WavefrontPathTracingv2>()->light_samples();
     bool use_sort = true;
     bool direct_launch = false;
     LUISA_INFO("Wavefront path tracing configurations: "
-               "resolution = {}x{}, spp = {}, state_count = {}.",
-               resolution.x, resolution.y, spp, state_count);
+               "resolution = {}x{}, spp = {}, state_count = {}, light_samples = {}.",
+               resolution.x, resolution.y, spp, state_count, light_sample_count);
 
     auto spectrum = pipeline().spectrum();
     PathStateSOA path_states{spectrum, state_count, gathering};
-    LightSampleSOA light_samples{spectrum, state_count, use_tag_sort ? pipeline().surfaces().size() : 0};
+    LightSampleSOA light_samples{spectrum, state_count, use_tag_sort ? pipeline().surfaces().size() : 0,
+                                 light_sample_count};
     sampler()->reset(command_buffer, resolution, state_count, spp);
     command_buffer << synchronize();
     AggregatedRayQueue aqueue{device,state_count,KERNEL_COUNT,gathering};
@@ -618,7 +629,7 @@ void WavefrontPathTracingv2Instance::_render_one_camera(
                 auto pdf_bsdf = path_states.read_pdf_bsdf(path_id);
                 auto beta = path_states.read_beta(path_id);
                 auto eval = light_sampler()->evaluate_miss(wi, swl, time);
-                auto mis_weight = balance_heuristic(pdf_bsdf, eval.pdf);
+                auto mis_weight = balance_heuristic(1u, pdf_bsdf, light_sample_count, eval.pdf);
                 auto Li = beta * eval.L * mis_weight;
                 auto pixel_id = path_states.read_pixel_index(path_id);
                 auto pixel_coord = make_uint2(pixel_id % resolution.x, pixel_id / resolution.x);
@@ -654,7 +665,7 @@ void WavefrontPathTracingv2Instance::_render_one_camera(
                 auto beta = path_states.read_beta(path_id);
                 auto it = pipeline().geometry()->interaction(ray, hit);
                 auto eval = light_sampler()->evaluate_hit(*it, ray->origin(), swl, time);
-                auto mis_weight = balance_heuristic(pdf_bsdf, eval.pdf);
+                auto mis_weight = balance_heuristic(1u, pdf_bsdf, light_sample_count, eval.pdf);
                 auto Li = beta * eval.L * mis_weight;
                 auto pixel_id = path_states.read_pixel_index(path_id);
                 auto pixel_coord = make_uint2(pixel_id % resolution.x, pixel_id / resolution.x);
@@ -696,21 +707,25 @@ void WavefrontPathTracingv2Instance::_render_one_camera(
             condition = (kernel_index == (uint)SAMPLE);
         }
         $if(condition) {
-        sampler()->load_state(path_id);
-        auto u_light_selection = sampler()->generate_1d();
-        auto u_light_surface = sampler()->generate_2d();
-        sampler()->save_state(path_id);
         auto ray = path_states.read_ray(path_id);
         auto hit = path_states.read_hit(path_id);
         auto it = pipeline().geometry()->interaction(ray, hit);
         auto [u_wl, swl] = path_states.read_swl(path_id);
-        auto light_sample = light_sampler()->sample(
-            *it, u_light_selection, u_light_surface, swl, time);
-        // trace shadow ray
-        auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);//if occluded, transit to invalid
-        light_samples.write_emission(path_id, ite(occluded, 0.f, 1.f) * light_sample.eval.L);
-        light_samples.write_wi_and_pdf(path_id, light_sample.shadow_ray->direction(),
-                                       ite(occluded, 0.f, light_sample.eval.pdf));
+        sampler()->load_state(path_id);
+        auto u_light_selection = sampler()->generate_1d();
+        $for(k, light_sample_count) {
+            auto u_light_surface = sampler()->generate_2d();
+            auto light_sample = light_sampler()->sample(
+                *it, sample_stratified_1d(u_light_selection, k, light_sample_count),
+                u_light_surface, swl, time);
+            // trace shadow ray
+            auto occluded = pipeline().geometry()->intersect_any(light_sample.shadow_ray);//if occluded, transit to invalid
+            auto sample_id = path_id * light_sample_count + k;
+            light_samples.write_emission(sample_id, ite(occluded, 0.f, 1.f) * light_sample.eval.L);
+            light_samples.write_wi_and_pdf(sample_id, light_sample.shadow_ray->direction(),
+                                           ite(occluded, 0.f, ite(light_sample.delta, -light_sample.eval.pdf, light_sample.eval.pdf)));
+        };
+        sampler()->save_state(path_id);
         if (use_tag_sort) {
             auto surface_tag = it->shape().surface_tag();
             light_samples.write_surface_tag(path_id, surface_tag);
@@ -769,14 +784,22 @@ void WavefrontPathTracingv2Instance::_render_one_camera(
                 };
             }
             // direct lighting
-            auto light_wi_and_pdf = light_samples.read_wi_and_pdf(path_id);
-            auto pdf_light = light_wi_and_pdf.w;
-            $if(light_wi_and_pdf.w > 0.f) {
-                auto eval = closure->evaluate(wo, light_wi_and_pdf.xyz());
-                auto mis_weight = balance_heuristic(pdf_light, eval.pdf);
-                // update Li
-                auto Ld = light_samples.read_emission(path_id);
-                auto Li = mis_weight / pdf_light * beta * eval.f * Ld;
+            SampledSpectrum Ld{swl.dimension()};
+            $for(k, light_sample_count) {
+                auto sample_id = path_id * light_sample_count + k;
+                auto light_wi_and_pdf = light_samples.read_wi_and_pdf(sample_id);
+                auto pdf_light = abs(light_wi_and_pdf.w);
+                $if(pdf_light > 0.f) {
+                    auto eval = closure->evaluate(wo, light_wi_and_pdf.xyz());
+                    auto mis_weight = ite(light_wi_and_pdf.w < 0.f, 1.f,
+                                          balance_heuristic(light_sample_count, pdf_light, 1u, eval.pdf));
+                    auto L = light_samples.read_emission(sample_id);
+                    Ld += mis_weight / (static_cast<float>(light_sample_count) * pdf_light) * eval.f * L;
+                };
+            };
+            // update Li
+            $if(!Ld.is_zero()) {
+                auto Li = beta * Ld;
                 auto pixel_id = path_states.read_pixel_index(path_id);
                 auto pixel_coord = make_uint2(pixel_id % resolution.x, pixel_id / resolution.x);
                 camera->film()->accumulate(pixel_coord, spectrum->srgb(swl, Li), 0.f);
@@ -1246,6 +1269,7 @@ void WavefrontPathTracingv2Instance::_render_one_camera(
                                                                  time, s.point.weight, generate_count)
                                           .dispatch(luisa::align(generate_count, generate_rays_shader.get().block_size().x));//generate rays in [valid_count,state_count)
                     launch_state_count -= generate_count;
+                    pipeline().stream_resources(command_buffer);
                     queues_empty = false;
                     continue;
                 }
@@ -5,6 +5,7 @@
 #include <base/light.h>
 #include <base/interaction.h>
 #include <util/sampling.h>
+#include <util/colorspace.h>
 #include <base/pipeline.h>
 #include <base/scene.h>
 
@@ -25,8 +26,14 @@ public:
           _scale{std::max(desc->property_float_or_default("scale", 1.0f), 0.0f)},
           _two_sided{desc->property_bool_or_default("two_sided", false)} {}
     [[nodiscard]] auto scale() const noexcept { return _scale; }
-    [[nodiscard]] auto two_sided() const noexcept { return _two_sided; }
+    [[nodiscard]] bool two_sided() const noexcept override { return _two_sided; }
     [[nodiscard]] bool is_null() const noexcept override { return _scale == 0.0f || _emission->is_black(); }
+    [[nodiscard]] float emission_estimate() const noexcept override {
+        // emission that cannot be averaged on the host is treated as unit radiance
+        auto v = _emission->evaluate_average().value_or(make_float4(1.f));
+        auto L = _emission->channels() == 1u ? v.x : srgb_to_cie_y(make_float3(v.x, v.y, v.z));
+        return _scale * std::max(L, 0.f);
+    }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] luisa::unique_ptr<Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
@@ -34,8 +41,15 @@ public:
 
 class DiffuseLightInstance final : public Light::Instance {
 
+public:
+    // strata per side when integrating the emission over a triangle
+    static constexpr auto max_emission_strata = 32u;
+    // for procedural textures, which have no texels
+    static constexpr auto default_texel_density = 64.f;
+
 private:
     const Texture::Instance *_texture;
+    mutable luisa::optional<compute::Shader1D<Buffer<float2>, Buffer<float>, float2>> _emission_shader;
 
 public:
     DiffuseLightInstance(
@@ -45,6 +59,10 @@ public:
     [[nodiscard]] auto texture() const noexcept { return _texture; }
     [[nodiscard]] luisa::unique_ptr<Light::Closure> closure(
         const SampledWavelengths &swl, Expr<float> time) const noexcept override;
+    [[nodiscard]] bool has_varying_emission() const noexcept override { return !_texture->node()->is_constant(); }
+    void triangle_emission(CommandBuffer &command_buffer,
+                           BufferView<float2> corner_uvs,
+                           BufferView<float> emission) const noexcept override;
 };
 
 luisa::unique_ptr<Light::Instance> DiffuseLight::build(
@@ -64,14 +82,14 @@ public:
         : Light::Closure{light, swl, time} {}
 
 private:
+    // pdf_triangle is the probability of picking the triangle from p_from
     [[nodiscard]] auto _evaluate(const Interaction &it_light,
-                                 Expr<float3> p_from) const noexcept {
+                                 Expr<float3> p_from,
+                                 Expr<float> pdf_triangle) const noexcept {
         auto eval = Light::Evaluation::zero(swl().dimension());
         $outline {
             using namespace luisa::compute;
             auto light = instance<DiffuseLightInstance>();
-            auto &&pipeline = light->pipeline();
-            auto pdf_triangle = pipeline.buffer<float>(it_light.shape().pdf_buffer_id()).read(it_light.triangle_id());
             auto pdf_area = pdf_triangle / it_light.triangle_area();
             auto cos_wo = abs_dot(normalize(p_from - it_light.p()), it_light.ng());
             auto L = light->texture()->evaluate_illuminant_spectrum(it_light, swl(), time()).value *
@@ -108,7 +126,12 @@ private:
 public:
     [[nodiscard]] Light::Evaluation evaluate(const Interaction &it_light,
                                              Expr<float3> p_from) const noexcept override {
-        return _evaluate(it_light, p_from);
+        auto light = instance<DiffuseLightInstance>();
+        auto &&geometry = *light->pipeline().geometry();
+        auto pdf_triangle = geometry.light_triangle_pmf(
+            it_light.shape(), geometry.instance_to_world(it_light.instance_id(), time()),
+            p_from, light->node<DiffuseLight>()->two_sided(), it_light.triangle_id());
+        return _evaluate(it_light, p_from, pdf_triangle);
     }
 
     [[nodiscard]] Light::Sample sample(Expr<uint> light_inst_id,
@@ -119,19 +142,17 @@ public:
             auto light = instance<DiffuseLightInstance>();
             auto &&pipeline = light->pipeline();
             auto light_inst = pipeline.geometry()->instance(light_inst_id);
-            auto light_to_world = pipeline.geometry()->instance_to_world(light_inst_id);
-            auto alias_table_buffer_id = light_inst.alias_table_buffer_id();
-            auto [triangle_id, ux] = sample_alias_table(
-                pipeline.buffer<AliasEntry>(alias_table_buffer_id),
-                light_inst.triangle_count(), u_in.x);
+            auto light_to_world = pipeline.geometry()->instance_to_world(light_inst_id, time());
+            // triangles are picked by their estimated contribution to p_from
+            auto [triangle_id, pdf_triangle, ux] = pipeline.geometry()->sample_light_triangle(
+                light_inst, light_to_world, p_from, light->node<DiffuseLight>()->two_sided(), u_in.x);
             auto triangle = pipeline.geometry()->triangle(light_inst, triangle_id);
             auto uvw = sample_uniform_triangle(make_float2(ux, u_in.y));
-            auto attrib = pipeline.geometry()->geometry_point(light_inst, triangle, uvw, light_to_world);
-            Interaction it_light{std::move(light_inst), light_inst_id,
-                                 triangle_id, attrib.area, attrib.p, attrib.n,
-                                 dot(p_from - attrib.p, attrib.n) < 0.f};
+            auto attrib = pipeline.geometry()->shading_point(light_inst, triangle, uvw, light_to_world);
+            Interaction it_light{std::move(light_inst), light_inst_id, triangle_id, attrib,
+                                 dot(attrib.g.n, p_from - attrib.g.p) < 0.f};
             DiffuseLightClosure closure{light, swl(), time()};
-            s = {.eval = closure._evaluate(it_light, p_from), .p = attrib.p};
+            s = {.eval = closure._evaluate(it_light, p_from, pdf_triangle), .p = attrib.g.p, .delta = false};
         };
         return s;
     }
@@ -145,7 +166,7 @@ public:
             auto light = instance<DiffuseLightInstance>();
             auto &&pipeline = light->pipeline();
             auto light_inst = pipeline.geometry()->instance(light_inst_id);
-            auto light_to_world = pipeline.geometry()->instance_to_world(light_inst_id);
+            auto light_to_world = pipeline.geometry()->instance_to_world(light_inst_id, time());
             auto alias_table_buffer_id = light_inst.alias_table_buffer_id();
             auto [triangle_id, ux] = sample_alias_table(
                 pipeline.buffer<AliasEntry>(alias_table_buffer_id),
@@ -184,12 +205,45 @@ public:
                 eval.pdf *= inv_pi;
             }
             ray = it_light.spawn_ray(we_world);
-            s = {.eval = eval, .p = attrib.p};
+            s = {.eval = eval, .p = attrib.p, .delta = false};
         };
         return {s, ray};
     }
 };
 
+void DiffuseLightInstance::triangle_emission(CommandBuffer &command_buffer,
+                                             BufferView<float2> corner_uvs,
+                                             BufferView<float> emission) const noexcept {
+    if (!has_varying_emission() || emission.size() == 0u) { return; }
+    if (!_emission_shader) {
+        Kernel1D emission_kernel = [this](BufferFloat2 uvs, BufferFloat emission, Float2 texel_density) noexcept {
+            auto i = dispatch_x();
+            auto uv0 = uvs.read(i * 3u + 0u);
+            auto uv1 = uvs.read(i * 3u + 1u);
+            auto uv2 = uvs.read(i * 3u + 2u);
+            // about one stratum per texel covered by the triangle
+            auto duv0 = (uv1 - uv0) * texel_density;
+            auto duv1 = (uv2 - uv0) * texel_density;
+            auto texels = .5f * abs(duv0.x * duv1.y - duv0.y * duv1.x);
+            auto n = clamp(cast<uint>(ceil(sqrt(texels))), 1u, max_emission_strata);
+            auto inv_n = 1.f / cast<float>(n);
+            auto swl = pipeline().spectrum()->sample(.5f);
+            auto sum = def(0.f);
+            $for(s, n * n) {
+                auto u = (make_float2(cast<float>(s % n), cast<float>(s / n)) + .5f) * inv_n;
+                auto b = sample_uniform_triangle(u);
+                Interaction it{b.x * uv0 + b.y * uv1 + b.z * uv2};
+                sum += max(_texture->evaluate_illuminant_spectrum(it, swl, 0.f).strength, 0.f);
+            };
+            emission.write(i, sum * sqr(inv_n) * node<DiffuseLight>()->scale());
+        };
+        _emission_shader.emplace(pipeline().device().compile(emission_kernel));
+    }
+    auto texel_density = _texture->node()->texel_density().value_or(make_float2(default_texel_density));
+    command_buffer << (*_emission_shader)(corner_uvs, emission, texel_density)
+                          .dispatch(static_cast<uint>(emission.size()));
+}
+
 luisa::unique_ptr<Light::Closure> DiffuseLightInstance::closure(
     const SampledWavelengths &swl, Expr<float> time) const noexcept {
     return luisa::make_unique<DiffuseLightClosure>(this, swl, time);
@@ -0,0 +1,103 @@
+#include <util/ies.h>
+#include <lights/punctual.h>
+
+namespace luisa::render {
+
+// Emits with the photometric profile in `file`, normalized to a peak of one and with the
+// nadir along the light direction. The azimuth is measured from the tangent that
+// Frame::make() picks for the direction.
+class IESLight final : public PunctualLight {
+
+public:
+    static constexpr auto profile_width = 512u; // azimuth
+    static constexpr auto profile_height = 256u;// angle from the nadir
+
+private:
+    luisa::vector<float> _profile;
+    float _profile_integral{0.f};
+    float _cos_max_angle{-1.f};
+
+public:
+    IESLight(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : PunctualLight{scene, desc} {
+        auto path = desc->property_path("file");
+        _profile = IESProfile::parse(path).resample(profile_width, profile_height);
+        auto peak = *std::max_element(_profile.cbegin(), _profile.cend());
+        if (!(peak > 0.f)) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "IES profile '{}' does not emit.",
+                path.string());
+            peak = 1.f;
+        }
+        auto last_row = 0u;
+        auto d_theta = pi / static_cast<float>(profile_height);
+        auto d_phi = 2.f * pi / static_cast<float>(profile_width);
+        for (auto y = 0u; y < profile_height; y++) {
+            auto sin_theta = std::sin((static_cast<float>(y) + .5f) * d_theta);
+            for (auto x = 0u; x < profile_width; x++) {
+                auto &&v = _profile[y * profile_width + x];
+                v = std::max(v / peak, 0.f);
+                _profile_integral += v * sin_theta * d_theta * d_phi;
+                if (v > 0.f) { last_row = y; }
+            }
+        }
+        // bilinear lookups reach up to the center of the next row
+        _cos_max_angle = std::cos(std::min(static_cast<float>(last_row + 2u) * d_theta, pi));
+    }
+    [[nodiscard]] auto profile() const noexcept { return luisa::span{_profile}; }
+    [[nodiscard]] bool is_null() const noexcept override { return _profile_integral == 0.f || PunctualLight::is_null(); }
+    [[nodiscard]] float profile_integral() const noexcept override { return _profile_integral; }
+    [[nodiscard]] float cos_max_angle() const noexcept override { return _cos_max_angle; }
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] luisa::unique_ptr<Instance> build(
+        Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+};
+
+class IESLightInstance final : public PunctualLightInstance {
+
+private:
+    uint _profile_buffer_id;
+    uint _profile_buffer_offset;// into the arena chunk bound at _profile_buffer_id
+
+public:
+    IESLightInstance(Pipeline &pipeline, const IESLight *light,
+                     CommandBuffer &command_buffer) noexcept
+        : PunctualLightInstance{pipeline, light, command_buffer} {
+        auto profile = light->profile();
+        auto [view, buffer_id, offset] = pipeline.bindless_arena_buffer<float>(profile.size());
+        _profile_buffer_id = buffer_id;
+        _profile_buffer_offset = offset;
+        command_buffer << view.copy_from(profile.data());
+    }
+    [[nodiscard]] Float profile(Expr<float3> w) const noexcept override {
+        constexpr auto width = IESLight::profile_width;
+        constexpr auto height = IESLight::profile_height;
+        auto buffer = pipeline().buffer<float>(_profile_buffer_id);
+        // bilinear, wrapping around in azimuth and clamping at the poles
+        auto st = direction_to_uv(w) * make_float2(static_cast<float>(width), static_cast<float>(height)) - .5f;
+        auto st0 = floor(st);
+        auto f = st - st0;
+        auto x0 = cast<uint>(cast<int>(st0.x) + static_cast<int>(width)) % width;
+        auto x1 = (x0 + 1u) % width;
+        auto y0 = cast<uint>(clamp(cast<int>(st0.y), 0, static_cast<int>(height) - 1));
+        auto y1 = cast<uint>(clamp(cast<int>(st0.y) + 1, 0, static_cast<int>(height) - 1));
+        auto v00 = buffer.read(_profile_buffer_offset + y0 * width + x0);
+        auto v01 = buffer.read(_profile_buffer_offset + y0 * width + x1);
+        auto v10 = buffer.read(_profile_buffer_offset + y1 * width + x0);
+        auto v11 = buffer.read(_profile_buffer_offset + y1 * width + x1);
+        return lerp(lerp(v00, v01, f.x), lerp(v10, v11, f.x), f.y);
+    }
+    [[nodiscard]] std::pair<Float3, Float> sample_direction(Expr<float2> u) const noexcept override {
+        auto cos_max = node<IESLight>()->cos_max_angle();
+        return std::make_pair(sample_uniform_cone(u, cos_max), uniform_cone_pdf(cos_max));
+    }
+};
+
+luisa::unique_ptr<Light::Instance> IESLight::build(
+    Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<IESLightInstance>(pipeline, this, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::IESLight)
@@ -0,0 +1,33 @@
+#include <lights/punctual.h>
+
+namespace luisa::render {
+
+// emits the same intensity in all directions
+class PointLight final : public PunctualLight {
+
+public:
+    PointLight(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : PunctualLight{scene, desc} {}
+    [[nodiscard]] float profile_integral() const noexcept override { return 4.f * pi; }
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] luisa::unique_ptr<Instance> build(
+        Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+};
+
+class PointLightInstance final : public PunctualLightInstance {
+
+public:
+    PointLightInstance(Pipeline &pipeline, const PointLight *light,
+                       CommandBuffer &command_buffer) noexcept
+        : PunctualLightInstance{pipeline, light, command_buffer} {}
+    [[nodiscard]] Float profile(Expr<float3> w) const noexcept override { return def(1.f); }
+};
+
+luisa::unique_ptr<Light::Instance> PointLight::build(
+    Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<PointLightInstance>(pipeline, this, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::PointLight)
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <util/sampling.h>
+#include <util/colorspace.h>
+#include <util/frame.h>
+#include <base/light.h>
+#include <base/interaction.h>
+#include <base/pipeline.h>
+#include <base/scene.h>
+
+namespace luisa::render {
+
+using namespace luisa::compute;
+
+// Base of the point, spot and IES lights, which emit from a single point with the
+// intensity (power per unit solid angle) of `emission` times `scale`, modulated by a
+// directional profile. The light sits at `position` and points along `direction`, both
+// in the space of the optional `transform`. The emission texture is looked up at the
+// equirectangular UV of the emitted direction around `direction`, so it can also act
+// as a goniometric map.
+class PunctualLight : public Light {
+
+private:
+    const Texture *_emission;
+    const Transform *_transform;
+    float3 _position;
+    float3 _direction;
+    float _scale;
+
+public:
+    PunctualLight(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : Light{scene, desc},
+          _emission{scene->load_texture(desc->property_node_or_default(
+              "emission", SceneNodeDesc::shared_default_texture("Constant")))},
+          _transform{scene->load_transform(desc->property_node_or_default("transform"))},
+          _position{desc->property_float3_or_default("position", make_float3(0.f))},
+          _direction{desc->property_float3_or_default("direction", make_float3(0.f, -1.f, 0.f))},
+          _scale{std::max(desc->property_float_or_default("scale", 1.f), 0.f)} {
+        if (!(length(_direction) > 0.f)) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Invalid direction of punctual light '{}'. "
+                "Falling back to (0, -1, 0).",
+                desc->identifier());
+            _direction = make_float3(0.f, -1.f, 0.f);
+        }
+        _direction = normalize(_direction);
+    }
+    [[nodiscard]] auto emission() const noexcept { return _emission; }
+    [[nodiscard]] auto transform() const noexcept { return _transform; }
+    [[nodiscard]] auto position() const noexcept { return _position; }
+    [[nodiscard]] auto direction() const noexcept { return _direction; }
+    [[nodiscard]] auto scale() const noexcept { return _scale; }
+    [[nodiscard]] bool is_punctual() const noexcept override { return true; }
+    [[nodiscard]] bool two_sided() const noexcept override { return false; }
+    [[nodiscard]] bool is_null() const noexcept override { return _scale == 0.f || _emission->is_black(); }
+    // average intensity before the profile is applied
+    [[nodiscard]] float emission_estimate() const noexcept override {
+        auto v = _emission->evaluate_average().value_or(make_float4(1.f));
+        auto I = _emission->channels() == 1u ? v.x : srgb_to_cie_y(make_float3(v.x, v.y, v.z));
+        return _scale * std::max(I, 0.f);
+    }
+    // integral of the profile over the unit sphere
+    [[nodiscard]] virtual float profile_integral() const noexcept = 0;
+    // cosine of the widest angle to `direction` with non-zero emission
+    [[nodiscard]] virtual float cos_max_angle() const noexcept { return -1.f; }
+    [[nodiscard]] LightBounds punctual_bounds(float time) const noexcept override {
+        auto m = _transform == nullptr ? make_float4x4(1.f) : _transform->matrix(time);
+        auto p = make_float3(m * make_float4(_position, 1.f));
+        auto w = make_float3x3(m) * _direction;
+        // the emission is not bounded any tighter beyond the cone
+        return {.p_min = p,
+                .p_max = p,
+                .axis = length(w) > 0.f ? normalize(w) : _direction,
+                .phi = emission_estimate() * profile_integral(),
+                .cos_theta_o = cos_max_angle(),
+                .cos_theta_e = 0.f,
+                .two_sided = false};
+    }
+};
+
+class PunctualLightInstance : public Light::Instance {
+
+private:
+    const Texture::Instance *_texture;
+
+public:
+    PunctualLightInstance(Pipeline &pipeline, const PunctualLight *light,
+                          CommandBuffer &command_buffer) noexcept
+        : Light::Instance{pipeline, light},
+          _texture{pipeline.build_texture(command_buffer, light->emission())} {
+        pipeline.register_transform(light->transform());
+    }
+    // profile in the direction w in the local frame, with +z along the light direction
+    [[nodiscard]] virtual Float profile(Expr<float3> w) const noexcept = 0;
+    // samples an emitted direction in the local frame with its solid-angle pdf
+    [[nodiscard]] virtual std::pair<Float3, Float> sample_direction(Expr<float2> u) const noexcept {
+        return std::make_pair(sample_uniform_sphere(u), def(uniform_sphere_pdf()));
+    }
+    [[nodiscard]] static Float2 direction_to_uv(Expr<float3> w) noexcept {
+        auto phi = atan2(w.y, w.x);
+        phi = ite(phi < 0.f, phi + 2.f * pi, phi);
+        return make_float2(phi * (.5f * inv_pi), acos(clamp(w.z, -1.f, 1.f)) * inv_pi);
+    }
+    // world-space position and local frame with the transform of the current update
+    [[nodiscard]] auto frame() const noexcept {
+        auto light = node<PunctualLight>();
+        auto m = pipeline().transform(light->transform());
+        auto p = make_float3(m * make_float4(light->position(), 1.f));
+        auto n = normalize(make_float3x3(m) * light->direction());
+        return std::make_pair(p, Frame::make(n));
+    }
+    [[nodiscard]] SampledSpectrum intensity(Expr<float3> w, const SampledWavelengths &swl,
+                                            Expr<float> time) const noexcept {
+        Interaction it{direction_to_uv(w)};
+        auto I = _texture->evaluate_illuminant_spectrum(it, swl, time).value;
+        return I * (node<PunctualLight>()->scale() * profile(w));
+    }
+    [[nodiscard]] luisa::unique_ptr<Light::Closure> closure(
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override;
+};
+
+class PunctualLightClosure final : public Light::Closure {
+
+public:
+    PunctualLightClosure(const PunctualLightInstance *light,
+                         const SampledWavelengths &swl,
+                         Expr<float> time) noexcept
+        : Light::Closure{light, swl, time} {}
+
+    // punctual lights are never hit
+    [[nodiscard]] Light::Evaluation evaluate(const Interaction &it_light,
+                                             Expr<float3> p_from) const noexcept override {
+        return Light::Evaluation::zero(swl().dimension());
+    }
+
+    [[nodiscard]] Light::Sample sample(Expr<uint> light_inst_id,
+                                       Expr<float3> p_from,
+                                       Expr<float2> u) const noexcept override {
+        auto s = Light::Sample::zero(swl().dimension());
+        $outline {
+            auto light = instance<PunctualLightInstance>();
+            auto [p, frame] = light->frame();
+            auto d = p_from - p;
+            auto d2 = length_squared(d);
+            auto wo = normalize(d);
+            auto I = light->intensity(frame.world_to_local(wo), swl(), time());
+            auto valid = d2 > 0.f;
+            // the position is a delta distribution
+            s = {.eval = {.L = ite(valid, I / d2, 0.f),
+                          .pdf = ite(valid, 1.f, 0.f),
+                          .p = p,
+                          .ng = wo},
+                 .p = p,
+                 .delta = true};
+        };
+        return s;
+    }
+
+    [[nodiscard]] std::pair<Light::Sample, Var<Ray>> sample_le(Expr<uint> light_inst_id,
+                                                               Expr<float2> u_light,
+                                                               Expr<float2> u_direction) const noexcept override {
+        auto s = Light::Sample::zero(swl().dimension());
+        auto ray = def<Ray>();
+        $outline {
+            auto light = instance<PunctualLightInstance>();
+            auto [p, frame] = light->frame();
+            auto [w, pdf] = light->sample_direction(u_direction);
+            auto we = frame.local_to_world(w);
+            s = {.eval = {.L = light->intensity(w, swl(), time()),
+                          .pdf = pdf,
+                          .p = p,
+                          .ng = we},
+                 .p = p,
+                 .delta = true};
+            ray = make_ray(p, we);
+        };
+        return {s, ray};
+    }
+};
+
+inline luisa::unique_ptr<Light::Closure> PunctualLightInstance::closure(
+    const SampledWavelengths &swl, Expr<float> time) const noexcept {
+    return luisa::make_unique<PunctualLightClosure>(this, swl, time);
+}
+
+}// namespace luisa::render
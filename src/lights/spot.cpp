@@ -0,0 +1,62 @@
+#include <numbers>
+
+#include <lights/punctual.h>
+
+namespace luisa::render {
+
+// Emits into a cone of apex `angle` around the light direction, with the intensity
+// smoothly falling off to zero over the outermost `falloff`, both in degrees.
+class SpotLight final : public PunctualLight {
+
+private:
+    float _cos_falloff_start;
+    float _cos_total_width;
+
+public:
+    SpotLight(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : PunctualLight{scene, desc} {
+        auto half_angle = .5f * std::clamp(desc->property_float_or_default("angle", 60.f), 1e-3f, 360.f);
+        auto falloff = std::clamp(desc->property_float_or_default("falloff", 5.f), 0.f, half_angle);
+        constexpr auto deg = std::numbers::pi_v<float> / 180.f;
+        _cos_total_width = std::cos(half_angle * deg);
+        _cos_falloff_start = std::cos((half_angle - falloff) * deg);
+    }
+    [[nodiscard]] auto cos_falloff_start() const noexcept { return _cos_falloff_start; }
+    [[nodiscard]] auto cos_total_width() const noexcept { return _cos_total_width; }
+    [[nodiscard]] float profile_integral() const noexcept override {
+        return 2.f * pi * ((1.f - _cos_falloff_start) + .5f * (_cos_falloff_start - _cos_total_width));
+    }
+    [[nodiscard]] float cos_max_angle() const noexcept override { return _cos_total_width; }
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] luisa::unique_ptr<Instance> build(
+        Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+};
+
+class SpotLightInstance final : public PunctualLightInstance {
+
+public:
+    SpotLightInstance(Pipeline &pipeline, const SpotLight *light,
+                      CommandBuffer &command_buffer) noexcept
+        : PunctualLightInstance{pipeline, light, command_buffer} {}
+    [[nodiscard]] Float profile(Expr<float3> w) const noexcept override {
+        auto light = node<SpotLight>();
+        auto cos_start = light->cos_falloff_start();
+        auto cos_total = light->cos_total_width();
+        // smoothstep over the falloff, or a hard edge without one
+        auto t = clamp((w.z - cos_total) / std::max(cos_start - cos_total, 1e-6f), 0.f, 1.f);
+        return t * t * (3.f - 2.f * t);
+    }
+    [[nodiscard]] std::pair<Float3, Float> sample_direction(Expr<float2> u) const noexcept override {
+        auto cos_total = node<SpotLight>()->cos_total_width();
+        return std::make_pair(sample_uniform_cone(u, cos_total), uniform_cone_pdf(cos_total));
+    }
+};
+
+luisa::unique_ptr<Light::Instance> SpotLight::build(
+    Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<SpotLightInstance>(pipeline, this, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::SpotLight)
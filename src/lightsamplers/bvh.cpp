@@ -0,0 +1,345 @@
+#include <core/clock.h>
+#include <util/sampling.h>
+#include <util/thread_pool.h>
+#include <util/light_tree.h>
+#include <base/light_sampler.h>
+#include <base/pipeline.h>
+
+namespace luisa::render {
+
+using namespace luisa::compute;
+
+class BVHLightSampler final : public LightSampler {
+
+private:
+    float _environment_weight{.5f};
+
+public:
+    BVHLightSampler(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : LightSampler{scene, desc},
+          _environment_weight{desc->property_float_or_default("environment_weight", 0.5f)} {}
+    [[nodiscard]] luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] auto environment_weight() const noexcept { return _environment_weight; }
+};
+
+// Selection with a shading point traverses a BVH over all emissive triangles and
+// punctual lights, and returns the index of the chosen leaf node as the tag. Selection
+// without one (for light tracing) picks a light instance in proportion to its power
+// instead, with the index into Geometry::light_instances() as the tag, so that the
+// light's own emission sampling applies. The importance only depends on the shading position, as the normal
+// is unavailable in evaluate_hit() and the probabilities must match for MIS.
+class BVHLightSamplerInstance final : public LightSampler::Instance {
+
+private:
+    static constexpr auto one_minus_epsilon = 0x1.fffffep-1f;
+
+private:
+    // bindless arena buffers, read at their offsets into the shared chunks
+    uint _light_buffer_id{0u};
+    uint _light_buffer_offset{0u};
+    uint _node_buffer_id{0u};
+    uint _node_buffer_offset{0u};
+    uint _instance_offset_buffer_id{0u};// first leaf table entry of each instance
+    uint _instance_offset_buffer_offset{0u};
+    uint _leaf_buffer_id{0u};// leaf node of each emissive triangle, ~0u if not in the tree
+    uint _leaf_buffer_offset{0u};
+    uint _power_alias_buffer_id{0u};
+    uint _power_alias_buffer_offset{0u};
+    uint _power_pdf_buffer_id{0u};
+    uint _power_pdf_buffer_offset{0u};
+    float _env_prob{0.f};
+    bool _any_punctual{false};
+
+private:
+    void _build(Pipeline &pipeline, CommandBuffer &command_buffer) noexcept;
+
+public:
+    BVHLightSamplerInstance(const BVHLightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept
+        : LightSampler::Instance{pipeline, sampler} {
+        if (!pipeline.lights().empty()) { _build(pipeline, command_buffer); }
+        if (auto env = pipeline.environment()) {
+            if (pipeline.lights().empty()) {
+                _env_prob = 1.f;
+            } else {
+                _env_prob = std::clamp(
+                    sampler->environment_weight(), 0.01f, 0.99f);
+            }
+        }
+    }
+
+private:
+    [[nodiscard]] LightSampler::Selection _select_bvh(Expr<float3> p, Expr<float> u) const noexcept {
+        auto nodes = pipeline().buffer<LightTreeNode>(_node_buffer_id);
+        auto [node_index, prob, _] = sample_light_tree(nodes, p, false, u, _node_buffer_offset);
+        return {.tag = node_index, .prob = prob};
+    }
+
+    // probability of _select_bvh() choosing the triangle
+    [[nodiscard]] Float _pmf_bvh(Expr<float3> p, Expr<uint> instance_id, Expr<uint> triangle_id) const noexcept {
+        auto nodes = pipeline().buffer<LightTreeNode>(_node_buffer_id);
+        auto offset = pipeline().buffer<uint>(_instance_offset_buffer_id).read(_instance_offset_buffer_offset + instance_id);
+        auto leaf = pipeline().buffer<uint>(_leaf_buffer_id).read(_leaf_buffer_offset + offset + triangle_id);
+        auto prob = def(0.f);
+        $if(leaf != ~0u) { prob = pmf_light_tree(nodes, p, false, leaf, _node_buffer_offset); };
+        return prob;
+    }
+
+    // solid-angle pdf of uniformly sampling the triangle
+    [[nodiscard]] static Float _triangle_pdf(const Interaction &it_light, Expr<float3> p_from) noexcept {
+        auto cos_wo = abs_dot(normalize(p_from - it_light.p()), it_light.ng());
+        return ite(cos_wo > 1e-6f,
+                   distance_squared(it_light.p(), p_from) / (it_light.triangle_area() * cos_wo),
+                   0.f);
+    }
+
+public:
+    [[nodiscard]] Light::Evaluation evaluate_hit(
+        const Interaction &it, Expr<float3> p_from,
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        auto eval = Light::Evaluation::zero(swl.dimension());
+        if (pipeline().lights().empty()) [[unlikely]] {// no lights
+            LUISA_WARNING_WITH_LOCATION("No lights in scene.");
+            return eval;
+        }
+        pipeline().lights().dispatch(it.shape().light_tag(), [&](auto light) noexcept {
+            auto closure = light->closure(swl, time);
+            eval = closure->evaluate(it, p_from);
+        });
+        // the light evaluates the pdf of its own area sampling, replace it with ours
+        auto pmf = _pmf_bvh(p_from, it.instance_id(), it.triangle_id());
+        eval.pdf = ite(eval.pdf > 0.f, _triangle_pdf(it, p_from) * pmf * (1.f - _env_prob), 0.f);
+        return eval;
+    }
+
+    [[nodiscard]] Light::Evaluation evaluate_miss(
+        Expr<float3> wi, const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        if (_env_prob == 0.f) [[unlikely]] {// no environment
+            LUISA_WARNING_WITH_LOCATION("No environment in scene");
+            return {.L = SampledSpectrum{swl.dimension()}, .pdf = 0.f};
+        }
+        auto eval = pipeline().environment()->evaluate(wi, swl, time);
+        eval.pdf *= _env_prob;
+        return eval;
+    }
+
+    [[nodiscard]] LightSampler::Selection select(
+        const Interaction &it_from, Expr<float> u,
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        LUISA_ASSERT(pipeline().has_lighting(), "No lights in scene.");
+        if (_env_prob == 1.f) { return {.tag = LightSampler::selection_environment, .prob = 1.f}; }
+        if (_env_prob == 0.f) { return _select_bvh(it_from.p_shading(), u); }
+        auto uu = min((u - _env_prob) / (1.f - _env_prob), one_minus_epsilon);
+        auto is_env = u < _env_prob;
+        auto sel = LightSampler::Selection{.tag = LightSampler::selection_environment, .prob = _env_prob};
+        $if(!is_env) {
+            auto s = _select_bvh(it_from.p_shading(), uu);
+            sel.tag = s.tag;
+            sel.prob = s.prob * (1.f - _env_prob);
+        };
+        return sel;
+    }
+
+    [[nodiscard]] LightSampler::Selection select(
+        Expr<float> u,
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        LUISA_ASSERT(pipeline().has_lighting(), "No lights in scene.");
+        if (_env_prob == 1.f) { return {.tag = LightSampler::selection_environment, .prob = 1.f}; }
+        auto n = static_cast<uint>(pipeline().geometry()->light_instances().size());
+        auto select_power = [&](Expr<float> u) noexcept {
+            auto [tag, _] = sample_alias_table(
+                pipeline().buffer<AliasEntry>(_power_alias_buffer_id), n, u, _power_alias_buffer_offset);
+            auto prob = pipeline().buffer<float>(_power_pdf_buffer_id).read(_power_pdf_buffer_offset + tag);
+            return LightSampler::Selection{.tag = tag, .prob = prob};
+        };
+        if (_env_prob == 0.f) { return select_power(u); }
+        auto uu = min((u - _env_prob) / (1.f - _env_prob), one_minus_epsilon);
+        auto s = select_power(uu);
+        auto is_env = u < _env_prob;
+        return {.tag = ite(is_env, LightSampler::selection_environment, s.tag),
+                .prob = ite(is_env, _env_prob, s.prob * (1.f - _env_prob))};
+    }
+
+private:
+    [[nodiscard]] Light::Sample _sample_light(const Interaction &it_from,
+                                              Expr<uint> tag, Expr<float2> u,
+                                              const SampledWavelengths &swl,
+                                              Expr<float> time) const noexcept override {
+        LUISA_ASSERT(!pipeline().lights().empty(), "No lights in the scene.");
+        auto node = pipeline().buffer<LightTreeNode>(_node_buffer_id).read(_node_buffer_offset + tag);
+        auto sample_triangle = [&] {
+            auto instance_id = node.index;
+            auto triangle_id = node.triangle;
+            auto light_inst = pipeline().geometry()->instance(instance_id);
+            auto light_to_world = pipeline().geometry()->instance_to_world(instance_id, time);
+            auto triangle = pipeline().geometry()->triangle(light_inst, triangle_id);
+            auto uvw = sample_uniform_triangle(u);
+            auto attrib = pipeline().geometry()->shading_point(light_inst, triangle, uvw, light_to_world);
+            auto p_from = it_from.p_shading();
+            Interaction it{std::move(light_inst), instance_id, triangle_id, attrib,
+                           dot(attrib.g.n, p_from - attrib.g.p) < 0.f};
+            auto eval = Light::Evaluation::zero(swl.dimension());
+            pipeline().lights().dispatch(it.shape().light_tag(), [&](auto light) noexcept {
+                auto closure = light->closure(swl, time);
+                eval = closure->evaluate(it, p_from);
+            });
+            eval.pdf = ite(eval.pdf > 0.f, _triangle_pdf(it, p_from), 0.f);
+            return Light::Sample{.eval = std::move(eval), .p = it.p(), .delta = false};
+        };
+        if (!_any_punctual) { return sample_triangle(); }
+        // punctual leaves keep the light tag in place of the triangle
+        auto s = Light::Sample::zero(swl.dimension());
+        $if(node.index == Light::Handle::punctual_instance) {
+            pipeline().lights().dispatch(node.triangle, [&](auto light) noexcept {
+                auto closure = light->closure(swl, time);
+                s = closure->sample(node.index, it_from.p_shading(), u);
+            });
+        }
+        $else { s = sample_triangle(); };
+        return s;
+    }
+
+    [[nodiscard]] Environment::Sample _sample_environment(Expr<float2> u,
+                                                          const SampledWavelengths &swl,
+                                                          Expr<float> time) const noexcept override {
+        LUISA_ASSERT(pipeline().environment() != nullptr, "No environment in the scene.");
+        return pipeline().environment()->sample(swl, time, u);
+    }
+
+    [[nodiscard]] LightSampler::Sample _sample_light_le(
+        Expr<uint> tag, Expr<float2> u_light, Expr<float2> u_direction,
+        const SampledWavelengths &swl,
+        Expr<float> time) const noexcept override {
+        LUISA_ASSERT(!pipeline().lights().empty(), "No lights in the scene.");
+        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(_light_buffer_offset + tag);
+        auto sp = Light::Sample::zero(swl.dimension());
+        Var<Ray> shadow_ray{};
+        pipeline().lights().dispatch(handle.light_tag, [&](auto light) noexcept {
+            auto closure = light->closure(swl, time);
+            auto [sp_tp, ray_tp] = closure->sample_le(handle.instance_id, u_light, u_direction);
+            sp = sp_tp;
+            shadow_ray = ray_tp;
+        });
+        return {.eval = sp.eval, .shadow_ray = shadow_ray, .delta = sp.delta};
+    }
+};
+
+void BVHLightSamplerInstance::_build(Pipeline &pipeline, CommandBuffer &command_buffer) noexcept {
+    Clock clock;
+    auto geometry = pipeline.geometry();
+    auto light_instances = geometry->light_instances();
+    auto light_meshes = geometry->light_mesh_instances();
+    // emissive triangles in world space at the initial time
+    luisa::vector<uint> instance_offsets(geometry->instances().size(), 0u);
+    auto triangle_count = 0u;
+    auto any_dynamic = false;
+    for (auto i = 0u; i < light_meshes.size(); i++) {
+        instance_offsets[light_instances[i].instance_id] = triangle_count;
+        triangle_count += static_cast<uint>(light_meshes[i].shape->mesh().triangles.size());
+        any_dynamic |= light_meshes[i].dynamic || light_meshes[i].shape->deformable();
+    }
+    if (any_dynamic) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "The light BVH is built with the initial poses of moving "
+            "or deforming lights. Direct lighting might be biased.");
+    }
+    // radiance per light for untextured emitters, evaluated once as it may average textures
+    luisa::vector<float> light_radiance(pipeline.lights().size());
+    for (auto i = 0u; i < light_radiance.size(); i++) {
+        auto light = pipeline.lights().impl(i)->node();
+        light_radiance[i] = light->emission_estimate() * (light->two_sided() ? 2.f : 1.f) * pi;
+    }
+    luisa::vector<LightTreePrimitive> primitives(triangle_count);
+    luisa::vector<float> instance_powers(light_instances.size());
+    // punctual lights follow the emissive instances, with the light tag in place of the triangle
+    for (auto i = light_meshes.size(); i < light_instances.size(); i++) {
+        auto tag = light_instances[i].light_tag;
+        auto bounds = pipeline.lights().impl(tag)->node()->punctual_bounds(pipeline.initial_time());
+        primitives.emplace_back(LightTreePrimitive{
+            .bounds = bounds, .instance = Light::Handle::punctual_instance, .triangle = tag});
+        instance_powers[i] = bounds.phi;
+        _any_punctual = true;
+    }
+    global_thread_pool().parallel(light_meshes.size(), [&](auto i) noexcept {
+        auto handle = light_instances[i];
+        auto two_sided = pipeline.lights().impl(handle.light_tag)->node()->two_sided();
+        auto radiance = light_radiance[handle.light_tag];
+        // textured emitters reuse the per-triangle emission of their sampling tables
+        auto emission = geometry->triangle_emission(light_meshes[i].shape);
+        auto emission_scale = (two_sided ? 2.f : 1.f) * pi;
+        auto m = light_meshes[i].object_to_world;
+        auto [vertices, triangles] = light_meshes[i].shape->mesh();
+        auto offset = instance_offsets[handle.instance_id];
+        auto power = 0.f;
+        for (auto j = 0u; j < triangles.size(); j++) {
+            auto t = triangles[j];
+            auto p0 = make_float3(m * make_float4(vertices[t.i0].position(), 1.f));
+            auto p1 = make_float3(m * make_float4(vertices[t.i1].position(), 1.f));
+            auto p2 = make_float3(m * make_float4(vertices[t.i2].position(), 1.f));
+            auto &&prim = primitives[offset + j];
+            prim.bounds = light_bounds_triangle(p0, p1, p2, emission.empty() ? radiance : emission[j] * emission_scale);
+            prim.bounds.two_sided = two_sided;
+            prim.instance = handle.instance_id;
+            prim.triangle = j;
+            power += prim.bounds.phi;
+        }
+        instance_powers[i] = power;
+    });
+    global_thread_pool().synchronize();
+    // emitters without power are left out of the tree
+    auto nodes = build_light_tree(primitives);
+    primitives = {};
+    if (nodes.empty()) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION("No emissive triangles or punctual lights with non-zero power.");
+    }
+    // kept non-empty for scenes lit by punctual lights only
+    luisa::vector<uint> leaves(std::max(triangle_count, 1u), ~0u);
+    auto emitter_count = 0u;
+    for (auto i = 0u; i < nodes.size(); i++) {
+        if (auto &&node = nodes[i]; node.flags & LightTreeNode::flag_leaf) {
+            if (node.index != Light::Handle::punctual_instance) {
+                leaves[instance_offsets[node.index] + node.triangle] = i;
+            }
+            emitter_count++;
+        }
+    }
+    // upload
+    auto [light_view, light_buffer_id, light_buffer_offset] = pipeline.bindless_arena_buffer<Light::Handle>(light_instances.size());
+    auto [node_view, node_buffer_id, node_buffer_offset] = pipeline.bindless_arena_buffer<LightTreeNode>(nodes.size());
+    auto [offset_view, offset_buffer_id, offset_buffer_offset] = pipeline.bindless_arena_buffer<uint>(instance_offsets.size());
+    auto [leaf_view, leaf_buffer_id, leaf_buffer_offset] = pipeline.bindless_arena_buffer<uint>(leaves.size());
+    auto [power_alias_table, power_pdf] = create_alias_table(instance_powers);
+    auto [alias_view, alias_buffer_id, alias_buffer_offset] = pipeline.bindless_arena_buffer<AliasEntry>(power_alias_table.size());
+    auto [pdf_view, pdf_buffer_id, pdf_buffer_offset] = pipeline.bindless_arena_buffer<float>(power_pdf.size());
+    _light_buffer_id = light_buffer_id;
+    _light_buffer_offset = light_buffer_offset;
+    _node_buffer_id = node_buffer_id;
+    _node_buffer_offset = node_buffer_offset;
+    _instance_offset_buffer_id = offset_buffer_id;
+    _instance_offset_buffer_offset = offset_buffer_offset;
+    _leaf_buffer_id = leaf_buffer_id;
+    _leaf_buffer_offset = leaf_buffer_offset;
+    _power_alias_buffer_id = alias_buffer_id;
+    _power_alias_buffer_offset = alias_buffer_offset;
+    _power_pdf_buffer_id = pdf_buffer_id;
+    _power_pdf_buffer_offset = pdf_buffer_offset;
+    command_buffer << light_view.copy_from(light_instances.data())
+                   << node_view.copy_from(nodes.data())
+                   << offset_view.copy_from(instance_offsets.data())
+                   << leaf_view.copy_from(leaves.data())
+                   << alias_view.copy_from(power_alias_table.data())
+                   << pdf_view.copy_from(power_pdf.data())
+                   << compute::commit();
+    LUISA_INFO("Built light BVH with {} nodes over {} emitters in {} ms.",
+               nodes.size(), emitter_count, clock.toc());
+}
+
+unique_ptr<LightSampler::Instance> BVHLightSampler::build(
+    Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<BVHLightSamplerInstance>(
+        this, pipeline, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::BVHLightSampler)
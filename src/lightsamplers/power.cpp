@@ -0,0 +1,216 @@
+#include <util/sampling.h>
+#include <util/thread_pool.h>
+#include <base/light_sampler.h>
+#include <base/pipeline.h>
+
+namespace luisa::render {
+
+class PowerLightSampler final : public LightSampler {
+
+private:
+    float _environment_weight{.5f};
+
+public:
+    PowerLightSampler(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : LightSampler{scene, desc},
+          _environment_weight{desc->property_float_or_default("environment_weight", 0.5f)} {}
+    [[nodiscard]] luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] auto environment_weight() const noexcept { return _environment_weight; }
+};
+
+// selects light instances in proportion to their emitted power, i.e., the average
+// emission times the world-space surface area, or the flux of punctual lights
+class PowerLightSamplerInstance final : public LightSampler::Instance {
+
+private:
+    // bindless arena buffers, read at their offsets into the shared chunks
+    uint _light_buffer_id{0u};
+    uint _light_buffer_offset{0u};
+    uint _alias_buffer_id{0u};
+    uint _alias_buffer_offset{0u};
+    uint _pdf_buffer_id{0u};
+    uint _pdf_buffer_offset{0u};
+    uint _instance_pdf_buffer_id{0u};// selection pdf indexed by instance id
+    uint _instance_pdf_buffer_offset{0u};
+    float _env_prob{0.f};
+
+private:
+    void _build(Pipeline &pipeline, CommandBuffer &command_buffer) noexcept;
+
+public:
+    PowerLightSamplerInstance(const PowerLightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept
+        : LightSampler::Instance{pipeline, sampler} {
+        if (!pipeline.lights().empty()) { _build(pipeline, command_buffer); }
+        if (auto env = pipeline.environment()) {
+            if (pipeline.lights().empty()) {
+                _env_prob = 1.f;
+            } else {
+                _env_prob = std::clamp(
+                    sampler->environment_weight(), 0.01f, 0.99f);
+            }
+        }
+    }
+
+    [[nodiscard]] Light::Evaluation evaluate_hit(
+        const Interaction &it, Expr<float3> p_from,
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        auto eval = Light::Evaluation::zero(swl.dimension());
+        if (pipeline().lights().empty()) [[unlikely]] {// no lights
+            LUISA_WARNING_WITH_LOCATION("No lights in scene.");
+            return eval;
+        }
+        pipeline().lights().dispatch(it.shape().light_tag(), [&](auto light) noexcept {
+            auto closure = light->closure(swl, time);
+            eval = closure->evaluate(it, p_from);
+        });
+        auto pdf = pipeline().buffer<float>(_instance_pdf_buffer_id).read(_instance_pdf_buffer_offset + it.instance_id());
+        eval.pdf *= (1.f - _env_prob) * pdf;
+        return eval;
+    }
+
+    [[nodiscard]] Light::Evaluation evaluate_miss(
+        Expr<float3> wi, const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        if (_env_prob == 0.f) [[unlikely]] {// no environment
+            LUISA_WARNING_WITH_LOCATION("No environment in scene");
+            return {.L = SampledSpectrum{swl.dimension()}, .pdf = 0.f};
+        }
+        auto eval = pipeline().environment()->evaluate(wi, swl, time);
+        eval.pdf *= _env_prob;
+        return eval;
+    }
+
+    [[nodiscard]] LightSampler::Selection select(
+        const Interaction &it_from, Expr<float> u,
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        return select(u, swl, time);
+    }
+
+    [[nodiscard]] LightSampler::Selection select(
+        Expr<float> u,
+        const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        LUISA_ASSERT(pipeline().has_lighting(), "No lights in scene.");
+        if (_env_prob == 1.f) { return {.tag = LightSampler::selection_environment, .prob = 1.f}; }
+        auto n = static_cast<uint>(pipeline().geometry()->light_instances().size());
+        auto select_light = [&](Expr<float> u) noexcept {
+            auto [tag, _] = sample_alias_table(
+                pipeline().buffer<AliasEntry>(_alias_buffer_id), n, u, _alias_buffer_offset);
+            auto prob = pipeline().buffer<float>(_pdf_buffer_id).read(_pdf_buffer_offset + tag);
+            return LightSampler::Selection{.tag = tag, .prob = prob};
+        };
+        if (_env_prob == 0.f) { return select_light(u); }
+        auto uu = clamp((u - _env_prob) / (1.f - _env_prob), 0.f, 1.f);
+        auto s = select_light(uu);
+        auto is_env = u < _env_prob;
+        return {.tag = ite(is_env, LightSampler::selection_environment, s.tag),
+                .prob = ite(is_env, _env_prob, s.prob * (1.f - _env_prob))};
+    }
+
+private:
+    [[nodiscard]] Light::Sample _sample_light(const Interaction &it_from,
+                                              Expr<uint> tag, Expr<float2> u,
+                                              const SampledWavelengths &swl,
+                                              Expr<float> time) const noexcept override {
+        LUISA_ASSERT(!pipeline().lights().empty(), "No lights in the scene.");
+        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(_light_buffer_offset + tag);
+        auto s = Light::Sample::zero(swl.dimension());
+        pipeline().lights().dispatch(handle.light_tag, [&](auto light) noexcept {
+            auto closure = light->closure(swl, time);
+            s = closure->sample(handle.instance_id, it_from.p_shading(), u);
+        });
+        return s;
+    }
+
+    [[nodiscard]] Environment::Sample _sample_environment(Expr<float2> u,
+                                                          const SampledWavelengths &swl,
+                                                          Expr<float> time) const noexcept override {
+        LUISA_ASSERT(pipeline().environment() != nullptr, "No environment in the scene.");
+        return pipeline().environment()->sample(swl, time, u);
+    }
+
+    [[nodiscard]] LightSampler::Sample _sample_light_le(
+        Expr<uint> tag, Expr<float2> u_light, Expr<float2> u_direction,
+        const SampledWavelengths &swl,
+        Expr<float> time) const noexcept override {
+        LUISA_ASSERT(!pipeline().lights().empty(), "No lights in the scene.");
+        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(_light_buffer_offset + tag);
+        auto sp = Light::Sample::zero(swl.dimension());
+        Var<Ray> shadow_ray{};
+        pipeline().lights().dispatch(handle.light_tag, [&](auto light) noexcept {
+            auto closure = light->closure(swl, time);
+            auto [sp_tp, ray_tp] = closure->sample_le(handle.instance_id, u_light, u_direction);
+            sp = sp_tp;
+            shadow_ray = ray_tp;
+        });
+        return {.eval = sp.eval, .shadow_ray = shadow_ray, .delta = sp.delta};
+    }
+};
+
+void PowerLightSamplerInstance::_build(Pipeline &pipeline, CommandBuffer &command_buffer) noexcept {
+    auto geometry = pipeline.geometry();
+    auto light_instances = geometry->light_instances();
+    auto light_meshes = geometry->light_mesh_instances();
+    // radiance per light, evaluated once as it may average textures
+    luisa::vector<float> radiance(pipeline.lights().size());
+    for (auto i = 0u; i < radiance.size(); i++) {
+        auto light = pipeline.lights().impl(i)->node();
+        radiance[i] = light->emission_estimate() * (light->two_sided() ? 2.f : 1.f) * pi;
+    }
+    luisa::vector<float> powers(light_instances.size());
+    // punctual lights follow the emissive instances and have no area
+    for (auto i = light_meshes.size(); i < light_instances.size(); i++) {
+        auto light = pipeline.lights().impl(light_instances[i].light_tag)->node();
+        powers[i] = light->punctual_bounds(pipeline.initial_time()).phi;
+    }
+    global_thread_pool().parallel(light_meshes.size(), [&](auto i) noexcept {
+        auto m = light_meshes[i].object_to_world;
+        auto [vertices, triangles] = light_meshes[i].shape->mesh();
+        auto area = 0.f;
+        for (auto t : triangles) {
+            auto p0 = make_float3(m * make_float4(vertices[t.i0].position(), 1.f));
+            auto p1 = make_float3(m * make_float4(vertices[t.i1].position(), 1.f));
+            auto p2 = make_float3(m * make_float4(vertices[t.i2].position(), 1.f));
+            area += .5f * length(cross(p1 - p0, p2 - p0));
+        }
+        powers[i] = radiance[light_instances[i].light_tag] * area;
+    });
+    global_thread_pool().synchronize();
+    if (std::all_of(powers.cbegin(), powers.cend(), [](auto p) noexcept { return p == 0.f; })) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "All lights have zero estimated power. "
+            "Falling back to uniform selection.");
+        std::fill(powers.begin(), powers.end(), 1.f);
+    }
+    auto [alias_table, pdf] = create_alias_table(powers);
+    luisa::vector<float> instance_pdf(geometry->instances().size(), 0.f);
+    for (auto i = 0u; i < light_meshes.size(); i++) {
+        instance_pdf[light_instances[i].instance_id] = pdf[i];
+    }
+    auto [light_view, light_buffer_id, light_buffer_offset] = pipeline.bindless_arena_buffer<Light::Handle>(light_instances.size());
+    auto [alias_view, alias_buffer_id, alias_buffer_offset] = pipeline.bindless_arena_buffer<AliasEntry>(alias_table.size());
+    auto [pdf_view, pdf_buffer_id, pdf_buffer_offset] = pipeline.bindless_arena_buffer<float>(pdf.size());
+    auto [instance_pdf_view, instance_pdf_buffer_id, instance_pdf_buffer_offset] = pipeline.bindless_arena_buffer<float>(instance_pdf.size());
+    _light_buffer_id = light_buffer_id;
+    _light_buffer_offset = light_buffer_offset;
+    _alias_buffer_id = alias_buffer_id;
+    _alias_buffer_offset = alias_buffer_offset;
+    _pdf_buffer_id = pdf_buffer_id;
+    _pdf_buffer_offset = pdf_buffer_offset;
+    _instance_pdf_buffer_id = instance_pdf_buffer_id;
+    _instance_pdf_buffer_offset = instance_pdf_buffer_offset;
+    command_buffer << light_view.copy_from(light_instances.data())
+                   << alias_view.copy_from(alias_table.data())
+                   << pdf_view.copy_from(pdf.data())
+                   << instance_pdf_view.copy_from(instance_pdf.data())
+                   << compute::commit();
+}
+
+unique_ptr<LightSampler::Instance> PowerLightSampler::build(
+    Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<PowerLightSamplerInstance>(
+        this, pipeline, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::PowerLightSampler)
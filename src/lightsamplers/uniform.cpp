@@ -26,15 +26,18 @@ class UniformLightSamplerInstance final : public LightSampler::Instance {
 
 private:
     uint _light_buffer_id{0u};
+    uint _light_buffer_offset{0u};// into the arena chunk bound at _light_buffer_id
     float _env_prob{0.f};
 
 public:
     UniformLightSamplerInstance(const UniformLightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept
         : LightSampler::Instance{pipeline, sampler} {
         if (!pipeline.lights().empty()) {
-            auto [view, buffer_id] = pipeline.bindless_arena_buffer<Light::Handle>(pipeline.lights().size());
+            auto light_instances = pipeline.geometry()->light_instances();
+            auto [view, buffer_id, offset] = pipeline.bindless_arena_buffer<Light::Handle>(light_instances.size());
             _light_buffer_id = buffer_id;
-            command_buffer << view.copy_from(pipeline.geometry()->light_instances().data())
+            _light_buffer_offset = offset;
+            command_buffer << view.copy_from(light_instances.data())
                            << compute::commit();
         }
         if (auto env = pipeline.environment()) {
@@ -59,7 +62,7 @@ public:
             auto closure = light->closure(swl, time);
             eval = closure->evaluate(it, p_from);
         });
-        auto n = static_cast<float>(pipeline().lights().size());
+        auto n = static_cast<float>(pipeline().geometry()->light_instances().size());
         eval.pdf *= (1.f - _env_prob) / n;
         return eval;
     }
@@ -79,7 +82,7 @@ public:
         const Interaction &it_from, Expr<float> u,
         const SampledWavelengths &swl, Expr<float> time) const noexcept override {
         LUISA_ASSERT(pipeline().has_lighting(), "No lights in scene.");
-        auto n = static_cast<float>(pipeline().lights().size());
+        auto n = static_cast<float>(pipeline().geometry()->light_instances().size());
         if (_env_prob == 1.f) { return {.tag = LightSampler::selection_environment, .prob = 1.f}; }
         if (_env_prob == 0.f) { return {.tag = cast<uint>(clamp(u * n, 0.f, n - 1.f)), .prob = 1.f / n}; }
         auto uu = (u - _env_prob) / (1.f - _env_prob);
@@ -92,7 +95,7 @@ public:
         Expr<float> u,
         const SampledWavelengths &swl, Expr<float> time) const noexcept override {
         LUISA_ASSERT(pipeline().has_lighting(), "No lights in scene.");
-        auto n = static_cast<float>(pipeline().lights().size());
+        auto n = static_cast<float>(pipeline().geometry()->light_instances().size());
         if (_env_prob == 1.f) { return {.tag = LightSampler::selection_environment, .prob = 1.f}; }
         if (_env_prob == 0.f) { return {.tag = cast<uint>(clamp(u * n, 0.f, n - 1.f)), .prob = 1.f / n}; }
         auto uu = (u - _env_prob) / (1.f - _env_prob);
@@ -104,36 +107,18 @@ public:
 
 
 private:
-    [[nodiscard]] auto _sample_area(Expr<float3> p_from,
-                                    Expr<uint> tag,
-                                    Expr<float2> u_in) const noexcept {
-        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(tag);
-        auto light_inst = pipeline().geometry()->instance(handle.instance_id);
-        auto light_to_world = pipeline().geometry()->instance_to_world(handle.instance_id);
-        auto alias_table_buffer_id = light_inst.alias_table_buffer_id();
-        auto [triangle_id, ux] = sample_alias_table(
-            pipeline().buffer<AliasEntry>(alias_table_buffer_id),
-            light_inst.triangle_count(), u_in.x);
-        auto triangle = pipeline().geometry()->triangle(light_inst, triangle_id);
-        auto uvw = sample_uniform_triangle(make_float2(ux, u_in.y));
-        auto attrib = pipeline().geometry()->shading_point(light_inst, triangle, uvw, light_to_world);
-        return luisa::make_shared<Interaction>(std::move(light_inst), handle.instance_id,
-                                               triangle_id, std::move(attrib),
-                                               dot(attrib.g.n, p_from - attrib.g.p) < 0.f);
-    }
-
     [[nodiscard]] Light::Sample _sample_light(const Interaction &it_from,
                                               Expr<uint> tag, Expr<float2> u,
                                               const SampledWavelengths &swl,
                                               Expr<float> time) const noexcept override {
         LUISA_ASSERT(!pipeline().lights().empty(), "No lights in the scene.");
-        auto it = _sample_area(it_from.p(), tag, u);
-        auto eval = Light::Evaluation::zero(swl.dimension());
-        pipeline().lights().dispatch(it->shape().light_tag(), [&](auto light) noexcept {
+        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(_light_buffer_offset + tag);
+        auto s = Light::Sample::zero(swl.dimension());
+        pipeline().lights().dispatch(handle.light_tag, [&](auto light) noexcept {
             auto closure = light->closure(swl, time);
-            eval = closure->evaluate(*it, it_from.p_shading());
+            s = closure->sample(handle.instance_id, it_from.p_shading(), u);
         });
-        return {.eval = std::move(eval), .p = it->p()};
+        return s;
     }
 
     [[nodiscard]] Environment::Sample _sample_environment(Expr<float2> u,
@@ -148,17 +133,16 @@ private:
                                               const SampledWavelengths &swl,
                                               Expr<float> time) const noexcept override {
         LUISA_ASSERT(!pipeline().lights().empty(), "No lights in the scene.");
-        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(tag);
-        auto light_inst = pipeline().geometry()->instance(handle.instance_id);
+        auto handle = pipeline().buffer<Light::Handle>(_light_buffer_id).read(_light_buffer_offset + tag);
         auto sp=Light::Sample::zero(swl.dimension());
         Var<Ray> shadow_ray{};
-        pipeline().lights().dispatch(light_inst.light_tag(), [&](auto light) noexcept {
+        pipeline().lights().dispatch(handle.light_tag, [&](auto light) noexcept {
             auto closure = light->closure(swl, time);
             auto [sp_tp,ray_tp] = closure->sample_le(handle.instance_id, u_light, u_direction);
             sp = sp_tp;
             shadow_ray = ray_tp;
         });
-        return {.eval = sp.eval, .shadow_ray = shadow_ray};
+        return {.eval = sp.eval, .shadow_ray = shadow_ray, .delta = sp.delta};
     }
 };
 
@@ -0,0 +1,98 @@
+#include <util/thread_pool.h>
+#include <base/shape.h>
+
+namespace luisa::render {
+
+// polyline strands for hair and fur, intersected as round tubes or flat ribbons per segment
+class Curves : public Shape {
+
+public:
+    enum struct Type {
+        ROUND,
+        RIBBON,
+    };
+
+private:
+    luisa::vector<AnalyticPrimitive> _primitives;
+
+public:
+    Curves(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : Shape{scene, desc} {
+        auto type = [desc] {
+            auto t = desc->property_string_or_default("type", "round");
+            for (auto &c : t) { c = static_cast<char>(tolower(c)); }
+            if (t == "ribbon") { return Type::RIBBON; }
+            if (t != "round") [[unlikely]] {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Unknown curve type '{}'. "
+                    "Fallback to round curves. [{}]",
+                    t, desc->source_location().string());
+            }
+            return Type::ROUND;
+        }();
+        auto points = desc->property_float_list("points");
+        auto radii = desc->property_float_list_or_default("radii");
+        auto radius = desc->property_float_or_default("radius", .01f);
+        auto normals = desc->property_float_list_or_default("normals");
+        // number of points of each strand, a single strand by default
+        auto strands = desc->property_uint_list_or_default("strands");
+        auto point_count = points.size() / 3u;
+        if (points.size() % 3u != 0u ||
+            (!radii.empty() && radii.size() != point_count) ||
+            (!normals.empty() && normals.size() != points.size())) [[unlikely]] {
+            LUISA_ERROR_WITH_LOCATION(
+                "Invalid curve point, radius or normal count. [{}]",
+                desc->source_location().string());
+        }
+        if (strands.empty()) { strands.emplace_back(static_cast<uint>(point_count)); }
+        auto point = [&](auto i) noexcept { return make_float3(points[i * 3u + 0u], points[i * 3u + 1u], points[i * 3u + 2u]); };
+        auto point_radius = [&](auto i) noexcept { return std::max(radii.empty() ? radius : radii[i], 0.f); };
+        // ribbons face +z unless normals are given
+        auto point_normal = [&](auto i) noexcept {
+            return normals.empty() ? make_float3(0.f, 0.f, 1.f) :
+                                     make_float3(normals[i * 3u + 0u], normals[i * 3u + 1u], normals[i * 3u + 2u]);
+        };
+        // segments, skipping the degenerate ones
+        luisa::vector<uint> segment_starts;
+        auto first = 0u;
+        for (auto n : strands) {
+            if (n < 2u || first + n > point_count) [[unlikely]] {
+                LUISA_ERROR_WITH_LOCATION(
+                    "Invalid strand with {} points. [{}]",
+                    n, desc->source_location().string());
+            }
+            for (auto i = first; i + 1u < first + n; i++) {
+                if (any(point(i) != point(i + 1u))) { segment_starts.emplace_back(i); }
+            }
+            first += n;
+        }
+        if (segment_starts.empty()) [[unlikely]] {
+            LUISA_ERROR_WITH_LOCATION(
+                "Curves without segments. [{}]",
+                desc->source_location().string());
+        }
+        _primitives.resize(segment_starts.size());
+        global_thread_pool().parallel(segment_starts.size(), [&](auto s) noexcept {
+            auto i = segment_starts[s];
+            auto p0 = point(i);
+            auto p1 = point(i + 1u);
+            auto r0 = point_radius(i);
+            auto r1 = point_radius(i + 1u);
+            _primitives[s] = type == Type::RIBBON ?
+                                 AnalyticPrimitive::ribbon_curve(p0, r0, p1, r1, point_normal(i) + point_normal(i + 1u)) :
+                                 AnalyticPrimitive::round_curve(p0, r0, p1, r1);
+        });
+        global_thread_pool().synchronize();
+    }
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] bool is_procedural() const noexcept override { return true; }
+    [[nodiscard]] luisa::span<const AnalyticPrimitive> primitives() const noexcept override { return _primitives; }
+};
+
+using CurvesWrapper =
+    VisibilityShapeWrapper<
+        IntersectionOffsetShapeWrapper<Curves>>;
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::CurvesWrapper)
@@ -2,17 +2,17 @@
 // Created by Mike Smith on 2022/11/8.
 //
 
+#include <future>
+
 #include <core/clock.h>
 #include <base/shape.h>
 #include <base/scene.h>
-#include <util/thread_pool.h>
 #include <util/loop_subdiv.h>
 
 namespace luisa::render {
 
 static constexpr auto max_loop_subdivision_level = 10u;
 
-// TODO: preserve uv mapping
 class LoopSubdiv : public Shape {
 
 private:
@@ -27,20 +27,38 @@ public:
                   return desc->property_node_or_default(
                       "shape", lazy_construct([desc] { return desc->property_node("base"); }));
               })))} {
-        LUISA_ASSERT(_mesh->is_mesh(), "LoopSubdiv only supports mesh shapes.");
-        auto level = std::min(desc->property_uint_or_default("level", 1u),
-                              max_loop_subdivision_level);
-        if (level == 0u) {
+        LUISA_ASSERT(_mesh->is_mesh(), "LoopSubdiv only supports mesh shapes "
+                                       "(spheres are meshes unless `procedural` is set).");
+        // in adaptive mode, `level` caps the refinement of edges that are longer than
+        // `max_edge_length` (in object space) or bend by more than `max_angle` (in degrees)
+        LoopSubdivOptions options{
+            .level = std::min(desc->property_uint_or_default("level", 1u),
+                              max_loop_subdivision_level),
+            .adaptive = desc->property_bool_or_default("adaptive", false),
+            .max_edge_length = std::max(desc->property_float_or_default("max_edge_length", 0.f), 0.f),
+            .max_angle = radians(std::clamp(desc->property_float_or_default("max_angle", 5.f), 0.f, 180.f)),
+            .parallel = true};
+        if (options.adaptive && options.max_edge_length == 0.f && options.max_angle == 0.f) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Adaptive LoopSubdiv without criteria. "
+                "Fallback to uniform subdivision. [{}]",
+                desc->source_location().string());
+            options.adaptive = false;
+        }
+        if (options.level == 0u) {
             LUISA_WARNING_WITH_LOCATION(
                 "LoopSubdiv level is 0, which is equivalent to no subdivision.");
         } else {
-            _geometry = global_thread_pool().async([level, mesh = _mesh] {
+            // pool tasks (e.g., hashing the meshes in Geometry::build()) may block on the
+            // result, so it runs on a dedicated thread instead of being queued behind them
+            _geometry = std::async(std::launch::async, [options, mesh = _mesh] {
                 auto m = mesh->mesh();
                 Clock clk;
-                auto [vertices, triangles, _] = loop_subdivide(m.vertices, m.triangles, level);
-                LUISA_INFO("LoopSubdiv (level = {}): subdivided {} vertices and {} "
+                auto [vertices, triangles, _] = loop_subdivide(m.vertices, m.triangles, options);
+                LUISA_INFO("LoopSubdiv ({}, level = {}): subdivided {} vertices and {} "
                            "triangles into {} vertices and {} triangles in {} ms.",
-                           level, m.vertices.size(), m.triangles.size(),
+                           options.adaptive ? "adaptive" : "uniform", options.level,
+                           m.vertices.size(), m.triangles.size(),
                            vertices.size(), triangles.size(), clk.toc());
                 return std::make_pair(std::move(vertices), std::move(triangles));
             });
@@ -55,7 +73,8 @@ public:
     }
     [[nodiscard]] uint vertex_properties() const noexcept override {
         return _geometry.valid() ?
-                   Shape::property_flag_has_vertex_normal :
+                   Shape::property_flag_has_vertex_normal |
+                       (_mesh->vertex_properties() & Shape::property_flag_has_vertex_uv) :
                    _mesh->vertex_properties();
     }
     [[nodiscard]] AccelOption build_option() const noexcept override { return _mesh->build_option(); }
@@ -10,46 +10,213 @@
 
 #include <core/clock.h>
 #include <util/thread_pool.h>
+#include <util/mapped_file.h>
+#include <util/mesh_simplify.h>
 #include <base/shape.h>
 
 namespace luisa::render {
 
 class MeshLoader {
 
+private:
+    static constexpr auto cache_magic = 0x48534d415349554cull;// "LUISAMSH" in little-endian
+    static constexpr auto cache_version = 2u;
+
+    // followed by the sizes of all levels, then the vertices of all levels, then the triangles of all levels
+    struct CacheHeader {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t properties;
+        uint32_t level_count;
+        uint32_t reserved;
+        uint64_t padding;
+    };
+
+    struct CacheLevel {
+        uint64_t vertex_count;
+        uint64_t triangle_count;
+    };
+
+    static_assert(sizeof(CacheHeader) % alignof(Vertex) == 0u);
+    static_assert(sizeof(CacheLevel) % alignof(Vertex) == 0u);
+
+public:
+    static constexpr auto max_lod_levels = 15u;
+    // simplification stops before levels would drop below this many triangles
+    static constexpr auto min_lod_triangles = 64u;
+
 private:
     luisa::vector<Vertex> _vertices;
     luisa::vector<Triangle> _triangles;
+    luisa::vector<SimplifiedMesh> _lods;// each with about half the triangles of the previous level
+    MappedFile _mapped;                 // valid if the mesh is loaded from the on-disk cache
     uint _properties{};
 
+private:
+    [[nodiscard]] static luisa::optional<MeshLoader> _load_cached(const std::filesystem::path &cache_path) noexcept {
+        auto file = MappedFile::open(cache_path);
+        if (!file || file.size() < sizeof(CacheHeader)) { return luisa::nullopt; }
+        CacheHeader header{};
+        std::memcpy(&header, file.data(), sizeof(CacheHeader));
+        auto valid = header.magic == cache_magic &&
+                     header.version == cache_version &&
+                     header.level_count != 0u &&
+                     header.level_count <= max_lod_levels + 1u &&
+                     file.size() >= sizeof(CacheHeader) + header.level_count * sizeof(CacheLevel);
+        if (valid) {
+            auto expected_size = sizeof(CacheHeader) + header.level_count * sizeof(CacheLevel);
+            for (auto i = 0u; i < header.level_count; i++) {
+                CacheLevel level{};
+                std::memcpy(&level, file.data() + sizeof(CacheHeader) + i * sizeof(CacheLevel), sizeof(CacheLevel));
+                valid &= level.vertex_count != 0u && level.triangle_count != 0u;
+                expected_size += level.vertex_count * sizeof(Vertex) + level.triangle_count * sizeof(Triangle);
+            }
+            valid &= file.size() == expected_size;
+        }
+        if (!valid) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Ignoring invalid mesh cache '{}'.",
+                cache_path.string());
+            return luisa::nullopt;
+        }
+        MeshLoader loader;
+        loader._mapped = std::move(file);
+        loader._properties = header.properties;
+        return luisa::make_optional(std::move(loader));
+    }
+
+    void _save_cached(const std::filesystem::path &cache_path) const noexcept {
+        CacheHeader header{.magic = cache_magic,
+                           .version = cache_version,
+                           .properties = _properties,
+                           .level_count = level_count()};
+        luisa::vector<CacheLevel> levels;
+        luisa::vector<luisa::span<const std::byte>> chunks;
+        for (auto i = 0u; i < level_count(); i++) {
+            auto m = mesh(i);
+            levels.emplace_back(CacheLevel{m.vertices.size(), m.triangles.size()});
+        }
+        chunks.emplace_back(std::as_bytes(luisa::span{&header, 1u}));
+        chunks.emplace_back(std::as_bytes(luisa::span{levels}));
+        for (auto i = 0u; i < level_count(); i++) { chunks.emplace_back(std::as_bytes(mesh(i).vertices)); }
+        for (auto i = 0u; i < level_count(); i++) { chunks.emplace_back(std::as_bytes(mesh(i).triangles)); }
+        if (write_file_atomic(cache_path, chunks)) {
+            LUISA_INFO("Saved mesh cache '{}'.", cache_path.string());
+        }
+    }
+
+    // halve the triangle count level by level until the levels stop shrinking
+    void _generate_lods(uint lod_levels) noexcept {
+        for (auto level = 0u; level < lod_levels; level++) {
+            auto [vertices, triangles] = mesh(level);
+            auto target = triangles.size() / 2u;
+            if (target < min_lod_triangles) { break; }
+            auto lod = simplify_mesh(vertices, triangles, target);
+            if (lod.triangles.empty() || lod.triangles.size() * 4u > triangles.size() * 3u) { break; }
+            _lods.emplace_back(std::move(lod));
+        }
+    }
+
 public:
-    [[nodiscard]] auto mesh() const noexcept { return MeshView{_vertices, _triangles}; }
+    [[nodiscard]] uint level_count() const noexcept {
+        if (!_mapped) { return static_cast<uint>(_lods.size() + 1u); }
+        CacheHeader header{};
+        std::memcpy(&header, _mapped.data(), sizeof(CacheHeader));
+        return header.level_count;
+    }
+    // level 0 is the full mesh
+    [[nodiscard]] MeshView mesh(uint level = 0u) const noexcept {
+        if (!_mapped) {
+            if (level == 0u) { return MeshView{_vertices, _triangles}; }
+            return MeshView{_lods[level - 1u].vertices, _lods[level - 1u].triangles};
+        }
+        CacheHeader header{};
+        std::memcpy(&header, _mapped.data(), sizeof(CacheHeader));
+        auto vertices = reinterpret_cast<const Vertex *>(_mapped.data() + sizeof(CacheHeader) +
+                                                         header.level_count * sizeof(CacheLevel));
+        auto vertex_offset = static_cast<size_t>(0u);
+        auto triangle_offset = static_cast<size_t>(0u);
+        auto vertex_total = static_cast<size_t>(0u);
+        CacheLevel selected{};
+        for (auto i = 0u; i < header.level_count; i++) {
+            CacheLevel l{};
+            std::memcpy(&l, _mapped.data() + sizeof(CacheHeader) + i * sizeof(CacheLevel), sizeof(CacheLevel));
+            if (i < level) {
+                vertex_offset += l.vertex_count;
+                triangle_offset += l.triangle_count;
+            }
+            if (i == level) { selected = l; }
+            vertex_total += l.vertex_count;
+        }
+        auto triangles = reinterpret_cast<const Triangle *>(vertices + vertex_total);
+        return MeshView{luisa::span{vertices + vertex_offset, selected.vertex_count},
+                        luisa::span{triangles + triangle_offset, selected.triangle_count}};
+    }
     [[nodiscard]] auto properties() const noexcept { return _properties; }
 
-    // Load the mesh from a file.
+    // Load the mesh from a file. If `cache_dir` is not empty, the processed mesh is
+    // looked up in (and, on a miss, stored into) a content-addressed on-disk cache
+    // keyed by the file contents and the import options. With `keep_vertex_order`,
+    // vertices are neither welded nor reordered, so that files sharing the same
+    // topology (e.g., keyframes of a vertex animation) map to the same vertices.
+    // With `lod_levels`, up to that many simplified levels are generated and cached
+    // along with the mesh.
     [[nodiscard]] static auto load(std::filesystem::path path, uint subdiv_level,
-                                   bool flip_uv, bool drop_normal, bool drop_uv) noexcept {
+                                   bool flip_uv, bool drop_normal, bool drop_uv, uint lod_levels,
+                                   std::filesystem::path cache_dir,
+                                   bool keep_vertex_order = false) noexcept {
 
         static luisa::lru_cache<uint64_t, std::shared_future<MeshLoader>> loaded_meshes{256u};
         static std::mutex mutex;
 
         auto abs_path = std::filesystem::canonical(path).string();
-        auto key = luisa::hash_value(abs_path, luisa::hash_value(subdiv_level));
-
+        lod_levels = std::min(lod_levels, max_lod_levels);
+        auto options = (static_cast<uint>(keep_vertex_order) << 31u) |
+                       (lod_levels << 24u) |
+                       (subdiv_level << 3u) |
+                       (static_cast<uint>(flip_uv) << 2u) |
+                       (static_cast<uint>(drop_normal) << 1u) |
+                       static_cast<uint>(drop_uv);
+        auto key = luisa::hash_value(abs_path, luisa::hash_value(options));
 
         std::scoped_lock lock{mutex};
         if (auto m = loaded_meshes.at(key)) { return *m; }
 
-        auto future = global_thread_pool().async([path = std::move(path), subdiv_level, flip_uv, drop_normal, drop_uv] {
+        auto future = global_thread_pool().async([path = std::move(path), cache_dir = std::move(cache_dir),
+                                                  subdiv_level, flip_uv, drop_normal, drop_uv, lod_levels,
+                                                  keep_vertex_order, options] {
             Clock clock;
             auto path_string = path.string();
+            auto cache_path = [&] {
+                if (cache_dir.empty()) { return std::filesystem::path{}; }
+                auto file = MappedFile::open(path);
+                if (!file) [[unlikely]] {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "Failed to map mesh '{}' for hashing. "
+                        "Mesh cache is disabled for it.",
+                        path_string);
+                    return std::filesystem::path{};
+                }
+                auto hash = luisa::hash64(file.data(), file.size(), luisa::hash64_default_seed);
+                hash = luisa::hash64(&options, sizeof(options), hash);
+                hash = luisa::hash64(&cache_version, sizeof(cache_version), hash);
+                return cache_dir / luisa::format("{:016x}.mesh", hash);
+            }();
+            if (!cache_path.empty()) {
+                if (auto cached = _load_cached(cache_path)) {
+                    LUISA_INFO("Loaded triangle mesh '{}' from cache '{}' in {} ms.",
+                               path_string, cache_path.string(), clock.toc());
+                    return std::move(*cached);
+                }
+            }
             Assimp::Importer importer;
             importer.SetPropertyInteger(
                 AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
             importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 45.f);
             auto import_flags = aiProcess_RemoveComponent | aiProcess_SortByPType |
-                                aiProcess_ValidateDataStructure | aiProcess_ImproveCacheLocality |
-                                aiProcess_PreTransformVertices | aiProcess_FindInvalidData |
-                                aiProcess_JoinIdenticalVertices;
+                                aiProcess_ValidateDataStructure |
+                                aiProcess_PreTransformVertices | aiProcess_FindInvalidData;
+            if (!keep_vertex_order) { import_flags |= aiProcess_ImproveCacheLocality | aiProcess_JoinIdenticalVertices; }
             auto remove_flags = aiComponent_ANIMATIONS | aiComponent_BONEWEIGHTS |
                                 aiComponent_CAMERAS | aiComponent_LIGHTS |
                                 aiComponent_MATERIALS | aiComponent_TEXTURES |
@@ -135,6 +302,12 @@ public:
                 }
             }
             LUISA_INFO("Loaded triangle mesh '{}' in {} ms.", path_string, clock.toc());
+            if (lod_levels != 0u) {
+                loader._generate_lods(lod_levels);
+                LUISA_INFO("Generated {} level(s) of detail for mesh '{}' in {} ms.",
+                           loader._lods.size(), path_string, clock.toc());
+            }
+            if (!cache_path.empty()) { loader._save_cached(cache_path); }
             return loader;
         });
         loaded_meshes.emplace(key, future);
@@ -146,19 +319,93 @@ class Mesh : public Shape {
 
 private:
     std::shared_future<MeshLoader> _loader;
+    // vertex animation: positions and normals are interpolated between keyframes
+    // that share the topology of the rest mesh loaded from `file`
+    luisa::vector<std::shared_future<MeshLoader>> _keyframes;
+    luisa::vector<float> _keyframe_times;
+    mutable std::once_flag _keyframes_validated;
+
+private:
+    void _validate_keyframes() const noexcept {
+        auto rest = _loader.get().mesh();
+        for (auto &&keyframe : _keyframes) {
+            auto m = keyframe.get().mesh();
+            if (m.vertices.size() != rest.vertices.size() ||
+                m.triangles.size() != rest.triangles.size() ||
+                std::memcmp(m.triangles.data(), rest.triangles.data(),
+                            rest.triangles.size_bytes()) != 0) [[unlikely]] {
+                LUISA_ERROR_WITH_LOCATION(
+                    "Mesh keyframes must share the topology of the rest mesh.");
+            }
+        }
+    }
 
 public:
     Mesh(Scene *scene, const SceneNodeDesc *desc) noexcept
         : Shape{scene, desc},
-          _loader{MeshLoader::load(desc->property_path("file"),
-                                   desc->property_uint_or_default("subdivision", 0u),
-                                   desc->property_bool_or_default("flip_uv", false),
-                                   desc->property_bool_or_default("drop_normal", false),
-                                   desc->property_bool_or_default("drop_uv", false))} {}
+          _keyframe_times{desc->property_float_list_or_default("keyframe_times")} {
+        auto keyframes = desc->property_path_list_or_default("keyframes");
+        auto lod_levels = desc->property_uint_or_default("lod_levels", 0u);
+        if (lod_levels != 0u && !keyframes.empty()) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Levels of detail are not supported for "
+                "meshes with keyframes. Ignoring them. [{}]",
+                desc->source_location().string());
+            lod_levels = 0u;
+        }
+        auto load = [&](std::filesystem::path path, bool keep_vertex_order) noexcept {
+            return MeshLoader::load(std::move(path),
+                                    desc->property_uint_or_default("subdivision", 0u),
+                                    desc->property_bool_or_default("flip_uv", false),
+                                    desc->property_bool_or_default("drop_normal", false),
+                                    desc->property_bool_or_default("drop_uv", false),
+                                    keep_vertex_order ? 0u : lod_levels,
+                                    desc->property_bool_or_default("cache", true) &&
+                                            !scene->cache_directory().empty() ?
+                                        scene->cache_directory() / "meshes" :
+                                        std::filesystem::path{},
+                                    keep_vertex_order);
+        };
+        if (keyframes.size() != _keyframe_times.size() ||
+            !std::is_sorted(_keyframe_times.cbegin(), _keyframe_times.cend())) [[unlikely]] {
+            LUISA_ERROR_WITH_LOCATION(
+                "Mesh keyframes ({}) must come with as many "
+                "sorted keyframe times ({}).",
+                keyframes.size(), _keyframe_times.size());
+        }
+        _loader = load(desc->property_path("file"), !keyframes.empty());
+        _keyframes.reserve(keyframes.size());
+        for (auto &&k : keyframes) { _keyframes.emplace_back(load(k, true)); }
+    }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] bool is_mesh() const noexcept override { return true; }
     [[nodiscard]] MeshView mesh() const noexcept override { return _loader.get().mesh(); }
+    [[nodiscard]] uint lod_count() const noexcept override { return _loader.get().level_count() - 1u; }
+    [[nodiscard]] MeshView lod(uint level) const noexcept override { return _loader.get().mesh(level); }
     [[nodiscard]] uint vertex_properties() const noexcept override { return _loader.get().properties(); }
+    [[nodiscard]] bool deformable() const noexcept override { return !_keyframes.empty(); }
+    void deform(float time, luisa::span<Vertex> vertices) const noexcept override {
+        if (_keyframes.empty()) {
+            Shape::deform(time, vertices);
+            return;
+        }
+        std::call_once(_keyframes_validated, [this] { _validate_keyframes(); });
+        auto rest = mesh().vertices;
+        LUISA_ASSERT(vertices.size() == rest.size(), "Invalid vertex count for deformation.");
+        auto i1 = static_cast<size_t>(std::upper_bound(_keyframe_times.cbegin(), _keyframe_times.cend(), time) -
+                                      _keyframe_times.cbegin());
+        auto i0 = i1 == 0u ? 0u : i1 - 1u;
+        i1 = std::min(i1, _keyframes.size() - 1u);
+        auto t = i0 == i1 ? 0.f : (time - _keyframe_times[i0]) / (_keyframe_times[i1] - _keyframe_times[i0]);
+        auto v0 = _keyframes[i0].get().mesh().vertices;
+        auto v1 = _keyframes[i1].get().mesh().vertices;
+        for (auto i = 0u; i < vertices.size(); i++) {
+            auto p = lerp(v0[i].position(), v1[i].position(), t);
+            auto n = lerp(v0[i].normal(), v1[i].normal(), t);
+            n = length_squared(n) > 0.f ? normalize(n) : v0[i].normal();
+            vertices[i] = Vertex::encode(p, n, rest[i].uv());
+        }
+    }
 };
 
 using MeshWrapper =
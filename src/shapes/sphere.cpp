@@ -6,6 +6,7 @@
 
 #include <util/thread_pool.h>
 #include <base/shape.h>
+#include <base/light.h>
 #include <util/loop_subdiv.h>
 
 namespace luisa::render {
@@ -101,20 +102,42 @@ public:
     }
 };
 
+// unit sphere at the origin, tessellated unless `procedural` is set
 class Sphere : public Shape {
 
 private:
+    static constexpr std::array _unit_sphere{AnalyticPrimitive{0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f,
+                                                               0.f, 0.f, 1.f, AnalyticPrimitive::kind_sphere}};
     std::shared_future<SphereGeometry> _geometry;
+    bool _procedural;
 
 public:
     Sphere(Scene *scene, const SceneNodeDesc *desc) noexcept
         : Shape{scene, desc},
-          _geometry{SphereGeometry::create(
-              std::min(desc->property_uint_or_default("subdivision", 0u),
-                       sphere_max_subdivision_level))} {}
+          // the analytic sphere is opt-in, as it is not alpha-tested, cannot be subdivided
+          // or motion-blurred, and cannot emit since lights are sampled by triangles
+          _procedural{desc->property_bool_or_default("procedural", false) &&
+                      (light() == nullptr || light()->is_null())} {
+        if (!_procedural && desc->property_bool_or_default("procedural", false)) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Procedural spheres cannot emit. "
+                "Fallback to a tessellated sphere. [{}]",
+                desc->source_location().string());
+        }
+        if (!_procedural) {
+            _geometry = SphereGeometry::create(
+                std::min(desc->property_uint_or_default("subdivision", 0u),
+                         sphere_max_subdivision_level));
+        }
+    }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
-    [[nodiscard]] bool is_mesh() const noexcept override { return true; }
-    [[nodiscard]] MeshView mesh() const noexcept override { return _geometry.get().mesh(); }
+    [[nodiscard]] bool is_mesh() const noexcept override { return !_procedural; }
+    [[nodiscard]] bool is_procedural() const noexcept override { return _procedural; }
+    [[nodiscard]] MeshView mesh() const noexcept override { return _procedural ? MeshView{} : _geometry.get().mesh(); }
+    [[nodiscard]] luisa::span<const AnalyticPrimitive> primitives() const noexcept override {
+        if (!_procedural) { return {}; }
+        return _unit_sphere;
+    }
     [[nodiscard]] uint vertex_properties() const noexcept override {
         return Shape::property_flag_has_vertex_normal |
                Shape::property_flag_has_vertex_uv;
@@ -0,0 +1,44 @@
+#include <util/thread_pool.h>
+#include <base/shape.h>
+
+namespace luisa::render {
+
+// particle cloud of exact spheres, e.g., for granular media and sprays
+class Spheres : public Shape {
+
+private:
+    luisa::vector<AnalyticPrimitive> _primitives;
+
+public:
+    Spheres(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : Shape{scene, desc} {
+        auto centers = desc->property_float_list("centers");
+        auto radii = desc->property_float_list_or_default("radii");
+        auto radius = desc->property_float_or_default("radius", 1.f);
+        auto count = centers.size() / 3u;
+        if (centers.empty() || centers.size() % 3u != 0u ||
+            (!radii.empty() && radii.size() != count)) [[unlikely]] {
+            LUISA_ERROR_WITH_LOCATION(
+                "Invalid sphere center or radius count. [{}]",
+                desc->source_location().string());
+        }
+        _primitives.resize(count);
+        global_thread_pool().parallel(count, [&](auto i) noexcept {
+            auto c = make_float3(centers[i * 3u + 0u], centers[i * 3u + 1u], centers[i * 3u + 2u]);
+            auto r = radii.empty() ? radius : radii[i];
+            _primitives[i] = AnalyticPrimitive::sphere(c, std::max(r, 0.f));
+        });
+        global_thread_pool().synchronize();
+    }
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] bool is_procedural() const noexcept override { return true; }
+    [[nodiscard]] luisa::span<const AnalyticPrimitive> primitives() const noexcept override { return _primitives; }
+};
+
+using SpheresWrapper =
+    VisibilityShapeWrapper<
+        IntersectionOffsetShapeWrapper<Spheres>>;
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::SpheresWrapper)
@@ -186,20 +186,11 @@ luisa::unique_ptr<Surface::Instance> MetalSurface::_build(
     auto roughness = pipeline.build_texture(command_buffer, _roughness);
     auto Kd = pipeline.build_texture(command_buffer, _kd);
     auto &&eta_k = _known_ior().at(_ior);
-    auto eta_buffer_id = pipeline.register_named_id(luisa::format("{}.eta", _ior), [&] {
-        auto [eta_view, eta_id] = pipeline.bindless_arena_buffer<float>(eta_k.eta.size());
-        command_buffer << eta_view.copy_from(eta_k.eta.data());
-        return eta_id;
-    });
-    auto k_buffer_id = pipeline.register_named_id(luisa::format("{}.k", _ior), [&] {
-        auto [k_view, k_id] = pipeline.bindless_arena_buffer<float>(eta_k.k.size());
-        command_buffer << k_view.copy_from(eta_k.k.data());
-        return k_id;
-    });
+    auto lut_step = static_cast<float>(ior::lut_step);
     return luisa::make_unique<MetalInstance>(
         pipeline, this, roughness, Kd,
-        SPD{pipeline, eta_buffer_id, static_cast<float>(ior::lut_step)},
-        SPD{pipeline, k_buffer_id, static_cast<float>(ior::lut_step)});
+        SPD::create(pipeline, command_buffer, luisa::format("{}.eta", _ior), eta_k.eta, lut_step),
+        SPD::create(pipeline, command_buffer, luisa::format("{}.k", _ior), eta_k.k, lut_step));
 }
 
 class MetalClosure : public Surface::Closure {
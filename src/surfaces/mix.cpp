@@ -68,6 +68,13 @@ public:
         auto opacity_b = _b->evaluate_opacity(it, swl, time).value_or(1.f);
         return opacity_a * opacity_b;
     }
+
+    [[nodiscard]] luisa::optional<float2> evaluate_opacity_range(float2 uv_min, float2 uv_max) const noexcept override {
+        auto range_a = _a->evaluate_opacity_range(uv_min, uv_max);
+        auto range_b = _b->evaluate_opacity_range(uv_min, uv_max);
+        if (!range_a || !range_b) { return luisa::nullopt; }
+        return clamp(*range_a, 0.f, 1.f) * clamp(*range_b, 0.f, 1.f);
+    }
 };
 
 luisa::unique_ptr<Surface::Instance> MixSurface::_build(
@@ -0,0 +1,401 @@
+#include <deque>
+#include <limits>
+#include <algorithm>
+
+#include <core/clock.h>
+#include <core/logging.h>
+#include <util/thread_pool.h>
+#include <util/loop_subdiv.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+using namespace luisa::render;
+
+// The serial, pointer-based implementation from PBRT-v4 that util/loop_subdiv.cpp
+// replaced, reduced to the limit positions and topology, as the reference output.
+// License: Apache 2.0
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+namespace reference {
+
+struct SDFace;
+
+[[nodiscard]] constexpr auto next(uint e) noexcept { return (e + 1u) % 3u; }
+[[nodiscard]] constexpr auto prev(uint e) noexcept { return (e + 2u) % 3u; }
+
+struct SDVertex {
+    float3 p;
+    bool regular{};
+    bool boundary{};
+    SDFace *start_face{};
+    SDVertex *child{};
+    [[nodiscard]] uint valence() noexcept;
+    void one_ring(float3 *pp) noexcept;
+};
+
+struct SDFace {
+    SDVertex *v[3]{};
+    SDFace *f[3]{};
+    SDFace *children[4]{};
+    uint base_triangle{};
+    [[nodiscard]] auto vnum(SDVertex *vert) const noexcept {
+        for (auto i = 0u; i < 3u; i++) {
+            if (v[i] == vert) { return i; }
+        }
+        LUISA_ERROR_WITH_LOCATION("Basic logic error in SDFace::vnum().");
+    }
+    [[nodiscard]] auto next_face(SDVertex *vert) noexcept { return f[vnum(vert)]; }
+    [[nodiscard]] auto prev_face(SDVertex *vert) noexcept { return f[prev(vnum(vert))]; }
+    [[nodiscard]] auto next_vert(SDVertex *vert) noexcept { return v[next(vnum(vert))]; }
+    [[nodiscard]] auto prev_vert(SDVertex *vert) noexcept { return v[prev(vnum(vert))]; }
+    [[nodiscard]] auto other_vert(SDVertex *v0, SDVertex *v1) noexcept {
+        for (auto i : v) {
+            if (i != v0 && i != v1) { return i; }
+        }
+        LUISA_ERROR_WITH_LOCATION("Basic logic error in SDFace::other_vert().");
+    }
+};
+
+struct SDEdge {
+    SDVertex *v[2];
+    SDFace *f[2]{};
+    uint f0_edge{~0u};
+    SDEdge(SDVertex *v0, SDVertex *v1) noexcept : v{std::min(v0, v1), std::max(v0, v1)} {}
+    [[nodiscard]] auto operator==(const SDEdge &e) const noexcept { return v[0] == e.v[0] && v[1] == e.v[1]; }
+};
+
+struct SDEdgeHash {
+    [[nodiscard]] auto operator()(const SDEdge &e) const noexcept {
+        return luisa::hash64(e.v, sizeof(e.v), 0x19980810u);
+    }
+};
+
+uint SDVertex::valence() noexcept {
+    auto f = start_face;
+    auto nf = 1u;
+    if (!boundary) {
+        while ((f = f->next_face(this)) != start_face) { nf++; }
+        return nf;
+    }
+    while ((f = f->next_face(this)) != nullptr) { nf++; }
+    f = start_face;
+    while ((f = f->prev_face(this)) != nullptr) { nf++; }
+    return nf + 1u;
+}
+
+void SDVertex::one_ring(float3 *pp) noexcept {
+    auto face = start_face;
+    if (!boundary) {
+        do {
+            *pp++ = face->next_vert(this)->p;
+            face = face->next_face(this);
+        } while (face != start_face);
+    } else {
+        SDFace *f2{nullptr};
+        while ((f2 = face->next_face(this)) != nullptr) { face = f2; }
+        *pp++ = face->next_vert(this)->p;
+        do {
+            *pp++ = face->prev_vert(this)->p;
+            face = face->prev_face(this);
+        } while (face != nullptr);
+    }
+}
+
+[[nodiscard]] inline auto beta(uint valence) noexcept {
+    return 3.f / (valence == 3u ? 16.f : 8.f * static_cast<float>(valence));
+}
+
+[[nodiscard]] inline auto loop_gamma(uint valence) noexcept {
+    return 1.f / (static_cast<float>(valence) + 3.f / (8.f * beta(valence)));
+}
+
+[[nodiscard]] float3 weight_one_ring(SDVertex *vert, float beta) noexcept {
+    auto valence = vert->valence();
+    luisa::vector<float3> ring(valence);
+    vert->one_ring(ring.data());
+    auto p = (1.f - static_cast<float>(valence) * beta) * vert->p;
+    for (auto q : ring) { p += beta * q; }
+    return p;
+}
+
+[[nodiscard]] float3 weight_boundary(SDVertex *vert, float beta) noexcept {
+    auto valence = vert->valence();
+    luisa::vector<float3> ring(valence);
+    vert->one_ring(ring.data());
+    return (1.f - 2.f * beta) * vert->p + beta * ring.front() + beta * ring.back();
+}
+
+[[nodiscard]] SubdivMesh loop_subdivide(luisa::span<const Vertex> vertices,
+                                        luisa::span<const Triangle> triangles,
+                                        uint level) noexcept {
+    std::deque<SDVertex> vertex_pool;
+    std::deque<SDFace> face_pool;
+    luisa::vector<SDVertex *> v;
+    luisa::vector<SDFace *> f;
+    for (auto &&vertex : vertices) { v.emplace_back(&vertex_pool.emplace_back(SDVertex{.p = vertex.position()})); }
+    for (auto i = 0u; i < triangles.size(); i++) {
+        auto face = &face_pool.emplace_back();
+        face->base_triangle = i;
+        auto t = triangles[i];
+        for (auto [j, index] : {std::pair{0u, t.i0}, std::pair{1u, t.i1}, std::pair{2u, t.i2}}) {
+            face->v[j] = v[index];
+            v[index]->start_face = face;
+        }
+        f.emplace_back(face);
+    }
+    luisa::unordered_set<SDEdge, SDEdgeHash> edges;
+    for (auto face : f) {
+        for (auto k = 0u; k < 3u; k++) {
+            SDEdge e{face->v[k], face->v[next(k)]};
+            if (auto iter = edges.find(e); iter == edges.end()) {
+                e.f[0] = face;
+                e.f0_edge = k;
+                edges.insert(e);
+            } else {
+                iter->f[0]->f[iter->f0_edge] = face;
+                face->f[k] = iter->f[0];
+                edges.erase(iter);
+            }
+        }
+    }
+    for (auto vertex : v) {
+        auto face = vertex->start_face;
+        do { face = face->next_face(vertex); } while (face != nullptr && face != vertex->start_face);
+        vertex->boundary = face == nullptr;
+        vertex->regular = (!vertex->boundary && vertex->valence() == 6u) ||
+                          (vertex->boundary && vertex->valence() == 4u);
+    }
+    for (auto l = 0u; l < level; l++) {
+        luisa::vector<SDVertex *> new_v;
+        luisa::vector<SDFace *> new_f;
+        for (auto vertex : v) {
+            vertex->child = &vertex_pool.emplace_back(SDVertex{.regular = vertex->regular, .boundary = vertex->boundary});
+            new_v.emplace_back(vertex->child);
+        }
+        for (auto face : f) {
+            for (auto &&c : face->children) {
+                c = &face_pool.emplace_back();
+                c->base_triangle = face->base_triangle;
+                new_f.emplace_back(c);
+            }
+        }
+        for (auto vertex : v) {
+            vertex->child->p = vertex->boundary ?
+                                   weight_boundary(vertex, 1.f / 8.f) :
+                                   weight_one_ring(vertex, vertex->regular ? 1.f / 16.f : beta(vertex->valence()));
+        }
+        luisa::unordered_map<SDEdge, SDVertex *, SDEdgeHash> edge_verts;
+        for (auto face : f) {
+            for (auto k = 0u; k < 3u; k++) {
+                SDEdge edge{face->v[k], face->v[next(k)]};
+                auto &&vert = edge_verts[edge];
+                if (vert != nullptr) { continue; }
+                vert = &vertex_pool.emplace_back(SDVertex{.regular = true, .boundary = face->f[k] == nullptr});
+                vert->start_face = face->children[3u];
+                new_v.emplace_back(vert);
+                vert->p = vert->boundary ?
+                              .5f * (edge.v[0]->p + edge.v[1]->p) :
+                              3.f / 8.f * (edge.v[0]->p + edge.v[1]->p) +
+                                  1.f / 8.f * (face->other_vert(edge.v[0], edge.v[1])->p +
+                                               face->f[k]->other_vert(edge.v[0], edge.v[1])->p);
+            }
+        }
+        for (auto vertex : v) {
+            vertex->child->start_face = vertex->start_face->children[vertex->start_face->vnum(vertex)];
+        }
+        for (auto face : f) {
+            for (auto j = 0u; j < 3u; j++) {
+                face->children[3]->f[j] = face->children[next(j)];
+                face->children[j]->f[next(j)] = face->children[3];
+                auto f2 = face->f[j];
+                face->children[j]->f[j] = f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
+                f2 = face->f[prev(j)];
+                face->children[j]->f[prev(j)] = f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
+            }
+        }
+        for (auto face : f) {
+            for (auto j = 0u; j < 3u; j++) {
+                face->children[j]->v[j] = face->v[j]->child;
+                auto vert = edge_verts.at(SDEdge{face->v[j], face->v[next(j)]});
+                face->children[j]->v[next(j)] = vert;
+                face->children[next(j)]->v[j] = vert;
+                face->children[3]->v[j] = vert;
+            }
+        }
+        v = std::move(new_v);
+        f = std::move(new_f);
+    }
+    luisa::vector<float3> limit(v.size());
+    for (auto i = 0u; i < v.size(); i++) {
+        limit[i] = v[i]->boundary ?
+                       weight_boundary(v[i], 1.f / 5.f) :
+                       weight_one_ring(v[i], loop_gamma(v[i]->valence()));
+    }
+    SubdivMesh mesh;
+    luisa::unordered_map<SDVertex *, uint> indices;
+    for (auto i = 0u; i < v.size(); i++) {
+        indices.emplace(v[i], i);
+        mesh.vertices.emplace_back(Vertex::encode(limit[i], make_float3(0.f, 0.f, 1.f), make_float2()));
+    }
+    for (auto face : f) {
+        mesh.triangles.emplace_back(Triangle{indices.at(face->v[0]), indices.at(face->v[1]), indices.at(face->v[2])});
+        mesh.base_triangle_indices.emplace_back(face->base_triangle);
+    }
+    return mesh;
+}
+
+}// namespace reference
+
+[[nodiscard]] static SubdivMesh icosahedron(float3 scale) noexcept {
+    auto t = (1.f + std::sqrt(5.f)) * .5f;
+    float3 p[] = {{-1.f, t, 0.f}, {1.f, t, 0.f}, {-1.f, -t, 0.f}, {1.f, -t, 0.f},
+                  {0.f, -1.f, t}, {0.f, 1.f, t}, {0.f, -1.f, -t}, {0.f, 1.f, -t},
+                  {t, 0.f, -1.f}, {t, 0.f, 1.f}, {-t, 0.f, -1.f}, {-t, 0.f, 1.f}};
+    SubdivMesh mesh;
+    for (auto q : p) { mesh.vertices.emplace_back(Vertex::encode(normalize(q) * scale, normalize(q), make_float2())); }
+    mesh.triangles = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+                      {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                      {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+                      {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+    return mesh;
+}
+
+// open n x n grid of quads, each split into two triangles
+[[nodiscard]] static SubdivMesh grid(uint n) noexcept {
+    SubdivMesh mesh;
+    for (auto y = 0u; y <= n; y++) {
+        for (auto x = 0u; x <= n; x++) {
+            auto p = make_float3(static_cast<float>(x), static_cast<float>(y),
+                                 .1f * static_cast<float>((x * 7u + y * 3u) % 5u));
+            mesh.vertices.emplace_back(Vertex::encode(p, make_float3(0.f, 0.f, 1.f), make_float2()));
+        }
+    }
+    for (auto y = 0u; y < n; y++) {
+        for (auto x = 0u; x < n; x++) {
+            auto i = y * (n + 1u) + x;
+            mesh.triangles.emplace_back(Triangle{i, i + 1u, i + n + 2u});
+            mesh.triangles.emplace_back(Triangle{i, i + n + 2u, i + n + 1u});
+        }
+    }
+    return mesh;
+}
+
+// the same limit positions and faces, up to the order of the vertices and triangles
+static void check_same_mesh(const SubdivMesh &expected, const SubdivMesh &actual, float tolerance) noexcept {
+    LUISA_ASSERT(expected.vertices.size() == actual.vertices.size() &&
+                     expected.triangles.size() == actual.triangles.size(),
+                 "Expected {} vertices and {} triangles, got {} and {}.",
+                 expected.vertices.size(), expected.triangles.size(),
+                 actual.vertices.size(), actual.triangles.size());
+    luisa::vector<uint> remap(actual.vertices.size());
+    for (auto i = 0u; i < actual.vertices.size(); i++) {
+        auto p = actual.vertices[i].position();
+        auto best = 0u;
+        auto best_distance = std::numeric_limits<float>::max();
+        for (auto j = 0u; j < expected.vertices.size(); j++) {
+            if (auto d = distance(p, expected.vertices[j].position()); d < best_distance) {
+                best = j;
+                best_distance = d;
+            }
+        }
+        LUISA_ASSERT(best_distance <= tolerance,
+                     "Vertex {} at ({}, {}, {}) is {} away from the reference.",
+                     i, p.x, p.y, p.z, best_distance);
+        remap[i] = best;
+    }
+    // faces as rotated index triples, so that the winding is checked as well
+    auto key = [](uint a, uint b, uint c) noexcept {
+        auto m = std::min({a, b, c});
+        auto k = m == a ? make_uint3(a, b, c) : (m == b ? make_uint3(b, c, a) : make_uint3(c, a, b));
+        return (static_cast<uint64_t>(k.x) << 42u) | (static_cast<uint64_t>(k.y) << 21u) | k.z;
+    };
+    luisa::unordered_map<uint64_t, uint> faces;
+    for (auto i = 0u; i < expected.triangles.size(); i++) {
+        auto t = expected.triangles[i];
+        faces.emplace(key(t.i0, t.i1, t.i2), expected.base_triangle_indices[i]);
+    }
+    for (auto i = 0u; i < actual.triangles.size(); i++) {
+        auto t = actual.triangles[i];
+        auto iter = faces.find(key(remap[t.i0], remap[t.i1], remap[t.i2]));
+        LUISA_ASSERT(iter != faces.end(), "Triangle {} is not in the reference.", i);
+        LUISA_ASSERT(iter->second == actual.base_triangle_indices[i],
+                     "Triangle {} comes from base triangle {} instead of {}.",
+                     i, actual.base_triangle_indices[i], iter->second);
+    }
+}
+
+// every directed edge is matched by exactly one opposite edge, i.e., no cracks or T-junctions
+static void check_watertight(const SubdivMesh &mesh) noexcept {
+    luisa::unordered_map<uint64_t, uint> edges;
+    auto edge = [](uint a, uint b) noexcept { return (static_cast<uint64_t>(a) << 32u) | b; };
+    for (auto t : mesh.triangles) {
+        for (auto [a, b] : {std::pair{t.i0, t.i1}, std::pair{t.i1, t.i2}, std::pair{t.i2, t.i0}}) {
+            LUISA_ASSERT(a != b, "Degenerate triangle.");
+            LUISA_ASSERT(edges.emplace(edge(a, b), 0u).second, "Edge ({}, {}) is used twice.", a, b);
+        }
+    }
+    for (auto [e, _] : edges) {
+        auto a = static_cast<uint>(e >> 32u);
+        auto b = static_cast<uint>(e & 0xffffffffu);
+        LUISA_ASSERT(edges.contains(edge(b, a)), "Edge ({}, {}) has no opposite edge.", a, b);
+    }
+}
+
+int main() {
+    static_cast<void>(global_thread_pool());
+
+    // uniform subdivision matches the previous implementation, with and without boundaries
+    for (auto &&[name, base] : {std::pair{"icosahedron", icosahedron(make_float3(1.f))},
+                                std::pair{"grid", grid(4u)}}) {
+        for (auto level = 1u; level <= 3u; level++) {
+            auto expected = reference::loop_subdivide(base.vertices, base.triangles, level);
+            auto actual = loop_subdivide(base.vertices, base.triangles, level);
+            check_same_mesh(expected, actual, 1e-4f);
+            LUISA_INFO("Uniform subdivision of the {} at level {} matches the reference "
+                       "({} vertices, {} triangles).",
+                       name, level, actual.vertices.size(), actual.triangles.size());
+        }
+    }
+
+    // the parallel passes produce the same mesh, even when run from a pool task
+    {
+        auto base = icosahedron(make_float3(1.f));
+        auto serial = loop_subdivide(base.vertices, base.triangles, 5u);
+        Clock clock;
+        auto parallel = global_thread_pool().async([&base] {
+                                                 return loop_subdivide(base.vertices, base.triangles,
+                                                                       LoopSubdivOptions{.level = 5u, .parallel = true});
+                                             })
+                            .get();
+        check_same_mesh(serial, parallel, 1e-5f);
+        LUISA_INFO("Parallel subdivision in a pool task matches the serial one ({} ms).", clock.toc());
+    }
+
+    // adaptive subdivision of a stretched closed mesh splits some faces and stays watertight
+    {
+        auto base = icosahedron(make_float3(4.f, 1.f, 1.f));
+        // only the edges stretched along x are longer than the threshold at first
+        auto min_edge = std::numeric_limits<float>::max();
+        auto max_edge = 0.f;
+        for (auto t : base.triangles) {
+            auto l = distance(base.vertices[t.i0].position(), base.vertices[t.i1].position());
+            min_edge = std::min(min_edge, l);
+            max_edge = std::max(max_edge, l);
+        }
+        for (auto level = 1u; level <= 4u; level++) {
+            auto mesh = loop_subdivide(base.vertices, base.triangles,
+                                       LoopSubdivOptions{.level = level,
+                                                         .adaptive = true,
+                                                         .max_edge_length = .5f * (min_edge + max_edge),
+                                                         .parallel = true});
+            check_watertight(mesh);
+            auto uniform_count = base.triangles.size() << (2u * level);
+            LUISA_ASSERT(mesh.triangles.size() > base.triangles.size() &&
+                             mesh.triangles.size() < uniform_count,
+                         "Adaptive subdivision at level {} produced {} triangles, "
+                         "expected between {} and {}.",
+                         level, mesh.triangles.size(), base.triangles.size(), uniform_count);
+            LUISA_INFO("Adaptive subdivision at level {} is watertight ({} triangles).",
+                       level, mesh.triangles.size());
+        }
+    }
+}
@@ -34,6 +34,12 @@ public:
         auto off_is_constant = _off == nullptr || _off->is_constant();
         return on_is_constant && off_is_constant;
     }
+    [[nodiscard]] luisa::optional<float4> evaluate_average() const noexcept override {
+        auto on = _on == nullptr ? luisa::make_optional(make_float4(1.f)) : _on->evaluate_average();
+        auto off = _off == nullptr ? luisa::make_optional(make_float4(0.f)) : _off->evaluate_average();
+        if (on && off) { return .5f * (*on + *off); }
+        return luisa::nullopt;
+    }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] uint channels() const noexcept override {
         auto on_channels = _on == nullptr ? 4u : _on->channels();
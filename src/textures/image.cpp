@@ -2,8 +2,12 @@
 // Created by Mike Smith on 2022/3/23.
 //
 
+#include <atomic>
+#include <mutex>
+
 #include <util/thread_pool.h>
 #include <util/imageio.h>
+#include <util/tiled_image.h>
 #include <util/half.h>
 #include <base/texture.h>
 #include <base/pipeline.h>
@@ -23,6 +27,7 @@ public:
     };
 
 private:
+    std::filesystem::path _path;
     std::shared_future<LoadedImage> _image;
     float2 _uv_scale;
     float2 _uv_offset;
@@ -31,6 +36,25 @@ private:
     float _scale{1.f};
     float _gamma{1.f};
     uint _mipmaps{0u};
+    // on-demand streaming of tiled textures
+    bool _tiled{false};
+    uint _tile_pool_size{0u};
+    uint _tile_lod{0u};
+    uint _max_tile_uploads{0u};
+    std::shared_future<TiledImage> _tiled_image;
+    // lazily computed for light samplers
+    mutable std::once_flag _average_flag;
+    mutable float4 _average{};
+    // lazily computed for opacity classification, before decoding
+    mutable std::once_flag _texel_range_flag;
+    mutable std::pair<float4, float4> _texel_range{};
+    // lazily computed for caches of derived data
+    mutable std::once_flag _content_hash_flag;
+    mutable luisa::optional<uint64_t> _content_hash;
+
+public:
+    // larger footprints are bounded by the range of the whole image
+    static constexpr auto max_range_texels = 1u << 16u;
 
 private:
     void _load_image(std::filesystem::path path) noexcept {
@@ -39,6 +63,53 @@ private:
         });
     }
 
+    // looks up (or creates) the tiled and mip-mapped version of the image in `folder`
+    void _load_tiled_image(std::filesystem::path path, std::filesystem::path folder, uint tile_size) noexcept {
+        auto address = [this] {
+            switch (_sampler.address()) {
+                case TextureSampler::Address::EDGE: return TiledImage::Address::EDGE;
+                case TextureSampler::Address::REPEAT: return TiledImage::Address::REPEAT;
+                case TextureSampler::Address::MIRROR: return TiledImage::Address::MIRROR;
+                case TextureSampler::Address::ZERO: return TiledImage::Address::ZERO;
+                default: break;
+            }
+            return TiledImage::Address::REPEAT;
+        }();
+        auto srgb = _encoding == Encoding::SRGB;
+        _tiled_image = global_thread_pool().async([path = std::move(path), folder = std::move(folder),
+                                                   tile_size, address, srgb] {
+            auto tiled_path = [&] {
+                auto file = MappedFile::open(path);
+                LUISA_ASSERT(file, "Failed to open image '{}'.", path.string());
+                auto options = make_uint2(tile_size, (luisa::to_underlying(address) << 1u) | static_cast<uint>(srgb));
+                auto hash = luisa::hash64(file.data(), file.size(), luisa::hash64_default_seed);
+                hash = luisa::hash64(&options, sizeof(options), hash);
+                return folder / luisa::format("{:016x}.tiled", hash);
+            }();
+            if (auto tiled = TiledImage::open(tiled_path)) { return std::move(*tiled); }
+            if (!TiledImage::convert(LoadedImage::load(path), tiled_path, tile_size, address, srgb)) [[unlikely]] {
+                LUISA_ERROR_WITH_LOCATION(
+                    "Failed to convert image '{}' into tiled image '{}'.",
+                    path.string(), tiled_path.string());
+            }
+            auto tiled = TiledImage::open(tiled_path);
+            LUISA_ASSERT(tiled.has_value(), "Failed to open tiled image '{}'.", tiled_path.string());
+            return std::move(*tiled);
+        });
+    }
+
+    [[nodiscard]] float4 _decode_host(float4 v) const noexcept {
+        auto f = [this](float x) noexcept {
+            switch (_encoding) {
+                case Encoding::SRGB: return x <= 0.04045f ? x * (1.f / 12.92f) : std::pow((x + 0.055f) * (1.f / 1.055f), 2.4f);
+                case Encoding::GAMMA: return std::pow(x, _gamma);
+                default: break;
+            }
+            return x;
+        };
+        return _scale * make_float4(f(v.x), f(v.y), f(v.z), f(v.w));
+    }
+
     void _generate_mipmaps_gamma(Pipeline &pipeline, CommandBuffer &command_buffer, Image<float> &image) const noexcept;
     void _generate_mipmaps_linear(Pipeline &pipeline, CommandBuffer &command_buffer, Image<float> &image) const noexcept;
     void _generate_mipmaps_sRGB(Pipeline &pipeline, CommandBuffer &command_buffer, Image<float> &image) const noexcept;
@@ -82,6 +153,7 @@ public:
                     "uv_offset", 0.0f));
             }));
         auto path = desc->property_path("file");
+        _path = path;
         auto encoding = desc->property_string_or_default(
             "encoding", lazy_construct([&path]() noexcept -> luisa::string {
                 auto ext = path.extension().string();
@@ -108,7 +180,31 @@ public:
         _mipmaps = desc->property_uint_or_default(
             "mipmaps", filter_mode == TextureSampler::Filter::ANISOTROPIC ? 0u : 1u);
         if (filter_mode == TextureSampler::Filter::POINT) { _mipmaps = 1u; }
-        _load_image(path);
+        _tiled = desc->property_bool_or_default("tiled", false);
+        // the tiled copy is written to the cache directory, or to the system temporary
+        // directory if on-disk caching is disabled, never next to the scene's images
+        auto folder = scene->cache_directory();
+        if (_tiled && folder.empty()) {
+            std::error_code ec;
+            if (auto temp = std::filesystem::temp_directory_path(ec); !ec) {
+                folder = temp / "luisa-render-cache";
+            } else [[unlikely]] {
+                LUISA_WARNING_WITH_LOCATION(
+                    "No cache directory for tiled texture '{}'. "
+                    "Fallback to an untiled texture. [{}]",
+                    path.string(), desc->source_location().string());
+                _tiled = false;
+            }
+        }
+        if (_tiled) {
+            auto tile_size = std::clamp(desc->property_uint_or_default("tile_size", 128u), 16u, 1024u);
+            _tile_pool_size = std::max(desc->property_uint_or_default("tile_pool", 1024u), 16u);
+            _tile_lod = desc->property_uint_or_default("lod", 0u);
+            _max_tile_uploads = std::max(desc->property_uint_or_default("max_tile_uploads", 256u), 1u);
+            _load_tiled_image(std::move(path), folder / "textures", tile_size);
+        } else {
+            _load_image(path);
+        }
     }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] bool is_black() const noexcept override { return _scale == 0.f; }
@@ -118,17 +214,165 @@ public:
     [[nodiscard]] auto uv_scale() const noexcept { return _uv_scale; }
     [[nodiscard]] auto uv_offset() const noexcept { return _uv_offset; }
     [[nodiscard]] auto encoding() const noexcept { return _encoding; }
-    [[nodiscard]] uint channels() const noexcept override { return _image.get().channels(); }
+    [[nodiscard]] auto sampler() const noexcept { return _sampler; }
+    [[nodiscard]] auto tile_pool_size() const noexcept { return _tile_pool_size; }
+    [[nodiscard]] auto tile_lod() const noexcept { return _tile_lod; }
+    [[nodiscard]] auto max_tile_uploads() const noexcept { return _max_tile_uploads; }
+    [[nodiscard]] uint channels() const noexcept override {
+        return _tiled ? _tiled_image.get().channels() : _image.get().channels();
+    }
+    [[nodiscard]] luisa::optional<float4> evaluate_average() const noexcept override;
+    [[nodiscard]] luisa::optional<std::pair<float4, float4>> evaluate_range(
+        float2 uv_min, float2 uv_max) const noexcept override;
+    [[nodiscard]] luisa::optional<uint64_t> content_hash() const noexcept override;
+    [[nodiscard]] luisa::optional<float2> texel_density() const noexcept override {
+        auto size = _tiled ? _tiled_image.get().size() : _image.get().size();
+        return make_float2(size) * abs(_uv_scale);
+    }
     [[nodiscard]] luisa::unique_ptr<Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
 };
 
-class ImageTextureInstance final : public Texture::Instance {
+luisa::optional<float4> ImageTexture::evaluate_average() const noexcept {
+    std::call_once(_average_flag, [this] {
+        if (_tiled) {
+            // the coarsest level is a single texel, read it from the
+            // interior of the padded tile and decode as the shader does
+            auto &&tiled = _tiled_image.get();
+            auto tile = tiled.tile(tiled.level_table().back().w);
+            auto offset = (tiled.padded_tile_size() + 1u) * tiled.texel_words();
+            auto v = make_float4(0.f);
+            if (tiled.texel_words() == 1u) {
+                auto packed = tile[offset];
+                v = make_float4(make_uint4(packed & 0xffu, (packed >> 8u) & 0xffu,
+                                           (packed >> 16u) & 0xffu, packed >> 24u)) *
+                    (1.f / 255.f);
+            } else {
+                std::memcpy(&v, tile.data() + offset, sizeof(float4));
+            }
+            _average = _decode_host(v);
+        } else {
+            // average rows first to keep the float sums well-conditioned
+            auto &&image = _image.get();
+            auto size = image.size();
+            auto sum = make_float4(0.f);
+            for (auto y = 0u; y < size.y; y++) {
+                auto row = make_float4(0.f);
+                for (auto x = 0u; x < size.x; x++) { row += _decode_host(image.texel(y * size.x + x)); }
+                sum += row / static_cast<float>(size.x);
+            }
+            _average = sum / static_cast<float>(std::max(size.y, 1u));
+        }
+    });
+    return _average;
+}
+
+luisa::optional<uint64_t> ImageTexture::content_hash() const noexcept {
+    std::call_once(_content_hash_flag, [this] {
+        auto file = MappedFile::open(_path);
+        if (!file) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Failed to map image '{}' for hashing.",
+                _path.string());
+            return;
+        }
+        auto hash = luisa::hash64(file.data(), file.size(), luisa::hash64_default_seed);
+        // and the parameters that change the values looked up from the image
+        auto encoding = luisa::to_underlying(_encoding);
+        auto address = luisa::to_underlying(_sampler.address());
+        auto filter = luisa::to_underlying(_sampler.filter());
+        hash = luisa::hash64(&_uv_scale, sizeof(_uv_scale), hash);
+        hash = luisa::hash64(&_uv_offset, sizeof(_uv_offset), hash);
+        hash = luisa::hash64(&encoding, sizeof(encoding), hash);
+        hash = luisa::hash64(&address, sizeof(address), hash);
+        hash = luisa::hash64(&filter, sizeof(filter), hash);
+        hash = luisa::hash64(&_scale, sizeof(_scale), hash);
+        hash = luisa::hash64(&_gamma, sizeof(_gamma), hash);
+        _content_hash.emplace(hash);
+    });
+    return _content_hash;
+}
 
-private:
-    uint _texture_id;
+luisa::optional<std::pair<float4, float4>> ImageTexture::evaluate_range(float2 uv_min, float2 uv_max) const noexcept {
+    // tiles of streamed textures are not kept on the host
+    if (_tiled) { return luisa::nullopt; }
+    auto &&image = _image.get();
+    auto size = image.size();
+    // texels touched by bilinear lookups in the rectangle, with a texel of slack
+    // on each side to absorb rounding of the interpolated UVs
+    auto st_a = (uv_min * _uv_scale + _uv_offset) * make_float2(size);
+    auto st_b = (uv_max * _uv_scale + _uv_offset) * make_float2(size);
+    auto st_min = clamp(min(st_a, st_b) - 1.f, -1e15f, 1e15f);
+    auto st_max = clamp(max(st_a, st_b) + 1.f, -1e15f, 1e15f);
+    if (!std::isfinite(st_min.x) || !std::isfinite(st_min.y) ||
+        !std::isfinite(st_max.x) || !std::isfinite(st_max.y)) { return luisa::nullopt; }
+    auto address = _sampler.address();
+    // clip the texel span to the texels it can reach after addressing
+    auto span = [address](float lo, float hi, int64_t n) noexcept {
+        auto i0 = static_cast<int64_t>(std::floor(lo));
+        auto i1 = static_cast<int64_t>(std::floor(hi));
+        switch (address) {
+            case TextureSampler::Address::EDGE: return std::make_pair(std::clamp<int64_t>(i0, 0, n - 1), std::clamp<int64_t>(i1, 0, n - 1));
+            case TextureSampler::Address::ZERO: return std::make_pair(std::clamp<int64_t>(i0, -1, n), std::clamp<int64_t>(i1, -1, n));
+            default: break;
+        }
+        return std::make_pair(i0, std::min(i1, i0 + 2 * n - 1));
+    };
+    // texel index after addressing, or -1 for the zero border
+    auto wrap = [address](int64_t i, int64_t n) noexcept -> int64_t {
+        switch (address) {
+            case TextureSampler::Address::REPEAT: return (i % n + n) % n;
+            case TextureSampler::Address::MIRROR: {
+                auto m = (i % (2 * n) + 2 * n) % (2 * n);
+                return m < n ? m : 2 * n - 1 - m;
+            }
+            default: break;
+        }
+        return i >= 0 && i < n ? i : -1;
+    };
+    auto [x0, x1] = span(st_min.x, st_max.x, size.x);
+    auto [y0, y1] = span(st_min.y, st_max.y, size.y);
+    auto raw_min = make_float4(std::numeric_limits<float>::max());
+    auto raw_max = make_float4(-std::numeric_limits<float>::max());
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > max_range_texels) {
+        std::call_once(_texel_range_flag, [&image, size, this] {
+            auto lo = make_float4(std::numeric_limits<float>::max());
+            auto hi = make_float4(-std::numeric_limits<float>::max());
+            for (auto i = 0u; i < size.x * size.y; i++) {
+                auto v = image.texel(i);
+                lo = min(lo, v);
+                hi = max(hi, v);
+            }
+            _texel_range = std::make_pair(lo, hi);
+        });
+        raw_min = _texel_range.first;
+        raw_max = _texel_range.second;
+        if (address == TextureSampler::Address::ZERO) {
+            raw_min = min(raw_min, make_float4(0.f));
+            raw_max = max(raw_max, make_float4(0.f));
+        }
+    } else {
+        for (auto y = y0; y <= y1; y++) {
+            for (auto x = x0; x <= x1; x++) {
+                auto wx = wrap(x, size.x);
+                auto wy = wrap(y, size.y);
+                auto v = wx < 0 || wy < 0 ?
+                             make_float4(0.f) :
+                             image.texel(static_cast<size_t>(wy) * size.x + static_cast<size_t>(wx));
+                raw_min = min(raw_min, v);
+                raw_max = max(raw_max, v);
+            }
+        }
+    }
+    // decoding is monotonic in each channel, up to the sign of the scale
+    auto lo = _decode_host(raw_min);
+    auto hi = _decode_host(raw_max);
+    return std::make_pair(min(lo, hi), max(lo, hi));
+}
 
-private:
+class ImageTextureInstanceBase : public Texture::Instance {
+
+protected:
     [[nodiscard]] Float2 _compute_uv(const Interaction &it) const noexcept {
         auto texture = node<ImageTexture>();
         auto uv_scale = texture->uv_scale();
@@ -154,11 +398,20 @@ private:
         return scale * rgba;
     }
 
+public:
+    using Texture::Instance::Instance;
+};
+
+class ImageTextureInstance final : public ImageTextureInstanceBase {
+
+private:
+    uint _texture_id;
+
 public:
     ImageTextureInstance(const Pipeline &pipeline,
                          const Texture *texture,
                          uint texture_id) noexcept
-        : Texture::Instance{pipeline, texture},
+        : ImageTextureInstanceBase{pipeline, texture},
           _texture_id{texture_id} {}
     [[nodiscard]] Float4 evaluate(
         const Interaction &it, const SampledWavelengths &swl, Expr<float> time) const noexcept override {
@@ -168,7 +421,228 @@ public:
     }
 };
 
+// Virtual texture: tiles live in a fixed-size device pool and are paged in on demand.
+// Shading records the tiles it wants in a feedback buffer and falls back to the finest
+// resident mip level; between sample passes the host reads the feedback back (without
+// stalling the stream) and uploads missing tiles, evicting the least recently used ones.
+class TiledImageTextureInstance final : public ImageTextureInstanceBase {
+
+private:
+    const TiledImage &_image;
+    uint _pool_slots;
+    uint _pinned_slots;
+    Buffer<uint> _pool;
+    Buffer<uint> _page_table;// slot + 1 for resident tiles, 0 otherwise
+    Buffer<uint> _feedback;  // non-zero for tiles requested since the last readback
+    Buffer<uint4> _levels;
+    // host-side pager state
+    luisa::vector<uint> _host_page_table;
+    luisa::vector<uint> _host_feedback;
+    luisa::vector<uint> _zeros;
+    luisa::vector<uint> _slot_tiles;
+    luisa::vector<uint> _slot_last_used;
+    luisa::vector<uint> _free_slots;
+    uint _frame{0u};
+    bool _feedback_pending{false};
+    std::atomic<bool> _feedback_ready{false};
+
+private:
+    void _page_in(CommandBuffer &command_buffer) noexcept {
+        _frame++;
+        luisa::vector<uint> missing;
+        for (auto tile = 0u; tile < _image.tile_count(); tile++) {
+            if (_host_feedback[tile] == 0u) { continue; }
+            if (auto entry = _host_page_table[tile]; entry != 0u) {
+                _slot_last_used[entry - 1u] = _frame;
+            } else {
+                missing.emplace_back(tile);
+            }
+        }
+        if (missing.empty()) { return; }
+        // coarser levels come later in the tile list; page them in first
+        // so that every request gets a close fallback as soon as possible
+        std::sort(missing.begin(), missing.end(), std::greater<>{});
+        if (auto max_uploads = node<ImageTexture>()->max_tile_uploads();
+            missing.size() > max_uploads) { missing.resize(max_uploads); }
+        luisa::vector<uint> victims;
+        if (missing.size() > _free_slots.size()) {
+            for (auto slot = _pinned_slots; slot < _pool_slots; slot++) {
+                if (_slot_tiles[slot] != ~0u && _slot_last_used[slot] != _frame) {
+                    victims.emplace_back(slot);
+                }
+            }
+            std::sort(victims.begin(), victims.end(), [this](auto lhs, auto rhs) noexcept {
+                return _slot_last_used[lhs] < _slot_last_used[rhs];
+            });
+        }
+        auto victim_count = 0u;
+        auto upload_count = 0u;
+        auto tile_words = _image.tile_words();
+        for (auto tile : missing) {
+            auto slot = 0u;
+            if (!_free_slots.empty()) {
+                slot = _free_slots.back();
+                _free_slots.pop_back();
+            } else if (victim_count < victims.size()) {
+                slot = victims[victim_count++];
+                _host_page_table[_slot_tiles[slot]] = 0u;
+            } else {
+                break;// the pool is saturated by tiles in use
+            }
+            _slot_tiles[slot] = tile;
+            _slot_last_used[slot] = _frame;
+            _host_page_table[tile] = slot + 1u;
+            command_buffer << _pool.view(static_cast<size_t>(slot) * tile_words, tile_words)
+                                  .copy_from(_image.tile(tile).data());
+            upload_count++;
+        }
+        if (upload_count != 0u) {
+            command_buffer << _page_table.copy_from(_host_page_table.data());
+        }
+    }
+
+    [[nodiscard]] Float4 _fetch(Expr<uint> slot, Expr<uint2> texel) const noexcept {
+        auto padded = _image.padded_tile_size();
+        auto texel_words = _image.texel_words();
+        auto address = (slot - 1u) * _image.tile_words() + (texel.y * padded + texel.x) * texel_words;
+        if (texel_words == 1u) {
+            auto x = _pool->read(address);
+            return make_float4(make_uint4(x & 0xffu, (x >> 8u) & 0xffu, (x >> 16u) & 0xffu, x >> 24u)) * (1.f / 255.f);
+        }
+        return make_float4(compute::as<float>(_pool->read(address + 0u)),
+                           compute::as<float>(_pool->read(address + 1u)),
+                           compute::as<float>(_pool->read(address + 2u)),
+                           compute::as<float>(_pool->read(address + 3u)));
+    }
+
+public:
+    TiledImageTextureInstance(Pipeline &pipeline, CommandBuffer &command_buffer,
+                              const ImageTexture *texture, const TiledImage &image) noexcept
+        : ImageTextureInstanceBase{pipeline, texture}, _image{image} {
+        auto tile_count = image.tile_count();
+        // the single-tile levels at the tail of the mip chain stay resident as the last fallback
+        _pinned_slots = 0u;
+        for (auto level : image.level_table()) {
+            if (level.z == 1u && level.y <= image.tile_size()) { _pinned_slots++; }
+        }
+        _pool_slots = std::min(std::max(texture->tile_pool_size(), _pinned_slots + 1u), tile_count);
+        _pool = pipeline.device().create_buffer<uint>(static_cast<size_t>(_pool_slots) * image.tile_words());
+        _page_table = pipeline.device().create_buffer<uint>(tile_count);
+        _feedback = pipeline.device().create_buffer<uint>(tile_count);
+        _levels = pipeline.device().create_buffer<uint4>(image.levels());
+        _host_page_table.resize(tile_count, 0u);
+        _host_feedback.resize(tile_count, 0u);
+        _zeros.resize(tile_count, 0u);
+        _slot_tiles.resize(_pool_slots, ~0u);
+        _slot_last_used.resize(_pool_slots, 0u);
+        for (auto i = 0u; i < _pinned_slots; i++) {
+            auto tile = tile_count - _pinned_slots + i;
+            _slot_tiles[i] = tile;
+            _host_page_table[tile] = i + 1u;
+            command_buffer << _pool.view(static_cast<size_t>(i) * image.tile_words(), image.tile_words())
+                                  .copy_from(image.tile(tile).data());
+        }
+        _free_slots.reserve(_pool_slots - _pinned_slots);
+        for (auto i = _pool_slots; i > _pinned_slots; i--) { _free_slots.emplace_back(i - 1u); }
+        command_buffer << _page_table.copy_from(_host_page_table.data())
+                       << _feedback.copy_from(_zeros.data())
+                       << _levels.copy_from(image.level_table().data())
+                       << compute::commit();
+        LUISA_INFO("Created tiled texture with {} tiles of {}x{} "
+                   "texels and a device pool of {} tiles.",
+                   tile_count, image.tile_size(), image.tile_size(), _pool_slots);
+    }
+
+    // host-side pager, called between sample passes; a synchronous call waits
+    // for the readback and serves the requests recorded so far right away
+    void stream(CommandBuffer &command_buffer, bool synchronous) noexcept {
+        if (_feedback_pending) {
+            if (synchronous) { command_buffer << compute::synchronize(); }
+            // the previous readback has not arrived yet; try again next time
+            if (!_feedback_ready.load(std::memory_order_acquire)) { return; }
+            _feedback_ready.store(false, std::memory_order_relaxed);
+            _feedback_pending = false;
+            _page_in(command_buffer);
+        }
+        command_buffer << _feedback.copy_to(_host_feedback.data())
+                       << _feedback.copy_from(_zeros.data())
+                       << [this] { _feedback_ready.store(true, std::memory_order_release); };
+        _feedback_pending = true;
+        if (synchronous) {
+            command_buffer << compute::synchronize();
+            _feedback_ready.store(false, std::memory_order_relaxed);
+            _feedback_pending = false;
+            _page_in(command_buffer);
+        }
+    }
+
+    [[nodiscard]] Float4 evaluate(
+        const Interaction &it, const SampledWavelengths &swl, Expr<float> time) const noexcept override {
+        auto texture = node<ImageTexture>();
+        auto uv = _compute_uv(it);
+        auto address = texture->sampler().address();
+        auto outside = def(false);
+        switch (address) {
+            case TextureSampler::Address::EDGE: uv = clamp(uv, 0.f, 1.f); break;
+            case TextureSampler::Address::MIRROR: {
+                auto m = fract(uv * .5f) * 2.f;
+                uv = ite(m > 1.f, 2.f - m, m);
+                break;
+            }
+            case TextureSampler::Address::ZERO: outside = any(uv < 0.f | uv >= 1.f); break;
+            default: uv = fract(uv); break;
+        }
+        auto tile_size = _image.tile_size();
+        auto tile_index = [&](Expr<uint> level) noexcept {
+            auto info = _levels->read(level);
+            auto st = uv * make_float2(info.xy());
+            auto tile = min(make_uint2(st / static_cast<float>(tile_size)),
+                            (info.xy() - 1u) / tile_size);
+            return std::make_pair(info.w + tile.y * info.z + tile.x,
+                                  st - make_float2(tile * tile_size));
+        };
+        auto level_count = _image.levels();
+        auto requested = std::min(texture->tile_lod(), level_count - 1u);
+        auto value = def(make_float4());
+        $if(!outside) {
+            _feedback->write(tile_index(requested).first, 1u);
+            // fall back to the finest resident level; the coarsest ones are always resident
+            auto level = def(requested);
+            auto slot = def(0u);
+            auto local = def(make_float2());
+            $loop {
+                auto [tile, st] = tile_index(level);
+                slot = _page_table->read(tile);
+                local = st;
+                $if(slot != 0u | level + 1u == level_count) { $break; };
+                level += 1u;
+            };
+            if (texture->sampler().filter() == TextureSampler::Filter::POINT) {
+                value = _fetch(slot, make_uint2(local) + 1u);
+            } else {
+                auto q = local + .5f;
+                auto t = fract(q);
+                auto p = make_uint2(q);
+                auto v00 = _fetch(slot, p);
+                auto v10 = _fetch(slot, p + make_uint2(1u, 0u));
+                auto v01 = _fetch(slot, p + make_uint2(0u, 1u));
+                auto v11 = _fetch(slot, p + 1u);
+                value = lerp(lerp(v00, v10, t.x), lerp(v01, v11, t.x), t.y);
+            }
+        };
+        return _decode(value);
+    }
+};
+
 luisa::unique_ptr<Texture::Instance> ImageTexture::build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    if (_tiled) {
+        auto instance = luisa::make_unique<TiledImageTextureInstance>(
+            pipeline, command_buffer, this, _tiled_image.get());
+        pipeline.register_streaming_callback([p = instance.get()](CommandBuffer &cb, bool synchronous) noexcept {
+            p->stream(cb, synchronous);
+        });
+        return instance;
+    }
     auto &&image = _image.get();
     auto device_image = pipeline.create<Image<float>>(image.pixel_storage(), image.size(), _mipmaps);
     auto tex_id = pipeline.register_bindless(*device_image, _sampler);
@@ -70,6 +70,28 @@ public:
         }
         return nullopt;
     }
+    [[nodiscard]] luisa::optional<float4> evaluate_average() const noexcept override {
+        if (auto v = _base->evaluate_average()) {
+            auto s = make_float4(0.f);
+            for (auto i = 0u; i < channels(); i++) { s[i] = (*v)[swizzle(i)]; }
+            return s;
+        }
+        return nullopt;
+    }
+    [[nodiscard]] luisa::optional<float2> texel_density() const noexcept override { return _base->texel_density(); }
+    [[nodiscard]] luisa::optional<std::pair<float4, float4>> evaluate_range(
+        float2 uv_min, float2 uv_max) const noexcept override {
+        if (auto r = _base->evaluate_range(uv_min, uv_max)) {
+            auto lo = make_float4(0.f);
+            auto hi = make_float4(0.f);
+            for (auto i = 0u; i < channels(); i++) {
+                lo[i] = r->first[swizzle(i)];
+                hi[i] = r->second[swizzle(i)];
+            }
+            return std::make_pair(lo, hi);
+        }
+        return nullopt;
+    }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] uint channels() const noexcept override { return _swizzle >> 16u; }
     [[nodiscard]] luisa::unique_ptr<Instance> build(
@@ -0,0 +1,182 @@
+#include <util/frame.h>
+#include <util/analytic_primitive.h>
+
+namespace luisa::render {
+
+using compute::Callable;
+
+AnalyticPrimitive AnalyticPrimitive::sphere(float3 center, float radius) noexcept {
+    return AnalyticPrimitive{center.x, center.y, center.z, radius,
+                             center.x, center.y, center.z, radius,
+                             0.f, 0.f, 1.f, kind_sphere};
+}
+
+AnalyticPrimitive AnalyticPrimitive::round_curve(float3 p0, float r0, float3 p1, float r1) noexcept {
+    // the swept sphere is only well-defined if the end spheres do not contain each other
+    if (auto l = length(p1 - p0); std::abs(r0 - r1) >= l) {
+        if (r0 > r1) {
+            r0 = r1 + .999f * l;
+        } else {
+            r1 = r0 + .999f * l;
+        }
+    }
+    return AnalyticPrimitive{p0.x, p0.y, p0.z, r0,
+                             p1.x, p1.y, p1.z, r1,
+                             0.f, 0.f, 1.f, kind_round_curve};
+}
+
+AnalyticPrimitive AnalyticPrimitive::ribbon_curve(float3 p0, float r0, float3 p1, float r1, float3 n) noexcept {
+    // the stored normal is the facing direction made orthogonal to the segment
+    auto t = normalize(p1 - p0);
+    auto w = cross(n, t);
+    if (dot(w, w) < 1e-12f) {
+        auto a = std::abs(t.x) < .9f ? make_float3(1.f, 0.f, 0.f) : make_float3(0.f, 1.f, 0.f);
+        w = cross(a, t);
+    }
+    auto np = normalize(cross(t, normalize(w)));
+    return AnalyticPrimitive{p0.x, p0.y, p0.z, r0,
+                             p1.x, p1.y, p1.z, r1,
+                             np.x, np.y, np.z, kind_ribbon_curve};
+}
+
+AABB AnalyticPrimitive::bounds() const noexcept {
+    auto b_min = min(p0() - r0, p1() - r1);
+    auto b_max = max(p0() + r0, p1() + r1);
+    return AABB{.packed_min = {b_min.x, b_min.y, b_min.z},
+                .packed_max = {b_max.x, b_max.y, b_max.z}};
+}
+
+Float intersect_analytic_primitive(const Var<AnalyticPrimitive> &primitive,
+                                   Expr<float3> o, Expr<float3> d,
+                                   Expr<float> t_min, Expr<float> t_max) noexcept {
+    static Callable impl = [](Var<AnalyticPrimitive> prim, Float3 o, Float3 d_in,
+                              Float t_min_in, Float t_max_in) noexcept {
+        // intersect with a unit direction and scale the distance back
+        auto scale = length(d_in);
+        auto d = d_in / scale;
+        auto t_min = t_min_in * scale;
+        auto t_max = t_max_in * scale;
+        auto in_range = [&](auto t) noexcept { return t >= t_min & t <= t_max; };
+        auto pa = prim->p0();
+        auto pb = prim->p1();
+        auto ra = prim.r0;
+        auto rb = prim.r1;
+        auto t = def(-1.f);
+        auto closer = [&](auto valid, auto t_new) noexcept {
+            t = ite(valid & in_range(t_new) & (t < 0.f | t_new < t), t_new, t);
+        };
+        $switch(prim.kind) {
+            $case(AnalyticPrimitive::kind_sphere) {
+                auto oc = o - pa;
+                auto b = dot(oc, d);
+                auto h = b * b - (dot(oc, oc) - ra * ra);
+                auto s = sqrt(max(h, 0.f));
+                closer(h >= 0.f, -b - s);
+                closer(h >= 0.f, -b + s);
+            };
+            $case(AnalyticPrimitive::kind_round_curve) {
+                // Quilez's rounded cone, extended to report exit points for rays starting inside
+                auto ba = pb - pa;
+                auto oa = o - pa;
+                auto ob = o - pb;
+                auto rr = ra - rb;
+                auto m0 = dot(ba, ba);
+                auto m1 = dot(ba, oa);
+                auto m2 = dot(ba, d);
+                auto m3 = dot(d, oa);
+                auto m5 = dot(oa, oa);
+                auto m6 = dot(ob, d);
+                auto m7 = dot(ob, ob);
+                auto d2 = m0 - rr * rr;
+                // the part of the surface a point lies on follows from its position along the axis
+                auto y = [&](auto t) noexcept { return m1 - ra * rr + t * m2; };
+                // body
+                auto k2 = d2 - m2 * m2;
+                auto k1 = d2 * m3 - m1 * m2 + m2 * rr * ra;
+                auto k0 = d2 * m5 - m1 * m1 + m1 * rr * ra * 2.f - m0 * ra * ra;
+                auto h = k1 * k1 - k0 * k2;
+                auto sh = sqrt(max(h, 0.f));
+                for (auto sign : {-1.f, 1.f}) {
+                    auto tb = (sign * sh - k1) / k2;
+                    closer(h >= 0.f & y(tb) > 0.f & y(tb) < d2, tb);
+                }
+                // caps
+                auto h1 = m3 * m3 - m5 + ra * ra;
+                auto h2 = m6 * m6 - m7 + rb * rb;
+                auto sh1 = sqrt(max(h1, 0.f));
+                auto sh2 = sqrt(max(h2, 0.f));
+                for (auto sign : {-1.f, 1.f}) {
+                    auto ta = -m3 + sign * sh1;
+                    closer(h1 >= 0.f & y(ta) <= 0.f, ta);
+                    auto tb = -m6 + sign * sh2;
+                    closer(h2 >= 0.f & y(tb) >= d2, tb);
+                }
+            };
+            $default {
+                auto ba = pb - pa;
+                auto np = prim->n();
+                auto w = normalize(cross(np, ba));
+                auto tp = dot(pa - o, np) / dot(d, np);
+                auto q = o + tp * d - pa;
+                auto s = dot(q, ba) / dot(ba, ba);
+                auto l = dot(q, w);
+                closer(s >= 0.f & s <= 1.f & abs(l) <= lerp(ra, rb, s), tp);
+            };
+        };
+        return ite(t < 0.f, -1.f, t / scale);
+    };
+    return impl(primitive, o, d, t_min, t_max);
+}
+
+AnalyticSurface analytic_primitive_surface(const Var<AnalyticPrimitive> &prim,
+                                           Expr<float3> p_in) noexcept {
+    auto pa = prim->p0();
+    auto pb = prim->p1();
+    auto ra = prim.r0;
+    auto rb = prim.r1;
+    auto ba = pb - pa;
+    auto length_ba = length(ba);
+    auto p = def(p_in);
+    auto n = def(make_float3(0.f, 0.f, 1.f));
+    auto uv = def(make_float2(0.f));
+    auto dpdu = def(make_float3(1.f, 0.f, 0.f));
+    auto area = def(0.f);
+    $switch(prim.kind) {
+        $case(AnalyticPrimitive::kind_sphere) {
+            // same parameterization as the tessellated sphere
+            n = normalize(p_in - pa);
+            p = pa + ra * n;
+            auto theta = acos(clamp(n.y, -1.f, 1.f));
+            auto phi = atan2(n.x, n.z);
+            uv = fract(make_float2(.5f * inv_pi * phi, theta * inv_pi));
+            dpdu = ite(abs(n.y) > 1.f - 1e-6f, make_float3(1.f, 0.f, 0.f),
+                       normalize(make_float3(-n.z, 0.f, n.x)));
+            area = 4.f * pi * ra * ra;
+        };
+        $case(AnalyticPrimitive::kind_round_curve) {
+            auto rr = ra - rb;
+            auto d2 = dot(ba, ba) - rr * rr;
+            auto q = p_in - pa;
+            auto y = dot(ba, q) - ra * rr;
+            n = normalize(ite(y <= 0.f, q, ite(y >= d2, p_in - pb, d2 * q - ba * y)));
+            auto frame = Frame::make(ba / length_ba);
+            auto phi = atan2(dot(n, frame.t()), dot(n, frame.s()));
+            uv = make_float2(saturate(dot(q, ba) / dot(ba, ba)), .5f * inv_pi * phi + .5f);
+            dpdu = ba / length_ba;
+            area = pi * (ra + rb) * sqrt(length_ba * length_ba + rr * rr);
+        };
+        $default {
+            n = prim->n();
+            auto w = normalize(cross(n, ba));
+            auto q = p_in - pa;
+            auto s = saturate(dot(q, ba) / dot(ba, ba));
+            auto half_width = max(lerp(ra, rb, s), 1e-8f);
+            uv = make_float2(s, saturate(dot(q, w) / half_width * .5f + .5f));
+            dpdu = ba / length_ba;
+            area = (ra + rb) * length_ba;
+        };
+    };
+    return {.p = p, .n = n, .uv = uv, .dpdu = dpdu, .area = area};
+}
+
+}// namespace luisa::render
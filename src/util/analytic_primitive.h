@@ -0,0 +1,80 @@
+#pragma once
+
+#include <dsl/syntax.h>
+#include <runtime/rtx/aabb.h>
+
+namespace luisa::render {
+
+using compute::AABB;
+using compute::Expr;
+using compute::Float;
+using compute::Float2;
+using compute::Float3;
+using compute::Var;
+
+// Primitive of procedural shapes, intersected analytically instead of being tessellated:
+// - spheres with center p0 and radius r0;
+// - round curve segments, i.e., spheres of radius r0 at p0 swept linearly to radius r1 at p1;
+// - ribbon curve segments, i.e., flat strips of half-width r0 at p0 and r1 at p1 facing n.
+struct alignas(16) AnalyticPrimitive {
+
+    static constexpr auto kind_sphere = 0u;
+    static constexpr auto kind_round_curve = 1u;
+    static constexpr auto kind_ribbon_curve = 2u;
+
+    float p0x;
+    float p0y;
+    float p0z;
+    float r0;
+    float p1x;
+    float p1y;
+    float p1z;
+    float r1;
+    float nx;
+    float ny;
+    float nz;
+    uint kind;
+
+    [[nodiscard]] static AnalyticPrimitive sphere(float3 center, float radius) noexcept;
+    // the larger end must not swallow the smaller one, so the radii are clamped if needed
+    [[nodiscard]] static AnalyticPrimitive round_curve(float3 p0, float r0, float3 p1, float r1) noexcept;
+    // the strip is oriented to face `n` as closely as possible
+    [[nodiscard]] static AnalyticPrimitive ribbon_curve(float3 p0, float r0, float3 p1, float r1, float3 n) noexcept;
+    [[nodiscard]] auto p0() const noexcept { return make_float3(p0x, p0y, p0z); }
+    [[nodiscard]] auto p1() const noexcept { return make_float3(p1x, p1y, p1z); }
+    [[nodiscard]] auto n() const noexcept { return make_float3(nx, ny, nz); }
+    [[nodiscard]] AABB bounds() const noexcept;
+};
+
+static_assert(sizeof(AnalyticPrimitive) == 48u);
+
+}// namespace luisa::render
+
+// clang-format off
+LUISA_STRUCT(luisa::render::AnalyticPrimitive, p0x, p0y, p0z, r0, p1x, p1y, p1z, r1, nx, ny, nz, kind) {
+    [[nodiscard]] auto p0() const noexcept { return make_float3(p0x, p0y, p0z); }
+    [[nodiscard]] auto p1() const noexcept { return make_float3(p1x, p1y, p1z); }
+    [[nodiscard]] auto n() const noexcept { return make_float3(nx, ny, nz); }
+};
+// clang-format on
+
+namespace luisa::render {
+
+// object-space surface of an analytic primitive at a hit point
+struct AnalyticSurface {
+    Float3 p;   // the hit point projected onto the surface
+    Float3 n;   // geometric normal
+    Float2 uv;  // (longitude, latitude) on spheres, (along, across) on curves
+    Float3 dpdu;// along the curve on curves
+    Float area; // of the whole primitive
+};
+
+// returns the smallest hit distance in [t_min, t_max] along the ray, or a negative value on a miss;
+// `d` need not be normalized and the distance is measured in its units
+[[nodiscard]] Float intersect_analytic_primitive(const Var<AnalyticPrimitive> &primitive,
+                                                 Expr<float3> o, Expr<float3> d,
+                                                 Expr<float> t_min, Expr<float> t_max) noexcept;
+[[nodiscard]] AnalyticSurface analytic_primitive_surface(const Var<AnalyticPrimitive> &primitive,
+                                                         Expr<float3> p) noexcept;
+
+}// namespace luisa::render
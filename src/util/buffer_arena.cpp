@@ -0,0 +1,37 @@
+#include <core/logging.h>
+#include <util/buffer_arena.h>
+
+namespace luisa::render {
+
+BufferArena::BufferArena(Device &device, size_t chunk_size) noexcept
+    : _device{device},
+      _chunk_size{(std::max(chunk_size, min_alignment * 4u) + min_alignment - 1u) /
+                  min_alignment * min_alignment} {}
+
+BufferArena::~BufferArena() noexcept {
+    if (_allocated_bytes != 0u) {
+        LUISA_VERBOSE_WITH_LOCATION(
+            "Buffer arena released {} bytes in {} chunk(s) "
+            "and {} dedicated buffer(s).",
+            _allocated_bytes, _chunks.size(), _dedicated.size());
+    }
+}
+
+size_t BufferArena::_allocate(size_t size_bytes, size_t alignment) noexcept {
+    LUISA_ASSERT(alignment != 0u && alignment % sizeof(uint) == 0u,
+                 "Invalid buffer arena alignment {}.", alignment);
+    LUISA_ASSERT(size_bytes <= _chunk_size,
+                 "Buffer arena allocation of {} bytes "
+                 "exceeds the chunk size {}.",
+                 size_bytes, _chunk_size);
+    auto offset = (_offset + alignment - 1u) / alignment * alignment;
+    if (_chunks.empty() || offset + size_bytes > _chunk_size) {
+        _chunks.emplace_back(_device.create_buffer<uint>(_chunk_size / sizeof(uint)));
+        offset = 0u;
+    }
+    _offset = offset + size_bytes;
+    _allocated_bytes += size_bytes;
+    return offset;
+}
+
+}// namespace luisa::render
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <numeric>
+
+#include <runtime/buffer.h>
+#include <runtime/device.h>
+
+namespace luisa::render {
+
+using compute::Buffer;
+using compute::BufferView;
+using compute::Device;
+using compute::Resource;
+
+// Bump allocator that carves small, pipeline-lifetime buffers out of large
+// backing buffers. Sub-ranges are aligned to max(alignof(T), min_alignment)
+// bytes so that they are valid as typed views and bindless buffer bindings.
+// Addressable sub-ranges also start at a whole element of their chunk, so that
+// a chunk bound once serves all of them by element offsets.
+// Requests larger than a quarter of the chunk get a dedicated buffer so that
+// they never waste the tail of a chunk.
+class BufferArena {
+
+public:
+    static constexpr auto min_alignment = static_cast<size_t>(16u);
+    static constexpr auto dedicated_chunk = ~0u;
+
+    template<typename T>
+    struct Allocation {
+        BufferView<T> view;
+        uint chunk; // dedicated_chunk if the view has a buffer of its own
+        uint offset;// of the first element in the chunk
+    };
+
+private:
+    Device &_device;
+    size_t _chunk_size;
+    luisa::vector<Buffer<uint>> _chunks;
+    luisa::vector<luisa::unique_ptr<Resource>> _dedicated;
+    size_t _offset{0u};// in bytes, into the last chunk
+    size_t _allocated_bytes{0u};
+
+private:
+    // returns the offset in bytes into the last chunk
+    [[nodiscard]] size_t _allocate(size_t size_bytes, size_t alignment) noexcept;
+
+public:
+    BufferArena(Device &device, size_t chunk_size) noexcept;
+    ~BufferArena() noexcept;
+    BufferArena(BufferArena &&) noexcept = delete;
+    BufferArena(const BufferArena &) noexcept = delete;
+    BufferArena &operator=(BufferArena &&) noexcept = delete;
+    BufferArena &operator=(const BufferArena &) noexcept = delete;
+
+    template<typename T>
+    [[nodiscard]] Allocation<T> allocate_addressable(size_t n) noexcept {
+        static_assert(sizeof(T) % sizeof(uint) == 0u,
+                      "Arena elements must be made of 4-byte words.");
+        n = std::max(n, static_cast<size_t>(1u));
+        auto size_bytes = n * sizeof(T);
+        if (size_bytes > _chunk_size / 4u) {
+            auto buffer = luisa::make_unique<Buffer<T>>(_device.create_buffer<T>(n));
+            auto view = buffer->view();
+            _dedicated.emplace_back(std::move(buffer));
+            _allocated_bytes += size_bytes;
+            return {view, dedicated_chunk, 0u};
+        }
+        auto alignment = std::lcm(std::max(alignof(T), min_alignment), sizeof(T));
+        auto offset = _allocate(size_bytes, alignment);
+        auto view = _chunks.back().view(offset / sizeof(uint), size_bytes / sizeof(uint)).template as<T>();
+        return {view, static_cast<uint>(_chunks.size() - 1u), static_cast<uint>(offset / sizeof(T))};
+    }
+    template<typename T>
+    [[nodiscard]] BufferView<T> allocate(size_t n) noexcept {
+        return allocate_addressable<T>(n).view;
+    }
+    [[nodiscard]] auto &chunk(size_t index) const noexcept { return _chunks[index]; }
+    [[nodiscard]] auto chunk_count() const noexcept { return _chunks.size(); }
+    [[nodiscard]] auto dedicated_count() const noexcept { return _dedicated.size(); }
+    [[nodiscard]] auto allocated_bytes() const noexcept { return _allocated_bytes; }
+};
+
+}// namespace luisa::render
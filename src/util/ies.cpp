@@ -2,6 +2,9 @@
 // Created by Mike Smith on 2022/1/27.
 //
 
+#include <cmath>
+#include <algorithm>
+
 #include <core/logging.h>
 #include <util/ies.h>
 
@@ -24,16 +27,20 @@ IESProfile IESProfile::parse(const std::filesystem::path &path) noexcept {
             path.string(), line);
     }
     while (!line.starts_with("TILT")) {
-        std::getline(file, line);
+        if (!std::getline(file, line)) [[unlikely]] {
+            LUISA_ERROR_WITH_LOCATION(
+                "Missing TILT line in IES profile '{}'.",
+                path.string());
+        }
     }
-    if (line.starts_with("TILE=INCLUDE")) {
+    if (line.starts_with("TILT=INCLUDE")) {
         std::getline(file, line);// <lamp to luminaire geometry>
         std::getline(file, line);// <number of tilt angles>
         std::getline(file, line);// <angles>
         std::getline(file, line);// <multiplying factors>
     }
     [[maybe_unused]] auto number_of_lamps = 0;
-    [[maybe_unused]] auto lumens_per_lamp = 0;
+    [[maybe_unused]] auto lumens_per_lamp = 0.0f;
     auto candela_multiplier = 0.0f;
     auto number_of_vertical_angles = 0u;
     auto number_of_horizontal_angles = 0u;
@@ -67,12 +74,17 @@ IESProfile IESProfile::parse(const std::filesystem::path &path) noexcept {
         candela_values.emplace_back(
             value * candela_multiplier);
     }
+    if (!file || n == 0u) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Invalid or truncated IES profile '{}'.",
+            path.string());
+    }
     return {std::move(vertical_angles),
             std::move(horizontal_angles),
             std::move(candela_values)};
 }
 
-inline IESProfile::IESProfile(
+IESProfile::IESProfile(
     luisa::vector<float> v_angles,
     luisa::vector<float> h_angles,
     luisa::vector<float> values) noexcept
@@ -80,4 +92,40 @@ inline IESProfile::IESProfile(
       _horizontal_angles{std::move(h_angles)},
       _candela_values{std::move(values)} {}
 
+luisa::vector<float> IESProfile::resample(uint width, uint height) const noexcept {
+    // linear interpolation in the sorted angles, zero outside
+    auto interpolate = [](luisa::span<const float> angles, float x, auto &&value) noexcept {
+        if (angles.size() == 1u) { return value(0u); }
+        if (x < angles.front() || x > angles.back()) { return 0.f; }
+        auto i = std::clamp(static_cast<size_t>(std::upper_bound(angles.begin(), angles.end(), x) - angles.begin()),
+                            static_cast<size_t>(1u), angles.size() - 1u);
+        auto t = (x - angles[i - 1u]) / std::max(angles[i] - angles[i - 1u], 1e-6f);
+        return std::lerp(value(i - 1u), value(i), std::clamp(t, 0.f, 1.f));
+    };
+    auto v_count = _vertical_angles.size();
+    auto h_last = _horizontal_angles.back();
+    luisa::vector<float> pixels(static_cast<size_t>(width) * height);
+    for (auto y = 0u; y < height; y++) {
+        auto theta = (static_cast<float>(y) + .5f) / static_cast<float>(height) * 180.f;
+        for (auto x = 0u; x < width; x++) {
+            auto phi = (static_cast<float>(x) + .5f) / static_cast<float>(width) * 360.f;
+            // fold the azimuth by the symmetry implied by the last horizontal angle
+            if (h_last == 0.f) {
+                phi = 0.f;
+            } else if (h_last == 90.f) {
+                phi = std::fmod(phi, 180.f);
+                if (phi > 90.f) { phi = 180.f - phi; }
+            } else if (h_last == 180.f && phi > 180.f) {
+                phi = 360.f - phi;
+            }
+            pixels[y * width + x] = interpolate(_horizontal_angles, phi, [&](size_t h) noexcept {
+                return interpolate(_vertical_angles, theta, [&](size_t v) noexcept {
+                    return _candela_values[h * v_count + v];
+                });
+            });
+        }
+    }
+    return pixels;
+}
+
 }// namespace luisa::render
@@ -11,7 +11,9 @@
 
 namespace luisa::render {
 
-// TODO
+// Photometric profile from an IESNA LM-63 file, assuming type C photometry. The candela
+// values are listed per horizontal angle, each over all the vertical angles, which are
+// measured from the nadir.
 class IESProfile {
 
 private:
@@ -29,6 +31,10 @@ public:
     [[nodiscard]] auto vertical_angles() const noexcept { return luisa::span{_vertical_angles}; }
     [[nodiscard]] auto horizontal_angles() const noexcept { return luisa::span{_horizontal_angles}; }
     [[nodiscard]] auto candela_values() const noexcept { return luisa::span{_candela_values}; }
+    // Candela values at the pixel centers of an equirectangular map, with the azimuth
+    // along the rows and the angle from the nadir down the columns, both increasing,
+    // and the horizontal symmetries of the profile unfolded. Zero outside the profile.
+    [[nodiscard]] luisa::vector<float> resample(uint width, uint height) const noexcept;
 };
 
 }// namespace luisa::render
@@ -0,0 +1,105 @@
+#include <core/logging.h>
+#include <util/imageio.h>
+#include <util/image_writer.h>
+
+namespace luisa::render {
+
+ImageWriter::ImageWriter(uint worker_count, size_t capacity) noexcept
+    : _capacity{std::max(capacity, static_cast<size_t>(1u))} {
+    worker_count = std::max(worker_count, 1u);
+    _workers.reserve(worker_count);
+    for (auto i = 0u; i < worker_count; i++) {
+        _workers.emplace_back([this] { _run(); });
+    }
+}
+
+ImageWriter::~ImageWriter() noexcept {
+    {
+        std::scoped_lock lock{_mutex};
+        _stop = true;
+    }
+    _cv_queue.notify_all();
+    for (auto &&w : _workers) { w.join(); }
+}
+
+void ImageWriter::_run() noexcept {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock lock{_mutex};
+            _cv_queue.wait(lock, [this] { return _stop || !_queue.empty(); });
+            // pending images are still written on shutdown
+            if (_queue.empty()) { return; }
+            job = std::move(_queue.front());
+            _queue.pop_front();
+            _busy_workers++;
+        }
+        _cv_space.notify_one();
+        save_image(job.path, job.pixels, job.resolution, job.components);
+        if (job.on_written) { job.on_written(); }
+        {
+            std::scoped_lock lock{_mutex};
+            _busy_workers--;
+        }
+        _cv_idle.notify_all();
+    }
+}
+
+bool ImageWriter::_enqueue(Job job, bool wait) noexcept {
+    {
+        std::unique_lock lock{_mutex};
+        if (wait) {
+            _cv_space.wait(lock, [this] { return _queue.size() < _capacity; });
+        } else if (_queue.size() >= _capacity) {
+            return false;
+        }
+        _queue.emplace_back(std::move(job));
+    }
+    _cv_queue.notify_one();
+    return true;
+}
+
+void ImageWriter::write(std::filesystem::path path, luisa::vector<float4> pixels, uint2 resolution) noexcept {
+    auto owner = luisa::make_shared<luisa::vector<float4>>(std::move(pixels));
+    auto data = reinterpret_cast<const float *>(owner->data());
+    static_cast<void>(_enqueue(Job{.path = std::move(path),
+                                   .pixels = data,
+                                   .resolution = resolution,
+                                   .components = 4u,
+                                   .on_written = [owner] {}},
+                               true));
+}
+
+void ImageWriter::write(std::filesystem::path path, luisa::vector<float> pixels,
+                        uint2 resolution, uint components) noexcept {
+    auto owner = luisa::make_shared<luisa::vector<float>>(std::move(pixels));
+    auto data = owner->data();
+    static_cast<void>(_enqueue(Job{.path = std::move(path),
+                                   .pixels = data,
+                                   .resolution = resolution,
+                                   .components = components,
+                                   .on_written = [owner] {}},
+                               true));
+}
+
+bool ImageWriter::try_write(std::filesystem::path path, const float *pixels, uint2 resolution,
+                            uint components, luisa::function<void()> on_written) noexcept {
+    return _enqueue(Job{.path = std::move(path),
+                        .pixels = pixels,
+                        .resolution = resolution,
+                        .components = components,
+                        .on_written = std::move(on_written)},
+                    false);
+}
+
+void ImageWriter::flush() noexcept {
+    std::unique_lock lock{_mutex};
+    _cv_idle.wait(lock, [this] { return _queue.empty() && _busy_workers == 0u; });
+}
+
+ImageWriter &global_image_writer() noexcept {
+    static ImageWriter writer;
+    return writer;
+}
+
+}// namespace luisa::render
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+
+#include <core/stl.h>
+#include <core/basic_types.h>
+
+namespace luisa::render {
+
+// Writes images on dedicated worker threads so that rendering can continue while
+// images are being encoded. The queue is bounded: write() blocks while it is full,
+// which also bounds the host memory held by pending images.
+class ImageWriter {
+
+private:
+    struct Job {
+        std::filesystem::path path;
+        const float *pixels;
+        uint2 resolution;
+        uint components;
+        luisa::function<void()> on_written;
+    };
+
+private:
+    luisa::vector<std::thread> _workers;
+    luisa::deque<Job> _queue;
+    std::mutex _mutex;
+    std::condition_variable _cv_queue;
+    std::condition_variable _cv_space;
+    std::condition_variable _cv_idle;
+    size_t _capacity;
+    size_t _busy_workers{0u};
+    bool _stop{false};
+
+private:
+    void _run() noexcept;
+    [[nodiscard]] bool _enqueue(Job job, bool wait) noexcept;
+
+public:
+    explicit ImageWriter(uint worker_count = 2u, size_t capacity = 4u) noexcept;
+    ~ImageWriter() noexcept;
+    ImageWriter(ImageWriter &&) noexcept = delete;
+    ImageWriter(const ImageWriter &) noexcept = delete;
+    ImageWriter &operator=(ImageWriter &&) noexcept = delete;
+    ImageWriter &operator=(const ImageWriter &) noexcept = delete;
+    // takes over the pixels and writes them in the background
+    void write(std::filesystem::path path, luisa::vector<float4> pixels, uint2 resolution) noexcept;
+    void write(std::filesystem::path path, luisa::vector<float> pixels, uint2 resolution, uint components) noexcept;
+    // the pixels must stay alive until `on_written` is called from a worker thread;
+    // returns false without queueing the image if the queue is full
+    [[nodiscard]] bool try_write(std::filesystem::path path, const float *pixels, uint2 resolution,
+                                 uint components, luisa::function<void()> on_written) noexcept;
+    // blocks until all queued images are written
+    void flush() noexcept;
+};
+
+[[nodiscard]] ImageWriter &global_image_writer() noexcept;
+
+}// namespace luisa::render
@@ -572,6 +572,43 @@ LoadedImage::LoadedImage(void *pixels,
     : _pixels{pixels}, _resolution{resolution},
       _storage{storage}, _deleter{std::move(deleter)} {}
 
+float4 LoadedImage::texel(size_t index) const noexcept {
+    auto component = [this](size_t i) noexcept -> float {
+        switch (_storage) {
+            case storage_type::BYTE1:
+            case storage_type::BYTE2:
+            case storage_type::BYTE4:
+                return static_cast<float>(static_cast<const uint8_t *>(_pixels)[i]) * (1.f / 255.f);
+            case storage_type::SHORT1:
+            case storage_type::SHORT2:
+            case storage_type::SHORT4:
+                return static_cast<float>(static_cast<const uint16_t *>(_pixels)[i]) * (1.f / 65535.f);
+            case storage_type::HALF1:
+            case storage_type::HALF2:
+            case storage_type::HALF4:
+                return half_to_float(static_cast<const uint16_t *>(_pixels)[i]);
+            case storage_type::FLOAT1:
+            case storage_type::FLOAT2:
+            case storage_type::FLOAT4:
+                return static_cast<const float *>(_pixels)[i];
+            case storage_type::INT1:
+            case storage_type::INT2:
+            case storage_type::INT4:
+                return static_cast<float>(static_cast<const uint32_t *>(_pixels)[i]);
+            default: break;
+        }
+        LUISA_ERROR_WITH_LOCATION(
+            "Unsupported pixel storage 0x{:02x}.",
+            luisa::to_underlying(_storage));
+    };
+    auto n = channels();
+    auto base = index * n;
+    return make_float4(component(base),
+                       n > 1u ? component(base + 1u) : 0.f,
+                       n > 2u ? component(base + 2u) : 0.f,
+                       n > 3u ? component(base + 3u) : 1.f);
+}
+
 //float4 LoadedImage::read(uint2 p) const noexcept {
 //    auto i = p.x + p.y * _resolution.x;
 //    constexpr auto byte_to_float = [](auto x) noexcept { return static_cast<float>(x) * (1.f / 255.f); };
@@ -12,7 +12,7 @@
 
 namespace luisa::render {
 
-// TODO: texture cache
+// see TiledImage for the on-demand streamed texture format
 class LoadedImage {
 
 public:
@@ -46,6 +46,8 @@ public:
     [[nodiscard]] auto pixel_storage() const noexcept { return _storage; }
     [[nodiscard]] auto channels() const noexcept { return compute::pixel_storage_channel_count(_storage); }
     [[nodiscard]] auto pixel_count() const noexcept { return _resolution.x * _resolution.y; }
+    // normalized value of the pixel, with missing channels filled as (0, 0, 0, 1)
+    [[nodiscard]] float4 texel(size_t index) const noexcept;
     [[nodiscard]] explicit operator bool() const noexcept { return _pixels != nullptr; }
     [[nodiscard]] static LoadedImage load(const std::filesystem::path &path) noexcept;
     [[nodiscard]] static LoadedImage load(const std::filesystem::path &path, storage_type storage) noexcept;
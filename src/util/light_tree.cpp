@@ -0,0 +1,198 @@
+#include <util/light_tree.h>
+
+namespace luisa::render {
+
+namespace detail {
+
+[[nodiscard]] inline auto light_bounds_angle_between(float3 a, float3 b) noexcept {
+    // numerically robust for nearly (anti-)parallel vectors
+    if (dot(a, b) < 0.f) { return pi - 2.f * std::asin(std::clamp(length(a + b) * .5f, 0.f, 1.f)); }
+    return 2.f * std::asin(std::clamp(length(b - a) * .5f, 0.f, 1.f));
+}
+
+// union of two direction cones (axis, cos_theta)
+[[nodiscard]] inline auto light_bounds_union_cone(float3 wa, float cos_a, float3 wb, float cos_b) noexcept {
+    auto entire_sphere = std::make_pair(make_float3(0.f, 0.f, 1.f), -1.f);
+    auto theta_a = std::acos(std::clamp(cos_a, -1.f, 1.f));
+    auto theta_b = std::acos(std::clamp(cos_b, -1.f, 1.f));
+    auto theta_d = light_bounds_angle_between(wa, wb);
+    if (std::min(theta_d + theta_b, pi) <= theta_a) { return std::make_pair(wa, cos_a); }
+    if (std::min(theta_d + theta_a, pi) <= theta_b) { return std::make_pair(wb, cos_b); }
+    auto theta_o = .5f * (theta_a + theta_d + theta_b);
+    if (theta_o >= pi) { return entire_sphere; }
+    auto wr = cross(wa, wb);
+    if (dot(wr, wr) == 0.f) { return entire_sphere; }
+    // rotate wa towards wb by theta_o - theta_a (Rodrigues' formula)
+    auto k = normalize(wr);
+    auto theta_r = theta_o - theta_a;
+    auto c = std::cos(theta_r);
+    auto s = std::sin(theta_r);
+    auto w = wa * c + cross(k, wa) * s + k * dot(k, wa) * (1.f - c);
+    return std::make_pair(normalize(w), std::cos(theta_o));
+}
+
+// surface area orientation heuristic
+[[nodiscard]] inline auto light_bounds_cost(const LightBounds &b, const LightBounds &node, uint dim) noexcept {
+    auto theta_o = std::acos(std::clamp(b.cos_theta_o, -1.f, 1.f));
+    auto theta_e = std::acos(std::clamp(b.cos_theta_e, -1.f, 1.f));
+    auto theta_w = std::min(theta_o + theta_e, pi);
+    auto sin_theta_o = std::sqrt(std::max(1.f - b.cos_theta_o * b.cos_theta_o, 0.f));
+    auto m_omega = 2.f * pi * (1.f - b.cos_theta_o) +
+                   .5f * pi * (2.f * theta_w * sin_theta_o - std::cos(theta_o - 2.f * theta_w) -
+                               2.f * theta_o * sin_theta_o + b.cos_theta_o);
+    auto d = node.p_max - node.p_min;
+    auto kr = std::max(std::max(d.x, d.y), d.z) / std::max(d[dim], 1e-20f);
+    return b.phi * m_omega * kr * b.surface_area();
+}
+
+}// namespace detail
+
+LightBounds light_bounds_union(const LightBounds &a, const LightBounds &b) noexcept {
+    if (a.phi == 0.f) { return b; }
+    if (b.phi == 0.f) { return a; }
+    auto [axis, cos_theta_o] = detail::light_bounds_union_cone(a.axis, a.cos_theta_o, b.axis, b.cos_theta_o);
+    return LightBounds{.p_min = min(a.p_min, b.p_min),
+                       .p_max = max(a.p_max, b.p_max),
+                       .axis = axis,
+                       .phi = a.phi + b.phi,
+                       .cos_theta_o = cos_theta_o,
+                       .cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e),
+                       .two_sided = a.two_sided || b.two_sided};
+}
+
+LightBounds light_bounds_triangle(float3 p0, float3 p1, float3 p2, float radiance) noexcept {
+    auto n = cross(p1 - p0, p2 - p0);
+    auto area = .5f * length(n);
+    if (!(area > 0.f) || !(radiance > 0.f)) { return {}; }
+    return {.p_min = min(min(p0, p1), p2),
+            .p_max = max(max(p0, p1), p2),
+            .axis = normalize(n),
+            .phi = radiance * area,
+            .cos_theta_o = 1.f,
+            .cos_theta_e = 0.f,
+            .two_sided = false};
+}
+
+luisa::vector<LightTreeNode> build_light_tree(luisa::span<const LightTreePrimitive> primitives) noexcept {
+    luisa::vector<LightTreePrimitive> emitters;
+    emitters.reserve(primitives.size());
+    for (auto &&p : primitives) {
+        if (p.bounds.phi > 0.f) { emitters.emplace_back(p); }
+    }
+    luisa::vector<LightTreeNode> nodes;
+    if (emitters.empty()) { return nodes; }
+    constexpr auto bucket_count = 12u;
+    nodes.reserve(emitters.size() * 2u - 1u);
+    struct Task {
+        uint begin;
+        uint end;
+        uint parent;
+        bool second_child;
+    };
+    luisa::vector<Task> stack;
+    stack.emplace_back(Task{0u, static_cast<uint>(emitters.size()), ~0u, false});
+    while (!stack.empty()) {
+        auto task = stack.back();
+        stack.pop_back();
+        auto node_index = static_cast<uint>(nodes.size());
+        if (task.second_child) { nodes[task.parent].index = node_index; }
+        LightBounds bounds;
+        auto centroid_min = make_float3(std::numeric_limits<float>::max());
+        auto centroid_max = make_float3(-std::numeric_limits<float>::max());
+        for (auto i = task.begin; i < task.end; i++) {
+            auto &&b = emitters[i].bounds;
+            bounds = light_bounds_union(bounds, b);
+            centroid_min = min(centroid_min, b.centroid());
+            centroid_max = max(centroid_max, b.centroid());
+        }
+        auto leaf = task.end - task.begin == 1u;
+        auto flags = (leaf ? LightTreeNode::flag_leaf : 0u) |
+                     (bounds.two_sided ? LightTreeNode::flag_two_sided : 0u);
+        nodes.emplace_back(LightTreeNode{
+            .min_x = bounds.p_min.x, .min_y = bounds.p_min.y, .min_z = bounds.p_min.z,
+            .phi = bounds.phi,
+            .max_x = bounds.p_max.x, .max_y = bounds.p_max.y, .max_z = bounds.p_max.z,
+            .cos_theta_o = bounds.cos_theta_o,
+            .axis_x = bounds.axis.x, .axis_y = bounds.axis.y, .axis_z = bounds.axis.z,
+            .cos_theta_e = bounds.cos_theta_e,
+            .index = leaf ? emitters[task.begin].instance : 0u,
+            .triangle = leaf ? emitters[task.begin].triangle : ~0u,
+            .parent = task.parent,
+            .flags = flags});
+        if (leaf) { continue; }
+        // find the best bucket split over all axes
+        auto best_cost = std::numeric_limits<float>::max();
+        auto best_dim = ~0u;
+        auto best_bucket = 0u;
+        auto centroid_extent = centroid_max - centroid_min;
+        auto bucket_of = [&](const LightBounds &b, uint dim) noexcept {
+            auto x = (b.centroid()[dim] - centroid_min[dim]) / centroid_extent[dim];
+            return std::min(static_cast<uint>(x * bucket_count), bucket_count - 1u);
+        };
+        for (auto dim = 0u; dim < 3u; dim++) {
+            if (!(centroid_extent[dim] > 0.f)) { continue; }
+            std::array<LightBounds, bucket_count> buckets{};
+            for (auto i = task.begin; i < task.end; i++) {
+                auto &&b = emitters[i].bounds;
+                auto &&bucket = buckets[bucket_of(b, dim)];
+                bucket = light_bounds_union(bucket, b);
+            }
+            // sweep from the right to get suffix unions
+            std::array<LightBounds, bucket_count> right{};
+            right[bucket_count - 1u] = buckets[bucket_count - 1u];
+            for (auto i = bucket_count - 1u; i > 0u; i--) {
+                right[i - 1u] = light_bounds_union(buckets[i - 1u], right[i]);
+            }
+            LightBounds left;
+            for (auto i = 0u; i < bucket_count - 1u; i++) {
+                left = light_bounds_union(left, buckets[i]);
+                if (left.phi == 0.f || right[i + 1u].phi == 0.f) { continue; }
+                auto cost = detail::light_bounds_cost(left, bounds, dim) +
+                            detail::light_bounds_cost(right[i + 1u], bounds, dim);
+                if (cost > 0.f && cost < best_cost) {
+                    best_cost = cost;
+                    best_dim = dim;
+                    best_bucket = i;
+                }
+            }
+        }
+        auto mid = (task.begin + task.end) / 2u;
+        if (best_dim != ~0u) {
+            auto iter = std::partition(
+                emitters.begin() + task.begin, emitters.begin() + task.end,
+                [&](const LightTreePrimitive &p) noexcept { return bucket_of(p.bounds, best_dim) <= best_bucket; });
+            auto split = static_cast<uint>(iter - emitters.begin());
+            if (split != task.begin && split != task.end) { mid = split; }
+        }
+        // the first child is processed next so that it immediately follows its parent
+        stack.emplace_back(Task{mid, task.end, node_index, true});
+        stack.emplace_back(Task{task.begin, mid, node_index, false});
+    }
+    return nodes;
+}
+
+Float light_tree_importance(const Var<LightTreeNode> &node, Expr<float3> p, Expr<bool> two_sided) noexcept {
+    using namespace luisa::compute;
+    auto p_min = node->p_min();
+    auto p_max = node->p_max();
+    auto pc = .5f * (p_min + p_max);
+    auto d2_center = distance_squared(p, pc);
+    auto d2 = max(d2_center, length(p_max - p_min) * .5f);
+    auto wi = ite(d2_center > 0.f, normalize(p - pc), node->axis());
+    auto cos_w = dot(node->axis(), wi);
+    cos_w = ite(two_sided | node->two_sided(), abs(cos_w), cos_w);
+    auto sin_w = sqrt(max(1.f - sqr(cos_w), 0.f));
+    // cone of directions subtended by the bounding sphere
+    auto sin2_b = distance_squared(pc, p_max) / d2_center;
+    auto cos_b = ite(sin2_b < 1.f, sqrt(max(1.f - sin2_b, 0.f)), -1.f);
+    auto sin_b = sqrt(max(1.f - sqr(cos_b), 0.f));
+    auto cos_o = node.cos_theta_o;
+    auto sin_o = sqrt(max(1.f - sqr(cos_o), 0.f));
+    // cos(max(0, theta_w - theta_o - theta_b))
+    auto cos_x = ite(cos_w > cos_o, 1.f, cos_w * cos_o + sin_w * sin_o);
+    auto sin_x = ite(cos_w > cos_o, 0.f, sin_w * cos_o - cos_w * sin_o);
+    auto cos_p = ite(cos_x > cos_b, 1.f, cos_x * cos_b + sin_x * sin_b);
+    return ite(cos_p <= node.cos_theta_e, 0.f, node.phi * cos_p / d2);
+}
+
+}// namespace luisa::render
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <dsl/syntax.h>
+#include <dsl/sugar.h>
+
+namespace luisa::render {
+
+// flattened light tree node, 64 bytes; the first child of an
+// interior node immediately follows it in the node array
+struct alignas(16) LightTreeNode {
+
+    static constexpr auto flag_leaf = 1u;
+    static constexpr auto flag_two_sided = 2u;
+
+    float min_x;
+    float min_y;
+    float min_z;
+    float phi;// total emitted power
+    float max_x;
+    float max_y;
+    float max_z;
+    float cos_theta_o;// spread of the surface normals around the axis
+    float axis_x;
+    float axis_y;
+    float axis_z;
+    float cos_theta_e;// emission falloff beyond the normals
+    uint index;       // second child for interior nodes, instance for leaves
+    uint triangle;    // triangle in the instance for leaves
+    uint parent;
+    uint flags;
+};
+
+static_assert(sizeof(LightTreeNode) == 64u);
+
+}// namespace luisa::render
+
+// clang-format off
+LUISA_STRUCT(luisa::render::LightTreeNode,
+             min_x, min_y, min_z, phi,
+             max_x, max_y, max_z, cos_theta_o,
+             axis_x, axis_y, axis_z, cos_theta_e,
+             index, triangle, parent, flags) {
+    [[nodiscard]] auto p_min() const noexcept { return make_float3(min_x, min_y, min_z); }
+    [[nodiscard]] auto p_max() const noexcept { return make_float3(max_x, max_y, max_z); }
+    [[nodiscard]] auto axis() const noexcept { return make_float3(axis_x, axis_y, axis_z); }
+    [[nodiscard]] auto is_leaf() const noexcept { return (flags & luisa::render::LightTreeNode::flag_leaf) != 0u; }
+    [[nodiscard]] auto two_sided() const noexcept { return (flags & luisa::render::LightTreeNode::flag_two_sided) != 0u; }
+};
+// clang-format on
+
+namespace luisa::render {
+
+using luisa::compute::Expr;
+using luisa::compute::Float;
+using luisa::compute::Var;
+
+// spatial and directional bounds of emitters, see "Importance Sampling of
+// Many Lights with Adaptive Tree Splitting" (Conty Estevez and Kulla, 2018)
+struct LightBounds {
+
+    float3 p_min{make_float3(std::numeric_limits<float>::max())};
+    float3 p_max{make_float3(-std::numeric_limits<float>::max())};
+    float3 axis{make_float3(0.f, 0.f, 1.f)};
+    float phi{0.f};
+    float cos_theta_o{1.f};
+    float cos_theta_e{1.f};
+    bool two_sided{false};
+
+    [[nodiscard]] auto centroid() const noexcept { return .5f * (p_min + p_max); }
+    [[nodiscard]] auto surface_area() const noexcept {
+        auto d = max(p_max - p_min, make_float3(0.f));
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+[[nodiscard]] LightBounds light_bounds_union(const LightBounds &a, const LightBounds &b) noexcept;
+
+// bounds of a single-sided triangle emitting `radiance` over its area, without power if degenerate
+[[nodiscard]] LightBounds light_bounds_triangle(float3 p0, float3 p1, float3 p2, float radiance) noexcept;
+
+struct LightTreePrimitive {
+    LightBounds bounds;
+    uint instance;
+    uint triangle;
+};
+
+// Top-down build with binned SAOH, emitting nodes in depth-first order. Primitives
+// without power are left out of the tree, which is empty if none remains.
+[[nodiscard]] luisa::vector<LightTreeNode> build_light_tree(luisa::span<const LightTreePrimitive> primitives) noexcept;
+
+// Conservative estimate of the power the emitters in the node send towards p. Emitters
+// are treated as two-sided if either the node or `two_sided` says so.
+[[nodiscard]] Float light_tree_importance(const Var<LightTreeNode> &node, Expr<float3> p, Expr<bool> two_sided) noexcept;
+
+// Descends from the root at `offset` choosing children by importance, and returns the
+// leaf relative to the root, its probability, and the remapped random number.
+template<typename Nodes>
+[[nodiscard]] inline auto sample_light_tree(const Nodes &nodes, Expr<float3> p, Expr<bool> two_sided,
+                                            Expr<float> u_in, Expr<uint> offset = 0u) noexcept {
+    using namespace luisa::compute;
+    static constexpr auto one_minus_epsilon = 0x1.fffffep-1f;
+    auto node_index = def(0u);
+    auto prob = def(1.f);
+    auto u = def(u_in);
+    $loop {
+        auto node = nodes->read(offset + node_index);
+        $if(node->is_leaf()) { $break; };
+        auto c0 = node_index + 1u;
+        auto c1 = node.index;
+        auto i0 = light_tree_importance(nodes->read(offset + c0), p, two_sided);
+        auto i1 = light_tree_importance(nodes->read(offset + c1), p, two_sided);
+        $if(i0 + i1 == 0.f) {
+            prob = 0.f;
+            $break;
+        };
+        auto p0 = i0 / (i0 + i1);
+        $if(u < p0) {
+            node_index = c0;
+            u = min(u / p0, one_minus_epsilon);
+            prob *= p0;
+        }
+        $else {
+            node_index = c1;
+            u = min((u - p0) / (1.f - p0), one_minus_epsilon);
+            prob *= 1.f - p0;
+        };
+    };
+    return std::make_tuple(node_index, prob, u);
+}
+
+// probability of sample_light_tree() reaching the leaf, evaluated bottom-up
+template<typename Nodes>
+[[nodiscard]] inline auto pmf_light_tree(const Nodes &nodes, Expr<float3> p, Expr<bool> two_sided,
+                                         Expr<uint> leaf, Expr<uint> offset = 0u) noexcept {
+    using namespace luisa::compute;
+    auto prob = def(1.f);
+    auto node_index = def(leaf);
+    $while(node_index != 0u) {
+        auto node = nodes->read(offset + node_index);
+        auto parent = node.parent;
+        auto sibling = ite(parent + 1u == node_index, nodes->read(offset + parent).index, parent + 1u);
+        auto i = light_tree_importance(node, p, two_sided);
+        auto i_sibling = light_tree_importance(nodes->read(offset + sibling), p, two_sided);
+        prob *= ite(i > 0.f, i / (i + i_sibling), 0.f);
+        node_index = parent;
+    };
+    return prob;
+}
+
+}// namespace luisa::render
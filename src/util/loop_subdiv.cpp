@@ -2,424 +2,374 @@
 // Created by Mike Smith on 2022/11/8.
 //
 
+#include <atomic>
+#include <thread>
 #include <numeric>
-#include <core/pool.h>
-#include <core/logging.h>
+#include <utility>
+#include <algorithm>
+#include <util/thread_pool.h>
 #include <util/loop_subdiv.h>
 
 namespace luisa::render {
 
-// The following code is from PBRT-v4.
-// License: Apache 2.0
-// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
-// The pbrt source code is licensed under the Apache License, Version 2.0.
-
-struct SDFace;
-struct SDVertex;
-
-// LoopSubdiv Macros
-
-[[nodiscard]] constexpr auto loop_subdiv_next(uint e) noexcept { return (e + 1u) % 3u; }
-[[nodiscard]] constexpr auto loop_subdiv_prev(uint e) noexcept { return (e + 2u) % 3u; }
-
-// LoopSubdiv Local Structures
-struct SDVertex {
-    float px{};
-    float py{};
-    float pz{};
-    bool regular{};
-    bool boundary{};
-    SDFace *startFace{};
-    SDVertex *child{};
-
-    // SDVertex Constructor
-    SDVertex() noexcept = default;
-    explicit SDVertex(float3 p) noexcept { set_p(p); }
-    [[nodiscard]] uint valence() noexcept;
-    void set_p(float3 p) noexcept {
-        px = p.x;
-        py = p.y;
-        pz = p.z;
-    }
-    [[nodiscard]] auto p() const noexcept { return make_float3(px, py, pz); }
-    void oneRing(float3 *pp) noexcept;
-};
-
-struct SDFace {
-
-    SDVertex *v[3]{};
-    SDFace *f[3]{};
-    SDFace *children[4]{};
-    uint baseTriangle{};
-
-    // SDFace Constructor
-    SDFace() noexcept = default;
-
-    // SDFace Methods
-    [[nodiscard]] auto vnum(SDVertex *vert) const noexcept {
-        for (auto i = 0u; i < 3u; i++) {
-            if (v[i] == vert) { return i; }
-        }
-        LUISA_ERROR_WITH_LOCATION("Basic logic error in SDFace::vnum()");
+namespace detail {
+
+// Runs f(i) for i in [0, n), in blocks on the global thread pool if requested. The caller
+// claims blocks as well and only waits for the blocks taken by the workers, instead of on
+// the pool-wide barrier: workers may be blocked waiting for this very subdivision (e.g.,
+// the geometry fetching meshes in pool tasks), and the subdivision must still progress.
+template<typename F>
+void loop_subdiv_for(uint n, bool parallel, F &&f) noexcept {
+    static constexpr auto block_size = 4096u;
+    if (!parallel || n <= block_size) {
+        for (auto i = 0u; i < n; i++) { f(i); }
+        return;
     }
-    [[nodiscard]] auto nextFace(SDVertex *vert) noexcept { return f[vnum(vert)]; }
-    [[nodiscard]] auto prevFace(SDVertex *vert) noexcept { return f[loop_subdiv_prev(vnum(vert))]; }
-    [[nodiscard]] auto nextVert(SDVertex *vert) noexcept { return v[loop_subdiv_next(vnum(vert))]; }
-    [[nodiscard]] auto prevVert(SDVertex *vert) noexcept { return v[loop_subdiv_prev(vnum(vert))]; }
-    [[nodiscard]] auto otherVert(SDVertex *v0, SDVertex *v1) noexcept {
-        for (auto i : v) {
-            if (i != v0 && i != v1) { return i; }
+    struct Blocks {
+        std::atomic_uint next{0u};
+        std::atomic_uint done{0u};
+    };
+    auto block_count = (n + block_size - 1u) / block_size;
+    // helpers may start after the loop is over, so they share ownership of the counters
+    auto blocks = luisa::make_shared<Blocks>();
+    auto run = [blocks, block_count, n, f = &f]() noexcept {
+        for (auto b = blocks->next.fetch_add(1u); b < block_count; b = blocks->next.fetch_add(1u)) {
+            auto end = std::min(n, (b + 1u) * block_size);
+            for (auto i = b * block_size; i < end; i++) { (*f)(i); }
+            blocks->done.fetch_add(1u, std::memory_order_release);
         }
-        LUISA_ERROR_WITH_LOCATION("Basic logic error in SDFace::otherVert()");
+    };
+    auto helper_count = std::min(block_count - 1u, std::max(std::thread::hardware_concurrency(), 1u));
+    global_thread_pool().parallel(helper_count, [run](uint) noexcept { run(); });
+    run();
+    while (blocks->done.load(std::memory_order_acquire) != block_count) {
+        std::this_thread::yield();
     }
-};
-
-struct SDEdge {
+}
 
-    SDVertex *v[2];
-    SDFace *f[2];
-    uint f0edgeNum;
+// in-place exclusive prefix sum, returning the total
+[[nodiscard]] inline auto loop_subdiv_scan(luisa::vector<uint> &v) noexcept {
+    auto sum = 0u;
+    for (auto &&x : v) { sum += std::exchange(x, sum); }
+    return sum;
+}
 
-    // SDEdge Constructor
-    explicit SDEdge(SDVertex *v0 = nullptr, SDVertex *v1 = nullptr) noexcept
-        : v{std::min(v0, v1), std::max(v0, v1)}, f{}, f0edgeNum{~0u} {}
+[[nodiscard]] inline auto loop_subdiv_corner(const Triangle &t, uint k) noexcept {
+    return k == 0u ? t.i0 : (k == 1u ? t.i1 : t.i2);
+}
 
-    // SDEdge Comparison Operators
-    [[nodiscard]] auto operator==(const SDEdge &e) const noexcept {
-        return v[0] == e.v[0] && v[1] == e.v[1];
+// items grouped by key in ascending order, i.e., compressed sparse rows
+struct LoopSubdivAdjacency {
+    luisa::vector<uint> offsets;
+    luisa::vector<uint> items;
+    [[nodiscard]] luisa::span<uint> operator[](uint key) noexcept {
+        return luisa::span<uint>{items}.subspan(offsets[key], offsets[key + 1u] - offsets[key]);
     }
-};
-
-struct SDEdgeHash {
-    [[nodiscard]] auto operator()(SDEdge e) const noexcept {
-        return luisa::hash64(e.v, sizeof(e.v), 0x19980810u);
+    [[nodiscard]] luisa::span<const uint> operator[](uint key) const noexcept {
+        return luisa::span<const uint>{items}.subspan(offsets[key], offsets[key + 1u] - offsets[key]);
     }
 };
 
-// LoopSubdiv Local Declarations
-[[nodiscard]] static float3 weightOneRing(SDVertex *vert, float beta) noexcept;
-[[nodiscard]] static float3 weightBoundary(SDVertex *vert, float beta) noexcept;
+template<typename Key>
+[[nodiscard]] auto loop_subdiv_adjacency(uint key_count, uint item_count, bool parallel, Key &&key) noexcept {
+    luisa::vector<uint> cursors(key_count + 1u, 0u);
+    loop_subdiv_for(item_count, parallel, [&](uint i) noexcept {
+        std::atomic_ref{cursors[key(i)]}.fetch_add(1u, std::memory_order_relaxed);
+    });
+    LoopSubdivAdjacency adjacency;
+    adjacency.items.resize(loop_subdiv_scan(cursors));
+    adjacency.offsets = cursors;
+    loop_subdiv_for(item_count, parallel, [&](uint i) noexcept {
+        auto slot = std::atomic_ref{cursors[key(i)]}.fetch_add(1u, std::memory_order_relaxed);
+        adjacency.items[slot] = i;
+    });
+    // sorted for results independent of the scheduling
+    loop_subdiv_for(key_count, parallel, [&](uint k) noexcept {
+        auto items = adjacency[k];
+        std::sort(items.begin(), items.end());
+    });
+    return adjacency;
+}
 
-// LoopSubdiv Inline Functions
-[[nodiscard]] inline uint SDVertex::valence() noexcept {
-    auto f = startFace;
-    if (!boundary) {
-        // Compute valence of interior vertex
-        auto nf = 1u;
-        while ((f = f->nextFace(this)) != startFace) { ++nf; }
-        return nf;
-    }
-    // Compute valence of boundary vertex
-    auto nf = 1u;
-    while ((f = f->nextFace(this)) != nullptr) { ++nf; }
-    f = startFace;
-    while ((f = f->prevFace(this)) != nullptr) { ++nf; }
-    return nf + 1u;
+// Edges (a, b) with a < b, with up to two of their half-edges. Half-edge 3 * t + k goes
+// from corner k of triangle t to the next corner. Edges with other than two faces are
+// treated as boundaries.
+struct LoopSubdivTopology {
+    luisa::vector<uint2> edges;
+    luisa::vector<uint2> edge_half_edges;
+    luisa::vector<uint> edge_face_counts;
+    luisa::vector<uint> half_edge_edges;
+    // 2 * edge + end, for each vertex
+    LoopSubdivAdjacency vertex_edges;
+};
+
+[[nodiscard]] auto loop_subdiv_topology(uint vertex_count, luisa::span<const Triangle> triangles, bool parallel) noexcept {
+    auto half_edge_count = static_cast<uint>(triangles.size() * 3u);
+    auto half_edge = [triangles](uint h) noexcept {
+        auto &&t = triangles[h / 3u];
+        auto a = loop_subdiv_corner(t, h % 3u);
+        auto b = loop_subdiv_corner(t, (h + 1u) % 3u);
+        return make_uint2(std::min(a, b), std::max(a, b));
+    };
+    auto half_edges = loop_subdiv_adjacency(
+        vertex_count, half_edge_count, parallel,
+        [&](uint h) noexcept { return half_edge(h).x; });
+    // group the half-edges leaving each vertex by the other end
+    luisa::vector<uint> edge_offsets(vertex_count + 1u, 0u);
+    loop_subdiv_for(vertex_count, parallel, [&](uint v) noexcept {
+        auto hs = half_edges[v];
+        std::stable_sort(hs.begin(), hs.end(), [&](auto lhs, auto rhs) noexcept {
+            return half_edge(lhs).y < half_edge(rhs).y;
+        });
+        auto count = 0u;
+        for (auto i = 0u; i < hs.size(); i++) {
+            if (i == 0u || half_edge(hs[i]).y != half_edge(hs[i - 1u]).y) { count++; }
+        }
+        edge_offsets[v] = count;
+    });
+    auto edge_count = loop_subdiv_scan(edge_offsets);
+    LoopSubdivTopology topology;
+    topology.edges.resize(edge_count);
+    topology.edge_half_edges.resize(edge_count, make_uint2(~0u));
+    topology.edge_face_counts.resize(edge_count, 0u);
+    topology.half_edge_edges.resize(half_edge_count);
+    loop_subdiv_for(vertex_count, parallel, [&](uint v) noexcept {
+        auto hs = half_edges[v];
+        auto e = edge_offsets[v];
+        for (auto i = 0u; i < hs.size(); i++) {
+            auto h = hs[i];
+            if (i != 0u && half_edge(h).y != half_edge(hs[i - 1u]).y) { e++; }
+            topology.edges[e] = half_edge(h);
+            if (auto c = topology.edge_face_counts[e]; c < 2u) { topology.edge_half_edges[e][c] = h; }
+            topology.edge_face_counts[e]++;
+            topology.half_edge_edges[h] = e;
+        }
+    });
+    topology.vertex_edges = loop_subdiv_adjacency(
+        vertex_count, edge_count * 2u, parallel,
+        [&](uint i) noexcept { return topology.edges[i / 2u][i % 2u]; });
+    return topology;
 }
 
-[[nodiscard]] inline auto beta(uint valence) noexcept {
+[[nodiscard]] inline auto loop_subdiv_beta(uint valence) noexcept {
     return 3.f / (valence == 3u ? 16.f : 8.f * static_cast<float>(valence));
 }
 
-[[nodiscard]] inline auto loopGamma(uint valence) noexcept {
-    return 1.f / (static_cast<float>(valence) + 3.f / (8.f * beta(valence)));
+[[nodiscard]] inline auto loop_subdiv_gamma(uint valence) noexcept {
+    return 1.f / (static_cast<float>(valence) + 3.f / (8.f * loop_subdiv_beta(valence)));
 }
 
-// LoopSubdiv Function Definitions
-SubdivMesh loop_subdivide(luisa::span<const Vertex> vertices,
-                          luisa::span<const Triangle> triangles,
-                          uint level) noexcept {
-
-    if (level == 0u) {
-        return {.vertices = {vertices.begin(), vertices.end()},
-                .triangles = {triangles.begin(), triangles.end()},
-                .base_triangle_indices = [n = triangles.size()] {
-                    luisa::vector<uint> indices(n);
-                    std::iota(indices.begin(), indices.end(), 0u);
-                    return indices;
-                }()};
-    }
-
-    luisa::vector<SDVertex *> vs;
-    luisa::vector<SDFace *> faces;
-    // Allocate _LoopSubdiv_ vertices and faces
-    luisa::vector<SDVertex> verts(vertices.size());
-    for (auto i = 0u; i < vertices.size(); ++i) {
-        verts[i] = SDVertex{vertices[i].position()};
-        vs.emplace_back(&verts[i]);
-    }
-    auto nFaces = triangles.size();
-    luisa::vector<SDFace> fs(nFaces);
-    for (int i = 0; i < nFaces; ++i) {
-        fs[i].baseTriangle = i;
-        faces.emplace_back(&fs[i]);
-    }
-
-    // Set face to vertex pointers
-    for (auto i = 0u; i < nFaces; i++) {
-        auto f = faces[i];
-        auto t = make_uint3(triangles[i].i0, triangles[i].i1, triangles[i].i2);
-        for (auto j = 0u; j < 3u; j++) {
-            auto v = vs[t[j]];
-            f->v[j] = v;
-            v->startFace = f;
+// Loop's vertex masks: weight w(valence) on each neighbor of an interior vertex and
+// weight wb on both boundary neighbors of a boundary vertex; corners and non-manifold
+// vertices stay in place
+template<typename W>
+[[nodiscard]] auto loop_subdiv_vertex_mask(const LoopSubdivTopology &topology,
+                                           luisa::span<const float3> positions,
+                                           uint v, W &&w, float wb) noexcept {
+    auto p = positions[v];
+    auto sum = make_float3();
+    auto boundary_sum = make_float3();
+    auto boundary_count = 0u;
+    auto ends = topology.vertex_edges[v];
+    for (auto i : ends) {
+        auto e = i / 2u;
+        auto q = positions[topology.edges[e][1u - i % 2u]];
+        sum += q;
+        if (topology.edge_face_counts[e] != 2u) {
+            boundary_sum += q;
+            boundary_count++;
         }
     }
-
-    // Set neighbor pointers in _faces_
-    luisa::unordered_set<SDEdge, SDEdgeHash> edges;
-    for (auto i = 0u; i < nFaces; i++) {
-        auto f = faces[i];
-        for (auto edgeNum = 0u; edgeNum < 3u; edgeNum++) {
-            // Update neighbor pointer for _edgeNum_
-            auto v0 = edgeNum;
-            auto v1 = loop_subdiv_next(edgeNum);
-            SDEdge e(f->v[v0], f->v[v1]);
-            if (edges.find(e) == edges.end()) {
-                // Handle new edge
-                e.f[0] = f;
-                e.f0edgeNum = edgeNum;
-                edges.insert(e);
-            } else {
-                // Handle previously seen edge
-                e = *edges.find(e);
-                e.f[0]->f[e.f0edgeNum] = f;
-                f->f[edgeNum] = e.f[0];
-                edges.erase(e);
-            }
-        }
+    if (auto n = static_cast<uint>(ends.size()); boundary_count == 0u && n >= 3u) {
+        auto wn = w(n);
+        return (1.f - static_cast<float>(n) * wn) * p + wn * sum;
     }
+    if (boundary_count == 2u) { return (1.f - 2.f * wb) * p + wb * boundary_sum; }
+    return p;
+}
 
-    // Finish vertex initialization
-    for (auto i = 0u; i < vertices.size(); i++) {
-        auto v = vs[i];
-        auto f = v->startFace;
-        do {
-            f = f->nextFace(v);
-        } while ((f != nullptr) && f != v->startFace);
-        v->boundary = (f == nullptr);
-        v->regular = (!v->boundary && v->valence() == 6u) ||
-                     (v->boundary && v->valence() == 4u);
-    }
-
-    // Refine _LoopSubdiv_ into triangles
-    auto f = faces;
-    auto v = vs;
-    Pool<SDVertex, false, false> vertexAllocator;
-    Pool<SDFace, false, false> faceAllocator;
-
-    for (auto i = 0u; i < level; i++) {
-        // Update _f_ and _v_ for next level of subdivision
-        luisa::vector<SDFace *> newFaces;
-        luisa::vector<SDVertex *> newVertices;
+}// namespace detail
 
-        // Allocate next level of children in mesh tree
-        for (auto vertex : v) {
-            vertex->child = vertexAllocator.create();
-            vertex->child->regular = vertex->regular;
-            vertex->child->boundary = vertex->boundary;
-            newVertices.push_back(vertex->child);
-        }
-        for (auto face : f) {
-            for (auto &k : face->children) {
-                k = faceAllocator.create();
-                k->baseTriangle = face->baseTriangle;
-                newFaces.push_back(k);
-            }
-        }
+SubdivMesh loop_subdivide(luisa::span<const Vertex> vertices,
+                          luisa::span<const Triangle> triangles,
+                          const LoopSubdivOptions &options) noexcept {
 
-        // Update vertex positions and create new edge vertices
+    using namespace detail;
 
-        // Update vertex positions for even vertices
-        for (auto vertex : v) {
-            if (!vertex->boundary) {
-                // Apply one-ring rule for even vertex
-                auto b = vertex->regular ? 1.f / 16.f : beta(vertex->valence());
-                vertex->child->set_p(weightOneRing(vertex, b));
-            } else {
-                // Apply boundary rule for even vertex
-                vertex->child->set_p(weightBoundary(vertex, 1.f / 8.f));
-            }
-        }
+    SubdivMesh mesh;
+    mesh.triangles = {triangles.begin(), triangles.end()};
+    mesh.base_triangle_indices.resize(triangles.size());
+    std::iota(mesh.base_triangle_indices.begin(), mesh.base_triangle_indices.end(), 0u);
+    if (options.level == 0u) {
+        mesh.vertices = {vertices.begin(), vertices.end()};
+        return mesh;
+    }
 
-        // Compute new odd edge vertices
-        luisa::unordered_map<SDEdge, SDVertex *, SDEdgeHash> edgeVerts;
-        for (auto face : f) {
-            for (auto k = 0u; k < 3u; k++) {
-                // Compute odd vertex on _k_th edge
-                SDEdge edge{face->v[k], face->v[loop_subdiv_next(k)]};
-                auto vert = edgeVerts[edge];
-                if (vert == nullptr) {
-                    // Create and initialize new odd vertex
-                    vert = vertexAllocator.create();
-                    newVertices.emplace_back(vert);
-                    vert->regular = true;
-                    vert->boundary = (face->f[k] == nullptr);
-                    vert->startFace = face->children[3u];
-                    // Apply edge rules to compute new vertex position
-                    if (vert->boundary) {
-                        vert->set_p(.5f * edge.v[0u]->p() + .5f * edge.v[1u]->p());
-                    } else {
-                        vert->set_p(3.f / 8.f * edge.v[0u]->p() +
-                                    3.f / 8.f * edge.v[1u]->p() +
-                                    1.f / 8.f * face->otherVert(edge.v[0u], edge.v[1u])->p() +
-                                    1.f / 8.f * face->f[k]->otherVert(edge.v[0u], edge.v[1u])->p());
-                    }
-                    edgeVerts[edge] = vert;
+    auto parallel = options.parallel;
+    auto vertex_count = static_cast<uint>(vertices.size());
+    luisa::vector<float3> positions(vertex_count);
+    luisa::vector<float2> uvs(vertex_count);
+    loop_subdiv_for(vertex_count, parallel, [&](uint i) noexcept {
+        positions[i] = vertices[i].position();
+        uvs[i] = vertices[i].uv();
+    });
+    auto cos_max_angle = std::cos(options.max_angle);
+    for (auto level = 0u; level < options.level; level++) {
+        auto face_count = static_cast<uint>(mesh.triangles.size());
+        auto topology = loop_subdiv_topology(vertex_count, mesh.triangles, parallel);
+        auto edge_count = static_cast<uint>(topology.edges.size());
+        auto opposite = [&](uint h) noexcept {
+            return loop_subdiv_corner(mesh.triangles[h / 3u], (h + 2u) % 3u);
+        };
+
+        // mark the edges to split, which become the odd vertex indices after the scan
+        luisa::vector<uint> odd_indices(edge_count + 1u, options.adaptive ? 0u : 1u);
+        odd_indices.back() = 0u;
+        if (options.adaptive) {
+            auto face_normal = [&](uint t) noexcept {
+                auto tri = mesh.triangles[t];
+                auto p0 = positions[tri.i0];
+                return cross(positions[tri.i1] - p0, positions[tri.i2] - p0);
+            };
+            loop_subdiv_for(edge_count, parallel, [&](uint e) noexcept {
+                auto edge = topology.edges[e];
+                auto split = options.max_edge_length > 0.f &&
+                             length(positions[edge.y] - positions[edge.x]) > options.max_edge_length;
+                if (!split && options.max_angle > 0.f && topology.edge_face_counts[e] == 2u) {
+                    auto n0 = face_normal(topology.edge_half_edges[e].x / 3u);
+                    auto n1 = face_normal(topology.edge_half_edges[e].y / 3u);
+                    auto l = length(n0) * length(n1);
+                    split = l > 0.f && dot(n0, n1) < cos_max_angle * l;
                 }
+                odd_indices[e] = split ? 1u : 0u;
+            });
+            // red-green closure: triangles with two split edges get the third one split as well
+            for (auto changed = 1u; changed != 0u;) {
+                changed = 0u;
+                loop_subdiv_for(face_count, parallel, [&](uint t) noexcept {
+                    auto count = 0u;
+                    for (auto k = 0u; k < 3u; k++) {
+                        auto e = topology.half_edge_edges[t * 3u + k];
+                        count += std::atomic_ref{odd_indices[e]}.load(std::memory_order_relaxed);
+                    }
+                    if (count == 2u) {
+                        for (auto k = 0u; k < 3u; k++) {
+                            auto e = topology.half_edge_edges[t * 3u + k];
+                            std::atomic_ref{odd_indices[e]}.store(1u, std::memory_order_relaxed);
+                        }
+                        std::atomic_ref{changed}.store(1u, std::memory_order_relaxed);
+                    }
+                });
             }
         }
-
-        // Update new mesh topology
-
-        // Update even vertex face pointers
-        for (auto vertex : v) {
-            auto vertNum = vertex->startFace->vnum(vertex);
-            vertex->child->startFace = vertex->startFace->children[vertNum];
-        }
-
-        // Update face neighbor pointers
-        for (auto face : f) {
-            for (auto j = 0u; j < 3u; j++) {
-                // Update children _f_ pointers for siblings
-                face->children[3]->f[j] = face->children[loop_subdiv_next(j)];
-                face->children[j]->f[loop_subdiv_next(j)] = face->children[3];
-                // Update children _f_ pointers for neighbor children
-                auto f2 = face->f[j];
-                face->children[j]->f[j] =
-                    f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
-                f2 = face->f[loop_subdiv_prev(j)];
-                face->children[j]->f[loop_subdiv_prev(j)] =
-                    f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
+        auto odd_count = loop_subdiv_scan(odd_indices);
+        if (odd_count == 0u) { break; }
+        auto is_split = [&](uint e) noexcept { return odd_indices[e + 1u] != odd_indices[e]; };
+
+        // even vertices move only when all their edges are split, so that the unrefined faces keep their shape
+        luisa::vector<float3> next_positions(vertex_count + odd_count);
+        luisa::vector<float2> next_uvs(vertex_count + odd_count);
+        loop_subdiv_for(vertex_count, parallel, [&](uint v) noexcept {
+            auto ends = topology.vertex_edges[v];
+            auto refined = std::all_of(ends.begin(), ends.end(), [&](auto i) noexcept { return is_split(i / 2u); });
+            next_positions[v] = refined ?
+                                    loop_subdiv_vertex_mask(topology, positions, v, loop_subdiv_beta, 1.f / 8.f) :
+                                    positions[v];
+            next_uvs[v] = uvs[v];
+        });
+        loop_subdiv_for(edge_count, parallel, [&](uint e) noexcept {
+            if (!is_split(e)) { return; }
+            auto edge = topology.edges[e];
+            auto p = .5f * (positions[edge.x] + positions[edge.y]);
+            if (topology.edge_face_counts[e] == 2u) {
+                auto c = opposite(topology.edge_half_edges[e].x);
+                auto d = opposite(topology.edge_half_edges[e].y);
+                p = 3.f / 8.f * (positions[edge.x] + positions[edge.y]) +
+                    1.f / 8.f * (positions[c] + positions[d]);
             }
-        }
-
-        // Update face vertex pointers
-        for (auto face : f) {
-            for (int j = 0u; j < 3u; ++j) {
-                // Update child vertex pointer to new even vertex
-                face->children[j]->v[j] = face->v[j]->child;
-                // Update child vertex pointer to new odd vertex
-                auto vert = edgeVerts[SDEdge(face->v[j], face->v[loop_subdiv_next(j)])];
-                face->children[j]->v[loop_subdiv_next(j)] = vert;
-                face->children[loop_subdiv_next(j)]->v[j] = vert;
-                face->children[3u]->v[j] = vert;
+            auto v = vertex_count + odd_indices[e];
+            next_positions[v] = p;
+            next_uvs[v] = .5f * (uvs[edge.x] + uvs[edge.y]);
+        });
+
+        // faces with three split edges are split into four, and those with one into two
+        luisa::vector<uint> child_offsets(face_count + 1u, 0u);
+        loop_subdiv_for(face_count, parallel, [&](uint t) noexcept {
+            auto count = 0u;
+            for (auto k = 0u; k < 3u; k++) {
+                if (is_split(topology.half_edge_edges[t * 3u + k])) { count++; }
             }
-        }
-
-        // Prepare for next level of subdivision
-        f = std::move(newFaces);
-        v = std::move(newVertices);
-    }
-
-    // Push vertices to limit surface
-    luisa::vector<float3> pLimit(v.size());
-    for (auto i = 0u; i < v.size(); i++) {
-        pLimit[i] = v[i]->boundary ?
-                        weightBoundary(v[i], 1.f / 5.f) :
-                        weightOneRing(v[i], loopGamma(v[i]->valence()));
-    }
-    for (auto i = 0u; i < v.size(); i++) { v[i]->set_p(pLimit[i]); }
-
-    // Compute vertex tangents on limit surface
-    luisa::vector<float3> pRing(16u);
-    luisa::vector<float3> nLimit(v.size());
-    for (auto i = 0u; i < v.size(); i++) {
-        auto S = make_float3();
-        auto T = make_float3();
-        auto vertex = v[i];
-        auto valence = vertex->valence();
-        if (valence > pRing.size()) { pRing.resize(valence); }
-        vertex->oneRing(pRing.data());
-        if (!vertex->boundary) {
-            // Compute tangents of interior face
-            for (auto j = 0u; j < valence; j++) {
-                S += std::cos(2.f * pi * static_cast<float>(j) / static_cast<float>(valence)) * pRing[j];
-                T += std::sin(2.f * pi * static_cast<float>(j) / static_cast<float>(valence)) * pRing[j];
+            child_offsets[t] = count == 0u ? 1u : (count == 1u ? 2u : 4u);
+        });
+        auto child_count = loop_subdiv_scan(child_offsets);
+        luisa::vector<Triangle> next_triangles(child_count);
+        luisa::vector<uint> next_base_triangle_indices(child_count);
+        loop_subdiv_for(face_count, parallel, [&](uint t) noexcept {
+            auto tri = mesh.triangles[t];
+            uint v[3]{tri.i0, tri.i1, tri.i2};
+            uint o[3]{~0u, ~0u, ~0u};
+            auto count = 0u;
+            auto last = 0u;
+            for (auto k = 0u; k < 3u; k++) {
+                if (auto e = topology.half_edge_edges[t * 3u + k]; is_split(e)) {
+                    o[k] = vertex_count + odd_indices[e];
+                    count++;
+                    last = k;
+                }
             }
-        } else {
-            // Compute tangents of boundary face
-            S = pRing[valence - 1u] - pRing[0u];
-            if (valence == 2u) {
-                T = pRing[0] + pRing[1u] - 2.f * vertex->p();
-            } else if (valence == 3u) {
-                T = pRing[1u] - vertex->p();
-            } else if (valence == 4u) {// regular
-                T = -1.f * pRing[0u] + 2.f * pRing[1u] + 2.f * pRing[2u] - 1.f * pRing[3] - 2.f * vertex->p();
+            auto child = child_offsets[t];
+            auto emit = [&](uint a, uint b, uint c) noexcept {
+                next_triangles[child] = Triangle{a, b, c};
+                next_base_triangle_indices[child] = mesh.base_triangle_indices[t];
+                child++;
+            };
+            if (count == 3u) {
+                emit(v[0], o[0], o[2]);
+                emit(o[0], v[1], o[1]);
+                emit(o[2], o[1], v[2]);
+                emit(o[0], o[1], o[2]);
+            } else if (count == 1u) {
+                auto k = last;
+                emit(v[k], o[k], v[(k + 2u) % 3u]);
+                emit(o[k], v[(k + 1u) % 3u], v[(k + 2u) % 3u]);
             } else {
-                auto theta = pi / float(valence - 1u);
-                T = std::sin(theta) * (pRing[0] + pRing[valence - 1u]);
-                for (auto k = 1u; k < valence - 1u; k++) {
-                    auto wt = (2.f * std::cos(theta) - 2.f) * std::sin(static_cast<float>(k) * theta);
-                    T += wt * pRing[k];
-                }
-                T = -T;
+                emit(v[0], v[1], v[2]);
             }
-        }
-        nLimit[i] = normalize(cross(T, S));
+        });
+        positions = std::move(next_positions);
+        uvs = std::move(next_uvs);
+        mesh.triangles = std::move(next_triangles);
+        mesh.base_triangle_indices = std::move(next_base_triangle_indices);
+        vertex_count += odd_count;
     }
 
-    // Create triangle mesh from subdivision mesh
-    SubdivMesh mesh;
-    mesh.vertices.resize(v.size());
-    mesh.triangles.resize(f.size());
-    mesh.base_triangle_indices.resize(f.size());
-    luisa::unordered_map<SDVertex *, uint> usedVerts;
-    for (auto i = 0u; i < v.size(); i++) {
-        usedVerts[v[i]] = i;
-        auto p = pLimit[i];
-        auto n = nLimit[i];
-        // FIXME: uv
-        mesh.vertices[i] = Vertex::encode(p, n, make_float2(0.f));
-    }
-    for (auto i = 0u; i < f.size(); ++i) {
-        mesh.triangles[i] = {usedVerts[f[i]->v[0u]],
-                             usedVerts[f[i]->v[1u]],
-                             usedVerts[f[i]->v[2u]]};
-        mesh.base_triangle_indices[i] = f[i]->baseTriangle;
-    }
+    // push the vertices to the limit surface and take the area-weighted face normals there
+    auto topology = loop_subdiv_topology(vertex_count, mesh.triangles, parallel);
+    luisa::vector<float3> limit_positions(vertex_count);
+    loop_subdiv_for(vertex_count, parallel, [&](uint v) noexcept {
+        limit_positions[v] = loop_subdiv_vertex_mask(topology, positions, v, loop_subdiv_gamma, 1.f / 5.f);
+    });
+    auto vertex_faces = loop_subdiv_adjacency(
+        vertex_count, static_cast<uint>(mesh.triangles.size() * 3u), parallel,
+        [&](uint h) noexcept { return loop_subdiv_corner(mesh.triangles[h / 3u], h % 3u); });
+    mesh.vertices.resize(vertex_count);
+    loop_subdiv_for(vertex_count, parallel, [&](uint v) noexcept {
+        auto n = make_float3();
+        for (auto h : vertex_faces[v]) {
+            auto t = mesh.triangles[h / 3u];
+            auto p0 = limit_positions[t.i0];
+            n += cross(limit_positions[t.i1] - p0, limit_positions[t.i2] - p0);
+        }
+        n = length_squared(n) > 0.f ? normalize(n) : make_float3(0.f, 0.f, 1.f);
+        mesh.vertices[v] = Vertex::encode(limit_positions[v], n, uvs[v]);
+    });
     return mesh;
 }
 
-static float3 weightOneRing(SDVertex *vert, float beta) noexcept {
-    // Put _vert_ one-ring in _pRing_
-    auto valence = vert->valence();
-    luisa::fixed_vector<float3, 16u> pRing(valence);
-    vert->oneRing(pRing.data());
-    auto p = (1.f - static_cast<float>(valence) * beta) * vert->p();
-    for (auto i = 0u; i < valence; i++) { p += beta * pRing[i]; }
-    return p;
-}
-
-void SDVertex::oneRing(float3 *pp) noexcept {
-    if (!boundary) {
-        // Get one-ring vertices for interior vertex
-        auto face = startFace;
-        do {
-            *pp++ = face->nextVert(this)->p();
-            face = face->nextFace(this);
-        } while (face != startFace);
-    } else {
-        // Get one-ring vertices for boundary vertex
-        auto face = startFace;
-        SDFace *f2{nullptr};
-        while ((f2 = face->nextFace(this)) != nullptr) { face = f2; }
-        *pp++ = face->nextVert(this)->p();
-        do {
-            *pp++ = face->prevVert(this)->p();
-            face = face->prevFace(this);
-        } while (face != nullptr);
-    }
-}
-
-static float3 weightBoundary(SDVertex *vert, float beta) noexcept {
-    // Put _vert_ one-ring in _pRing_
-    auto valence = vert->valence();
-    luisa::fixed_vector<float3, 16u> pRing(valence);
-    vert->oneRing(pRing.data());
-    return (1.f - 2.f * beta) * vert->p() +
-           beta * pRing[0] +
-           beta * pRing[valence - 1];
+SubdivMesh loop_subdivide(luisa::span<const Vertex> vertices,
+                          luisa::span<const Triangle> triangles,
+                          uint level) noexcept {
+    return loop_subdivide(vertices, triangles, LoopSubdivOptions{.level = level});
 }
 
 }// namespace luisa::render
@@ -18,6 +18,26 @@ struct SubdivMesh {
     luisa::vector<uint> base_triangle_indices;
 };
 
+struct LoopSubdivOptions {
+    // maximum number of refinement passes
+    uint level{1u};
+    // only split edges longer than `max_edge_length` or whose adjacent faces bend by more
+    // than `max_angle` (in radians), with red-green closure; zero disables a criterion
+    bool adaptive{false};
+    float max_edge_length{0.f};
+    float max_angle{0.f};
+    // split the passes over the global thread pool; the calling thread takes part in
+    // the work, so it never waits on pool tasks that might be blocked themselves
+    bool parallel{false};
+};
+
+// Loop subdivision on flat index arrays, with the vertices pushed to the limit surface.
+// UVs are interpolated linearly and UV seams are kept as boundaries.
+[[nodiscard]] SubdivMesh loop_subdivide(luisa::span<const Vertex> vertices,
+                                        luisa::span<const Triangle> triangles,
+                                        const LoopSubdivOptions &options) noexcept;
+
+// uniform subdivision on the calling thread
 [[nodiscard]] SubdivMesh loop_subdivide(luisa::span<const Vertex> vertices,
                                         luisa::span<const Triangle> triangles,
                                         uint level) noexcept;
@@ -0,0 +1,128 @@
+#include <fstream>
+#include <random>
+#include <thread>
+
+#if defined(LUISA_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <core/logging.h>
+#include <util/mapped_file.h>
+
+namespace luisa::render {
+
+void MappedFile::_unmap() noexcept {
+    if (_data == nullptr) { return; }
+#if defined(LUISA_PLATFORM_WINDOWS)
+    UnmapViewOfFile(_data);
+    CloseHandle(static_cast<HANDLE>(_handle));
+#else
+    munmap(_data, _size);
+#endif
+    _data = nullptr;
+    _size = 0u;
+    _handle = nullptr;
+}
+
+MappedFile::~MappedFile() noexcept { _unmap(); }
+
+MappedFile::MappedFile(MappedFile &&another) noexcept
+    : _data{std::exchange(another._data, nullptr)},
+      _size{std::exchange(another._size, 0u)},
+      _handle{std::exchange(another._handle, nullptr)} {}
+
+MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept {
+    if (&rhs != this) [[likely]] {
+        _unmap();
+        _data = std::exchange(rhs._data, nullptr);
+        _size = std::exchange(rhs._size, 0u);
+        _handle = std::exchange(rhs._handle, nullptr);
+    }
+    return *this;
+}
+
+MappedFile MappedFile::open(const std::filesystem::path &path) noexcept {
+#if defined(LUISA_PLATFORM_WINDOWS)
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return {}; }
+    LARGE_INTEGER file_size{};
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return {};
+    }
+    auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) { return {}; }
+    auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        return {};
+    }
+    return {data, static_cast<size_t>(file_size.QuadPart), mapping};
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return {}; }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return {};
+    }
+    auto size = static_cast<size_t>(st.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) { return {}; }
+    return {data, size, nullptr};
+#endif
+}
+
+bool write_file_atomic(const std::filesystem::path &path,
+                       luisa::span<const luisa::span<const std::byte>> chunks) noexcept {
+    std::error_code ec;
+    if (auto folder = path.parent_path();
+        !folder.empty() && !std::filesystem::exists(folder, ec)) {
+        std::filesystem::create_directories(folder, ec);
+    }
+    // a unique temporary name so that concurrent writers never clobber each other
+    auto tmp_path = path;
+    tmp_path += luisa::format(
+        ".{:016x}.tmp",
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+            std::random_device{}());
+    {
+        std::ofstream file{tmp_path, std::ios::binary};
+        if (!file) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Failed to open '{}' for writing.",
+                tmp_path.string());
+            return false;
+        }
+        for (auto chunk : chunks) {
+            file.write(reinterpret_cast<const char *>(chunk.data()),
+                       static_cast<std::streamsize>(chunk.size()));
+        }
+        if (!file) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Failed to write '{}'.", tmp_path.string());
+            file.close();
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to rename '{}' to '{}': {}.",
+            tmp_path.string(), path.string(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+}// namespace luisa::render
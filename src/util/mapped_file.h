@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+
+#include <core/stl.h>
+
+namespace luisa::render {
+
+// read-only memory mapping of a whole file
+class MappedFile {
+
+private:
+    void *_data{nullptr};
+    size_t _size{0u};
+    void *_handle{nullptr};// file mapping handle on Windows
+
+private:
+    MappedFile(void *data, size_t size, void *handle) noexcept
+        : _data{data}, _size{size}, _handle{handle} {}
+    void _unmap() noexcept;
+
+public:
+    MappedFile() noexcept = default;
+    ~MappedFile() noexcept;
+    MappedFile(MappedFile &&another) noexcept;
+    MappedFile &operator=(MappedFile &&rhs) noexcept;
+    MappedFile(const MappedFile &) noexcept = delete;
+    MappedFile &operator=(const MappedFile &) noexcept = delete;
+    // returns an invalid mapping if the file does not exist or cannot be mapped
+    [[nodiscard]] static MappedFile open(const std::filesystem::path &path) noexcept;
+    [[nodiscard]] auto data() const noexcept { return static_cast<const std::byte *>(_data); }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] auto bytes() const noexcept { return luisa::span{data(), size()}; }
+    [[nodiscard]] explicit operator bool() const noexcept { return _data != nullptr; }
+};
+
+// atomically replaces the file at `path` by writing to a temporary file and renaming it
+bool write_file_atomic(const std::filesystem::path &path,
+                       luisa::span<const luisa::span<const std::byte>> chunks) noexcept;
+
+}// namespace luisa::render
@@ -0,0 +1,232 @@
+#include <queue>
+#include <util/mesh_simplify.h>
+
+namespace luisa::render {
+
+namespace detail {
+
+// symmetric 4x4 matrix of the squared distances to a set of planes, upper triangle only
+struct Quadric {
+
+    std::array<double, 10u> m{};
+
+    // the plane is dot(n, p) + d = 0 with a unit normal
+    void add_plane(float3 n, float3 p, double w) noexcept {
+        auto nx = static_cast<double>(n.x);
+        auto ny = static_cast<double>(n.y);
+        auto nz = static_cast<double>(n.z);
+        auto d = -(nx * p.x + ny * p.y + nz * p.z);
+        m[0] += w * nx * nx;
+        m[1] += w * nx * ny;
+        m[2] += w * nx * nz;
+        m[3] += w * nx * d;
+        m[4] += w * ny * ny;
+        m[5] += w * ny * nz;
+        m[6] += w * ny * d;
+        m[7] += w * nz * nz;
+        m[8] += w * nz * d;
+        m[9] += w * d * d;
+    }
+    void add(const Quadric &q) noexcept {
+        for (auto i = 0u; i < m.size(); i++) { m[i] += q.m[i]; }
+    }
+    [[nodiscard]] auto evaluate(float3 p) const noexcept {
+        auto x = static_cast<double>(p.x);
+        auto y = static_cast<double>(p.y);
+        auto z = static_cast<double>(p.z);
+        return m[0] * x * x + 2. * m[1] * x * y + 2. * m[2] * x * z + 2. * m[3] * x +
+               m[4] * y * y + 2. * m[5] * y * z + 2. * m[6] * y +
+               m[7] * z * z + 2. * m[8] * z + m[9];
+    }
+};
+
+struct CollapseCandidate {
+    double cost;
+    uint v0;
+    uint v1;
+    uint version0;
+    uint version1;
+    [[nodiscard]] auto operator>(const CollapseCandidate &rhs) const noexcept { return cost > rhs.cost; }
+};
+
+// relative to the squared length of the border edge
+static constexpr auto simplify_border_weight = 16.;
+
+}// namespace detail
+
+SimplifiedMesh simplify_mesh(luisa::span<const Vertex> vertices,
+                             luisa::span<const Triangle> triangles,
+                             size_t target_triangle_count) noexcept {
+
+    using detail::CollapseCandidate;
+    using detail::Quadric;
+
+    auto vertex_count = static_cast<uint>(vertices.size());
+    luisa::vector<float3> positions(vertex_count);
+    luisa::vector<float3> normals(vertex_count);
+    luisa::vector<float2> uvs(vertex_count);
+    for (auto i = 0u; i < vertex_count; i++) {
+        positions[i] = vertices[i].position();
+        normals[i] = vertices[i].normal();
+        uvs[i] = vertices[i].uv();
+    }
+    luisa::vector<Triangle> faces{triangles.begin(), triangles.end()};
+    luisa::vector<bool> face_alive(faces.size(), true);
+    luisa::vector<bool> vertex_alive(vertex_count, true);
+    luisa::vector<uint> versions(vertex_count, 0u);
+    luisa::vector<luisa::vector<uint>> vertex_faces(vertex_count);
+    auto face_normal = [&](const Triangle &t) noexcept {
+        auto p0 = positions[t.i0];
+        return cross(positions[t.i1] - p0, positions[t.i2] - p0);
+    };
+
+    // area-weighted plane quadrics of the faces, plus penalty planes along the borders
+    luisa::vector<Quadric> quadrics(vertex_count);
+    luisa::unordered_map<uint64_t, uint> edge_uses;
+    auto edge_key = [](uint a, uint b) noexcept {
+        return (static_cast<uint64_t>(std::min(a, b)) << 32u) | std::max(a, b);
+    };
+    auto live_faces = faces.size();
+    for (auto f = 0u; f < faces.size(); f++) {
+        auto t = faces[f];
+        uint v[3]{t.i0, t.i1, t.i2};
+        for (auto k = 0u; k < 3u; k++) {
+            vertex_faces[v[k]].emplace_back(f);
+            edge_uses[edge_key(v[k], v[(k + 1u) % 3u])]++;
+        }
+        auto n = face_normal(t);
+        if (auto l = length(n); l > 0.f) {
+            for (auto k : v) { quadrics[k].add_plane(n / l, positions[t.i0], .5 * l); }
+        }
+    }
+    for (auto &&t : faces) {
+        auto n = face_normal(t);
+        if (length_squared(n) == 0.f) { continue; }
+        uint v[3]{t.i0, t.i1, t.i2};
+        for (auto k = 0u; k < 3u; k++) {
+            auto a = v[k];
+            auto b = v[(k + 1u) % 3u];
+            if (edge_uses[edge_key(a, b)] != 1u) { continue; }
+            auto e = positions[b] - positions[a];
+            auto nb = cross(e, n);
+            if (auto l = length(nb); l > 0.f) {
+                auto w = detail::simplify_border_weight * static_cast<double>(length_squared(e));
+                quadrics[a].add_plane(nb / l, positions[a], w);
+                quadrics[b].add_plane(nb / l, positions[a], w);
+            }
+        }
+    }
+
+    // the collapsed vertex is placed at either end or at the midpoint, whichever is cheapest
+    std::priority_queue<CollapseCandidate, luisa::vector<CollapseCandidate>, std::greater<>> candidates;
+    auto placement = [&](uint a, uint b) noexcept {
+        auto q = quadrics[a];
+        q.add(quadrics[b]);
+        auto best = std::make_pair(q.evaluate(positions[a]), 0.f);
+        for (auto t : {1.f, .5f}) {
+            if (auto cost = q.evaluate(lerp(positions[a], positions[b], t)); cost < best.first) {
+                best = std::make_pair(cost, t);
+            }
+        }
+        return best;
+    };
+    auto push_candidate = [&](uint a, uint b) noexcept {
+        auto cost = std::max(placement(a, b).first, 0.);
+        candidates.push(CollapseCandidate{cost, a, b, versions[a], versions[b]});
+    };
+    for (auto [key, uses] : edge_uses) {
+        push_candidate(static_cast<uint>(key >> 32u), static_cast<uint>(key & 0xffffffffu));
+    }
+    edge_uses = {};
+
+    luisa::vector<uint> ring;
+    while (live_faces > target_triangle_count && !candidates.empty()) {
+        auto c = candidates.top();
+        candidates.pop();
+        if (!vertex_alive[c.v0] || !vertex_alive[c.v1] ||
+            versions[c.v0] != c.version0 || versions[c.v1] != c.version1) { continue; }
+        auto [cost, t] = placement(c.v0, c.v1);
+        auto p = lerp(positions[c.v0], positions[c.v1], t);
+        // reject collapses that flip or degenerate the surviving faces around either end
+        auto flips = false;
+        for (auto v : {c.v0, c.v1}) {
+            for (auto f : vertex_faces[v]) {
+                if (!face_alive[f]) { continue; }
+                auto tri = faces[f];
+                auto has_v0 = tri.i0 == c.v0 || tri.i1 == c.v0 || tri.i2 == c.v0;
+                auto has_v1 = tri.i0 == c.v1 || tri.i1 == c.v1 || tri.i2 == c.v1;
+                if (has_v0 && has_v1) { continue; }
+                auto old_n = face_normal(tri);
+                auto moved = tri;
+                if (moved.i0 == v) { moved.i0 = c.v0; }
+                if (moved.i1 == v) { moved.i1 = c.v0; }
+                if (moved.i2 == v) { moved.i2 = c.v0; }
+                auto saved = positions[c.v0];
+                positions[c.v0] = p;
+                auto new_n = face_normal(moved);
+                positions[c.v0] = saved;
+                if (dot(old_n, new_n) <= 0.f) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips) { break; }
+        }
+        if (flips) { continue; }
+        // merge v1 into v0
+        positions[c.v0] = p;
+        auto n = lerp(normals[c.v0], normals[c.v1], t);
+        normals[c.v0] = length_squared(n) > 0.f ? normalize(n) : normals[c.v0];
+        uvs[c.v0] = lerp(uvs[c.v0], uvs[c.v1], t);
+        quadrics[c.v0].add(quadrics[c.v1]);
+        vertex_alive[c.v1] = false;
+        versions[c.v0]++;
+        for (auto f : vertex_faces[c.v1]) {
+            if (!face_alive[f]) { continue; }
+            auto &&tri = faces[f];
+            auto has_v0 = tri.i0 == c.v0 || tri.i1 == c.v0 || tri.i2 == c.v0;
+            if (has_v0) {
+                face_alive[f] = false;
+                live_faces--;
+                continue;
+            }
+            if (tri.i0 == c.v1) { tri.i0 = c.v0; }
+            if (tri.i1 == c.v1) { tri.i1 = c.v0; }
+            if (tri.i2 == c.v1) { tri.i2 = c.v0; }
+            vertex_faces[c.v0].emplace_back(f);
+        }
+        vertex_faces[c.v1] = {};
+        // drop the dead faces and re-queue the edges of the one-ring
+        auto &&fs = vertex_faces[c.v0];
+        fs.erase(std::remove_if(fs.begin(), fs.end(), [&](auto f) noexcept { return !face_alive[f]; }), fs.end());
+        ring.clear();
+        for (auto f : fs) {
+            for (auto v : {faces[f].i0, faces[f].i1, faces[f].i2}) {
+                if (v != c.v0) { ring.emplace_back(v); }
+            }
+        }
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+        for (auto v : ring) { push_candidate(c.v0, v); }
+    }
+
+    // compact the surviving vertices and faces
+    SimplifiedMesh mesh;
+    luisa::vector<uint> remap(vertex_count, ~0u);
+    mesh.triangles.reserve(live_faces);
+    for (auto f = 0u; f < faces.size(); f++) {
+        if (!face_alive[f]) { continue; }
+        auto t = faces[f];
+        for (auto v : {&t.i0, &t.i1, &t.i2}) {
+            if (remap[*v] == ~0u) {
+                remap[*v] = static_cast<uint>(mesh.vertices.size());
+                mesh.vertices.emplace_back(Vertex::encode(positions[*v], normals[*v], uvs[*v]));
+            }
+            *v = remap[*v];
+        }
+        mesh.triangles.emplace_back(t);
+    }
+    return mesh;
+}
+
+}// namespace luisa::render
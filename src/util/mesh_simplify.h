@@ -0,0 +1,24 @@
+#pragma once
+
+#include <core/stl.h>
+#include <runtime/rtx/triangle.h>
+#include <util/vertex.h>
+
+namespace luisa::render {
+
+using compute::Triangle;
+
+struct SimplifiedMesh {
+    luisa::vector<Vertex> vertices;
+    luisa::vector<Triangle> triangles;
+};
+
+// Edge-collapse simplification driven by quadric error metrics (Garland and Heckbert 1997).
+// Open borders, including UV and normal seams where vertices are split, are preserved by
+// penalty quadrics, and collapses that would flip a triangle are rejected, so the result
+// may keep more than `target_triangle_count` triangles.
+[[nodiscard]] SimplifiedMesh simplify_mesh(luisa::span<const Vertex> vertices,
+                                           luisa::span<const Triangle> triangles,
+                                           size_t target_triangle_count) noexcept;
+
+}// namespace luisa::render
@@ -197,4 +197,9 @@ Float sample_exponential(Expr<float> u, Expr<float> a) noexcept {
     return -log(1.f - u) / a;
 }
 
+Float sample_stratified_1d(Expr<float> u, Expr<uint> i, Expr<uint> n) noexcept {
+    static constexpr auto one_minus_epsilon = 0x1.fffffep-1f;
+    return min((cast<float>(i) + u) / cast<float>(n), one_minus_epsilon);
+}
+
 }// namespace luisa::render
@@ -74,6 +74,8 @@ template<typename ProbTable, typename AliasTable>
 [[nodiscard]] UInt sample_discrete(Expr<float3> weights, Expr<float> u) noexcept;
 [[nodiscard]] UInt sample_discrete(const SampledSpectrum &weights, Expr<float> u) noexcept;
 [[nodiscard]] Float sample_exponential(Expr<float> u, Expr<float> a) noexcept;
+// maps u into the i-th of n equal strata of [0, 1)
+[[nodiscard]] Float sample_stratified_1d(Expr<float> u, Expr<uint> i, Expr<uint> n) noexcept;
 
 }// namespace luisa::render
 
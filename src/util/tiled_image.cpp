@@ -0,0 +1,153 @@
+#include <core/clock.h>
+#include <core/logging.h>
+#include <util/tiled_image.h>
+
+namespace luisa::render {
+
+static constexpr auto tiled_image_magic = 0x4c4954415349554cull;// "LUISATIL" in little-endian
+static constexpr auto tiled_image_version = 1u;
+
+luisa::optional<TiledImage> TiledImage::open(const std::filesystem::path &path) noexcept {
+    auto file = MappedFile::open(path);
+    if (!file || file.size() < sizeof(Header)) { return luisa::nullopt; }
+    Header header{};
+    std::memcpy(&header, file.data(), sizeof(Header));
+    auto valid = header.magic == tiled_image_magic &&
+                 header.version == tiled_image_version &&
+                 header.levels != 0u && header.tile_size != 0u &&
+                 (header.texel_words == 1u || header.texel_words == 4u);
+    if (valid) {
+        auto padded = static_cast<size_t>(header.tile_size + 2u);
+        auto expected_size = sizeof(Header) +
+                             header.levels * sizeof(uint4) +
+                             header.tile_count * padded * padded * header.texel_words * sizeof(uint);
+        valid = file.size() == expected_size;
+    }
+    if (!valid) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Ignoring invalid tiled image '{}'.",
+            path.string());
+        return luisa::nullopt;
+    }
+    return luisa::make_optional(TiledImage{std::move(file)});
+}
+
+namespace detail {
+
+[[nodiscard]] static auto tiled_image_load_texels(const LoadedImage &image) noexcept {
+    luisa::vector<float4> texels(image.pixel_count());
+    for (auto i = 0u; i < texels.size(); i++) { texels[i] = image.texel(i); }
+    return texels;
+}
+
+[[nodiscard]] static auto tiled_image_downsample(luisa::span<const float4> src, uint2 src_size,
+                                                 bool srgb) noexcept {
+    constexpr auto to_linear = [](float x) noexcept {
+        return x <= 0.04045f ? x * (1.f / 12.92f) : std::pow((x + 0.055f) * (1.f / 1.055f), 2.4f);
+    };
+    constexpr auto to_srgb = [](float x) noexcept {
+        return x <= 0.0031308f ? 12.92f * x : 1.055f * std::pow(x, 1.f / 2.4f) - 0.055f;
+    };
+    auto dst_size = max(src_size / 2u, make_uint2(1u));
+    luisa::vector<float4> dst(dst_size.x * dst_size.y);
+    for (auto y = 0u; y < dst_size.y; y++) {
+        for (auto x = 0u; x < dst_size.x; x++) {
+            auto sum = make_float4(0.f);
+            for (auto dy = 0u; dy < 2u; dy++) {
+                for (auto dx = 0u; dx < 2u; dx++) {
+                    auto sx = std::min(x * 2u + dx, src_size.x - 1u);
+                    auto sy = std::min(y * 2u + dy, src_size.y - 1u);
+                    auto v = src[sy * src_size.x + sx];
+                    if (srgb) { v = make_float4(to_linear(v.x), to_linear(v.y), to_linear(v.z), v.w); }
+                    sum += v;
+                }
+            }
+            auto v = sum * .25f;
+            if (srgb) { v = make_float4(to_srgb(v.x), to_srgb(v.y), to_srgb(v.z), v.w); }
+            dst[y * dst_size.x + x] = v;
+        }
+    }
+    return std::make_pair(std::move(dst), dst_size);
+}
+
+// returns -1 for texels outside the image with the ZERO address mode
+[[nodiscard]] static auto tiled_image_address(int x, int n, TiledImage::Address address) noexcept {
+    switch (address) {
+        case TiledImage::Address::EDGE: return std::clamp(x, 0, n - 1);
+        case TiledImage::Address::REPEAT: return (x % n + n) % n;
+        case TiledImage::Address::MIRROR: {
+            auto m = (x % (2 * n) + 2 * n) % (2 * n);
+            return m < n ? m : 2 * n - 1 - m;
+        }
+        case TiledImage::Address::ZERO: return x >= 0 && x < n ? x : -1;
+    }
+    return std::clamp(x, 0, n - 1);
+}
+
+}// namespace detail
+
+bool TiledImage::convert(const LoadedImage &image, const std::filesystem::path &path,
+                         uint tile_size, Address address, bool srgb) noexcept {
+    Clock clock;
+    auto storage = image.pixel_storage();
+    auto is_ldr = storage == LoadedImage::storage_type::BYTE1 ||
+                  storage == LoadedImage::storage_type::BYTE2 ||
+                  storage == LoadedImage::storage_type::BYTE4;
+    Header header{.magic = tiled_image_magic,
+                  .version = tiled_image_version,
+                  .levels = 0u,
+                  .tile_size = tile_size,
+                  .texel_words = is_ldr ? 1u : 4u,
+                  .channels = image.channels(),
+                  .tile_count = 0u};
+    auto padded = tile_size + 2u;
+    auto tile_words = padded * padded * header.texel_words;
+    luisa::vector<uint4> level_table;
+    luisa::vector<uint> tile_data;
+    auto texels = detail::tiled_image_load_texels(image);
+    auto size = image.size();
+    for (;;) {
+        auto tiles = (size + tile_size - 1u) / tile_size;
+        level_table.emplace_back(make_uint4(size, tiles.x, header.tile_count));
+        header.tile_count += tiles.x * tiles.y;
+        tile_data.resize(static_cast<size_t>(header.tile_count) * tile_words);
+        auto level_data = tile_data.data() + static_cast<size_t>(level_table.back().w) * tile_words;
+        for (auto ty = 0u; ty < tiles.y; ty++) {
+            for (auto tx = 0u; tx < tiles.x; tx++) {
+                auto tile = level_data + static_cast<size_t>(ty * tiles.x + tx) * tile_words;
+                for (auto py = 0u; py < padded; py++) {
+                    for (auto px = 0u; px < padded; px++) {
+                        auto x = detail::tiled_image_address(static_cast<int>(tx * tile_size + px) - 1,
+                                                             static_cast<int>(size.x), address);
+                        auto y = detail::tiled_image_address(static_cast<int>(ty * tile_size + py) - 1,
+                                                             static_cast<int>(size.y), address);
+                        auto v = x < 0 || y < 0 ? make_float4(0.f) : texels[y * size.x + x];
+                        auto texel = tile + (py * padded + px) * header.texel_words;
+                        if (is_ldr) {
+                            auto q = make_uint4(clamp(v * 255.f + .5f, 0.f, 255.f));
+                            texel[0] = q.x | (q.y << 8u) | (q.z << 16u) | (q.w << 24u);
+                        } else {
+                            std::memcpy(texel, &v, sizeof(float4));
+                        }
+                    }
+                }
+            }
+        }
+        if (all(size == 1u)) { break; }
+        auto [next, next_size] = detail::tiled_image_downsample(texels, size, srgb && is_ldr);
+        texels = std::move(next);
+        size = next_size;
+    }
+    header.levels = static_cast<uint>(level_table.size());
+    std::array chunks{std::as_bytes(luisa::span{&header, 1u}),
+                      std::as_bytes(luisa::span{level_table}),
+                      std::as_bytes(luisa::span{tile_data})};
+    if (!write_file_atomic(path, chunks)) { return false; }
+    LUISA_INFO("Converted {}x{} image into tiled image '{}' "
+               "({} levels, {} tiles) in {} ms.",
+               image.size().x, image.size().y, path.string(),
+               header.levels, header.tile_count, clock.toc());
+    return true;
+}
+
+}// namespace luisa::render
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <filesystem>
+
+#include <core/stl.h>
+#include <core/basic_types.h>
+#include <util/imageio.h>
+#include <util/mapped_file.h>
+
+namespace luisa::render {
+
+// Pre-converted, mip-mapped image split into fixed-size tiles for on-demand streaming.
+// Each tile carries a one-texel border so that bilinear filtering never crosses tiles.
+// Texels are stored as packed RGBA8 (one word) for 8-bit sources and as RGBA32F (four
+// words) otherwise. The file is memory-mapped, so tile data is paged in by the OS only
+// when it is uploaded to the device.
+class TiledImage {
+
+public:
+    enum struct Address : uint {
+        EDGE,
+        REPEAT,
+        MIRROR,
+        ZERO,
+    };
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t levels;
+        uint32_t tile_size;
+        uint32_t texel_words;
+        uint32_t channels;
+        uint32_t tile_count;
+    };
+
+    static_assert(sizeof(Header) == 32u);
+
+private:
+    MappedFile _file;
+
+private:
+    explicit TiledImage(MappedFile file) noexcept : _file{std::move(file)} {}
+    [[nodiscard]] auto _header() const noexcept { return reinterpret_cast<const Header *>(_file.data()); }
+    [[nodiscard]] auto _level_table() const noexcept { return reinterpret_cast<const uint4 *>(_file.data() + sizeof(Header)); }
+    [[nodiscard]] auto _tile_data() const noexcept {
+        return reinterpret_cast<const uint *>(_file.data() + sizeof(Header) + levels() * sizeof(uint4));
+    }
+
+public:
+    TiledImage() noexcept = default;
+    // returns nullopt if the file is missing or invalid
+    [[nodiscard]] static luisa::optional<TiledImage> open(const std::filesystem::path &path) noexcept;
+    // converts the image into the tiled format and writes it to `path`
+    static bool convert(const LoadedImage &image, const std::filesystem::path &path,
+                        uint tile_size, Address address, bool srgb) noexcept;
+    [[nodiscard]] auto levels() const noexcept { return _header()->levels; }
+    [[nodiscard]] auto tile_size() const noexcept { return _header()->tile_size; }
+    [[nodiscard]] auto padded_tile_size() const noexcept { return tile_size() + 2u; }
+    [[nodiscard]] auto texel_words() const noexcept { return _header()->texel_words; }
+    [[nodiscard]] auto tile_words() const noexcept { return padded_tile_size() * padded_tile_size() * texel_words(); }
+    [[nodiscard]] auto channels() const noexcept { return _header()->channels; }
+    [[nodiscard]] auto tile_count() const noexcept { return _header()->tile_count; }
+    // (width, height, tiles in x, index of the first tile) of each level
+    [[nodiscard]] auto level_table() const noexcept { return luisa::span{_level_table(), levels()}; }
+    [[nodiscard]] auto size() const noexcept {
+        auto l = level_table().front();
+        return make_uint2(l.x, l.y);
+    }
+    [[nodiscard]] auto tile(uint index) const noexcept { return luisa::span{_tile_data() + index * tile_words(), tile_words()}; }
+    [[nodiscard]] explicit operator bool() const noexcept { return static_cast<bool>(_file); }
+};
+
+}// namespace luisa::render
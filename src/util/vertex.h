@@ -6,6 +6,7 @@
 
 #include <concepts>
 #include <dsl/syntax.h>
+#include <util/half.h>
 
 namespace luisa::render {
 
@@ -34,6 +35,18 @@ template<typename T>
     return make_float3(xy, n.z);
 }
 
+// decodes an IEEE 754 binary16 value stored in the low 16 bits of `h`;
+// infinities and NaNs are not preserved as they never appear in vertex data
+template<typename T>
+    requires std::same_as<luisa::compute::expr_value_t<T>, uint>
+[[nodiscard]] inline auto half_decode(T h) noexcept {
+    auto magnitude = h & 0x7fffu;
+    auto normal = luisa::compute::as<float>((magnitude << 13u) + 0x38000000u);
+    auto denormal = luisa::compute::cast<float>(magnitude) * 0x1p-24f;
+    auto x = luisa::compute::ite((magnitude & 0x7c00u) == 0u, denormal, normal);
+    return luisa::compute::ite((h & 0x8000u) != 0u, -x, x);
+}
+
 struct alignas(16) Vertex {
 
     float px;
@@ -55,6 +68,28 @@ struct alignas(16) Vertex {
 
 static_assert(sizeof(Vertex) == 32u);
 
+// Compressed vertex with a full-precision position (the leading float3 is what
+// the acceleration structure builder reads), an octahedral-encoded normal and a
+// half-precision UV. Meshes opt into it with the `compress_vertices` property.
+struct CompressedVertex {
+
+    float px;
+    float py;
+    float pz;
+    uint packed_normal;
+    uint packed_uv;
+
+    [[nodiscard]] static auto encode(const Vertex &v) noexcept {
+        auto uv = clamp(v.uv(), half_min, half_max);
+        return CompressedVertex{v.px, v.py, v.pz,
+                                oct_encode(v.normal()),
+                                float_to_half(uv.x) | (float_to_half(uv.y) << 16u)};
+    }
+    [[nodiscard]] auto position() const noexcept { return make_float3(px, py, pz); }
+};
+
+static_assert(sizeof(CompressedVertex) == 20u);
+
 }// namespace luisa::render
 
 // clang-format off
@@ -63,4 +98,13 @@ LUISA_STRUCT(luisa::render::Vertex, px, py, pz, nx, ny, nz, u, v) {
     [[nodiscard]] auto normal() const noexcept { return make_float3(nx, ny, nz); }
     [[nodiscard]] auto uv() const noexcept { return make_float2(u, v); }
 };
+
+LUISA_STRUCT(luisa::render::CompressedVertex, px, py, pz, packed_normal, packed_uv) {
+    [[nodiscard]] auto position() const noexcept { return make_float3(px, py, pz); }
+    [[nodiscard]] auto normal() const noexcept { return luisa::render::oct_decode(packed_normal); }
+    [[nodiscard]] auto uv() const noexcept {
+        return make_float2(luisa::render::half_decode(packed_uv & 0xffffu),
+                           luisa::render::half_decode(packed_uv >> 16u));
+    }
+};
 // clang-format on